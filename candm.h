@@ -109,7 +109,13 @@
 #define REQ_SELECT_DATA 69
 #define REQ_RELOAD_SOURCES 70
 #define REQ_DOFFSET2 71
-#define N_REQUEST_TYPES 72
+#define REQ_SOURCE_DATA_BY_INDEX 72
+#define REQ_SOURCESTATS_BY_INDEX 73
+#define REQ_SELECT_DATA_BY_INDEX 74
+#define REQ_SCHED_STATS 75
+#define REQ_SUBSCRIBE 76
+#define REQ_SERVER_SOCKET_STATS 77
+#define N_REQUEST_TYPES 78
 
 /* Structure used to exchange timespecs independent of time_t size */
 typedef struct {
@@ -271,6 +277,7 @@ typedef struct {
 #define REQ_ADDSRC_NTS 0x200
 #define REQ_ADDSRC_COPY 0x400
 #define REQ_ADDSRC_EF_EXP1 0x800
+#define REQ_ADDSRC_MONITOR 0x1000
 
 typedef struct {
   uint32_t type;
@@ -370,6 +377,33 @@ typedef struct {
   int32_t EOR;
 } REQ_SelectData;
 
+typedef struct {
+  uint32_t first_index;
+  uint32_t n_sources;
+  int32_t EOR;
+} REQ_SourcesByIndex;
+
+typedef struct {
+  uint32_t first_index;
+  uint32_t reset;
+  int32_t EOR;
+} REQ_SchedStats;
+
+typedef struct {
+  uint32_t first_index;
+  int32_t EOR;
+} REQ_ServerSocketStats;
+
+#define REQ_SUBSCRIBE_TRACKING 0x1
+#define REQ_SUBSCRIBE_SERVER_STATS 0x2
+
+typedef struct {
+  uint32_t reports;
+  Float interval;
+  uint32_t lifetime;
+  int32_t EOR;
+} REQ_Subscribe;
+
 /* ================================================== */
 
 #define PKT_TYPE_CMD_REQUEST 1
@@ -409,7 +443,8 @@ typedef struct {
    (two times), delta offset, and manual timestamp, added new fields and
    flags to NTP source request and report, made length of manual list constant,
    added new commands: authdata, ntpdata, onoffline, refresh, reset,
-   selectdata, serverstats, shutdown, sourcename
+   selectdata, serverstats, shutdown, sourcename, source data, sourcestats
+   and selectdata by index, schedstats, subscribe, server socket stats
  */
 
 #define PROTO_VERSION_NUMBER 6
@@ -476,6 +511,10 @@ typedef struct {
     REQ_NTPSourceName ntp_source_name;
     REQ_AuthData auth_data;
     REQ_SelectData select_data;
+    REQ_SourcesByIndex sources_by_index;
+    REQ_SchedStats sched_stats;
+    REQ_Subscribe subscribe;
+    REQ_ServerSocketStats server_socket_stats;
   } data; /* Command specific parameters */
 
   /* Padding used to prevent traffic amplification.  It only defines the
@@ -518,7 +557,13 @@ typedef struct {
 #define RPY_SERVER_STATS2 22
 #define RPY_SELECT_DATA 23
 #define RPY_SERVER_STATS3 24
-#define N_REPLY_TYPES 25
+#define RPY_SOURCE_DATA_BY_INDEX 25
+#define RPY_SOURCESTATS_BY_INDEX 26
+#define RPY_SELECT_DATA_BY_INDEX 27
+#define RPY_SCHED_STATS 28
+#define RPY_SERVER_STATS4 29
+#define RPY_SERVER_SOCKET_STATS 30
+#define N_REPLY_TYPES 31
 
 /* Status codes */
 #define STT_SUCCESS 0
@@ -578,6 +623,33 @@ typedef struct {
   int32_t EOR;
 } RPY_Source_Data;
 
+/* The records in replies to requests by index have the same layout as the
+   corresponding single-source replies without the EOR field.  Their number
+   is limited by the maximum length of padding in the request. */
+#define MAX_SOURCE_DATA_RECORDS 9
+
+typedef struct {
+  IPAddr ip_addr;
+  int16_t poll;
+  uint16_t stratum;
+  uint16_t state;
+  uint16_t mode;
+  uint16_t flags;
+  uint16_t reachability;
+  uint32_t  since_sample;
+  Float orig_latest_meas;
+  Float latest_meas;
+  Float latest_meas_err;
+} RPY_SourceDataRecord;
+
+typedef struct {
+  uint32_t n_indices;      /* how many sources there are in the server's table */
+  uint32_t next_index;     /* the index 1 beyond those processed on this call */
+  uint32_t n_sources;      /* the number of valid entries in the following array */
+  RPY_SourceDataRecord sources[MAX_SOURCE_DATA_RECORDS];
+  int32_t EOR;
+} RPY_SourceDataByIndex;
+
 typedef struct {
   uint32_t ref_id;
   IPAddr ip_addr;
@@ -610,6 +682,30 @@ typedef struct {
   int32_t EOR;
 } RPY_Sourcestats;
 
+#define MAX_SOURCESTATS_RECORDS 7
+
+typedef struct {
+  uint32_t ref_id;
+  IPAddr ip_addr;
+  uint32_t n_samples;
+  uint32_t n_runs;
+  uint32_t span_seconds;
+  Float sd;
+  Float resid_freq_ppm;
+  Float skew_ppm;
+  Float est_offset;
+  Float est_offset_err;
+  uint32_t n_dropped;
+} RPY_SourcestatsRecord;
+
+typedef struct {
+  uint32_t n_indices;
+  uint32_t next_index;
+  uint32_t n_sources;
+  RPY_SourcestatsRecord sources[MAX_SOURCESTATS_RECORDS];
+  int32_t EOR;
+} RPY_SourcestatsByIndex;
+
 typedef struct {
   Timespec ref_time;
   uint16_t n_samples;
@@ -664,6 +760,11 @@ typedef struct {
   uint32_t ntp_interleaved_hits;
   uint32_t ntp_timestamps;
   uint32_t ntp_span_seconds;
+  uint32_t ntp_sockets;
+  uint32_t ntp_socket_min_hits;
+  uint32_t ntp_socket_max_hits;
+  uint32_t ptp_hits;
+  uint32_t ptp_sent;
   int32_t EOR;
 } RPY_ServerStats;
 
@@ -764,6 +865,7 @@ typedef struct {
 #define RPY_SD_OPTION_PREFER 0x2
 #define RPY_SD_OPTION_TRUST 0x4
 #define RPY_SD_OPTION_REQUIRE 0x8
+#define RPY_SD_OPTION_MONITOR 0x10
 
 typedef struct {
   uint32_t ref_id;
@@ -781,6 +883,74 @@ typedef struct {
   int32_t EOR;
 } RPY_SelectData;
 
+#define MAX_SELECT_DATA_RECORDS 9
+
+typedef struct {
+  uint32_t ref_id;
+  IPAddr ip_addr;
+  uint8_t state_char;
+  uint8_t authentication;
+  uint8_t leap;
+  uint8_t pad;
+  uint16_t conf_options;
+  uint16_t eff_options;
+  uint32_t last_sample_ago;
+  Float score;
+  Float lo_limit;
+  Float hi_limit;
+} RPY_SelectDataRecord;
+
+typedef struct {
+  uint32_t n_indices;
+  uint32_t next_index;
+  uint32_t n_sources;
+  RPY_SelectDataRecord sources[MAX_SELECT_DATA_RECORDS];
+  int32_t EOR;
+} RPY_SelectDataByIndex;
+
+#define MAX_SCHED_HANDLER_STATS 9
+#define MAX_SCHED_HANDLER_NAME_LENGTH 32
+
+#define RPY_SCH_TYPE_TIMEOUT 0
+#define RPY_SCH_TYPE_FILE 1
+
+typedef struct {
+  int8_t name[MAX_SCHED_HANDLER_NAME_LENGTH];
+  uint16_t type;
+  uint16_t pad;
+  uint32_t calls;
+  Float total_time;
+  Float max_time;
+} RPY_SchedHandlerStats;
+
+typedef struct {
+  uint32_t iterations;
+  Float blocked_time;
+  Float busy_time;
+  Float max_busy_time;
+  uint32_t n_indices;      /* how many handlers there are in the server's table */
+  uint32_t next_index;     /* the index 1 beyond those processed on this call */
+  uint32_t n_handlers;     /* the number of valid entries in the following array */
+  RPY_SchedHandlerStats handlers[MAX_SCHED_HANDLER_STATS];
+  int32_t EOR;
+} RPY_SchedStats;
+
+#define MAX_SERVER_SOCKET_STATS 32
+
+typedef struct {
+  uint16_t family;
+  uint16_t pad;
+  uint32_t rx_messages;
+} RPY_ServerSocketStatsRecord;
+
+typedef struct {
+  uint32_t n_indices;      /* how many sockets there are in the server's table */
+  uint32_t next_index;     /* the index 1 beyond those processed on this call */
+  uint32_t n_sockets;      /* the number of valid entries in the following array */
+  RPY_ServerSocketStatsRecord sockets[MAX_SERVER_SOCKET_STATS];
+  int32_t EOR;
+} RPY_ServerSocketStats;
+
 typedef struct {
   uint8_t version;
   uint8_t pkt_type;
@@ -813,6 +983,11 @@ typedef struct {
     RPY_NTPSourceName ntp_source_name;
     RPY_AuthData auth_data;
     RPY_SelectData select_data;
+    RPY_SourceDataByIndex source_data_by_index;
+    RPY_SourcestatsByIndex sourcestats_by_index;
+    RPY_SelectDataByIndex select_data_by_index;
+    RPY_SchedStats sched_stats;
+    RPY_ServerSocketStats server_socket_stats;
   } data; /* Reply specific parameters */
 
 } CMD_Reply;
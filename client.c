@@ -71,6 +71,8 @@ static int source_names = 0;
 
 static int csv_mode = 0;
 
+static int json_mode = 0;
+
 /* ================================================== */
 /* Log a message. This is a minimalistic replacement of the logging.c
    implementation to avoid linking with it and other modules. */
@@ -949,7 +951,8 @@ process_cmd_add_source(CMD_Request *msg, char *line)
           (data.params.sel_options & SRC_SELECT_PREFER ? REQ_ADDSRC_PREFER : 0) |
           (data.params.sel_options & SRC_SELECT_NOSELECT ? REQ_ADDSRC_NOSELECT : 0) |
           (data.params.sel_options & SRC_SELECT_TRUST ? REQ_ADDSRC_TRUST : 0) |
-          (data.params.sel_options & SRC_SELECT_REQUIRE ? REQ_ADDSRC_REQUIRE : 0));
+          (data.params.sel_options & SRC_SELECT_REQUIRE ? REQ_ADDSRC_REQUIRE : 0) |
+          (data.params.sel_options & SRC_SELECT_MONITOR ? REQ_ADDSRC_MONITOR : 0));
       msg->data.ntp_source.filter_length = htonl(data.params.filter_length);
       msg->data.ntp_source.cert_set = htonl(data.params.cert_set);
       memset(msg->data.ntp_source.reserved, 0, sizeof (msg->data.ntp_source.reserved));
@@ -1006,6 +1009,7 @@ give_help(void)
     "maxupdateskew <skew>\0Modify maximum valid skew to update frequency\0"
     "waitsync [<max-tries> [<max-correction> [<max-skew> [<interval>]]]]\0"
                           "Wait until synchronised in specified limits\0"
+    "watch <report> [<interval> [<count>]]\0Print changes in report\0"
     "\0\0"
     "Time sources:\0\0"
     "sources [-a] [-v]\0Display information about current sources\0"
@@ -1048,6 +1052,8 @@ give_help(void)
     "accheck <address>\0Check whether address is allowed\0"
     "clients [-p <packets>] [-k] [-r]\0Report on clients that accessed the server\0"
     "serverstats\0Display statistics of the server\0"
+    "socketstats\0Display statistics of server sockets\0"
+    "schedstats [-r]\0Display statistics of the main loop\0"
     "allow [<subnet>]\0Allow access to subnet as a default\0"
     "allow all [<subnet>]\0Allow access to subnet and all children\0"
     "deny [<subnet>]\0Deny access to subnet as a default\0"
@@ -1109,6 +1115,7 @@ enum {
   TAB_COMPLETE_SOURCESTATS_OPTS,
   TAB_COMPLETE_AUTHDATA_OPTS,
   TAB_COMPLETE_SELECTDATA_OPTS,
+  TAB_COMPLETE_WATCH_OPTS,
   TAB_COMPLETE_MAX_INDEX
 };
 
@@ -1125,9 +1132,9 @@ command_name_generator(const char *text, int state)
     "manual", "maxdelay", "maxdelaydevratio", "maxdelayratio", "maxpoll",
     "maxupdateskew", "minpoll", "minstratum", "ntpdata", "offline", "online", "onoffline",
     "polltarget", "quit", "refresh", "rekey", "reload", "reselect", "reselectdist", "reset",
-    "retries", "rtcdata", "selectdata", "serverstats", "settime", "shutdown", "smoothing",
-    "smoothtime", "sourcename", "sources", "sourcestats",
-    "timeout", "tracking", "trimrtc", "waitsync", "writertc",
+    "retries", "rtcdata", "schedstats", "selectdata", "serverstats", "settime", "shutdown", "smoothing",
+    "smoothtime", "socketstats", "sourcename", "sources", "sourcestats",
+    "timeout", "tracking", "trimrtc", "waitsync", "watch", "writertc",
     NULL
   };
   const char *add_options[] = { "peer", "pool", "server", NULL };
@@ -1135,6 +1142,7 @@ command_name_generator(const char *text, int state)
   const char *reset_options[] = { "sources", NULL };
   const char *reload_options[] = { "sources", NULL };
   const char *common_source_options[] = { "-a", "-v", NULL };
+  const char *watch_options[] = { "rtcdata", "serverstats", "smoothing", "tracking", NULL };
   static int list_index, len;
 
   names[TAB_COMPLETE_BASE_CMDS] = base_commands;
@@ -1146,6 +1154,7 @@ command_name_generator(const char *text, int state)
   names[TAB_COMPLETE_SELECTDATA_OPTS] = common_source_options;
   names[TAB_COMPLETE_SOURCES_OPTS] = common_source_options;
   names[TAB_COMPLETE_SOURCESTATS_OPTS] = common_source_options;
+  names[TAB_COMPLETE_WATCH_OPTS] = watch_options;
 
   if (!state) {
     list_index = 0;
@@ -1187,6 +1196,8 @@ command_name_completion(const char *text, int start, int end)
     tab_complete_index = TAB_COMPLETE_SOURCES_OPTS;
   } else if (!strcmp(first, "sourcestats ")) {
     tab_complete_index = TAB_COMPLETE_SOURCESTATS_OPTS;
+  } else if (!strcmp(first, "watch ")) {
+    tab_complete_index = TAB_COMPLETE_WATCH_OPTS;
   } else if (first[0] == '\0') {
     tab_complete_index = TAB_COMPLETE_BASE_CMDS;
   } else {
@@ -1356,10 +1367,8 @@ submit_request(CMD_Request *request, CMD_Reply *reply)
 /* ================================================== */
 
 static int
-request_reply(CMD_Request *request, CMD_Reply *reply, int requested_reply, int verbose)
+send_request(CMD_Request *request, CMD_Reply *reply)
 {
-  int status;
-
   while (!submit_request(request, reply)) {
     /* Try connecting to other addresses before giving up */
     if (open_io())
@@ -1368,6 +1377,16 @@ request_reply(CMD_Request *request, CMD_Reply *reply, int requested_reply, int v
     return 0;
   }
 
+  return 1;
+}
+
+/* ================================================== */
+
+static int
+check_reply(CMD_Reply *reply, int requested_reply, int verbose)
+{
+  int status;
+
   status = ntohs(reply->status);
         
   if (verbose || status != STT_SUCCESS) {
@@ -1459,25 +1478,225 @@ request_reply(CMD_Request *request, CMD_Reply *reply, int requested_reply, int v
 
 /* ================================================== */
 
+static int
+request_reply(CMD_Request *request, CMD_Reply *reply, int requested_reply, int verbose)
+{
+  if (!send_request(request, reply))
+    return 0;
+
+  return check_reply(reply, requested_reply, verbose);
+}
+
+/* ================================================== */
+/* Reports which can be requested for a single source by index, or for
+   a range of sources in one request if supported by the server */
+
+typedef enum {
+  SOURCE_RECORD_DATA,
+  SOURCE_RECORD_STATS,
+  SOURCE_RECORD_SELECT,
+} SourceRecordType;
+
+static const struct {
+  uint16_t command;
+  uint16_t reply;
+  uint16_t index_command;
+  uint16_t index_reply;
+  uint16_t max_records;
+  uint16_t record_length;
+} source_record_types[] = {
+  { REQ_SOURCE_DATA, RPY_SOURCE_DATA,
+    REQ_SOURCE_DATA_BY_INDEX, RPY_SOURCE_DATA_BY_INDEX,
+    MAX_SOURCE_DATA_RECORDS, sizeof (RPY_SourceDataRecord) },
+  { REQ_SOURCESTATS, RPY_SOURCESTATS,
+    REQ_SOURCESTATS_BY_INDEX, RPY_SOURCESTATS_BY_INDEX,
+    MAX_SOURCESTATS_RECORDS, sizeof (RPY_SourcestatsRecord) },
+  { REQ_SELECT_DATA, RPY_SELECT_DATA,
+    REQ_SELECT_DATA_BY_INDEX, RPY_SELECT_DATA_BY_INDEX,
+    MAX_SELECT_DATA_RECORDS, sizeof (RPY_SelectDataRecord) },
+};
+
+/* Last reply to a request by index */
+static CMD_Reply records_reply;
+static int records_valid = 0;
+static SourceRecordType records_type;
+static uint32_t records_first_index;
+static uint32_t records_n_sources;
+static uint32_t records_n_indices;
+
+/* Flag indicating the server doesn't support requests by index */
+static int no_index_requests = 0;
+
+/* ================================================== */
+
+static int
+request_source_records(SourceRecordType type, uint32_t first_index)
+{
+  CMD_Request request;
+
+  records_valid = 0;
+
+  request.command = htons(source_record_types[type].index_command);
+  request.data.sources_by_index.first_index = htonl(first_index);
+  request.data.sources_by_index.n_sources = htonl(source_record_types[type].max_records);
+
+  if (!send_request(&request, &records_reply))
+    return 0;
+
+  /* Fall back to one request per source if the server is too old */
+  if (ntohs(records_reply.status) == STT_INVALID) {
+    DEBUG_LOG("Requests by index not supported");
+    no_index_requests = 1;
+    return 1;
+  }
+
+  if (!check_reply(&records_reply, source_record_types[type].index_reply, 0))
+    return 0;
+
+  /* All replies by index start with the same fields */
+  records_valid = 1;
+  records_type = type;
+  records_first_index = first_index;
+  records_n_indices = ntohl(records_reply.data.source_data_by_index.n_indices);
+  records_n_sources = ntohl(records_reply.data.source_data_by_index.n_sources);
+  if (records_n_sources > source_record_types[type].max_records)
+    records_n_sources = source_record_types[type].max_records;
+
+  return 1;
+}
+
+/* ================================================== */
+
+static int
+get_number_of_sources(SourceRecordType type, uint32_t *n_sources)
+{
+  CMD_Request request;
+  CMD_Reply reply;
+
+  /* Get the first records together with the number of sources */
+  if (!no_index_requests) {
+    if (!request_source_records(type, 0))
+      return 0;
+
+    if (records_valid) {
+      *n_sources = records_n_indices;
+      return 1;
+    }
+  }
+
+  request.command = htons(REQ_N_SOURCES);
+  if (!request_reply(&request, &reply, RPY_N_SOURCES, 0))
+    return 0;
+
+  *n_sources = ntohl(reply.data.n_sources.n_sources);
+
+  return 1;
+}
+
+/* ================================================== */
+
+static int
+get_source_record(SourceRecordType type, uint32_t index, void *record)
+{
+  CMD_Request request;
+  CMD_Reply reply;
+  int length;
+  void *data;
+
+  if (!no_index_requests) {
+    if (!records_valid || records_type != type || index < records_first_index ||
+        index >= records_first_index + records_n_sources) {
+      if (!request_source_records(type, index))
+        return 0;
+    }
+  }
+
+  if (records_valid) {
+    if (index >= records_first_index + records_n_sources) {
+      printf("503 No such source\n");
+      return 0;
+    }
+
+    switch (type) {
+      case SOURCE_RECORD_DATA:
+        data = &records_reply.data.source_data_by_index.sources[index - records_first_index];
+        break;
+      case SOURCE_RECORD_STATS:
+        data = &records_reply.data.sourcestats_by_index.sources[index - records_first_index];
+        break;
+      case SOURCE_RECORD_SELECT:
+        data = &records_reply.data.select_data_by_index.sources[index - records_first_index];
+        break;
+      default:
+        assert(0);
+    }
+
+    memcpy(record, data, source_record_types[type].record_length);
+    return 1;
+  }
+
+  /* The single-source requests have the same format of the index and the
+     replies start with the same fields as the records.  Fields missing in
+     the reply are zeroed. */
+  request.command = htons(source_record_types[type].command);
+  request.data.source_data.index = htonl(index);
+  if (!request_reply(&request, &reply, source_record_types[type].reply, 0))
+    return 0;
+
+  length = PKL_ReplyLength(&reply) - offsetof(CMD_Reply, data);
+  length = MIN(length, source_record_types[type].record_length);
+  memset(record, 0, source_record_types[type].record_length);
+  memcpy(record, &reply.data, length);
+
+  return 1;
+}
+
+/* ================================================== */
+/* Buffer capturing the output of print_report() in the watch mode */
+
+static ARR_Instance captured_report = NULL;
+
+static void
+report_printf(const char *format, ...)
+{
+  char buf[256];
+  va_list ap;
+  int i, len;
+
+  va_start(ap, format);
+
+  if (!captured_report) {
+    vprintf(format, ap);
+  } else {
+    len = vsnprintf(buf, sizeof (buf), format, ap);
+    for (i = 0; i < len && i < sizeof (buf) - 1; i++)
+      ARR_AppendElement(captured_report, &buf[i]);
+  }
+
+  va_end(ap);
+}
+
+/* ================================================== */
+
 static void
 print_seconds(unsigned long s)
 {
   unsigned long d;
 
   if (s == (uint32_t)-1) {
-    printf("   -");
+    report_printf("   -");
   } else if (s < 1200) {
-    printf("%4lu", s);
+    report_printf("%4lu", s);
   } else if (s < 36000) {
-    printf("%3lum", s / 60);
+    report_printf("%3lum", s / 60);
   } else if (s < 345600) {
-    printf("%3luh", s / 3600);
+    report_printf("%3luh", s / 3600);
   } else {
     d = s / 86400;
     if (d > 999) {
-      printf("%3luy", d / 365);
+      report_printf("%3luy", d / 365);
     } else {
-      printf("%3lud", d);
+      report_printf("%3lud", d);
     }
   }
 }
@@ -1490,23 +1709,23 @@ print_nanoseconds(double s)
   s = fabs(s);
 
   if (s < 9999.5e-9) {
-    printf("%4.0fns", s * 1e9);
+    report_printf("%4.0fns", s * 1e9);
   } else if (s < 9999.5e-6) {
-    printf("%4.0fus", s * 1e6);
+    report_printf("%4.0fus", s * 1e6);
   } else if (s < 9999.5e-3) {
-    printf("%4.0fms", s * 1e3);
+    report_printf("%4.0fms", s * 1e3);
   } else if (s < 999.5) {
-    printf("%5.1fs", s);
+    report_printf("%5.1fs", s);
   } else if (s < 99999.5) {
-    printf("%5.0fs", s);
+    report_printf("%5.0fs", s);
   } else if (s < 99999.5 * 60) {
-    printf("%5.0fm", s / 60);
+    report_printf("%5.0fm", s / 60);
   } else if (s < 99999.5 * 3600) {
-    printf("%5.0fh", s / 3600);
+    report_printf("%5.0fh", s / 3600);
   } else if (s < 99999.5 * 3600 * 24) {
-    printf("%5.0fd", s / (3600 * 24));
+    report_printf("%5.0fd", s / (3600 * 24));
   } else {
-    printf("%5.0fy", s / (3600 * 24 * 365));
+    report_printf("%5.0fy", s / (3600 * 24 * 365));
   }
 }
 
@@ -1520,23 +1739,23 @@ print_signed_nanoseconds(double s)
   x = fabs(s);
 
   if (x < 9999.5e-9) {
-    printf("%+5.0fns", s * 1e9);
+    report_printf("%+5.0fns", s * 1e9);
   } else if (x < 9999.5e-6) {
-    printf("%+5.0fus", s * 1e6);
+    report_printf("%+5.0fus", s * 1e6);
   } else if (x < 9999.5e-3) {
-    printf("%+5.0fms", s * 1e3);
+    report_printf("%+5.0fms", s * 1e3);
   } else if (x < 999.5) {
-    printf("%+6.1fs", s);
+    report_printf("%+6.1fs", s);
   } else if (x < 99999.5) {
-    printf("%+6.0fs", s);
+    report_printf("%+6.0fs", s);
   } else if (x < 99999.5 * 60) {
-    printf("%+6.0fm", s / 60);
+    report_printf("%+6.0fm", s / 60);
   } else if (x < 99999.5 * 3600) {
-    printf("%+6.0fh", s / 3600);
+    report_printf("%+6.0fh", s / 3600);
   } else if (x < 99999.5 * 3600 * 24) {
-    printf("%+6.0fd", s / (3600 * 24));
+    report_printf("%+6.0fd", s / (3600 * 24));
   } else {
-    printf("%+6.0fy", s / (3600 * 24 * 365));
+    report_printf("%+6.0fy", s / (3600 * 24 * 365));
   }
 }
 
@@ -1546,9 +1765,9 @@ static void
 print_freq_ppm(double f)
 {
   if (fabs(f) < 99999.5) {
-    printf("%10.3f", f);
+    report_printf("%10.3f", f);
   } else {
-    printf("%10.0f", f);
+    report_printf("%10.0f", f);
   }
 }
 
@@ -1558,9 +1777,9 @@ static void
 print_signed_freq_ppm(double f)
 {
   if (fabs(f) < 99999.5) {
-    printf("%+10.3f", f);
+    report_printf("%+10.3f", f);
   } else {
-    printf("%+10.0f", f);
+    report_printf("%+10.0f", f);
   }
 }
 
@@ -1570,9 +1789,9 @@ static void
 print_clientlog_interval(int rate)
 {
   if (rate >= 127) {
-    printf(" -");
+    report_printf(" -");
   } else {
-    printf("%2d", rate);
+    report_printf("%2d", rate);
   }
 }
 
@@ -1598,15 +1817,141 @@ print_header(const char *header)
 
 #define REPORT_END 0x1234
 
+/* Names of the fields of reports in the JSON mode.  They need to be in the
+   same order as the format specifiers in the print_report() call. */
+
+static const char *const sourcename_fields[] = {
+  "name", NULL
+};
+
+static const char *const sources_fields[] = {
+  "mode", "state", "name", "stratum", "poll", "reach", "last_rx",
+  "last_sample_offset", "last_sample_original_offset", "last_sample_error", NULL
+};
+
+static const char *const sourcestats_fields[] = {
+  "name", "samples", "runs", "span", "frequency", "frequency_skew",
+  "offset", "standard_deviation", "dropped_samples", NULL
+};
+
+static const char *const tracking_fields[] = {
+  "reference_id", "reference_name", "stratum", "reference_time", "system_time",
+  "last_offset", "rms_offset", "frequency", "residual_frequency", "skew",
+  "root_delay", "root_dispersion", "update_interval", "leap_status", NULL
+};
+
+static const char *const authdata_fields[] = {
+  "name", "mode", "key_id", "key_type", "key_length", "last_ke_ago",
+  "ke_attempts", "nak", "cookies", "cookie_length", NULL
+};
+
+static const char *const ntpdata_fields[] = {
+  "remote_address", "remote_address_id", "remote_port", "local_address",
+  "local_address_id", "leap_status", "version", "mode", "stratum",
+  "poll", "poll_interval", "precision", "precision_interval", "root_delay",
+  "root_dispersion", "reference_id", "reference_name", "reference_time",
+  "offset", "peer_delay", "peer_dispersion", "response_time",
+  "jitter_asymmetry", "tests_1", "tests_2", "tests_3", "interleaved",
+  "authenticated", "tx_timestamping", "rx_timestamping", "total_tx",
+  "total_rx", "total_valid_rx", NULL
+};
+
+static const char *const selectdata_fields[] = {
+  "state", "name", "authentication",
+  "configured_noselect", "configured_prefer", "configured_trust",
+  "configured_require", "configured_monitor",
+  "effective_noselect", "effective_prefer", "effective_trust",
+  "effective_require", "effective_monitor",
+  "last_sample_ago", "score", "low_limit", "high_limit", "leap", NULL
+};
+
+static const char *const serverstats_fields[] = {
+  "ntp_packets_received", "ntp_packets_dropped", "command_packets_received",
+  "command_packets_dropped", "client_log_records_dropped",
+  "ntske_connections_accepted", "ntske_connections_dropped",
+  "authenticated_ntp_packets", "interleaved_ntp_packets",
+  "ntp_timestamps_held", "ntp_timestamp_span", "ntp_server_sockets",
+  "ntp_socket_min_packets", "ntp_socket_max_packets",
+  "ntp_over_ptp_packets_received", "ntp_over_ptp_packets_sent", NULL
+};
+
+static const char *const socketstats_fields[] = {
+  "socket", "family", "packets_received", NULL
+};
+
+static const char *const schedstats_fields[] = {
+  "iterations", "blocked_time", "busy_time", "average_iteration_time",
+  "maximum_iteration_time", NULL
+};
+
+static const char *const schedstats_handler_fields[] = {
+  "handler", "type", "calls", "total_time", "average_time", "maximum_time", NULL
+};
+
+static const char *const smoothing_fields[] = {
+  "active", "leap_only", "offset", "frequency", "wander", "last_update_ago",
+  "remaining_time", NULL
+};
+
+static const char *const rtcdata_fields[] = {
+  "reference_time", "samples", "runs", "span", "rtc_offset", "rtc_gain_rate",
+  NULL
+};
+
+static const char *const clients_fields[] = {
+  "name", "ntp_hits", "ntp_drops", "ntp_interval", "ntp_timeout_interval",
+  "last_ntp_hit_ago", "cmd_hits", "cmd_drops", "cmd_interval",
+  "last_cmd_hit_ago", NULL
+};
+
+static const char *const clients_nke_fields[] = {
+  "name", "ntp_hits", "ntp_drops", "ntp_interval", "ntp_timeout_interval",
+  "last_ntp_hit_ago", "nke_hits", "nke_drops", "nke_interval",
+  "last_nke_hit_ago", NULL
+};
+
+static const char *const manual_list_fields[] = {
+  "index", "time", "slewed_offset", "original_offset", "residual", NULL
+};
+
+static const char *const activity_fields[] = {
+  "online", "offline", "burst_online", "burst_offline", "unresolved", NULL
+};
+
+static const char *const waitsync_fields[] = {
+  "try", "reference_id", "correction", "skew", NULL
+};
+
+/* ================================================== */
+
+static void
+print_json_string(const char *s)
+{
+  report_printf("\"");
+
+  for (; *s != '\0'; s++) {
+    if (*s == '"' || *s == '\\')
+      report_printf("\\%c", *s);
+    else if ((unsigned char)*s < 0x20)
+      report_printf("\\u%04x", (unsigned int)(unsigned char)*s);
+    else
+      report_printf("%c", *s);
+  }
+
+  report_printf("\"");
+}
+
+/* ================================================== */
 /* Print a report. The syntax of the format is similar to printf(), but not all
-   specifiers are supported and some are different! */
+   specifiers are supported and some are different!  The names of fields
+   are used only in the JSON mode. */
 
 static void
-print_report(const char *format, ...)
+print_report(const char *const *fields, const char *format, ...)
 {
   char buf[256];
   va_list ap;
-  int i, field, sign, width, prec, spec;
+  int i, field, sign, width, prec, spec, quote;
   const char *string;
   unsigned long long_uinteger;
   unsigned int uinteger;
@@ -1617,6 +1962,8 @@ print_report(const char *format, ...)
 
   va_start(ap, format);
 
+  quote = 0;
+
   for (field = 0; ; field++) {
     /* Search for text between format specifiers and print it
        if not in the CSV mode */
@@ -1629,7 +1976,7 @@ print_report(const char *format, ...)
     buf[i] = '\0';
 
     if (!csv_mode)
-      printf("%s", buf);
+      report_printf("%s", buf);
 
     if (format[i] == '\0' || format[i + 1] == '\0')
       break;
@@ -1666,7 +2013,53 @@ print_report(const char *format, ...)
       sign = width = 0;
 
       if (field > 0)
-        printf(",");
+        report_printf(",");
+
+      if (json_mode) {
+        /* Catch a mismatch between the fields and format */
+        assert(fields[field]);
+        report_printf("%s\"%s\":", field == 0 ? "{" : "", fields[field]);
+
+        switch (spec) {
+          case 'B':
+            integer = va_arg(ap, int);
+            report_printf("%s", integer ? "true" : "false");
+            continue;
+          case 'F':
+          case 'O':
+          case 'P':
+          case 'S':
+          case 'f':
+            dbl = va_arg(ap, double);
+            if (!isfinite(dbl))
+              report_printf("null");
+            else
+              report_printf("%.*f", spec == 'f' ? prec : spec == 'F' || spec == 'P' ? 3 : 9,
+                            dbl);
+            continue;
+          case 'c':
+            buf[0] = va_arg(ap, int);
+            buf[1] = '\0';
+            print_json_string(buf);
+            continue;
+          case 's':
+            string = va_arg(ap, const char *);
+            print_json_string(string);
+            continue;
+          case 'L':
+          case 'M':
+          case 'N':
+          case 'R':
+          case 'b':
+            /* Printed as strings below */
+            quote = 1;
+            report_printf("\"");
+            break;
+          case 'o':
+            spec = 'u';
+            break;
+        }
+      }
 
       switch (spec) {
         case 'C':
@@ -1694,7 +2087,7 @@ print_report(const char *format, ...)
     switch (spec) {
       case 'B': /* boolean */
         integer = va_arg(ap, int);
-        printf("%s", integer ? "Yes" : "No");
+        report_printf("%s", integer ? "Yes" : "No");
         break;
       case 'C': /* clientlog interval */
         integer = va_arg(ap, int);
@@ -1703,9 +2096,9 @@ print_report(const char *format, ...)
       case 'F': /* absolute frequency in ppm with fast/slow keyword */
       case 'O': /* absolute offset in seconds with fast/slow keyword */
         dbl = va_arg(ap, double);
-        printf("%*.*f %s %s", width, prec, fabs(dbl),
-               spec == 'O' ? "seconds" : "ppm",
-               (dbl > 0.0) ^ (spec != 'O') ? "slow" : "fast");
+        report_printf("%*.*f %s %s", width, prec, fabs(dbl),
+                      spec == 'O' ? "seconds" : "ppm",
+                      (dbl > 0.0) ^ (spec != 'O') ? "slow" : "fast");
         break;
       case 'I': /* interval with unit */
         long_uinteger = va_arg(ap, unsigned long);
@@ -1730,7 +2123,7 @@ print_report(const char *format, ...)
             string = width != 1 ? "Invalid" : "?";
             break;
         }
-        printf("%s", string);
+        report_printf("%s", string);
         break;
       case 'M': /* NTP mode */
         integer = va_arg(ap, int);
@@ -1748,7 +2141,7 @@ print_report(const char *format, ...)
             string = "Invalid";
             break;
         }
-        printf("%s", string);
+        report_printf("%s", string);
         break;
       case 'N': /* Timestamp source */
         integer = va_arg(ap, int);
@@ -1766,7 +2159,7 @@ print_report(const char *format, ...)
             string = "Invalid";
             break;
         }
-        printf("%s", string);
+        report_printf("%s", string);
         break;
       case 'P': /* frequency in ppm */
         dbl = va_arg(ap, double);
@@ -1777,7 +2170,7 @@ print_report(const char *format, ...)
         break;
       case 'R': /* reference ID in hexdecimal */
         long_uinteger = va_arg(ap, unsigned long);
-        printf("%08lX", long_uinteger);
+        report_printf("%08lX", long_uinteger);
         break;
       case 'S': /* offset with unit */
         dbl = va_arg(ap, double);
@@ -1792,51 +2185,56 @@ print_report(const char *format, ...)
         if (!tm)
           break;
         strftime(buf, sizeof (buf), "%a %b %d %T %Y", tm);
-        printf("%s", buf);
+        report_printf("%s", buf);
         break;
       case 'U': /* unsigned long in decimal */
         long_uinteger = va_arg(ap, unsigned long);
-        printf("%*lu", width, long_uinteger);
+        report_printf("%*lu", width, long_uinteger);
         break;
       case 'V': /* timespec as seconds since epoch */
         ts = va_arg(ap, struct timespec *);
-        printf("%s", UTI_TimespecToString(ts));
+        report_printf("%s", UTI_TimespecToString(ts));
         break;
       case 'b': /* unsigned int in binary */
         uinteger = va_arg(ap, unsigned int);
         for (i = prec - 1; i >= 0; i--)
-          printf("%c", uinteger & 1U << i ? '1' : '0');
+          report_printf("%c", uinteger & 1U << i ? '1' : '0');
         break;
 
       /* Classic printf specifiers */
       case 'c': /* character */
         integer = va_arg(ap, int);
-        printf("%c", integer);
+        report_printf("%c", integer);
         break;
       case 'd': /* signed int in decimal */
         integer = va_arg(ap, int);
-        printf("%*d", width, integer);
+        report_printf("%*d", width, integer);
         break;
       case 'f': /* double */
         dbl = va_arg(ap, double);
-        printf(sign ? "%+*.*f" : "%*.*f", width, prec, dbl);
+        report_printf(sign ? "%+*.*f" : "%*.*f", width, prec, dbl);
         break;
       case 'o': /* unsigned int in octal */
         uinteger = va_arg(ap, unsigned int);
-        printf("%*o", width, uinteger);
+        report_printf("%*o", width, uinteger);
         break;
       case 's': /* string */
         string = va_arg(ap, const char *);
         if (sign)
-          printf("%-*s", width, string);
+          report_printf("%-*s", width, string);
         else
-          printf("%*s", width, string);
+          report_printf("%*s", width, string);
         break;
       case 'u': /* unsigned int in decimal */
         uinteger = va_arg(ap, unsigned int);
-        printf("%*u", width, uinteger);
+        report_printf("%*u", width, uinteger);
         break;
     }
+
+    if (quote) {
+      report_printf("\"");
+      quote = 0;
+    }
   }
 
   /* Require terminating argument to catch bad type conversions */
@@ -1845,8 +2243,13 @@ print_report(const char *format, ...)
 
   va_end(ap);
 
+  if (json_mode) {
+    assert(!fields[field]);
+    report_printf("}");
+  }
+
   if (csv_mode)
-    printf("\n");
+    report_printf("\n");
 }
 
 /* ================================================== */
@@ -1946,7 +2349,7 @@ process_cmd_sourcename(char *line)
   if (!get_source_name(&ip_addr, name, sizeof (name)))
     return 0;
 
-  print_report("%s\n", name, REPORT_END);
+  print_report(sourcename_fields, "%s\n", name, REPORT_END);
 
   return 1;
 }
@@ -1956,8 +2359,7 @@ process_cmd_sourcename(char *line)
 static int
 process_cmd_sources(char *line)
 {
-  CMD_Request request;
-  CMD_Reply reply;
+  RPY_SourceDataRecord data;
   IPAddr ip_addr;
   uint32_t i, mode, n_sources;
   char name[256], mode_ch, state_ch;
@@ -1965,12 +2367,9 @@ process_cmd_sources(char *line)
 
   parse_sources_options(line, &all, &verbose);
   
-  request.command = htons(REQ_N_SOURCES);
-  if (!request_reply(&request, &reply, RPY_N_SOURCES, 0))
+  if (!get_number_of_sources(SOURCE_RECORD_DATA, &n_sources))
     return 0;
 
-  n_sources = ntohl(reply.data.n_sources.n_sources);
-
   if (verbose) {
     printf("\n");
     printf("  .-- Source mode  '^' = server, '=' = peer, '#' = local clock.\n");
@@ -1988,13 +2387,11 @@ process_cmd_sources(char *line)
   /*           "MS NNNNNNNNNNNNNNNNNNNNNNNNNNN  SS  PP   RRR  RRRR  SSSSSSS[SSSSSSS] +/- SSSSSS" */
 
   for (i = 0; i < n_sources; i++) {
-    request.command = htons(REQ_SOURCE_DATA);
-    request.data.source_data.index = htonl(i);
-    if (!request_reply(&request, &reply, RPY_SOURCE_DATA, 0))
+    if (!get_source_record(SOURCE_RECORD_DATA, i, &data))
       return 0;
 
-    mode = ntohs(reply.data.source_data.mode);
-    UTI_IPNetworkToHost(&reply.data.source_data.ip_addr, &ip_addr);
+    mode = ntohs(data.mode);
+    UTI_IPNetworkToHost(&data.ip_addr, &ip_addr);
     if (!all && ip_addr.family == IPADDR_ID)
       continue;
 
@@ -2016,7 +2413,7 @@ process_cmd_sources(char *line)
         mode_ch = ' ';
     }
 
-    switch (ntohs(reply.data.source_data.state)) {
+    switch (ntohs(data.state)) {
       case RPY_SD_ST_SELECTED:
         state_ch = '*';
         break;
@@ -2039,20 +2436,21 @@ process_cmd_sources(char *line)
         state_ch = ' ';
     }
 
-    switch (ntohs(reply.data.source_data.flags)) {
+    switch (ntohs(data.flags)) {
       default:
         break;
     }
 
-    print_report("%c%c %-27s  %2d  %2d   %3o  %I  %+S[%+S] +/- %S\n",
+    print_report(sources_fields,
+                 "%c%c %-27s  %2d  %2d   %3o  %I  %+S[%+S] +/- %S\n",
                  mode_ch, state_ch, name,
-                 ntohs(reply.data.source_data.stratum),
-                 (int16_t)ntohs(reply.data.source_data.poll),
-                 ntohs(reply.data.source_data.reachability),
-                 (unsigned long)ntohl(reply.data.source_data.since_sample),
-                 UTI_FloatNetworkToHost(reply.data.source_data.latest_meas),
-                 UTI_FloatNetworkToHost(reply.data.source_data.orig_latest_meas),
-                 UTI_FloatNetworkToHost(reply.data.source_data.latest_meas_err),
+                 ntohs(data.stratum),
+                 (int16_t)ntohs(data.poll),
+                 ntohs(data.reachability),
+                 (unsigned long)ntohl(data.since_sample),
+                 UTI_FloatNetworkToHost(data.latest_meas),
+                 UTI_FloatNetworkToHost(data.orig_latest_meas),
+                 UTI_FloatNetworkToHost(data.latest_meas_err),
                  REPORT_END);
   }
 
@@ -2064,8 +2462,7 @@ process_cmd_sources(char *line)
 static int
 process_cmd_sourcestats(char *line)
 {
-  CMD_Request request;
-  CMD_Reply reply;
+  RPY_SourcestatsRecord data;
   uint32_t i, n_sources;
   int all, verbose;
   char name[256];
@@ -2073,51 +2470,66 @@ process_cmd_sourcestats(char *line)
 
   parse_sources_options(line, &all, &verbose);
 
-  request.command = htons(REQ_N_SOURCES);
-  if (!request_reply(&request, &reply, RPY_N_SOURCES, 0))
+  if (!get_number_of_sources(SOURCE_RECORD_STATS, &n_sources))
     return 0;
 
-  n_sources = ntohl(reply.data.n_sources.n_sources);
-
+  /* The number of dropped samples doesn't fit in the 80-column table
+     and is printed only in the verbose and CSV modes */
   if (verbose) {
-    printf("                             .- Number of sample points in measurement set.\n");
-    printf("                            /    .- Number of residual runs with same sign.\n");
-    printf("                           |    /    .- Length of measurement set (time).\n");
-    printf("                           |   |    /      .- Est. clock freq error (ppm).\n");
-    printf("                           |   |   |      /           .- Est. error in freq.\n");
-    printf("                           |   |   |     |           /         .- Est. offset.\n");
-    printf("                           |   |   |     |          |          |   On the -.\n");
-    printf("                           |   |   |     |          |          |   samples. \\\n");
-    printf("                           |   |   |     |          |          |             |\n");
+    printf("                                                                 Dropped samples -.\n");
+    printf("                             .- Number of sample points in measurement set.       |\n");
+    printf("                            /    .- Number of residual runs with same sign.       |\n");
+    printf("                           |    /    .- Length of measurement set (time).         |\n");
+    printf("                           |   |    /      .- Est. clock freq error (ppm).        |\n");
+    printf("                           |   |   |      /           .- Est. error in freq.      |\n");
+    printf("                           |   |   |     |           /         .- Est. offset.    |\n");
+    printf("                           |   |   |     |          |          |   On the -.      |\n");
+    printf("                           |   |   |     |          |          |   samples. \\     |\n");
+    printf("                           |   |   |     |          |          |             |    |\n");
+    print_header("Name/IP Address            NP  NR  Span  Frequency  Freq Skew  Offset  Std Dev  Drop");
+  } else {
+    print_header("Name/IP Address            NP  NR  Span  Frequency  Freq Skew  Offset  Std Dev");
   }
 
-  print_header("Name/IP Address            NP  NR  Span  Frequency  Freq Skew  Offset  Std Dev");
-
-  /*           "NNNNNNNNNNNNNNNNNNNNNNNNN  NP  NR  SSSS FFFFFFFFFF SSSSSSSSSS  SSSSSSS  SSSSSS" */
+  /*           "NNNNNNNNNNNNNNNNNNNNNNNNN  NP  NR  SSSS FFFFFFFFFF SSSSSSSSSS  SSSSSSS  SSSSSS  DDDD" */
 
   for (i = 0; i < n_sources; i++) {
-    request.command = htons(REQ_SOURCESTATS);
-    request.data.source_data.index = htonl(i);
-    if (!request_reply(&request, &reply, RPY_SOURCESTATS, 0))
+    if (!get_source_record(SOURCE_RECORD_STATS, i, &data))
       return 0;
 
-    UTI_IPNetworkToHost(&reply.data.sourcestats.ip_addr, &ip_addr);
+    UTI_IPNetworkToHost(&data.ip_addr, &ip_addr);
     if (!all && ip_addr.family == IPADDR_ID)
       continue;
 
     format_name(name, sizeof (name), 25, ip_addr.family == IPADDR_UNSPEC,
-                ntohl(reply.data.sourcestats.ref_id), 1, &ip_addr);
+                ntohl(data.ref_id), 1, &ip_addr);
 
-    print_report("%-25s %3U %3U  %I %+P %P  %+S  %S\n",
-                 name,
-                 (unsigned long)ntohl(reply.data.sourcestats.n_samples),
-                 (unsigned long)ntohl(reply.data.sourcestats.n_runs),
-                 (unsigned long)ntohl(reply.data.sourcestats.span_seconds),
-                 UTI_FloatNetworkToHost(reply.data.sourcestats.resid_freq_ppm),
-                 UTI_FloatNetworkToHost(reply.data.sourcestats.skew_ppm),
-                 UTI_FloatNetworkToHost(reply.data.sourcestats.est_offset),
-                 UTI_FloatNetworkToHost(reply.data.sourcestats.sd),
-                 REPORT_END);
+    if (verbose || csv_mode) {
+      print_report(sourcestats_fields,
+                   "%-25s %3U %3U  %I %+P %P  %+S  %S  %4U\n",
+                   name,
+                   (unsigned long)ntohl(data.n_samples),
+                   (unsigned long)ntohl(data.n_runs),
+                   (unsigned long)ntohl(data.span_seconds),
+                   UTI_FloatNetworkToHost(data.resid_freq_ppm),
+                   UTI_FloatNetworkToHost(data.skew_ppm),
+                   UTI_FloatNetworkToHost(data.est_offset),
+                   UTI_FloatNetworkToHost(data.sd),
+                   (unsigned long)ntohl(data.n_dropped),
+                   REPORT_END);
+    } else {
+      print_report(sourcestats_fields,
+                   "%-25s %3U %3U  %I %+P %P  %+S  %S\n",
+                   name,
+                   (unsigned long)ntohl(data.n_samples),
+                   (unsigned long)ntohl(data.n_runs),
+                   (unsigned long)ntohl(data.span_seconds),
+                   UTI_FloatNetworkToHost(data.resid_freq_ppm),
+                   UTI_FloatNetworkToHost(data.skew_ppm),
+                   UTI_FloatNetworkToHost(data.est_offset),
+                   UTI_FloatNetworkToHost(data.sd),
+                   REPORT_END);
+    }
   }
 
   return 1;
@@ -2125,29 +2537,32 @@ process_cmd_sourcestats(char *line)
 
 /* ================================================== */
 
-static int
-process_cmd_tracking(char *line)
+static void
+print_tracking(CMD_Reply *reply)
 {
-  CMD_Request request;
-  CMD_Reply reply;
+  static IPAddr last_ip_addr;
+  static uint32_t last_ref_id = 0;
+  static char name[256] = "";
   IPAddr ip_addr;
   uint32_t ref_id;
-  char name[256];
   struct timespec ref_time;
-  
-  request.command = htons(REQ_TRACKING);
-  if (!request_reply(&request, &reply, RPY_TRACKING, 0))
-    return 0;
 
-  ref_id = ntohl(reply.data.tracking.ref_id);
+  ref_id = ntohl(reply->data.tracking.ref_id);
+
+  UTI_IPNetworkToHost(&reply->data.tracking.ip_addr, &ip_addr);
 
-  UTI_IPNetworkToHost(&reply.data.tracking.ip_addr, &ip_addr);
-  format_name(name, sizeof (name), sizeof (name),
-              ip_addr.family == IPADDR_UNSPEC, ref_id, 1, &ip_addr);
+  /* Avoid repeated DNS lookups of the same address in the watch mode */
+  if (!name[0] || ref_id != last_ref_id || UTI_CompareIPs(&ip_addr, &last_ip_addr, NULL)) {
+    format_name(name, sizeof (name), sizeof (name),
+                ip_addr.family == IPADDR_UNSPEC, ref_id, 1, &ip_addr);
+    last_ref_id = ref_id;
+    last_ip_addr = ip_addr;
+  }
 
-  UTI_TimespecNetworkToHost(&reply.data.tracking.ref_time, &ref_time);
+  UTI_TimespecNetworkToHost(&reply->data.tracking.ref_time, &ref_time);
 
-  print_report("Reference ID    : %R (%s)\n"
+  print_report(tracking_fields,
+               "Reference ID    : %R (%s)\n"
                "Stratum         : %u\n"
                "Ref time (UTC)  : %T\n"
                "System time     : %.9O of NTP time\n"
@@ -2161,18 +2576,33 @@ process_cmd_tracking(char *line)
                "Update interval : %.1f seconds\n"
                "Leap status     : %L\n",
                (unsigned long)ref_id, name,
-               ntohs(reply.data.tracking.stratum),
+               ntohs(reply->data.tracking.stratum),
                &ref_time,
-               UTI_FloatNetworkToHost(reply.data.tracking.current_correction),
-               UTI_FloatNetworkToHost(reply.data.tracking.last_offset),
-               UTI_FloatNetworkToHost(reply.data.tracking.rms_offset),
-               UTI_FloatNetworkToHost(reply.data.tracking.freq_ppm),
-               UTI_FloatNetworkToHost(reply.data.tracking.resid_freq_ppm),
-               UTI_FloatNetworkToHost(reply.data.tracking.skew_ppm),
-               UTI_FloatNetworkToHost(reply.data.tracking.root_delay),
-               UTI_FloatNetworkToHost(reply.data.tracking.root_dispersion),
-               UTI_FloatNetworkToHost(reply.data.tracking.last_update_interval),
-               ntohs(reply.data.tracking.leap_status), REPORT_END);
+               UTI_FloatNetworkToHost(reply->data.tracking.current_correction),
+               UTI_FloatNetworkToHost(reply->data.tracking.last_offset),
+               UTI_FloatNetworkToHost(reply->data.tracking.rms_offset),
+               UTI_FloatNetworkToHost(reply->data.tracking.freq_ppm),
+               UTI_FloatNetworkToHost(reply->data.tracking.resid_freq_ppm),
+               UTI_FloatNetworkToHost(reply->data.tracking.skew_ppm),
+               UTI_FloatNetworkToHost(reply->data.tracking.root_delay),
+               UTI_FloatNetworkToHost(reply->data.tracking.root_dispersion),
+               UTI_FloatNetworkToHost(reply->data.tracking.last_update_interval),
+               ntohs(reply->data.tracking.leap_status), REPORT_END);
+}
+
+/* ================================================== */
+
+static int
+process_cmd_tracking(char *line)
+{
+  CMD_Request request;
+  CMD_Reply reply;
+
+  request.command = htons(REQ_TRACKING);
+  if (!request_reply(&request, &reply, RPY_TRACKING, 0))
+    return 0;
+
+  print_tracking(&reply);
 
   return 1;
 }
@@ -2184,6 +2614,7 @@ process_cmd_authdata(char *line)
 {
   CMD_Request request;
   CMD_Reply reply;
+  RPY_SourceDataRecord data;
   IPAddr ip_addr;
   uint32_t i, source_mode, n_sources;
   int all, verbose;
@@ -2192,12 +2623,9 @@ process_cmd_authdata(char *line)
 
   parse_sources_options(line, &all, &verbose);
 
-  request.command = htons(REQ_N_SOURCES);
-  if (!request_reply(&request, &reply, RPY_N_SOURCES, 0))
+  if (!get_number_of_sources(SOURCE_RECORD_DATA, &n_sources))
     return 0;
 
-  n_sources = ntohl(reply.data.n_sources.n_sources);
-
   if (verbose) {
     printf(    "                             .- Auth. mechanism (NTS, SK - symmetric key)\n");
     printf(    "                            |   Key length -.  Cookie length (bytes) -.\n");
@@ -2211,21 +2639,19 @@ process_cmd_authdata(char *line)
   /*           "NNNNNNNNNNNNNNNNNNNNNNNNNNN MMMM KKKKK AAAA LLLL LLLL AAAA NNNN CCCC LLLL" */
 
   for (i = 0; i < n_sources; i++) {
-    request.command = htons(REQ_SOURCE_DATA);
-    request.data.source_data.index = htonl(i);
-    if (!request_reply(&request, &reply, RPY_SOURCE_DATA, 0))
+    if (!get_source_record(SOURCE_RECORD_DATA, i, &data))
       return 0;
 
-    source_mode = ntohs(reply.data.source_data.mode);
+    source_mode = ntohs(data.mode);
     if (source_mode != RPY_SD_MD_CLIENT && source_mode != RPY_SD_MD_PEER)
       continue;
 
-    UTI_IPNetworkToHost(&reply.data.source_data.ip_addr, &ip_addr);
+    UTI_IPNetworkToHost(&data.ip_addr, &ip_addr);
     if (!all && ip_addr.family == IPADDR_ID)
       continue;
 
     request.command = htons(REQ_AUTH_DATA);
-    request.data.auth_data.ip_addr = reply.data.source_data.ip_addr;
+    request.data.auth_data.ip_addr = data.ip_addr;
     if (!request_reply(&request, &reply, RPY_AUTH_DATA, 0))
       return 0;
 
@@ -2246,7 +2672,8 @@ process_cmd_authdata(char *line)
         break;
     }
 
-    print_report("%-27s %4s %5U %4d %4d %I %4d %4d %4d %4d\n",
+    print_report(authdata_fields,
+                 "%-27s %4s %5U %4d %4d %I %4d %4d %4d %4d\n",
                  name, mode_str,
                  (unsigned long)ntohl(reply.data.auth_data.key_id),
                  ntohs(reply.data.auth_data.key_type),
@@ -2269,6 +2696,7 @@ process_cmd_ntpdata(char *line)
 {
   CMD_Request request;
   CMD_Reply reply;
+  RPY_SourceDataRecord data;
   IPAddr remote_addr, local_addr;
   struct timespec ref_time;
   uint32_t i, n_sources;
@@ -2280,10 +2708,8 @@ process_cmd_ntpdata(char *line)
     n_sources = 1;
   } else {
     specified_addr = 0;
-    request.command = htons(REQ_N_SOURCES);
-    if (!request_reply(&request, &reply, RPY_N_SOURCES, 0))
+    if (!get_number_of_sources(SOURCE_RECORD_DATA, &n_sources))
       return 0;
-    n_sources = ntohl(reply.data.n_sources.n_sources);
   }
 
   for (i = 0; i < n_sources; i++) {
@@ -2293,16 +2719,14 @@ process_cmd_ntpdata(char *line)
         return 0;
       }
     } else {
-      request.command = htons(REQ_SOURCE_DATA);
-      request.data.source_data.index = htonl(i);
-      if (!request_reply(&request, &reply, RPY_SOURCE_DATA, 0))
+      if (!get_source_record(SOURCE_RECORD_DATA, i, &data))
         return 0;
 
-      mode = ntohs(reply.data.source_data.mode);
+      mode = ntohs(data.mode);
       if (mode != RPY_SD_MD_CLIENT && mode != RPY_SD_MD_PEER)
         continue;
 
-      UTI_IPNetworkToHost(&reply.data.source_data.ip_addr, &remote_addr);
+      UTI_IPNetworkToHost(&data.ip_addr, &remote_addr);
       if (!UTI_IsIPReal(&remote_addr))
         continue;
     }
@@ -2319,7 +2743,8 @@ process_cmd_ntpdata(char *line)
     if (!specified_addr && !csv_mode)
       printf("\n");
 
-    print_report("Remote address  : %s (%R)\n"
+    print_report(ntpdata_fields,
+                 "Remote address  : %s (%R)\n"
                  "Remote port     : %u\n"
                  "Local address   : %s (%R)\n"
                  "Leap status     : %L\n"
@@ -2383,8 +2808,7 @@ process_cmd_ntpdata(char *line)
 static int
 process_cmd_selectdata(char *line)
 {
-  CMD_Request request;
-  CMD_Reply reply;
+  RPY_SelectDataRecord data;
   uint32_t i, n_sources;
   int all, verbose, conf_options, eff_options;
   char name[256];
@@ -2392,19 +2816,16 @@ process_cmd_selectdata(char *line)
 
   parse_sources_options(line, &all, &verbose);
 
-  request.command = htons(REQ_N_SOURCES);
-  if (!request_reply(&request, &reply, RPY_N_SOURCES, 0))
+  if (!get_number_of_sources(SOURCE_RECORD_SELECT, &n_sources))
     return 0;
 
-  n_sources = ntohl(reply.data.n_sources.n_sources);
-
   if (verbose) {
     printf(    "  . State: N - noselect, s - unsynchronised, M - missing samples,\n");
     printf(    " /         d/D - large distance, ~ - jittery, w/W - waits for others,\n");
     printf(    "|          S - stale, O - orphan, T - not trusted, P - not preferred,\n");
     printf(    "|          U - waits for update,, x - falseticker, + - combined, * - best.\n");
-    printf(    "|   Effective options   ---------.  (N - noselect, P - prefer\n");
-    printf(    "|   Configured options  ----.     \\  T - trust, R - require)\n");
+    printf(    "|   Effective options   ---------.  (N - noselect, P - prefer,\n");
+    printf(    "|   Configured options  ----.     \\  T - trust, R - require, M - monitor)\n");
     printf(    "|   Auth. enabled (Y/N) -.   \\     \\     Offset interval --.\n");
     printf(    "|                        |    |     |                       |\n");
   }
@@ -2414,40 +2835,39 @@ process_cmd_selectdata(char *line)
   /*           "S NNNNNNNNNNNNNNNNNNNNNNNNN A OOOO- OOOO- LLLL SSSSS IIIIIII IIIIIII  L" */
 
   for (i = 0; i < n_sources; i++) {
-    request.command = htons(REQ_SELECT_DATA);
-    request.data.source_data.index = htonl(i);
-    if (!request_reply(&request, &reply, RPY_SELECT_DATA, 0))
+    if (!get_source_record(SOURCE_RECORD_SELECT, i, &data))
       return 0;
 
-    UTI_IPNetworkToHost(&reply.data.select_data.ip_addr, &ip_addr);
+    UTI_IPNetworkToHost(&data.ip_addr, &ip_addr);
     if (!all && ip_addr.family == IPADDR_ID)
       continue;
 
     format_name(name, sizeof (name), 25, ip_addr.family == IPADDR_UNSPEC,
-                ntohl(reply.data.select_data.ref_id), 1, &ip_addr);
+                ntohl(data.ref_id), 1, &ip_addr);
 
-    conf_options = ntohs(reply.data.select_data.conf_options);
-    eff_options = ntohs(reply.data.select_data.eff_options);
+    conf_options = ntohs(data.conf_options);
+    eff_options = ntohs(data.eff_options);
 
-    print_report("%c %-25s %c %c%c%c%c%c %c%c%c%c%c %I %5.1f %+S %+S  %1L\n",
-                 reply.data.select_data.state_char,
+    print_report(selectdata_fields,
+                 "%c %-25s %c %c%c%c%c%c %c%c%c%c%c %I %5.1f %+S %+S  %1L\n",
+                 data.state_char,
                  name,
-                 reply.data.select_data.authentication ? 'Y' : 'N',
+                 data.authentication ? 'Y' : 'N',
                  conf_options & RPY_SD_OPTION_NOSELECT ? 'N' : '-',
                  conf_options & RPY_SD_OPTION_PREFER ? 'P' : '-',
                  conf_options & RPY_SD_OPTION_TRUST ? 'T' : '-',
                  conf_options & RPY_SD_OPTION_REQUIRE ? 'R' : '-',
-                 '-',
+                 conf_options & RPY_SD_OPTION_MONITOR ? 'M' : '-',
                  eff_options & RPY_SD_OPTION_NOSELECT ? 'N' : '-',
                  eff_options & RPY_SD_OPTION_PREFER ? 'P' : '-',
                  eff_options & RPY_SD_OPTION_TRUST ? 'T' : '-',
                  eff_options & RPY_SD_OPTION_REQUIRE ? 'R' : '-',
-                 '-',
-                 (unsigned long)ntohl(reply.data.select_data.last_sample_ago),
-                 UTI_FloatNetworkToHost(reply.data.select_data.score),
-                 UTI_FloatNetworkToHost(reply.data.select_data.lo_limit),
-                 UTI_FloatNetworkToHost(reply.data.select_data.hi_limit),
-                 reply.data.select_data.leap,
+                 eff_options & RPY_SD_OPTION_MONITOR ? 'M' : '-',
+                 (unsigned long)ntohl(data.last_sample_ago),
+                 UTI_FloatNetworkToHost(data.score),
+                 UTI_FloatNetworkToHost(data.lo_limit),
+                 UTI_FloatNetworkToHost(data.hi_limit),
+                 data.leap,
                  REPORT_END);
   }
 
@@ -2456,17 +2876,11 @@ process_cmd_selectdata(char *line)
 
 /* ================================================== */
 
-static int
-process_cmd_serverstats(char *line)
+static void
+print_server_stats(CMD_Reply *reply)
 {
-  CMD_Request request;
-  CMD_Reply reply;
-
-  request.command = htons(REQ_SERVER_STATS);
-  if (!request_reply(&request, &reply, RPY_SERVER_STATS3, 0))
-    return 0;
-
-  print_report("NTP packets received       : %U\n"
+  print_report(serverstats_fields,
+               "NTP packets received       : %U\n"
                "NTP packets dropped        : %U\n"
                "Command packets received   : %U\n"
                "Command packets dropped    : %U\n"
@@ -2476,19 +2890,185 @@ process_cmd_serverstats(char *line)
                "Authenticated NTP packets  : %U\n"
                "Interleaved NTP packets    : %U\n"
                "NTP timestamps held        : %U\n"
-               "NTP timestamp span         : %U\n",
-               (unsigned long)ntohl(reply.data.server_stats.ntp_hits),
-               (unsigned long)ntohl(reply.data.server_stats.ntp_drops),
-               (unsigned long)ntohl(reply.data.server_stats.cmd_hits),
-               (unsigned long)ntohl(reply.data.server_stats.cmd_drops),
-               (unsigned long)ntohl(reply.data.server_stats.log_drops),
-               (unsigned long)ntohl(reply.data.server_stats.nke_hits),
-               (unsigned long)ntohl(reply.data.server_stats.nke_drops),
-               (unsigned long)ntohl(reply.data.server_stats.ntp_auth_hits),
-               (unsigned long)ntohl(reply.data.server_stats.ntp_interleaved_hits),
-               (unsigned long)ntohl(reply.data.server_stats.ntp_timestamps),
-               (unsigned long)ntohl(reply.data.server_stats.ntp_span_seconds),
+               "NTP timestamp span         : %U\n"
+               "NTP server sockets         : %U\n"
+               "Min NTP packets per socket : %U\n"
+               "Max NTP packets per socket : %U\n"
+               "NTP-over-PTP received      : %U\n"
+               "NTP-over-PTP sent          : %U\n",
+               (unsigned long)ntohl(reply->data.server_stats.ntp_hits),
+               (unsigned long)ntohl(reply->data.server_stats.ntp_drops),
+               (unsigned long)ntohl(reply->data.server_stats.cmd_hits),
+               (unsigned long)ntohl(reply->data.server_stats.cmd_drops),
+               (unsigned long)ntohl(reply->data.server_stats.log_drops),
+               (unsigned long)ntohl(reply->data.server_stats.nke_hits),
+               (unsigned long)ntohl(reply->data.server_stats.nke_drops),
+               (unsigned long)ntohl(reply->data.server_stats.ntp_auth_hits),
+               (unsigned long)ntohl(reply->data.server_stats.ntp_interleaved_hits),
+               (unsigned long)ntohl(reply->data.server_stats.ntp_timestamps),
+               (unsigned long)ntohl(reply->data.server_stats.ntp_span_seconds),
+               (unsigned long)ntohl(reply->data.server_stats.ntp_sockets),
+               (unsigned long)ntohl(reply->data.server_stats.ntp_socket_min_hits),
+               (unsigned long)ntohl(reply->data.server_stats.ntp_socket_max_hits),
+               (unsigned long)ntohl(reply->data.server_stats.ptp_hits),
+               (unsigned long)ntohl(reply->data.server_stats.ptp_sent),
                REPORT_END);
+}
+
+/* ================================================== */
+
+static int
+process_cmd_serverstats(char *line)
+{
+  CMD_Request request;
+  CMD_Reply reply;
+
+  request.command = htons(REQ_SERVER_STATS);
+  if (!send_request(&request, &reply))
+    return 0;
+
+  /* Older servers don't report the socket and NTP-over-PTP counters */
+  if (ntohs(reply.reply) == RPY_SERVER_STATS3) {
+    reply.reply = htons(RPY_SERVER_STATS4);
+    memset(&reply.data.server_stats.ntp_sockets, 0,
+           offsetof(RPY_ServerStats, EOR) - offsetof(RPY_ServerStats, ntp_sockets));
+  }
+
+  if (!check_reply(&reply, RPY_SERVER_STATS4, 0))
+    return 0;
+
+  print_server_stats(&reply);
+
+  return 1;
+}
+
+/* ================================================== */
+
+static int
+process_cmd_socketstats(char *line)
+{
+  CMD_Request request;
+  CMD_Reply reply;
+  RPY_ServerSocketStatsRecord *record;
+  uint32_t i, n_sockets, next_index, n_indices;
+
+  next_index = 0;
+
+  print_header("Socket  Family     Packets");
+
+  while (1) {
+    request.command = htons(REQ_SERVER_SOCKET_STATS);
+    request.data.server_socket_stats.first_index = htonl(next_index);
+
+    if (!request_reply(&request, &reply, RPY_SERVER_SOCKET_STATS, 0))
+      return 0;
+
+    n_sockets = ntohl(reply.data.server_socket_stats.n_sockets);
+    n_indices = ntohl(reply.data.server_socket_stats.n_indices);
+
+    for (i = 0; i < n_sockets && i < MAX_SERVER_SOCKET_STATS; i++) {
+      record = &reply.data.server_socket_stats.sockets[i];
+
+      print_report(socketstats_fields,
+                   "%6U  %-6s %11U\n",
+                   (unsigned long)(next_index + i),
+                   ntohs(record->family) == IPADDR_INET4 ? "IPv4" : "IPv6",
+                   (unsigned long)ntohl(record->rx_messages),
+                   REPORT_END);
+    }
+
+    next_index = ntohl(reply.data.server_socket_stats.next_index);
+
+    if (next_index >= n_indices || n_sockets < MAX_SERVER_SOCKET_STATS)
+      break;
+  }
+
+  return 1;
+}
+
+/* ================================================== */
+
+static int
+process_cmd_schedstats(char *line)
+{
+  CMD_Request request;
+  CMD_Reply reply;
+  RPY_SchedHandlerStats *handler;
+  uint32_t i, iterations, n_handlers, next_index, n_indices, calls;
+  double busy_time;
+  char name[MAX_SCHED_HANDLER_NAME_LENGTH + 1], *opt;
+  int reset;
+
+  reset = 0;
+
+  while (*line) {
+    opt = line;
+    line = CPS_SplitWord(line);
+    if (strcmp(opt, "-r") == 0) {
+      reset = 1;
+    } else {
+      LOG(LOGS_ERR, "Invalid syntax for schedstats command");
+      return 0;
+    }
+  }
+
+  next_index = 0;
+
+  while (1) {
+    request.command = htons(REQ_SCHED_STATS);
+    request.data.sched_stats.first_index = htonl(next_index);
+    request.data.sched_stats.reset = htonl(reset);
+
+    if (!request_reply(&request, &reply, RPY_SCHED_STATS, 0))
+      return 0;
+
+    if (next_index == 0) {
+      iterations = ntohl(reply.data.sched_stats.iterations);
+      busy_time = UTI_FloatNetworkToHost(reply.data.sched_stats.busy_time);
+
+      print_report(schedstats_fields,
+                   "Main loop iterations   : %U\n"
+                   "Time blocked in select : %.3f seconds\n"
+                   "Time processing events : %.6f seconds\n"
+                   "Average iteration time : %.9f seconds\n"
+                   "Maximum iteration time : %.9f seconds\n",
+                   (unsigned long)iterations,
+                   UTI_FloatNetworkToHost(reply.data.sched_stats.blocked_time),
+                   busy_time, iterations > 0 ? busy_time / iterations : 0.0,
+                   UTI_FloatNetworkToHost(reply.data.sched_stats.max_busy_time),
+                   REPORT_END);
+
+      if (!csv_mode)
+        printf("\n");
+      print_header("Handler                  Type          Calls    Total  Average  Maximum");
+    }
+
+    n_handlers = ntohl(reply.data.sched_stats.n_handlers);
+    n_indices = ntohl(reply.data.sched_stats.n_indices);
+
+    for (i = 0; i < n_handlers && i < MAX_SCHED_HANDLER_STATS; i++) {
+      handler = &reply.data.sched_stats.handlers[i];
+      calls = ntohl(handler->calls);
+
+      memcpy(name, handler->name, sizeof (handler->name));
+      name[sizeof (name) - 1] = '\0';
+
+      print_report(schedstats_handler_fields,
+                   "%-24s %-7s %11U   %S   %S   %S\n",
+                   name,
+                   ntohs(handler->type) == RPY_SCH_TYPE_FILE ? "file" : "timeout",
+                   (unsigned long)calls,
+                   UTI_FloatNetworkToHost(handler->total_time),
+                   calls > 0 ? UTI_FloatNetworkToHost(handler->total_time) / calls : 0.0,
+                   UTI_FloatNetworkToHost(handler->max_time),
+                   REPORT_END);
+    }
+
+    next_index = ntohl(reply.data.sched_stats.next_index);
+
+    if (next_index >= n_indices || n_handlers < MAX_SCHED_HANDLER_STATS)
+      break;
+  }
 
   return 1;
 }
@@ -2508,7 +3088,8 @@ process_cmd_smoothing(char *line)
 
   flags = ntohl(reply.data.smoothing.flags);
 
-  print_report("Active         : %B %s\n"
+  print_report(smoothing_fields,
+               "Active         : %B %s\n"
                "Offset         : %+.9f seconds\n"
                "Frequency      : %+.6f ppm\n"
                "Wander         : %+.6f ppm per second\n"
@@ -2560,7 +3141,8 @@ process_cmd_rtcreport(char *line)
 
   UTI_TimespecNetworkToHost(&reply.data.rtc.ref_time, &ref_time);
 
-  print_report("RTC ref time (UTC) : %T\n"
+  print_report(rtcdata_fields,
+               "RTC ref time (UTC) : %T\n"
                "Number of samples  : %u\n"
                "Number of runs     : %u\n"
                "Sample span period : %I\n"
@@ -2642,7 +3224,8 @@ process_cmd_clients(char *line)
 
       format_name(name, sizeof (name), 25, 0, 0, 0, &ip);
 
-      print_report("%-25s  %6U  %5U  %C  %C  %I  %6U  %5U  %C  %I\n",
+      print_report(nke ? clients_nke_fields : clients_fields,
+                   "%-25s  %6U  %5U  %C  %C  %I  %6U  %5U  %C  %I\n",
                    name,
                    (unsigned long)ntohl(client->ntp_hits),
                    (unsigned long)ntohl(client->ntp_drops),
@@ -2692,7 +3275,8 @@ process_cmd_manual_list(const char *line)
     sample = &reply.data.manual_list.samples[i];
     UTI_TimespecNetworkToHost(&sample->when, &when);
 
-    print_report("%2d %s %10.2f %10.2f %10.2f\n",
+    print_report(manual_list_fields,
+                 "%2d %s %10.2f %10.2f %10.2f\n",
                  i, UTI_TimeToLogForm(when.tv_sec),
                  UTI_FloatNetworkToHost(sample->slewed_offset),
                  UTI_FloatNetworkToHost(sample->orig_offset),
@@ -2799,7 +3383,8 @@ process_cmd_activity(const char *line)
 
   print_info_field("200 OK\n");
 
-  print_report("%U sources online\n"
+  print_report(activity_fields,
+               "%U sources online\n"
                "%U sources offline\n"
                "%U sources doing burst (return to online)\n"
                "%U sources doing burst (return to offline)\n"
@@ -2921,7 +3506,8 @@ process_cmd_waitsync(char *line)
       correction = fabs(correction);
       skew_ppm = UTI_FloatNetworkToHost(reply.data.tracking.skew_ppm);
 
-      print_report("try: %d, refid: %R, correction: %.9f, skew: %.3f\n",
+      print_report(waitsync_fields,
+                   "try: %d, refid: %R, correction: %.9f, skew: %.3f\n",
                    i, (unsigned long)ref_id, correction, skew_ppm, REPORT_END);
 
       if ((ip_addr.family != IPADDR_UNSPEC ||
@@ -2943,6 +3529,389 @@ process_cmd_waitsync(char *line)
   return ret;
 }
 
+/* ================================================== */
+/* Reports which can be watched for changes, and the subscriptions and
+   replies used when the server can push them to us */
+
+static const struct {
+  const char *name;
+  int (*process)(char *line);
+  void (*print)(CMD_Reply *reply);
+  uint16_t reply;
+  uint32_t subscription;
+} watch_reports[] = {
+  { "rtcdata", process_cmd_rtcreport, NULL, 0, 0 },
+  { "serverstats", process_cmd_serverstats, print_server_stats,
+    RPY_SERVER_STATS4, REQ_SUBSCRIBE_SERVER_STATS },
+  { "smoothing", process_cmd_smoothing, NULL, 0, 0 },
+  { "tracking", process_cmd_tracking, print_tracking,
+    RPY_TRACKING, REQ_SUBSCRIBE_TRACKING },
+};
+
+#define MAX_WATCH_FIELDS 32
+
+/* Lifetime of subscriptions (renewed after a third of it) */
+#define WATCH_SUBSCRIPTION_LIFETIME 60
+
+/* ================================================== */
+
+static void
+start_report_capture(void)
+{
+  assert(!captured_report);
+  captured_report = ARR_CreateInstance(sizeof (char));
+}
+
+/* ================================================== */
+
+static char *
+finish_report_capture(void)
+{
+  char *report, c;
+  int len;
+
+  /* Drop the final newline */
+  len = ARR_GetSize(captured_report);
+  if (len > 0 && *(char *)ARR_GetElement(captured_report, len - 1) == '\n')
+    ARR_SetSize(captured_report, len - 1);
+
+  c = '\0';
+  ARR_AppendElement(captured_report, &c);
+  report = Strdup(ARR_GetElements(captured_report));
+
+  ARR_DestroyInstance(captured_report);
+  captured_report = NULL;
+
+  return report;
+}
+
+/* ================================================== */
+
+static int
+split_report(char *report, char separator, char **fields)
+{
+  int n, quoted;
+  char *s;
+
+  for (n = 0; n < MAX_WATCH_FIELDS; ) {
+    fields[n++] = report;
+
+    /* Skip separators in JSON strings */
+    for (s = report, quoted = 0; *s != '\0'; s++) {
+      if (json_mode && *s == '"')
+        quoted = !quoted;
+      else if (json_mode && *s == '\\' && s[1] != '\0')
+        s++;
+      else if (!quoted && *s == separator)
+        break;
+    }
+
+    if (*s == '\0')
+      break;
+    *s = '\0';
+    report = s + 1;
+  }
+
+  return n;
+}
+
+/* ================================================== */
+/* Remove the braces enclosing a report in the JSON mode */
+
+static char *
+strip_json_object(char *report)
+{
+  size_t len;
+
+  if (!json_mode)
+    return report;
+
+  len = strlen(report);
+  if (len < 2 || report[0] != '{' || report[len - 1] != '}')
+    return report;
+
+  report[len - 1] = '\0';
+  memmove(report, report + 1, len - 1);
+
+  return report;
+}
+
+/* ================================================== */
+/* Print lines (or fields in the CSV mode) of a report which are different
+   from the previous report.  Unchanged CSV fields are left empty and
+   unchanged JSON fields are left out. */
+
+static void
+print_report_changes(const char *report, const char *last_report)
+{
+  char *fields[MAX_WATCH_FIELDS], *last_fields[MAX_WATCH_FIELDS];
+  char *buf, *last_buf, separator;
+  int i, j, n, last_n, changed[MAX_WATCH_FIELDS], any_changed;
+
+  separator = csv_mode ? ',' : '\n';
+
+  buf = strip_json_object(Strdup(report));
+  n = split_report(buf, separator, fields);
+
+  last_buf = last_report ? strip_json_object(Strdup(last_report)) : NULL;
+  last_n = last_buf ? split_report(last_buf, separator, last_fields) : 0;
+
+  for (i = any_changed = 0; i < n; i++) {
+    changed[i] = i >= last_n || strcmp(fields[i], last_fields[i]) != 0;
+    any_changed |= changed[i];
+  }
+
+  if (any_changed) {
+    if (json_mode)
+      printf("{");
+
+    for (i = j = 0; i < n; i++) {
+      if (json_mode) {
+        if (changed[i])
+          printf("%s%s", j++ > 0 ? "," : "", fields[i]);
+      } else if (csv_mode) {
+        printf("%s%s", i > 0 ? "," : "", changed[i] ? fields[i] : "");
+      } else if (changed[i]) {
+        printf("%s\n", fields[i]);
+      }
+    }
+
+    if (json_mode)
+      printf("}");
+    if (csv_mode)
+      printf("\n");
+
+    fflush(stdout);
+  }
+
+  Free(buf);
+  Free(last_buf);
+}
+
+/* ================================================== */
+
+static void
+update_watched_report(char **last_report, int valid)
+{
+  char *report;
+
+  report = finish_report_capture();
+
+  if (!valid) {
+    Free(report);
+    return;
+  }
+
+  print_report_changes(report, *last_report);
+
+  Free(*last_report);
+  *last_report = report;
+}
+
+/* ================================================== */
+/* Ask the server to push the reports to us when they change.  Returns
+   1 if subscribed, 0 if not supported, and -1 on error. */
+
+static int
+subscribe_reports(uint32_t reports, double interval, uint32_t *sequence)
+{
+  CMD_Request request;
+  CMD_Reply reply;
+
+  request.command = htons(REQ_SUBSCRIBE);
+  request.data.subscribe.reports = htonl(reports);
+  request.data.subscribe.interval = UTI_FloatHostToNetwork(interval);
+  request.data.subscribe.lifetime = htonl(WATCH_SUBSCRIPTION_LIFETIME);
+
+  if (!send_request(&request, &reply))
+    return -1;
+
+  /* Subscriptions are supported only by newer servers and only on the Unix
+     domain socket */
+  if (ntohs(reply.status) != STT_SUCCESS || ntohs(reply.reply) != RPY_NULL) {
+    DEBUG_LOG("Subscription failed status=%d", ntohs(reply.status));
+    return 0;
+  }
+
+  *sequence = request.sequence;
+
+  return 1;
+}
+
+/* ================================================== */
+
+static int
+receive_pushed_reply(CMD_Reply *reply, uint32_t sequence, double timeout)
+{
+  struct timeval tv;
+  fd_set rdfd;
+  int length;
+
+  UTI_DoubleToTimeval(timeout, &tv);
+
+  FD_ZERO(&rdfd);
+  FD_SET(sock_fd, &rdfd);
+
+  if (quit || select(sock_fd + 1, &rdfd, NULL, NULL, &tv) <= 0)
+    return 0;
+
+  length = SCK_Receive(sock_fd, reply, sizeof (*reply), 0);
+
+  if (length < (int)offsetof(CMD_Reply, data) ||
+      reply->version != proto_version ||
+      reply->pkt_type != PKT_TYPE_CMD_REPLY ||
+      reply->res1 != 0 ||
+      reply->res2 != 0 ||
+      reply->command != htons(REQ_SUBSCRIBE) ||
+      reply->sequence != sequence ||
+      reply->status != htons(STT_SUCCESS) ||
+      PKL_ReplyLength(reply) == 0 ||
+      length < PKL_ReplyLength(reply)) {
+    DEBUG_LOG("Invalid pushed reply");
+    return 0;
+  }
+
+  return 1;
+}
+
+/* ================================================== */
+
+static int
+watch_pushed_report(int index, double interval, int count, uint32_t sequence)
+{
+  CMD_Reply reply;
+  struct timeval tv;
+  double now, renewal, end, timeout;
+  char *last_report;
+  int received, ret;
+
+  last_report = NULL;
+  renewal = end = -1.0;
+  received = 0;
+  ret = 1;
+
+  while (!quit) {
+    if (gettimeofday(&tv, NULL) < 0) {
+      ret = 0;
+      break;
+    }
+    now = UTI_TimevalToDouble(&tv);
+
+    /* Reports are pushed only when they change.  Wait for the specified
+       number of intervals as if they were polled. */
+    if (end < 0.0)
+      end = now + (count - 1) * interval;
+    if (count > 0 && received && now >= end)
+      break;
+
+    if (renewal < 0.0 || now + WATCH_SUBSCRIPTION_LIFETIME < renewal) {
+      renewal = now + WATCH_SUBSCRIPTION_LIFETIME / 3.0;
+    } else if (now >= renewal) {
+      if (subscribe_reports(watch_reports[index].subscription, interval, &sequence) <= 0) {
+        ret = 0;
+        break;
+      }
+      renewal = now + WATCH_SUBSCRIPTION_LIFETIME / 3.0;
+    }
+
+    timeout = renewal - now;
+    if (count > 0 && received)
+      timeout = MIN(timeout, end - now);
+
+    if (!receive_pushed_reply(&reply, sequence, timeout) ||
+        ntohs(reply.reply) != watch_reports[index].reply)
+      continue;
+
+    start_report_capture();
+    watch_reports[index].print(&reply);
+    update_watched_report(&last_report, 1);
+    received = 1;
+  }
+
+  /* Cancel the subscription unless interrupted (the server will drop it
+     when our socket is removed) */
+  if (!quit)
+    subscribe_reports(0, interval, &sequence);
+
+  Free(last_report);
+
+  return ret;
+}
+
+/* ================================================== */
+
+static int
+watch_polled_report(int index, double interval, int count)
+{
+  struct timeval timeout;
+  char *last_report;
+  int i, ret;
+
+  last_report = NULL;
+  ret = 1;
+
+  for (i = 0; !count || i < count; i++) {
+    if (i > 0) {
+      UTI_DoubleToTimeval(interval, &timeout);
+      if (quit || select(0, NULL, NULL, NULL, &timeout))
+        break;
+    }
+
+    start_report_capture();
+    ret = watch_reports[index].process("");
+    update_watched_report(&last_report, ret);
+
+    if (!ret)
+      break;
+  }
+
+  Free(last_report);
+
+  return ret;
+}
+
+/* ================================================== */
+
+static int
+process_cmd_watch(char *line)
+{
+  uint32_t sequence;
+  double interval;
+  int i, count, r;
+  char *report;
+
+  report = line;
+  line = CPS_SplitWord(line);
+  interval = 1.0;
+  count = 0;
+
+  for (i = 0; i < sizeof (watch_reports) / sizeof (watch_reports[0]); i++) {
+    if (strcmp(watch_reports[i].name, report) == 0)
+      break;
+  }
+
+  if (i >= sizeof (watch_reports) / sizeof (watch_reports[0]) ||
+      (*line && sscanf(line, "%lf %d", &interval, &count) < 1) || count < 0) {
+    LOG(LOGS_ERR, "Invalid syntax for watch command");
+    return 0;
+  }
+
+  /* Don't allow shorter interval than 0.1 seconds */
+  if (interval < 0.1)
+    interval = 0.1;
+
+  /* Prefer reports pushed by the server, if it supports it */
+  if (watch_reports[i].subscription) {
+    r = subscribe_reports(watch_reports[i].subscription, interval, &sequence);
+    if (r < 0)
+      return 0;
+    if (r > 0)
+      return watch_pushed_report(i, interval, count, sequence);
+  }
+
+  return watch_polled_report(i, interval, count);
+}
+
 /* ================================================== */
 
 static int
@@ -3186,6 +4155,9 @@ process_line(char *line)
   } else if (!strcmp(command, "rtcdata")) {
     do_normal_submit = 0;
     ret = process_cmd_rtcreport(line);
+  } else if (!strcmp(command, "schedstats")) {
+    do_normal_submit = 0;
+    ret = process_cmd_schedstats(line);
   } else if (!strcmp(command, "selectdata")) {
     do_normal_submit = 0;
     ret = process_cmd_selectdata(line);
@@ -3202,6 +4174,9 @@ process_line(char *line)
     ret = process_cmd_smoothing(line);
   } else if (!strcmp(command, "smoothtime")) {
     do_normal_submit = process_cmd_smoothtime(&tx_message, line);
+  } else if (!strcmp(command, "socketstats")) {
+    do_normal_submit = 0;
+    ret = process_cmd_socketstats(line);
   } else if (!strcmp(command, "sourcename")) {
     do_normal_submit = 0;
     ret = process_cmd_sourcename(line);
@@ -3222,6 +4197,9 @@ process_line(char *line)
   } else if (!strcmp(command, "waitsync")) {
     ret = process_cmd_waitsync(line);
     do_normal_submit = 0;
+  } else if (!strcmp(command, "watch")) {
+    ret = process_cmd_watch(line);
+    do_normal_submit = 0;
   } else if (!strcmp(command, "writertc")) {
     process_cmd_writertc(&tx_message, line);
   } else if (!strcmp(command, "authhash") ||
@@ -3313,6 +4291,7 @@ print_help(const char *progname)
              "  -n\t\tDon't resolve hostnames\n"
              "  -N\t\tPrint original source names\n"
              "  -c\t\tEnable CSV format\n"
+             "  -j\t\tEnable JSON format\n"
 #if DEBUG > 0
              "  -d\t\tEnable debug messages\n"
 #endif
@@ -3357,7 +4336,7 @@ main(int argc, char **argv)
   optind = 1;
 
   /* Parse short command-line options */
-  while ((opt = getopt(argc, argv, "+46acdf:h:mnNp:v")) != -1) {
+  while ((opt = getopt(argc, argv, "+46acdf:h:jmnNp:v")) != -1) {
     switch (opt) {
       case '4':
       case '6':
@@ -3378,6 +4357,10 @@ main(int argc, char **argv)
       case 'h':
         hostnames = optarg;
         break;
+      case 'j':
+        /* The JSON format is an extension of the CSV format */
+        csv_mode = json_mode = 1;
+        break;
       case 'm':
         multi = 1;
         break;
@@ -37,6 +37,7 @@
 #include "keys.h"
 #include "ntp_sources.h"
 #include "ntp_core.h"
+#include "ntp_io.h"
 #include "smooth.h"
 #include "socket.h"
 #include "sources.h"
@@ -68,6 +69,27 @@ static int bound_sock_fd4;
 /* Flag indicating whether this module has been initialised or not */
 static int initialised = 0;
 
+/* Local clients subscribed to reports which are sent to them when
+   they change */
+
+#define MAX_SUBSCRIPTIONS 16
+#define MIN_SUBSCRIPTION_INTERVAL 0.1
+#define MAX_SUBSCRIPTION_INTERVAL 3600.0
+#define MAX_SUBSCRIPTION_LIFETIME 3600
+
+typedef struct {
+  char *path;
+  uint32_t reports;
+  uint32_t sequence;
+  double interval;
+  double expiry;
+  SCH_TimeoutID timeout_id;
+  CMD_Reply last_tracking;
+  CMD_Reply last_server_stats;
+} Subscription;
+
+static Subscription subscriptions[MAX_SUBSCRIPTIONS];
+
 /* ================================================== */
 /* Array of permission levels for command types */
 
@@ -144,6 +166,12 @@ static const char permissions[] = {
   PERMIT_AUTH, /* SELECT_DATA */
   PERMIT_AUTH, /* RELOAD_SOURCES */
   PERMIT_AUTH, /* DOFFSET2 */
+  PERMIT_OPEN, /* SOURCE_DATA_BY_INDEX */
+  PERMIT_OPEN, /* SOURCESTATS_BY_INDEX */
+  PERMIT_AUTH, /* SELECT_DATA_BY_INDEX */
+  PERMIT_AUTH, /* SCHED_STATS */
+  PERMIT_AUTH, /* SUBSCRIBE */
+  PERMIT_AUTH, /* SERVER_SOCKET_STATS */
 };
 
 /* ================================================== */
@@ -155,6 +183,7 @@ static ADF_AuthTable access_auth_table;
 /* ================================================== */
 /* Forward prototypes */
 static void read_from_cmd_socket(int sock_fd, int event, void *anything);
+static void cancel_subscription(Subscription *subscription);
 
 /* ================================================== */
 
@@ -218,6 +247,9 @@ do_size_checks(void)
 
   assert(offsetof(CMD_Request, data) == 20);
   assert(offsetof(CMD_Reply, data) == 28);
+  assert(offsetof(RPY_Source_Data, EOR) == sizeof (RPY_SourceDataRecord));
+  assert(offsetof(RPY_Sourcestats, EOR) == offsetof(RPY_SourcestatsRecord, n_dropped));
+  assert(offsetof(RPY_SelectData, EOR) == sizeof (RPY_SelectDataRecord));
 
   for (i = 0; i < N_REQUEST_TYPES; i++) {
     request.version = PROTO_VERSION_NUMBER;
@@ -257,6 +289,8 @@ CAM_Initialise(void)
   sock_fd4 = open_socket(IPADDR_INET4);
   sock_fd6 = open_socket(IPADDR_INET6);
 
+  memset(subscriptions, 0, sizeof (subscriptions));
+
   access_auth_table = ADF_CreateTable();
 }
 
@@ -265,6 +299,11 @@ CAM_Initialise(void)
 void
 CAM_Finalise(void)
 {
+  int i;
+
+  for (i = 0; i < MAX_SUBSCRIPTIONS; i++)
+    cancel_subscription(&subscriptions[i]);
+
   if (sock_fdu != INVALID_SOCK_FD) {
     SCH_RemoveFileHandler(sock_fdu);
     SCK_RemoveSocket(sock_fdu);
@@ -571,66 +610,80 @@ handle_n_sources(CMD_Request *rx_message, CMD_Reply *tx_message)
 
 /* ================================================== */
 
+static int
+get_source_data(uint32_t index, RPY_SourceDataRecord *record, struct timespec *now)
+{
+  RPT_SourceReport report;
+
+  if (!SRC_ReportSource(index, &report, now))
+    return 0;
+
+  switch (SRC_GetType(index)) {
+    case SRC_NTP:
+      NSR_ReportSource(&report, now);
+      break;
+    case SRC_REFCLOCK:
+      RCL_ReportSource(&report, now);
+      break;
+  }
+
+  UTI_IPHostToNetwork(&report.ip_addr, &record->ip_addr);
+  record->stratum = htons(report.stratum);
+  record->poll    = htons(report.poll);
+  switch (report.state) {
+    case RPT_NONSELECTABLE:
+      record->state   = htons(RPY_SD_ST_NONSELECTABLE);
+      break;
+    case RPT_FALSETICKER:
+      record->state   = htons(RPY_SD_ST_FALSETICKER);
+      break;
+    case RPT_JITTERY:
+      record->state   = htons(RPY_SD_ST_JITTERY);
+      break;
+    case RPT_SELECTABLE:
+      record->state   = htons(RPY_SD_ST_SELECTABLE);
+      break;
+    case RPT_UNSELECTED:
+      record->state   = htons(RPY_SD_ST_UNSELECTED);
+      break;
+    case RPT_SELECTED:
+      record->state   = htons(RPY_SD_ST_SELECTED);
+      break;
+  }
+  switch (report.mode) {
+    case RPT_NTP_CLIENT:
+      record->mode    = htons(RPY_SD_MD_CLIENT);
+      break;
+    case RPT_NTP_PEER:
+      record->mode    = htons(RPY_SD_MD_PEER);
+      break;
+    case RPT_LOCAL_REFERENCE:
+      record->mode    = htons(RPY_SD_MD_REF);
+      break;
+  }
+  record->flags = htons(0);
+  record->reachability = htons(report.reachability);
+  record->since_sample = htonl(report.latest_meas_ago);
+  record->orig_latest_meas = UTI_FloatHostToNetwork(report.orig_latest_meas);
+  record->latest_meas = UTI_FloatHostToNetwork(report.latest_meas);
+  record->latest_meas_err = UTI_FloatHostToNetwork(report.latest_meas_err);
+
+  return 1;
+}
+
+/* ================================================== */
+
 static void
 handle_source_data(CMD_Request *rx_message, CMD_Reply *tx_message)
 {
-  RPT_SourceReport report;
+  RPY_SourceDataRecord record;
   struct timespec now_corr;
 
   /* Get data */
   SCH_GetLastEventTime(&now_corr, NULL, NULL);
-  if (SRC_ReportSource(ntohl(rx_message->data.source_data.index), &report, &now_corr)) {
-    switch (SRC_GetType(ntohl(rx_message->data.source_data.index))) {
-      case SRC_NTP:
-        NSR_ReportSource(&report, &now_corr);
-        break;
-      case SRC_REFCLOCK:
-        RCL_ReportSource(&report, &now_corr);
-        break;
-    }
-    
+  if (get_source_data(ntohl(rx_message->data.source_data.index), &record, &now_corr)) {
     tx_message->reply  = htons(RPY_SOURCE_DATA);
-    
-    UTI_IPHostToNetwork(&report.ip_addr, &tx_message->data.source_data.ip_addr);
-    tx_message->data.source_data.stratum = htons(report.stratum);
-    tx_message->data.source_data.poll    = htons(report.poll);
-    switch (report.state) {
-      case RPT_NONSELECTABLE:
-        tx_message->data.source_data.state   = htons(RPY_SD_ST_NONSELECTABLE);
-        break;
-      case RPT_FALSETICKER:
-        tx_message->data.source_data.state   = htons(RPY_SD_ST_FALSETICKER);
-        break;
-      case RPT_JITTERY:
-        tx_message->data.source_data.state   = htons(RPY_SD_ST_JITTERY);
-        break;
-      case RPT_SELECTABLE:
-        tx_message->data.source_data.state   = htons(RPY_SD_ST_SELECTABLE);
-        break;
-      case RPT_UNSELECTED:
-        tx_message->data.source_data.state   = htons(RPY_SD_ST_UNSELECTED);
-        break;
-      case RPT_SELECTED:
-        tx_message->data.source_data.state   = htons(RPY_SD_ST_SELECTED);
-        break;
-    }
-    switch (report.mode) {
-      case RPT_NTP_CLIENT:
-        tx_message->data.source_data.mode    = htons(RPY_SD_MD_CLIENT);
-        break;
-      case RPT_NTP_PEER:
-        tx_message->data.source_data.mode    = htons(RPY_SD_MD_PEER);
-        break;
-      case RPT_LOCAL_REFERENCE:
-        tx_message->data.source_data.mode    = htons(RPY_SD_MD_REF);
-        break;
-    }
-    tx_message->data.source_data.flags = htons(0);
-    tx_message->data.source_data.reachability = htons(report.reachability);
-    tx_message->data.source_data.since_sample = htonl(report.latest_meas_ago);
-    tx_message->data.source_data.orig_latest_meas = UTI_FloatHostToNetwork(report.orig_latest_meas);
-    tx_message->data.source_data.latest_meas = UTI_FloatHostToNetwork(report.latest_meas);
-    tx_message->data.source_data.latest_meas_err = UTI_FloatHostToNetwork(report.latest_meas_err);
+    memcpy(&tx_message->data.source_data, &record, sizeof (record));
   } else {
     tx_message->status = htons(STT_NOSUCHSOURCE);
   }
@@ -638,6 +691,35 @@ handle_source_data(CMD_Request *rx_message, CMD_Reply *tx_message)
 
 /* ================================================== */
 
+static void
+handle_source_data_by_index(CMD_Request *rx_message, CMD_Reply *tx_message)
+{
+  RPY_SourceDataByIndex *data = &tx_message->data.source_data_by_index;
+  uint32_t i, j, first_index, n_sources, n_indices;
+  struct timespec now_corr;
+
+  SCH_GetLastEventTime(&now_corr, NULL, NULL);
+
+  first_index = ntohl(rx_message->data.sources_by_index.first_index);
+  n_sources = ntohl(rx_message->data.sources_by_index.n_sources);
+  if (n_sources > MAX_SOURCE_DATA_RECORDS)
+    n_sources = MAX_SOURCE_DATA_RECORDS;
+  n_indices = SRC_ReadNumberOfSources();
+
+  tx_message->reply = htons(RPY_SOURCE_DATA_BY_INDEX);
+
+  for (i = first_index, j = 0; i < n_indices && j < n_sources; i++, j++) {
+    if (!get_source_data(i, &data->sources[j], &now_corr))
+      break;
+  }
+
+  data->n_indices = htonl(n_indices);
+  data->next_index = htonl(i);
+  data->n_sources = htonl(j);
+}
+
+/* ================================================== */
+
 static void
 handle_rekey(CMD_Request *rx_message, CMD_Reply *tx_message)
 {
@@ -775,7 +857,8 @@ handle_add_source(CMD_Request *rx_message, CMD_Reply *tx_message)
     (ntohl(rx_message->data.ntp_source.flags) & REQ_ADDSRC_PREFER ? SRC_SELECT_PREFER : 0) |
     (ntohl(rx_message->data.ntp_source.flags) & REQ_ADDSRC_NOSELECT ? SRC_SELECT_NOSELECT : 0) |
     (ntohl(rx_message->data.ntp_source.flags) & REQ_ADDSRC_TRUST ? SRC_SELECT_TRUST : 0) |
-    (ntohl(rx_message->data.ntp_source.flags) & REQ_ADDSRC_REQUIRE ? SRC_SELECT_REQUIRE : 0);
+    (ntohl(rx_message->data.ntp_source.flags) & REQ_ADDSRC_REQUIRE ? SRC_SELECT_REQUIRE : 0) |
+    (ntohl(rx_message->data.ntp_source.flags) & REQ_ADDSRC_MONITOR ? SRC_SELECT_MONITOR : 0);
 
   status = NSR_AddSourceByName(name, port, pool, type, &params, NULL);
   switch (status) {
@@ -952,29 +1035,46 @@ handle_smoothtime(CMD_Request *rx_message, CMD_Reply *tx_message)
 
 /* ================================================== */
 
+static int
+get_sourcestats(uint32_t index, RPY_SourcestatsRecord *record, struct timespec *now)
+{
+  RPT_SourcestatsReport report;
+
+  if (!SRC_ReportSourcestats(index, &report, now))
+    return 0;
+
+  if (SRC_GetType(index) == SRC_REFCLOCK)
+    RCL_ReportSourcestats(&report);
+
+  record->ref_id = htonl(report.ref_id);
+  UTI_IPHostToNetwork(&report.ip_addr, &record->ip_addr);
+  record->n_samples = htonl(report.n_samples);
+  record->n_runs = htonl(report.n_runs);
+  record->span_seconds = htonl(report.span_seconds);
+  record->resid_freq_ppm = UTI_FloatHostToNetwork(report.resid_freq_ppm);
+  record->skew_ppm = UTI_FloatHostToNetwork(report.skew_ppm);
+  record->sd = UTI_FloatHostToNetwork(report.sd);
+  record->est_offset = UTI_FloatHostToNetwork(report.est_offset);
+  record->est_offset_err = UTI_FloatHostToNetwork(report.est_offset_err);
+  record->n_dropped = htonl(report.n_dropped);
+
+  return 1;
+}
+
+/* ================================================== */
+
 static void
 handle_sourcestats(CMD_Request *rx_message, CMD_Reply *tx_message)
 {
-  int status;
-  RPT_SourcestatsReport report;
+  RPY_SourcestatsRecord record;
   struct timespec now_corr;
 
   SCH_GetLastEventTime(&now_corr, NULL, NULL);
-  status = SRC_ReportSourcestats(ntohl(rx_message->data.sourcestats.index),
-                                 &report, &now_corr);
 
-  if (status) {
+  if (get_sourcestats(ntohl(rx_message->data.sourcestats.index), &record, &now_corr)) {
+    /* The single-source reply has only the fields preceding n_dropped */
     tx_message->reply = htons(RPY_SOURCESTATS);
-    tx_message->data.sourcestats.ref_id = htonl(report.ref_id);
-    UTI_IPHostToNetwork(&report.ip_addr, &tx_message->data.sourcestats.ip_addr);
-    tx_message->data.sourcestats.n_samples = htonl(report.n_samples);
-    tx_message->data.sourcestats.n_runs = htonl(report.n_runs);
-    tx_message->data.sourcestats.span_seconds = htonl(report.span_seconds);
-    tx_message->data.sourcestats.resid_freq_ppm = UTI_FloatHostToNetwork(report.resid_freq_ppm);
-    tx_message->data.sourcestats.skew_ppm = UTI_FloatHostToNetwork(report.skew_ppm);
-    tx_message->data.sourcestats.sd = UTI_FloatHostToNetwork(report.sd);
-    tx_message->data.sourcestats.est_offset = UTI_FloatHostToNetwork(report.est_offset);
-    tx_message->data.sourcestats.est_offset_err = UTI_FloatHostToNetwork(report.est_offset_err);
+    memcpy(&tx_message->data.sourcestats, &record, offsetof(RPY_Sourcestats, EOR));
   } else {
     tx_message->status = htons(STT_NOSUCHSOURCE);
   }
@@ -982,6 +1082,35 @@ handle_sourcestats(CMD_Request *rx_message, CMD_Reply *tx_message)
 
 /* ================================================== */
 
+static void
+handle_sourcestats_by_index(CMD_Request *rx_message, CMD_Reply *tx_message)
+{
+  RPY_SourcestatsByIndex *data = &tx_message->data.sourcestats_by_index;
+  uint32_t i, j, first_index, n_sources, n_indices;
+  struct timespec now_corr;
+
+  SCH_GetLastEventTime(&now_corr, NULL, NULL);
+
+  first_index = ntohl(rx_message->data.sources_by_index.first_index);
+  n_sources = ntohl(rx_message->data.sources_by_index.n_sources);
+  if (n_sources > MAX_SOURCESTATS_RECORDS)
+    n_sources = MAX_SOURCESTATS_RECORDS;
+  n_indices = SRC_ReadNumberOfSources();
+
+  tx_message->reply = htons(RPY_SOURCESTATS_BY_INDEX);
+
+  for (i = first_index, j = 0; i < n_indices && j < n_sources; i++, j++) {
+    if (!get_sourcestats(i, &data->sources[j], &now_corr))
+      break;
+  }
+
+  data->n_indices = htonl(n_indices);
+  data->next_index = htonl(i);
+  data->n_sources = htonl(j);
+}
+
+/* ================================================== */
+
 static void
 handle_rtcreport(CMD_Request *rx_message, CMD_Reply *tx_message)
 {
@@ -1167,7 +1296,10 @@ handle_server_stats(CMD_Request *rx_message, CMD_Reply *tx_message)
   RPT_ServerStatsReport report;
 
   CLG_GetServerStatsReport(&report);
-  tx_message->reply = htons(RPY_SERVER_STATS3);
+  report.ntp_sockets = NIO_GetServerSocketStats(&report.ntp_socket_min_hits,
+                                                &report.ntp_socket_max_hits);
+  NIO_GetPtpMessageStats(&report.ptp_hits, &report.ptp_sent);
+  tx_message->reply = htons(RPY_SERVER_STATS4);
   tx_message->data.server_stats.ntp_hits = htonl(report.ntp_hits);
   tx_message->data.server_stats.nke_hits = htonl(report.nke_hits);
   tx_message->data.server_stats.cmd_hits = htonl(report.cmd_hits);
@@ -1179,6 +1311,11 @@ handle_server_stats(CMD_Request *rx_message, CMD_Reply *tx_message)
   tx_message->data.server_stats.ntp_interleaved_hits = htonl(report.ntp_interleaved_hits);
   tx_message->data.server_stats.ntp_timestamps = htonl(report.ntp_timestamps);
   tx_message->data.server_stats.ntp_span_seconds = htonl(report.ntp_span_seconds);
+  tx_message->data.server_stats.ntp_sockets = htonl(report.ntp_sockets);
+  tx_message->data.server_stats.ntp_socket_min_hits = htonl(report.ntp_socket_min_hits);
+  tx_message->data.server_stats.ntp_socket_max_hits = htonl(report.ntp_socket_max_hits);
+  tx_message->data.server_stats.ptp_hits = htonl(report.ptp_hits);
+  tx_message->data.server_stats.ptp_sent = htonl(report.ptp_sent);
 }
 
 /* ================================================== */
@@ -1330,7 +1467,34 @@ convert_select_options(int options)
   return (options & SRC_SELECT_PREFER ? RPY_SD_OPTION_PREFER : 0) |
          (options & SRC_SELECT_NOSELECT ? RPY_SD_OPTION_NOSELECT : 0) |
          (options & SRC_SELECT_TRUST ? RPY_SD_OPTION_TRUST : 0) |
-         (options & SRC_SELECT_REQUIRE ? RPY_SD_OPTION_REQUIRE : 0);
+         (options & SRC_SELECT_REQUIRE ? RPY_SD_OPTION_REQUIRE : 0) |
+         (options & SRC_SELECT_MONITOR ? RPY_SD_OPTION_MONITOR : 0);
+}
+
+/* ================================================== */
+
+static int
+get_select_data(uint32_t index, RPY_SelectDataRecord *record)
+{
+  RPT_SelectReport report;
+
+  if (!SRC_GetSelectReport(index, &report))
+    return 0;
+
+  record->ref_id = htonl(report.ref_id);
+  UTI_IPHostToNetwork(&report.ip_addr, &record->ip_addr);
+  record->state_char = report.state_char;
+  record->authentication = report.authentication;
+  record->leap = report.leap;
+  record->pad = 0;
+  record->conf_options = htons(convert_select_options(report.conf_options));
+  record->eff_options = htons(convert_select_options(report.eff_options));
+  record->last_sample_ago = htonl(report.last_sample_ago);
+  record->score = UTI_FloatHostToNetwork(report.score);
+  record->hi_limit = UTI_FloatHostToNetwork(report.hi_limit);
+  record->lo_limit = UTI_FloatHostToNetwork(report.lo_limit);
+
+  return 1;
 }
 
 /* ================================================== */
@@ -1338,26 +1502,254 @@ convert_select_options(int options)
 static void
 handle_select_data(CMD_Request *rx_message, CMD_Reply *tx_message)
 {
-  RPT_SelectReport report;
+  RPY_SelectDataRecord record;
 
-  if (!SRC_GetSelectReport(ntohl(rx_message->data.select_data.index), &report)) {
+  if (!get_select_data(ntohl(rx_message->data.select_data.index), &record)) {
     tx_message->status = htons(STT_NOSUCHSOURCE);
     return;
   }
 
   tx_message->reply = htons(RPY_SELECT_DATA);
+  memcpy(&tx_message->data.select_data, &record, sizeof (record));
+}
+
+/* ================================================== */
+
+static void
+handle_select_data_by_index(CMD_Request *rx_message, CMD_Reply *tx_message)
+{
+  RPY_SelectDataByIndex *data = &tx_message->data.select_data_by_index;
+  uint32_t i, j, first_index, n_sources, n_indices;
+
+  first_index = ntohl(rx_message->data.sources_by_index.first_index);
+  n_sources = ntohl(rx_message->data.sources_by_index.n_sources);
+  if (n_sources > MAX_SELECT_DATA_RECORDS)
+    n_sources = MAX_SELECT_DATA_RECORDS;
+  n_indices = SRC_ReadNumberOfSources();
+
+  tx_message->reply = htons(RPY_SELECT_DATA_BY_INDEX);
+
+  for (i = first_index, j = 0; i < n_indices && j < n_sources; i++, j++) {
+    if (!get_select_data(i, &data->sources[j]))
+      break;
+  }
+
+  data->n_indices = htonl(n_indices);
+  data->next_index = htonl(i);
+  data->n_sources = htonl(j);
+}
+
+static void
+handle_sched_stats(CMD_Request *rx_message, CMD_Reply *tx_message)
+{
+  RPT_SchedHandlerReport handler_report;
+  RPT_SchedStatsReport report;
+  RPY_SchedHandlerStats *handler;
+  uint32_t i, j, first_index;
+  int reset;
+
+  first_index = ntohl(rx_message->data.sched_stats.first_index);
+  reset = ntohl(rx_message->data.sched_stats.reset) != 0;
+
+  if (!SCH_GetStatsReport(&report, reset && first_index == 0)) {
+    tx_message->status = htons(STT_NOTENABLED);
+    return;
+  }
+
+  tx_message->reply = htons(RPY_SCHED_STATS);
+  tx_message->data.sched_stats.iterations = htonl(report.iterations);
+  tx_message->data.sched_stats.blocked_time = UTI_FloatHostToNetwork(report.blocked_time);
+  tx_message->data.sched_stats.busy_time = UTI_FloatHostToNetwork(report.busy_time);
+  tx_message->data.sched_stats.max_busy_time = UTI_FloatHostToNetwork(report.max_busy_time);
+  tx_message->data.sched_stats.n_indices = htonl(report.n_handlers);
+
+  for (i = first_index, j = 0; i < report.n_handlers && j < MAX_SCHED_HANDLER_STATS;
+       i++, j++) {
+    if (!SCH_GetHandlerStatsReport(i, &handler_report, reset))
+      break;
+
+    handler = &tx_message->data.sched_stats.handlers[j];
+    snprintf((char *)handler->name, sizeof (handler->name), "%s", handler_report.name);
+    handler->type = htons(handler_report.type == RPT_SCH_FILE ?
+                          RPY_SCH_TYPE_FILE : RPY_SCH_TYPE_TIMEOUT);
+    handler->calls = htonl(handler_report.calls);
+    handler->total_time = UTI_FloatHostToNetwork(handler_report.total_time);
+    handler->max_time = UTI_FloatHostToNetwork(handler_report.max_time);
+  }
+
+  tx_message->data.sched_stats.next_index = htonl(i);
+  tx_message->data.sched_stats.n_handlers = htonl(j);
+}
+
+/* ================================================== */
+
+static void
+handle_server_socket_stats(CMD_Request *rx_message, CMD_Reply *tx_message)
+{
+  RPY_ServerSocketStatsRecord *record;
+  RPT_ServerSocketReport report;
+  uint32_t i, j, first_index, n_sockets, min_rx_messages, max_rx_messages;
+
+  first_index = ntohl(rx_message->data.server_socket_stats.first_index);
+  n_sockets = NIO_GetServerSocketStats(&min_rx_messages, &max_rx_messages);
+
+  tx_message->reply = htons(RPY_SERVER_SOCKET_STATS);
+  tx_message->data.server_socket_stats.n_indices = htonl(n_sockets);
+
+  for (i = first_index, j = 0; i < n_sockets && j < MAX_SERVER_SOCKET_STATS; i++, j++) {
+    if (!NIO_GetServerSocketReport(i, &report))
+      break;
+
+    record = &tx_message->data.server_socket_stats.sockets[j];
+    record->family = htons(report.family);
+    record->pad = 0;
+    record->rx_messages = htonl(report.rx_messages);
+  }
+
+  tx_message->data.server_socket_stats.next_index = htonl(i);
+  tx_message->data.server_socket_stats.n_sockets = htonl(j);
+}
+
+/* ================================================== */
+
+static void
+cancel_subscription(Subscription *subscription)
+{
+  if (!subscription->path)
+    return;
+
+  DEBUG_LOG("Cancelled subscription of %s", subscription->path);
+
+  SCH_RemoveTimeout(subscription->timeout_id);
+  Free(subscription->path);
+  memset(subscription, 0, sizeof (*subscription));
+}
+
+/* ================================================== */
+
+static int
+push_report(Subscription *subscription, CMD_Reply *last_reply,
+            void (*handler)(CMD_Request *, CMD_Reply *))
+{
+  SCK_Message message;
+  CMD_Reply reply;
+
+  memset(&reply, 0, sizeof (reply));
+  reply.version = PROTO_VERSION_NUMBER;
+  reply.pkt_type = PKT_TYPE_CMD_REPLY;
+  reply.command = htons(REQ_SUBSCRIBE);
+  reply.status = htons(STT_SUCCESS);
+  reply.sequence = subscription->sequence;
+
+  (*handler)(NULL, &reply);
+
+  /* Send the report only if it changed since the last push */
+  if (memcmp(&reply, last_reply, PKL_ReplyLength(&reply)) == 0)
+    return 1;
+
+  *last_reply = reply;
+
+  SCK_InitMessage(&message, SCK_ADDR_UNIX);
+  message.remote_addr.path = subscription->path;
+  message.data = &reply;
+  message.length = PKL_ReplyLength(&reply);
+
+  return SCK_SendMessage(sock_fdu, &message, 0);
+}
 
-  tx_message->data.select_data.ref_id = htonl(report.ref_id);
-  UTI_IPHostToNetwork(&report.ip_addr, &tx_message->data.select_data.ip_addr);
-  tx_message->data.select_data.state_char = report.state_char;
-  tx_message->data.select_data.authentication = report.authentication;
-  tx_message->data.select_data.leap = report.leap;
-  tx_message->data.select_data.conf_options = htons(convert_select_options(report.conf_options));
-  tx_message->data.select_data.eff_options = htons(convert_select_options(report.eff_options));
-  tx_message->data.select_data.last_sample_ago = htonl(report.last_sample_ago);
-  tx_message->data.select_data.score = UTI_FloatHostToNetwork(report.score);
-  tx_message->data.select_data.hi_limit = UTI_FloatHostToNetwork(report.hi_limit);
-  tx_message->data.select_data.lo_limit = UTI_FloatHostToNetwork(report.lo_limit);
+/* ================================================== */
+
+static void
+push_reports(void *arg)
+{
+  Subscription *subscription = arg;
+  int ok = 1;
+
+  subscription->timeout_id = 0;
+
+  if (subscription->reports & REQ_SUBSCRIBE_TRACKING)
+    ok = ok && push_report(subscription, &subscription->last_tracking, handle_tracking);
+  if (subscription->reports & REQ_SUBSCRIBE_SERVER_STATS)
+    ok = ok && push_report(subscription, &subscription->last_server_stats,
+                           handle_server_stats);
+
+  /* Drop the subscription if the client is no longer running, or it
+     didn't renew the subscription in time */
+  if (!ok || SCH_GetLastEventMonoTime() > subscription->expiry) {
+    cancel_subscription(subscription);
+    return;
+  }
+
+  subscription->timeout_id = SCH_AddTimeoutByDelay(subscription->interval,
+                                                   push_reports, subscription);
+}
+
+/* ================================================== */
+
+static void
+handle_subscribe(CMD_Request *rx_message, CMD_Reply *tx_message, SCK_Message *message)
+{
+  Subscription *subscription;
+  uint32_t reports, lifetime;
+  double interval;
+  int i;
+
+  /* Reports can be pushed only to local clients */
+  if (message->addr_type != SCK_ADDR_UNIX || sock_fdu == INVALID_SOCK_FD) {
+    tx_message->status = htons(STT_UNAUTH);
+    return;
+  }
+
+  reports = ntohl(rx_message->data.subscribe.reports);
+  interval = UTI_FloatNetworkToHost(rx_message->data.subscribe.interval);
+  lifetime = ntohl(rx_message->data.subscribe.lifetime);
+
+  if (reports & ~(REQ_SUBSCRIBE_TRACKING | REQ_SUBSCRIBE_SERVER_STATS) ||
+      !(interval >= MIN_SUBSCRIPTION_INTERVAL) || interval > MAX_SUBSCRIPTION_INTERVAL) {
+    tx_message->status = htons(STT_INVALID);
+    return;
+  }
+
+  /* Find an existing subscription of the client, or a free slot */
+  for (i = 0, subscription = NULL; i < MAX_SUBSCRIPTIONS; i++) {
+    if (subscriptions[i].path && strcmp(subscriptions[i].path, message->remote_addr.path) == 0) {
+      subscription = &subscriptions[i];
+      break;
+    }
+    if (!subscription && !subscriptions[i].path)
+      subscription = &subscriptions[i];
+  }
+
+  if (!reports) {
+    if (subscription && subscription->path)
+      cancel_subscription(subscription);
+    return;
+  }
+
+  if (!subscription) {
+    tx_message->status = htons(STT_FAILED);
+    return;
+  }
+
+  if (!subscription->path) {
+    subscription->path = Strdup(message->remote_addr.path);
+    DEBUG_LOG("New subscription of %s", subscription->path);
+  }
+
+  /* Push all reports again after renewal, the client doesn't accept
+     the old sequence number */
+  memset(&subscription->last_tracking, 0, sizeof (subscription->last_tracking));
+  memset(&subscription->last_server_stats, 0, sizeof (subscription->last_server_stats));
+
+  subscription->reports = reports;
+  subscription->sequence = rx_message->sequence;
+  subscription->interval = interval;
+  subscription->expiry = SCH_GetLastEventMonoTime() +
+                         MIN(lifetime, MAX_SUBSCRIPTION_LIFETIME);
+
+  /* Send the first reports after the reply */
+  SCH_RemoveTimeout(subscription->timeout_id);
+  subscription->timeout_id = SCH_AddTimeoutByDelay(0.0, push_reports, subscription);
 }
 
 /* ================================================== */
@@ -1754,6 +2146,30 @@ read_from_cmd_socket(int sock_fd, int event, void *anything)
           handle_reload_sources(&rx_message, &tx_message);
           break;
 
+        case REQ_SOURCE_DATA_BY_INDEX:
+          handle_source_data_by_index(&rx_message, &tx_message);
+          break;
+
+        case REQ_SOURCESTATS_BY_INDEX:
+          handle_sourcestats_by_index(&rx_message, &tx_message);
+          break;
+
+        case REQ_SELECT_DATA_BY_INDEX:
+          handle_select_data_by_index(&rx_message, &tx_message);
+          break;
+
+        case REQ_SCHED_STATS:
+          handle_sched_stats(&rx_message, &tx_message);
+          break;
+
+        case REQ_SUBSCRIBE:
+          handle_subscribe(&rx_message, &tx_message, sck_message);
+          break;
+
+        case REQ_SERVER_SOCKET_STATS:
+          handle_server_socket_stats(&rx_message, &tx_message);
+          break;
+
         default:
           DEBUG_LOG("Unhandled command %d", rx_command);
           tx_message.status = htons(STT_FAILED);
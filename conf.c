@@ -94,6 +94,7 @@ static int restarted = 0;
 static char *rtc_device;
 static int acquisition_port = -1;
 static int ntp_port = NTP_PORT;
+static int ntp_server_sockets = 1;
 static char *keys_file = NULL;
 static char *drift_file = NULL;
 static char *rtc_file = NULL;
@@ -236,6 +237,9 @@ static int smooth_leap_only = 0;
 /* Temperature sensor, update interval and compensation coefficients */
 static char *tempcomp_sensor_file = NULL;
 static char *tempcomp_point_file = NULL;
+
+/* File with the shared memory segment published for other applications */
+static char *time_shm_file = NULL;
 static double tempcomp_interval;
 static double tempcomp_T0, tempcomp_k0, tempcomp_k1, tempcomp_k2;
 
@@ -477,6 +481,7 @@ CNF_Finalise(void)
   Free(mail_user_on_change);
   Free(tempcomp_sensor_file);
   Free(tempcomp_point_file);
+  Free(time_shm_file);
   Free(nts_dump_dir);
   Free(nts_ntp_server);
 }
@@ -712,6 +717,8 @@ CNF_ParseLine(const char *filename, int number, char *line)
     parse_int(p, &sched_priority);
   } else if (!strcasecmp(command, "server")) {
     parse_source(p, command, 1);
+  } else if (!strcasecmp(command, "serversockets")) {
+    parse_int(p, &ntp_server_sockets);
   } else if (!strcasecmp(command, "smoothtime")) {
     parse_smoothtime(p);
   } else if (!strcasecmp(command, "sourcedir")) {
@@ -720,6 +727,8 @@ CNF_ParseLine(const char *filename, int number, char *line)
     parse_double(p, &stratum_weight);
   } else if (!strcasecmp(command, "tempcomp")) {
     parse_tempcomp(p);
+  } else if (!strcasecmp(command, "timeshmfile")) {
+    parse_string(p, &time_shm_file);
   } else if (!strcasecmp(command, "user")) {
     parse_string(p, &user);
   } else if (!strcasecmp(command, "commandkey") ||
@@ -1448,6 +1457,7 @@ parse_hwtimestamp(char *line)
   iface = ARR_GetNewElement(hwts_interfaces);
   iface->name = Strdup(p);
   iface->minpoll = 0;
+  iface->maxpoll = 4;
   iface->min_samples = 2;
   iface->max_samples = 16;
   iface->nocrossts = 0;
@@ -1459,7 +1469,10 @@ parse_hwtimestamp(char *line)
   for (p = line; *p; line += n, p = line) {
     line = CPS_SplitWord(line);
 
-    if (!strcasecmp(p, "maxsamples")) {
+    if (!strcasecmp(p, "maxpoll")) {
+      if (sscanf(line, "%d%n", &iface->maxpoll, &n) != 1)
+        break;
+    } else if (!strcasecmp(p, "maxsamples")) {
       if (sscanf(line, "%d%n", &iface->max_samples, &n) != 1)
         break;
     } else if (!strcasecmp(p, "minpoll")) {
@@ -1880,6 +1893,14 @@ CNF_GetNTPPort(void)
 
 /* ================================================== */
 
+int
+CNF_GetNTPServerSockets(void)
+{
+  return ntp_server_sockets;
+}
+
+/* ================================================== */
+
 int
 CNF_GetAcquisitionPort(void)
 {
@@ -2421,6 +2442,14 @@ CNF_GetTempComp(char **file, double *interval, char **point_file, double *T0, do
 
 /* ================================================== */
 
+char *
+CNF_GetTimeShmFile(void)
+{
+  return time_shm_file;
+}
+
+/* ================================================== */
+
 char *
 CNF_GetUser(void)
 {
@@ -33,7 +33,6 @@
 #include "local.h"
 #include "logging.h"
 #include "memory.h"
-#include "regress.h"
 #include "util.h"
 
 /* Minimum and maximum number of samples per clock */
@@ -43,26 +42,45 @@
 /* Maximum acceptable frequency offset of the clock */
 #define MAX_FREQ_OFFSET (2.0 / 3.0)
 
+/* Limits of the ratio between the prediction error of a new sample and its
+   maximum error to increase and decrease the interval between samples */
+#define MAX_INCREASE_RESIDUAL_RATIO 0.5
+#define MIN_DECREASE_RESIDUAL_RATIO 0.75
+
+/* Number of consecutive samples within the limit needed for an increase */
+#define STABLE_SAMPLES 4
+
 struct HCL_Instance_Record {
-  /* HW and local reference timestamp */
+  /* HW and local reference timestamp (of the last sample) */
   struct timespec hw_ref;
   struct timespec local_ref;
 
-  /* Samples stored as intervals (uncorrected for frequency error)
-     relative to local_ref and hw_ref */
-  double *x_data;
-  double *y_data;
+  /* Exponentially weighted means, variance and covariance of the samples
+     stored as intervals (uncorrected for frequency error) relative to
+     local_ref and hw_ref */
+  double x_mean;
+  double y_mean;
+  double x_var;
+  double xy_cov;
 
-  /* Minimum, maximum and current number of samples */
+  /* Minimum, maximum and current number of samples in the averages */
   int min_samples;
   int max_samples;
   int n_samples;
 
+  /* Flag indicating the last sample was rejected */
+  int rejected;
+
+  /* Number of consecutive samples agreeing with the prediction */
+  int stable_samples;
+
   /* Maximum error of the last sample */
   double last_err;
 
-  /* Minimum interval between samples */
+  /* Minimum, maximum and current interval between samples */
   double min_separation;
+  double max_separation;
+  double separation;
 
   /* Flag indicating the offset and frequency values are valid */
   int valid_coefs;
@@ -92,7 +110,8 @@ handle_slew(struct timespec *raw, struct timespec *cooked, double dfreq,
 /* ================================================== */
 
 HCL_Instance
-HCL_CreateInstance(int min_samples, int max_samples, double min_separation)
+HCL_CreateInstance(int min_samples, int max_samples, double min_separation,
+                   double max_separation)
 {
   HCL_Instance clock;
 
@@ -101,15 +120,15 @@ HCL_CreateInstance(int min_samples, int max_samples, double min_separation)
   max_samples = MAX(min_samples, max_samples);
 
   clock = MallocNew(struct HCL_Instance_Record);
-  clock->x_data = MallocArray(double, max_samples);
-  clock->y_data = MallocArray(double, max_samples);
-  clock->x_data[max_samples - 1] = 0.0;
-  clock->y_data[max_samples - 1] = 0.0;
   clock->min_samples = min_samples;
   clock->max_samples = max_samples;
   clock->n_samples = 0;
+  clock->rejected = 0;
+  clock->stable_samples = 0;
   clock->valid_coefs = 0;
   clock->min_separation = min_separation;
+  clock->max_separation = MAX(min_separation, max_separation);
+  clock->separation = min_separation;
 
   LCL_AddParameterChangeHandler(handle_slew, clock);
 
@@ -121,8 +140,6 @@ HCL_CreateInstance(int min_samples, int max_samples, double min_separation)
 void HCL_DestroyInstance(HCL_Instance clock)
 {
   LCL_RemoveParameterChangeHandler(handle_slew, clock);
-  Free(clock->y_data);
-  Free(clock->x_data);
   Free(clock);
 }
 
@@ -132,7 +149,7 @@ int
 HCL_NeedsNewSample(HCL_Instance clock, struct timespec *now)
 {
   if (!clock->n_samples ||
-      fabs(UTI_DiffTimespecsToDouble(now, &clock->local_ref)) >= clock->min_separation)
+      fabs(UTI_DiffTimespecsToDouble(now, &clock->local_ref)) >= clock->separation)
     return 1;
 
   return 0;
@@ -140,69 +157,119 @@ HCL_NeedsNewSample(HCL_Instance clock, struct timespec *now)
 
 /* ================================================== */
 
+static void
+reset_clock(HCL_Instance clock)
+{
+  clock->n_samples = 0;
+  clock->rejected = 0;
+  clock->stable_samples = 0;
+  clock->valid_coefs = 0;
+  clock->separation = clock->min_separation;
+}
+
+/* ================================================== */
+
+static void
+update_separation(HCL_Instance clock, double residual_ratio)
+{
+  /* Sample the clock more frequently if the prediction error is getting
+     close to the error of the samples, e.g. due to a changing frequency
+     of the oscillators, and less frequently if the clocks are stable */
+  if (residual_ratio > MIN_DECREASE_RESIDUAL_RATIO) {
+    clock->separation = MAX(clock->separation / 2.0, clock->min_separation);
+    clock->stable_samples = 0;
+  } else if (residual_ratio < MAX_INCREASE_RESIDUAL_RATIO) {
+    if (++clock->stable_samples >= STABLE_SAMPLES) {
+      clock->separation = MIN(clock->separation * 2.0, clock->max_separation);
+      clock->stable_samples = 0;
+    }
+  }
+}
+
+/* ================================================== */
+
 void
 HCL_AccumulateSample(HCL_Instance clock, struct timespec *hw_ts,
                      struct timespec *local_ts, double err)
 {
-  double hw_delta, local_delta, local_freq, raw_freq;
-  int i, n_runs, best_start;
+  double hw_delta, local_delta, local_freq, raw_freq, residual, weight, dx, dy;
 
   local_freq = 1.0 - LCL_ReadAbsoluteFrequency() / 1.0e6;
 
-  /* Shift old samples */
   if (clock->n_samples) {
-    if (clock->n_samples >= clock->max_samples)
-      clock->n_samples--;
-
     hw_delta = UTI_DiffTimespecsToDouble(hw_ts, &clock->hw_ref);
     local_delta = UTI_DiffTimespecsToDouble(local_ts, &clock->local_ref) / local_freq;
 
     if (hw_delta <= 0.0 || local_delta < clock->min_separation / 2.0) {
-      clock->n_samples = 0;
+      reset_clock(clock);
       DEBUG_LOG("HW clock reset interval=%f", local_delta);
+    } else if (clock->valid_coefs) {
+      /* Compare the sample with the prediction of the current model */
+      residual = hw_delta - (clock->offset + clock->xy_cov / clock->x_var * local_delta);
+
+      if (fabs(residual) > err) {
+        /* Ignore the first sample which doesn't fit and forget older
+           samples if the next one doesn't fit either */
+        if (!clock->rejected) {
+          clock->rejected = 1;
+          DEBUG_LOG("HW clock sample rejected residual=%e err=%e", residual, err);
+          return;
+        }
+        clock->n_samples = MIN(clock->n_samples, clock->min_samples);
+      }
+
+      clock->rejected = 0;
+      update_separation(clock, fabs(residual) / err);
     }
 
-    for (i = clock->max_samples - clock->n_samples; i < clock->max_samples; i++) {
-      clock->y_data[i - 1] = clock->y_data[i] - hw_delta;
-      clock->x_data[i - 1] = clock->x_data[i] - local_delta;
+    /* Move the origin to the new sample */
+    if (clock->n_samples) {
+      clock->x_mean -= local_delta;
+      clock->y_mean -= hw_delta;
     }
   }
 
-  clock->n_samples++;
+  /* Add the new sample to the averages.  The weight of older samples
+     decreases exponentially when the maximum number is reached. */
+  if (clock->n_samples < clock->max_samples)
+    clock->n_samples++;
+
+  weight = 1.0 / clock->n_samples;
+  dx = -clock->x_mean;
+  dy = -clock->y_mean;
+
+  clock->x_mean += weight * dx;
+  clock->y_mean += weight * dy;
+  clock->x_var = (1.0 - weight) * (clock->x_var + weight * dx * dx);
+  clock->xy_cov = (1.0 - weight) * (clock->xy_cov + weight * dx * dy);
+
   clock->hw_ref = *hw_ts;
   clock->local_ref = *local_ts;
   clock->last_err = err;
 
   /* Get new coefficients */
-  clock->valid_coefs =
-    RGR_FindBestRobustRegression(clock->x_data + clock->max_samples - clock->n_samples,
-                                 clock->y_data + clock->max_samples - clock->n_samples,
-                                 clock->n_samples, 1.0e-10, &clock->offset, &raw_freq,
-                                 &n_runs, &best_start);
-
-  if (!clock->valid_coefs) {
+  if (clock->n_samples < MIN_SAMPLES || clock->x_var <= 0.0) {
+    clock->valid_coefs = 0;
     DEBUG_LOG("HW clock needs more samples");
     return;
   }
 
+  raw_freq = clock->xy_cov / clock->x_var;
+  clock->offset = clock->y_mean - raw_freq * clock->x_mean;
   clock->frequency = raw_freq / local_freq;
-
-  /* Drop unneeded samples */
-  if (clock->n_samples > clock->min_samples)
-    clock->n_samples -= MIN(best_start, clock->n_samples - clock->min_samples);
+  clock->valid_coefs = 1;
 
   /* If the fit doesn't cross the error interval of the last sample,
      or the frequency is not sane, drop all samples and start again */
   if (fabs(clock->offset) > err ||
       fabs(clock->frequency - 1.0) > MAX_FREQ_OFFSET) {
     DEBUG_LOG("HW clock reset");
-    clock->n_samples = 0;
-    clock->valid_coefs = 0;
+    reset_clock(clock);
   }
 
-  DEBUG_LOG("HW clock samples=%d offset=%e freq=%e raw_freq=%e err=%e ref_diff=%e",
+  DEBUG_LOG("HW clock samples=%d offset=%e freq=%e raw_freq=%e err=%e separation=%f ref_diff=%e",
             clock->n_samples, clock->offset, clock->frequency - 1.0, raw_freq - 1.0, err,
-            UTI_DiffTimespecsToDouble(&clock->hw_ref, &clock->local_ref));
+            clock->separation, UTI_DiffTimespecsToDouble(&clock->hw_ref, &clock->local_ref));
 }
 
 /* ================================================== */
@@ -39,6 +39,7 @@
 #include "smooth.h"
 #include "util.h"
 #include "logging.h"
+#include "usdt.h"
 
 /* ================================================== */
 
@@ -62,6 +63,15 @@ static lcl_OffsetCorrectionDriver drv_offset_convert;
 static lcl_SetLeapDriver drv_set_leap;
 static lcl_SetSyncStatusDriver drv_set_sync_status;
 
+/* Cached model of the offset correction which allows raw timestamps to be
+   cooked without calling the driver */
+static LCL_CookingModel cooking_model;
+static int cooking_model_valid;
+
+/* Handler called when the model changes */
+static LCL_CookingModelHandler cooking_model_handler;
+static void *cooking_model_handler_arg;
+
 /* ================================================== */
 
 /* Types and variables associated with handling the parameter change
@@ -154,6 +164,8 @@ LCL_Initialise(void)
   drv_set_freq = NULL;
   drv_accrue_offset = NULL;
   drv_offset_convert = NULL;
+  cooking_model_valid = 0;
+  cooking_model_handler = NULL;
 
   /* This ought to be set from the system driver layer */
   current_freq_ppm = 0.0;
@@ -392,6 +404,18 @@ LCL_CookTime(struct timespec *raw, struct timespec *cooked, double *err)
 void
 LCL_GetOffsetCorrection(struct timespec *raw, double *correction, double *err)
 {
+  double duration;
+
+  if (cooking_model_valid) {
+    duration = UTI_DiffTimespecsToDouble(raw, &cooking_model.ref);
+    if (duration <= cooking_model.valid_interval) {
+      *correction = cooking_model.offset + cooking_model.rate * duration;
+      if (err)
+        *err = fabs(duration) <= cooking_model.err_interval ? cooking_model.err : 0.0;
+      return;
+    }
+  }
+
   /* Call system specific driver to get correction */
   (*drv_offset_convert)(raw, correction, err);
 }
@@ -620,6 +644,9 @@ LCL_AccumulateFrequencyAndOffset(double dfreq, double doffset, double corr_rate)
 
   (*drv_accrue_offset)(doffset, corr_rate);
 
+  USDT_PROBE5(clock_accumulate, USDT_PPB(dfreq), USDT_NS(doffset), USDT_PPB(corr_rate),
+              USDT_PPB(old_freq_ppm * 1.0e-6), USDT_PPB(current_freq_ppm * 1.0e-6));
+
   /* Dispatch to all handlers */
   invoke_parameter_change_handlers(&raw, &cooked, dfreq, doffset, LCL_ChangeAdjust);
 
@@ -676,11 +703,48 @@ lcl_RegisterSystemDrivers(lcl_ReadFrequencyDriver read_freq,
   drv_set_leap = set_leap;
   drv_set_sync_status = set_sync_status;
 
+  cooking_model_valid = 0;
+
   current_freq_ppm = (*drv_read_freq)();
 
   DEBUG_LOG("Local freq=%.3fppm", current_freq_ppm);
 }
 
+/* ================================================== */
+
+int
+LCL_GetCookingModel(LCL_CookingModel *model)
+{
+  if (!cooking_model_valid)
+    return 0;
+
+  *model = cooking_model;
+
+  return 1;
+}
+
+/* ================================================== */
+
+void
+LCL_SetCookingModelHandler(LCL_CookingModelHandler handler, void *anything)
+{
+  cooking_model_handler = handler;
+  cooking_model_handler_arg = anything;
+}
+
+/* ================================================== */
+
+void
+lcl_SetCookingModel(LCL_CookingModel *model)
+{
+  if (model)
+    cooking_model = *model;
+  cooking_model_valid = model != NULL;
+
+  if (cooking_model_handler)
+    (cooking_model_handler)(cooking_model_handler_arg);
+}
+
 /* ================================================== */
 /* Look at the current difference between the system time and the NTP
    time, and make a step to cancel it. */
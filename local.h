@@ -53,6 +53,31 @@ extern void LCL_CookTime(struct timespec *raw, struct timespec *cooked, double *
 
 extern void LCL_GetOffsetCorrection(struct timespec *raw, double *correction, double *err);
 
+/* Linear model of the offset correction provided by the system driver.
+   The correction of a raw time is offset + rate * (raw - ref) and its error
+   is err if the raw time is within err_interval of ref, or zero otherwise.
+   The model can be used for raw times up to valid_interval after ref. */
+typedef struct {
+  struct timespec ref;
+  double offset;
+  double rate;
+  double err;
+  double err_interval;
+  double valid_interval;
+} LCL_CookingModel;
+
+/* Get the current model of the offset correction.  Returns 0 if the
+   system driver doesn't provide one, e.g. when the correction is not
+   known in advance. */
+extern int LCL_GetCookingModel(LCL_CookingModel *model);
+
+/* Function type for a handler to be called when the model of the offset
+   correction changes */
+typedef void (*LCL_CookingModelHandler)(void *anything);
+
+/* Set the handler, or NULL to disable it */
+extern void LCL_SetCookingModelHandler(LCL_CookingModelHandler handler, void *anything);
+
 /* Type of routines that may be invoked as callbacks when there is a
    change to the frequency or offset.
 
@@ -29,6 +29,8 @@
 #ifndef GOT_LOCALP_H
 #define GOT_LOCALP_H
 
+#include "local.h"
+
 /* System driver to read the current local frequency, in ppm relative
    to nominal.  A positive value indicates that the local clock runs
    fast when uncompensated. */
@@ -62,6 +64,11 @@ typedef void (*lcl_SetSyncStatusDriver)(int synchronised, double est_error, doub
 
 extern void lcl_InvokeDispersionNotifyHandlers(double dispersion);
 
+/* Routine to be called by the system driver whenever the offset correction
+   changes.  NULL disables the model and all raw times are converted by the
+   offset correction driver. */
+extern void lcl_SetCookingModel(LCL_CookingModel *model);
+
 extern void
 lcl_RegisterSystemDrivers(lcl_ReadFrequencyDriver read_freq,
                           lcl_SetFrequencyDriver set_freq,
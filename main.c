@@ -54,6 +54,7 @@
 #include "clientlog.h"
 #include "nameserv.h"
 #include "privops.h"
+#include "shmpub.h"
 #include "smooth.h"
 #include "tempcomp.h"
 #include "util.h"
@@ -117,6 +118,7 @@ MAI_CleanupAndExit(void)
   /* Don't update clock when removing sources */
   REF_SetMode(REF_ModeIgnore);
 
+  SHP_Finalise();
   SMT_Finalise();
   TMC_Finalise();
   MNL_Finalise();
@@ -125,7 +127,6 @@ MAI_CleanupAndExit(void)
   NNS_Finalise();
   NSD_Finalise();
   NSR_Finalise();
-  SST_Finalise();
   NCR_Finalise();
   NIO_Finalise();
   CAM_Finalise();
@@ -133,6 +134,7 @@ MAI_CleanupAndExit(void)
   KEY_Finalise();
   RCL_Finalise();
   SRC_Finalise();
+  SST_Finalise();
   REF_Finalise();
   RTC_Finalise();
   SYS_Finalise();
@@ -612,6 +614,7 @@ int main
 
   SYS_Initialise(clock_control);
   RTC_Initialise(do_init_rtc);
+  SST_Initialise();
   SRC_Initialise();
   RCL_Initialise();
   KEY_Initialise();
@@ -642,7 +645,6 @@ int main
     LOG(LOGS_WARN, "Running with root privileges");
 
   REF_Initialise();
-  SST_Initialise();
   NSR_Initialise();
   NSD_Initialise();
   NNS_Initialise();
@@ -651,6 +653,7 @@ int main
   MNL_Initialise();
   TMC_Initialise();
   SMT_Initialise();
+  SHP_Initialise();
 
   /* From now on, it is safe to do finalisation on exit */
   initialised = 1;
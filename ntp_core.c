@@ -46,6 +46,7 @@
 #include "logging.h"
 #include "addrfilt.h"
 #include "clientlog.h"
+#include "usdt.h"
 
 /* ================================================== */
 
@@ -111,6 +112,7 @@ struct NCR_Instance_Record {
                                    minimum */
 
   int copy;                     /* Boolean suppressing own refid and stratum */
+  int monitor;                  /* Boolean enabling monitor-only mode */
 
   int poll_target;              /* Target number of sourcestats samples */
 
@@ -605,6 +607,7 @@ NCR_CreateInstance(NTP_Remote_Address *remote_addr, NTP_Source_Type type,
   result->auto_burst = params->burst;
   result->auto_offline = params->auto_offline;
   result->copy = params->copy && result->mode == MODE_CLIENT;
+  result->monitor = params->sel_options & SRC_SELECT_MONITOR ? 1 : 0;
   result->poll_target = params->poll_target;
   result->ext_field_flags = params->ext_fields;
 
@@ -825,6 +828,10 @@ get_poll_adj(NCR_Instance inst, double error_in_estimate, double peer_distance)
        we are clearly not tracking the peer at all well, so we back off the
        sampling rate depending on just how bad the situation is */
     poll_adj = -log(error_in_estimate / peer_distance) / log(2.0);
+  } else if (inst->monitor) {
+    /* Monitor-only sources keep only the last sample, so slowly increase
+       the interval as long as the prediction from that sample is good */
+    poll_adj = 1.0 / inst->poll_target;
   } else {
     samples = SST_Samples(SRC_GetSourcestats(inst->source));
 
@@ -1212,6 +1219,9 @@ transmit_packet(NTP_Mode my_mode, /* The mode this machine wants to be */
 
   ret = NIO_SendPacket(&message, where_to, from, info.length, local_tx != NULL);
 
+  USDT_PROBE8(ntp_tx, &where_to->ip_addr, where_to->port, (int)my_mode, interleaved,
+              info.length, (int64_t)local_transmit.tv_sec, (int64_t)local_transmit.tv_nsec, ret);
+
   if (local_tx) {
     if (smooth_time)
       UTI_AddDoubleToTimespec(&local_transmit, smooth_offset, &local_transmit);
@@ -2042,6 +2052,11 @@ process_response(NCR_Instance inst, NTP_Local_Address *local_addr,
             kod_rate, interleaved_packet, inst->presend_done, valid_packet, good_packet,
             updated_timestamps);
 
+  USDT_PROBE9(ntp_sample, &inst->remote_addr.ip_addr, inst->remote_addr.port,
+              valid_packet, good_packet, USDT_NS(sample.offset), USDT_NS(sample.peer_delay),
+              USDT_NS(sample.peer_dispersion), (int64_t)sample.time.tv_sec,
+              (int64_t)sample.time.tv_nsec);
+
   if (valid_packet) {
     inst->remote_poll = message->poll;
     inst->remote_stratum = message->stratum != NTP_INVALID_STRATUM ?
@@ -2328,7 +2343,7 @@ NCR_ProcessRxUnknown(NTP_Remote_Address *remote_addr, NTP_Local_Address *local_a
   NTP_Mode my_mode;
   NTP_Local_Timestamp local_tx, *tx_ts;
   NTP_int64 ntp_rx, *local_ntp_rx;
-  int log_index, interleaved, poll, version;
+  int log_index, interleaved, poll, version, limited;
   uint32_t kod;
 
   /* Ignore the packet if it wasn't received by server socket */
@@ -2374,7 +2389,11 @@ NCR_ProcessRxUnknown(NTP_Remote_Address *remote_addr, NTP_Local_Address *local_a
   log_index = CLG_LogServiceAccess(CLG_NTP, &remote_addr->ip_addr, &rx_ts->ts);
 
   /* Don't reply to all requests if the rate is excessive */
-  if (log_index >= 0 && CLG_LimitServiceRate(CLG_NTP, log_index)) {
+  limited = log_index >= 0 && CLG_LimitServiceRate(CLG_NTP, log_index);
+
+  USDT_PROBE4(ntp_ratelimit, &remote_addr->ip_addr, remote_addr->port, log_index, limited);
+
+  if (limited) {
       DEBUG_LOG("NTP packet discarded to limit response rate");
       return;
   }
@@ -30,6 +30,7 @@
 
 #include "sysincl.h"
 
+#include "array.h"
 #include "memory.h"
 #include "ntp_io.h"
 #include "ntp_core.h"
@@ -42,6 +43,7 @@
 #include "conf.h"
 #include "privops.h"
 #include "util.h"
+#include "usdt.h"
 
 #ifdef HAVE_LINUX_TIMESTAMPING
 #include "ntp_io_linux.h"
@@ -49,6 +51,9 @@
 
 #define INVALID_SOCK_FD -1
 
+/* Maximum number of server sockets per IP family */
+#define MAX_SERVER_SOCKETS 256
+
 /* The server/peer and client sockets for IPv4 and IPv6 */
 static int server_sock_fd4;
 static int server_sock_fd6;
@@ -72,6 +77,21 @@ static int permanent_server_sockets;
 /* Flag indicating the server IPv4 socket is bound to an address */
 static int bound_server_sock_fd4;
 
+/* Number of server sockets sharing the port in each IP family.  The kernel
+   selects the socket receiving a packet by the CPU which processed it. */
+static int n_server_sockets;
+
+/* Information about server sockets indexed by their descriptor */
+struct ServerSocket {
+  /* Descriptor of the first socket in the group (server_sock_fd4 or
+     server_sock_fd6), which is used for sending, or INVALID_SOCK_FD */
+  int first_fd;
+  /* Number of received messages */
+  uint32_t rx_messages;
+};
+
+static ARR_Instance server_sockets;
+
 /* PTP event port, or 0 if disabled */
 static int ptp_port;
 
@@ -79,8 +99,25 @@ static int ptp_port;
 static int ptp_sock_fd4;
 static int ptp_sock_fd6;
 
-/* Buffer for transmitted NTP-over-PTP messages */
-static PTP_NtpMessage *ptp_message;
+/* PTP header and TLV header preceding the NTP message in NTP-over-PTP
+   messages, which can be compared as 64-bit words */
+typedef union {
+  struct {
+    PTP_Header header;
+    uint8_t origin_ts[10];
+    PTP_TlvHeader tlv_header;
+  } fields;
+  uint64_t words[PTP_NTP_PREFIX_LENGTH / sizeof (uint64_t)];
+} PtpPrefix;
+
+/* Template of the prefix with constant fields and a mask of fields checked
+   in received messages */
+static PtpPrefix ptp_prefix_template;
+static PtpPrefix ptp_prefix_mask;
+
+/* Numbers of received and sent NTP-over-PTP messages */
+static uint32_t ptp_rx_messages;
+static uint32_t ptp_tx_messages;
 
 /* Flag indicating that we have been initialised */
 static int initialised=0;
@@ -172,6 +209,130 @@ close_socket(int sock_fd)
 
 /* ================================================== */
 
+static struct ServerSocket *
+get_server_socket(int sock_fd)
+{
+  struct ServerSocket *s;
+
+  if (sock_fd < 0 || sock_fd >= ARR_GetSize(server_sockets))
+    return NULL;
+
+  s = ARR_GetElement(server_sockets, sock_fd);
+
+  return s->first_fd != INVALID_SOCK_FD ? s : NULL;
+}
+
+/* ================================================== */
+
+static void
+add_server_socket(int sock_fd, int first_fd)
+{
+  struct ServerSocket *s;
+  int i;
+
+  for (i = ARR_GetSize(server_sockets); i <= sock_fd; i++) {
+    s = ARR_GetNewElement(server_sockets);
+    s->first_fd = INVALID_SOCK_FD;
+  }
+
+  s = ARR_GetElement(server_sockets, sock_fd);
+  s->first_fd = first_fd;
+  s->rx_messages = 0;
+}
+
+/* ================================================== */
+
+static int
+open_server_sockets(int family, int local_port)
+{
+  int i, sock_fd, first_fd;
+
+  first_fd = open_socket(family, local_port, 0, NULL);
+  if (first_fd == INVALID_SOCK_FD)
+    return INVALID_SOCK_FD;
+
+  add_server_socket(first_fd, first_fd);
+
+  for (i = 1; i < n_server_sockets; i++) {
+    sock_fd = open_socket(family, local_port, 0, NULL);
+    if (sock_fd == INVALID_SOCK_FD)
+      break;
+    add_server_socket(sock_fd, first_fd);
+  }
+
+  if (i > 1 && !SCK_EnableCpuSteering(first_fd, i))
+    LOG(LOGS_WARN, "Could not enable CPU steering of NTP sockets");
+
+  DEBUG_LOG("Opened %d server sockets fd=%d", i, first_fd);
+
+  return first_fd;
+}
+
+/* ================================================== */
+
+static void
+close_server_sockets(int first_fd)
+{
+  struct ServerSocket *s;
+  int i;
+
+  if (first_fd == INVALID_SOCK_FD)
+    return;
+
+  for (i = 0; i < ARR_GetSize(server_sockets); i++) {
+    s = ARR_GetElement(server_sockets, i);
+    if (s->first_fd != first_fd)
+      continue;
+    s->first_fd = INVALID_SOCK_FD;
+    close_socket(i);
+  }
+}
+
+/* ================================================== */
+
+static void
+init_ptp_prefix(void)
+{
+  PTP_Header *header;
+  PTP_TlvHeader *tlv_header;
+
+  assert(sizeof (PtpPrefix) == PTP_NTP_PREFIX_LENGTH);
+  assert(offsetof(PtpPrefix, fields.tlv_header) ==
+         offsetof(PTP_NtpMessage, tlv_header));
+
+  memset(&ptp_prefix_template, 0, sizeof (ptp_prefix_template));
+  header = &ptp_prefix_template.fields.header;
+  tlv_header = &ptp_prefix_template.fields.tlv_header;
+  header->type = PTP_TYPE_DELAY_REQ;
+  header->version = PTP_VERSION;
+  header->domain = PTP_DOMAIN_NTP;
+  header->flags = htons(PTP_FLAG_UNICAST);
+  tlv_header->type = htons(PTP_TLV_NTP);
+
+  memset(&ptp_prefix_mask, 0, sizeof (ptp_prefix_mask));
+  header = &ptp_prefix_mask.fields.header;
+  tlv_header = &ptp_prefix_mask.fields.tlv_header;
+  header->type = 0xff;
+  header->version = 0xff;
+  header->length = 0xffff;
+  header->domain = 0xff;
+  header->flags = 0xffff;
+  tlv_header->type = 0xffff;
+  tlv_header->length = 0xffff;
+}
+
+/* ================================================== */
+
+static void
+make_ptp_prefix(PtpPrefix *prefix, int ntp_length)
+{
+  *prefix = ptp_prefix_template;
+  prefix->fields.header.length = htons(PTP_NTP_PREFIX_LENGTH + ntp_length);
+  prefix->fields.tlv_header.length = htons(ntp_length);
+}
+
+/* ================================================== */
+
 void
 NIO_Initialise(void)
 {
@@ -205,6 +366,17 @@ NIO_Initialise(void)
   permanent_server_sockets = !server_port || (!separate_client_sockets &&
                                               client_port == server_port);
 
+  n_server_sockets = CNF_GetNTPServerSockets();
+  if (n_server_sockets == 0)
+    n_server_sockets = sysconf(_SC_NPROCESSORS_ONLN);
+#ifndef LINUX
+  if (n_server_sockets != 1)
+    LOG(LOGS_WARN, "Multiple server sockets not supported");
+  n_server_sockets = 1;
+#endif
+  n_server_sockets = CLAMP(1, n_server_sockets, MAX_SERVER_SOCKETS);
+  server_sockets = ARR_CreateInstance(sizeof (struct ServerSocket));
+
   server_sock_fd4 = INVALID_SOCK_FD;
   server_sock_fd6 = INVALID_SOCK_FD;
   client_sock_fd4 = INVALID_SOCK_FD;
@@ -213,8 +385,8 @@ NIO_Initialise(void)
   server_sock_ref6 = 0;
 
   if (permanent_server_sockets && server_port) {
-    server_sock_fd4 = open_socket(IPADDR_INET4, server_port, 0, NULL);
-    server_sock_fd6 = open_socket(IPADDR_INET6, server_port, 0, NULL);
+    server_sock_fd4 = open_server_sockets(IPADDR_INET4, server_port);
+    server_sock_fd6 = open_server_sockets(IPADDR_INET6, server_port);
   }
 
   if (!separate_client_sockets) {
@@ -237,12 +409,12 @@ NIO_Initialise(void)
   ptp_port = CNF_GetPtpPort();
   ptp_sock_fd4 = INVALID_SOCK_FD;
   ptp_sock_fd6 = INVALID_SOCK_FD;
-  ptp_message = NULL;
+  ptp_rx_messages = ptp_tx_messages = 0;
 
   if (ptp_port > 0) {
     ptp_sock_fd4 = open_socket(IPADDR_INET4, ptp_port, 0, NULL);
     ptp_sock_fd6 = open_socket(IPADDR_INET6, ptp_port, 0, NULL);
-    ptp_message = MallocNew(PTP_NtpMessage);
+    init_ptp_prefix();
   }
 }
 
@@ -253,18 +425,19 @@ NIO_Finalise(void)
 {
   if (server_sock_fd4 != client_sock_fd4)
     close_socket(client_sock_fd4);
-  close_socket(server_sock_fd4);
+  close_server_sockets(server_sock_fd4);
   server_sock_fd4 = client_sock_fd4 = INVALID_SOCK_FD;
 
   if (server_sock_fd6 != client_sock_fd6)
     close_socket(client_sock_fd6);
-  close_socket(server_sock_fd6);
+  close_server_sockets(server_sock_fd6);
   server_sock_fd6 = client_sock_fd6 = INVALID_SOCK_FD;
 
+  ARR_DestroyInstance(server_sockets);
+
   close_socket(ptp_sock_fd4);
   close_socket(ptp_sock_fd6);
   ptp_sock_fd4 = ptp_sock_fd6 = INVALID_SOCK_FD;
-  Free(ptp_message);
 
 #ifdef HAVE_LINUX_TIMESTAMPING
   NIO_Linux_Finalise();
@@ -308,7 +481,7 @@ NIO_OpenServerSocket(NTP_Remote_Address *remote_addr)
       if (permanent_server_sockets)
         return server_sock_fd4;
       if (server_sock_fd4 == INVALID_SOCK_FD)
-        server_sock_fd4 = open_socket(IPADDR_INET4, CNF_GetNTPPort(), 0, NULL);
+        server_sock_fd4 = open_server_sockets(IPADDR_INET4, CNF_GetNTPPort());
       if (server_sock_fd4 != INVALID_SOCK_FD)
         server_sock_ref4++;
       return server_sock_fd4;
@@ -318,7 +491,7 @@ NIO_OpenServerSocket(NTP_Remote_Address *remote_addr)
       if (permanent_server_sockets)
         return server_sock_fd6;
       if (server_sock_fd6 == INVALID_SOCK_FD)
-        server_sock_fd6 = open_socket(IPADDR_INET6, CNF_GetNTPPort(), 0, NULL);
+        server_sock_fd6 = open_server_sockets(IPADDR_INET6, CNF_GetNTPPort());
       if (server_sock_fd6 != INVALID_SOCK_FD)
         server_sock_ref6++;
       return server_sock_fd6;
@@ -358,12 +531,12 @@ NIO_CloseServerSocket(int sock_fd)
 
   if (sock_fd == server_sock_fd4) {
     if (--server_sock_ref4 <= 0) {
-      close_socket(server_sock_fd4);
+      close_server_sockets(server_sock_fd4);
       server_sock_fd4 = INVALID_SOCK_FD;
     }
   } else if (sock_fd == server_sock_fd6) {
     if (--server_sock_ref6 <= 0) {
-      close_socket(server_sock_fd6);
+      close_server_sockets(server_sock_fd6);
       server_sock_fd6 = INVALID_SOCK_FD;
     }
   } else {
@@ -391,6 +564,61 @@ NIO_IsServerSocketOpen(void)
 
 /* ================================================== */
 
+int
+NIO_GetServerSocketStats(uint32_t *min_rx_messages, uint32_t *max_rx_messages)
+{
+  struct ServerSocket *s;
+  int i, sockets;
+
+  *min_rx_messages = *max_rx_messages = 0;
+
+  for (i = sockets = 0; i < ARR_GetSize(server_sockets); i++) {
+    s = ARR_GetElement(server_sockets, i);
+    if (s->first_fd == INVALID_SOCK_FD)
+      continue;
+
+    if (sockets == 0 || *min_rx_messages > s->rx_messages)
+      *min_rx_messages = s->rx_messages;
+    if (sockets == 0 || *max_rx_messages < s->rx_messages)
+      *max_rx_messages = s->rx_messages;
+    sockets++;
+  }
+
+  return sockets;
+}
+
+/* ================================================== */
+
+int
+NIO_GetServerSocketReport(int index, RPT_ServerSocketReport *report)
+{
+  struct ServerSocket *s;
+  int i;
+
+  for (i = 0; i < ARR_GetSize(server_sockets); i++) {
+    s = ARR_GetElement(server_sockets, i);
+    if (s->first_fd == INVALID_SOCK_FD || index-- > 0)
+      continue;
+
+    report->family = s->first_fd == server_sock_fd4 ? IPADDR_INET4 : IPADDR_INET6;
+    report->rx_messages = s->rx_messages;
+    return 1;
+  }
+
+  return 0;
+}
+
+/* ================================================== */
+
+void
+NIO_GetPtpMessageStats(uint32_t *rx_messages, uint32_t *tx_messages)
+{
+  *rx_messages = ptp_rx_messages;
+  *tx_messages = ptp_tx_messages;
+}
+
+/* ================================================== */
+
 int
 NIO_IsServerConnectable(NTP_Remote_Address *remote_addr)
 {
@@ -418,7 +646,10 @@ process_message(SCK_Message *message, int sock_fd, int event)
   local_ts.source = NTP_TS_DAEMON;
   sched_ts = local_ts.ts;
 
-  if (message->addr_type != SCK_ADDR_IP) {
+  /* Timestamps from the error queue might not include the address
+     (SOF_TIMESTAMPING_OPT_TSONLY) */
+  if (message->addr_type != SCK_ADDR_IP &&
+      !(event == SCH_FILE_EXCEPTION && message->addr_type == SCK_ADDR_UNSPEC)) {
     DEBUG_LOG("Unexpected address type");
     return;
   }
@@ -441,6 +672,9 @@ process_message(SCK_Message *message, int sock_fd, int event)
     DEBUG_LOG("Updated RX timestamp delay=%.9f tss=%u",
               UTI_DiffTimespecsToDouble(&sched_ts, &local_ts.ts), local_ts.source);
 
+  if (is_ptp_socket(sock_fd))
+    ptp_rx_messages++;
+
   if (!NIO_UnwrapMessage(message, sock_fd))
     return;
 
@@ -450,6 +684,10 @@ process_message(SCK_Message *message, int sock_fd, int event)
     return;
   }
 
+  USDT_PROBE6(ntp_rx, &message->remote_addr.ip.ip_addr, message->remote_addr.ip.port,
+              message->length, (int64_t)local_ts.ts.tv_sec, (int64_t)local_ts.ts.tv_nsec,
+              (int)local_ts.source);
+
   NSR_ProcessRx(&message->remote_addr.ip, &local_addr, &local_ts, message->data, message->length);
 }
 
@@ -458,14 +696,10 @@ process_message(SCK_Message *message, int sock_fd, int event)
 static void
 read_from_socket(int sock_fd, int event, void *anything)
 {
+  struct ServerSocket *server_socket;
   SCK_Message *messages;
   int i, received, flags = 0;
 
-#ifdef HAVE_LINUX_TIMESTAMPING
-  if (NIO_Linux_ProcessEvent(sock_fd, event))
-    return;
-#endif
-
   if (event == SCH_FILE_EXCEPTION) {
 #ifdef HAVE_LINUX_TIMESTAMPING
     flags |= SCK_FLAG_MSG_ERRQUEUE;
@@ -478,6 +712,15 @@ read_from_socket(int sock_fd, int event, void *anything)
   if (!messages)
     return;
 
+  /* Process messages received by any server socket of the group as if they
+     were received by the first socket */
+  server_socket = get_server_socket(sock_fd);
+  if (server_socket) {
+    if (event != SCH_FILE_EXCEPTION)
+      server_socket->rx_messages += received;
+    sock_fd = server_socket->first_fd;
+  }
+
   for (i = 0; i < received; i++)
     process_message(&messages[i], sock_fd, event);
 }
@@ -487,7 +730,9 @@ read_from_socket(int sock_fd, int event, void *anything)
 int
 NIO_UnwrapMessage(SCK_Message *message, int sock_fd)
 {
-  PTP_NtpMessage *msg;
+  PtpPrefix expected, received;
+  uint64_t diff;
+  int i;
 
   if (!is_ptp_socket(sock_fd))
     return 1;
@@ -497,14 +742,14 @@ NIO_UnwrapMessage(SCK_Message *message, int sock_fd)
     return 0;
   }
 
-  msg = message->data;
+  /* Compare the checked fields with the expected values in whole words */
+  make_ptp_prefix(&expected, message->length - PTP_NTP_PREFIX_LENGTH);
+  memcpy(&received, message->data, sizeof (received));
+
+  for (i = 0, diff = 0; i < sizeof (expected.words) / sizeof (expected.words[0]); i++)
+    diff |= (received.words[i] ^ expected.words[i]) & ptp_prefix_mask.words[i];
 
-  if (msg->header.type != PTP_TYPE_DELAY_REQ || msg->header.version != PTP_VERSION ||
-      ntohs(msg->header.length) != message->length ||
-      msg->header.domain != PTP_DOMAIN_NTP ||
-      ntohs(msg->header.flags) != PTP_FLAG_UNICAST ||
-      ntohs(msg->tlv_header.type) != PTP_TLV_NTP ||
-      ntohs(msg->tlv_header.length) != message->length - PTP_NTP_PREFIX_LENGTH) {
+  if (diff != 0) {
     DEBUG_LOG("Unexpected PTP message");
     return 0;
   }
@@ -519,37 +764,29 @@ NIO_UnwrapMessage(SCK_Message *message, int sock_fd)
 
 /* ================================================== */
 
+/* Prepend the PTP prefix (which needs to be valid until the message is
+   sent) to the message without copying the NTP data */
+
 static int
-wrap_message(SCK_Message *message, int sock_fd)
+wrap_message(SCK_Message *message, int sock_fd, PtpPrefix *prefix)
 {
   assert(PTP_NTP_PREFIX_LENGTH == 48);
 
   if (!is_ptp_socket(sock_fd))
     return 1;
 
-  if (!ptp_message)
-    return 0;
-
   if (message->length < NTP_HEADER_LENGTH ||
-      message->length + PTP_NTP_PREFIX_LENGTH > sizeof (*ptp_message)) {
+      message->length + PTP_NTP_PREFIX_LENGTH > sizeof (PTP_NtpMessage)) {
     DEBUG_LOG("Unexpected length");
     return 0;
   }
 
-  memset(ptp_message, 0, PTP_NTP_PREFIX_LENGTH);
-  ptp_message->header.type = PTP_TYPE_DELAY_REQ;
-  ptp_message->header.version = PTP_VERSION;
-  ptp_message->header.length = htons(PTP_NTP_PREFIX_LENGTH + message->length);
-  ptp_message->header.domain = PTP_DOMAIN_NTP;
-  ptp_message->header.flags = htons(PTP_FLAG_UNICAST);
-  ptp_message->tlv_header.type = htons(PTP_TLV_NTP);
-  ptp_message->tlv_header.length = htons(message->length);
-  memcpy((char *)ptp_message + PTP_NTP_PREFIX_LENGTH, message->data, message->length);
+  make_ptp_prefix(prefix, message->length);
 
-  message->data = ptp_message;
-  message->length += PTP_NTP_PREFIX_LENGTH;
+  message->header = prefix;
+  message->header_length = sizeof (*prefix);
 
-  DEBUG_LOG("Wrapped NTP->PTP len=%d", message->length - PTP_NTP_PREFIX_LENGTH);
+  DEBUG_LOG("Wrapped NTP->PTP len=%d", message->length);
 
   return 1;
 }
@@ -562,6 +799,8 @@ NIO_SendPacket(NTP_Packet *packet, NTP_Remote_Address *remote_addr,
                NTP_Local_Address *local_addr, int length, int process_tx)
 {
   SCK_Message message;
+  PtpPrefix ptp_prefix;
+  int sent;
 
   assert(initialised);
 
@@ -575,7 +814,7 @@ NIO_SendPacket(NTP_Packet *packet, NTP_Remote_Address *remote_addr,
   message.data = packet;
   message.length = length;
 
-  if (!wrap_message(&message, local_addr->sock_fd))
+  if (!wrap_message(&message, local_addr->sock_fd, &ptp_prefix))
     return 0;
 
   /* Specify remote address if the socket is not connected */
@@ -600,11 +839,17 @@ NIO_SendPacket(NTP_Packet *packet, NTP_Remote_Address *remote_addr,
 
 #ifdef HAVE_LINUX_TIMESTAMPING
   if (process_tx)
-    NIO_Linux_RequestTxTimestamp(&message, local_addr->sock_fd);
+    NIO_Linux_RequestTxTimestamp(&message, remote_addr, local_addr->sock_fd);
 #endif
 
-  if (!SCK_SendMessage(local_addr->sock_fd, &message, 0))
-    return 0;
+  sent = SCK_SendMessage(local_addr->sock_fd, &message, 0);
 
-  return 1;
+  if (sent && message.header_length > 0)
+    ptp_tx_messages++;
+
+#ifdef HAVE_LINUX_TIMESTAMPING
+  NIO_Linux_SaveTxPacket(local_addr->sock_fd, &message, packet, remote_addr, local_addr, sent);
+#endif
+
+  return sent;
 }
@@ -31,6 +31,7 @@
 
 #include "ntp.h"
 #include "addressing.h"
+#include "reports.h"
 #include "socket.h"
 
 /* Function to initialise the module. */
@@ -57,6 +58,17 @@ extern int NIO_IsServerSocket(int sock_fd);
 /* Function to check if a server socket is currently open */
 extern int NIO_IsServerSocketOpen(void);
 
+/* Function to get the number of open server sockets and the minimum and
+   maximum number of messages received by a socket */
+extern int NIO_GetServerSocketStats(uint32_t *min_rx_messages, uint32_t *max_rx_messages);
+
+/* Function to get a report of the open server socket with the specified
+   index.  Return 0 if the index is not valid. */
+extern int NIO_GetServerSocketReport(int index, RPT_ServerSocketReport *report);
+
+/* Function to get the number of received and sent NTP-over-PTP messages */
+extern void NIO_GetPtpMessageStats(uint32_t *rx_messages, uint32_t *tx_messages);
+
 /* Function to check if client packets can be sent to a server */
 extern int NIO_IsServerConnectable(NTP_Remote_Address *remote_addr);
 
@@ -39,6 +39,7 @@
 #include "hwclock.h"
 #include "local.h"
 #include "logging.h"
+#include "memory.h"
 #include "ntp_core.h"
 #include "ntp_io.h"
 #include "ntp_io_linux.h"
@@ -88,16 +89,35 @@ static int permanent_ts_options;
 
 /* When sending client requests to a close and fast server, it is possible that
    a response will be received before the HW transmit timestamp of the request
-   itself.  To avoid processing of the response without the HW timestamp, we
-   monitor events returned by select() and suspend reading of packets from the
-   receive queue for up to 200 microseconds.  As the requests are normally
-   separated by at least 200 milliseconds, it is sufficient to monitor and
-   suspend one socket at a time. */
-static int monitored_socket;
-static int suspended_socket;
-static SCH_TimeoutID resume_timeout_id;
+   itself.  To avoid processing of the response without the HW timestamp, each
+   client socket has a small table of requests waiting for their HW transmit
+   timestamp.  A response from a server which has a pending request is saved
+   and its processing is deferred until the timestamp is received, or up to
+   200 microseconds.  Other packets received on the socket are processed
+   normally, i.e. requests to many servers can wait for their timestamps
+   concurrently. */
+struct PendingTx {
+  int valid;
+  NTP_Remote_Address remote_addr;
+  /* Response received before the transmit timestamp */
+  int deferred;
+  SCH_TimeoutID timeout_id;
+  NTP_Local_Address local_addr;
+  NTP_Local_Timestamp local_ts;
+  int length;
+  NTP_Packet packet;
+};
+
+/* Array of pointers to tables of pending requests indexed by the socket
+   descriptor (NULL if no HW timestamp was requested on the socket) */
+static ARR_Instance pending_tables;
+
+/* Number of entries in a table (the oldest entry is replaced by a new one) */
+#define MAX_PENDING_TX 16
 
-#define RESUME_TIMEOUT 200.0e-6
+#define DEFER_TIMEOUT 200.0e-6
+
+static void remove_pending_table(int sock_fd);
 
 /* Unbound socket keeping the kernel RX timestamping permanently enabled
    in order to avoid a race condition between receiving a server response
@@ -107,6 +127,43 @@ static int dummy_rxts_socket;
 
 #define INVALID_SOCK_FD -3
 
+/* Packet sent with a requested TX timestamp.  If the timestamps are
+   identified by the SOF_TIMESTAMPING_OPT_ID counter, the kernel doesn't
+   need to loop the packet back to the error queue and the timestamp is
+   matched to the saved addresses and NTP header instead. */
+struct TxPacket {
+  uint32_t id;
+  int valid;
+  NTP_Remote_Address remote_addr;
+  NTP_Local_Address local_addr;
+  unsigned char header[NTP_HEADER_LENGTH];
+};
+
+/* Socket with identified TX timestamps */
+struct TxSocket {
+  /* Timestamping flags of the socket, zero if IDs are not used */
+  int flags;
+  /* Flag indicating all sent packets are timestamped */
+  int all_tx;
+  /* ID of the next timestamped packet */
+  uint32_t next_id;
+  /* Ring of the last sent packets indexed by their ID */
+  struct TxPacket *packets;
+  int size;
+};
+
+/* Array of TxSocket indexed by the socket descriptor */
+static ARR_Instance tx_sockets;
+
+/* Flags enabling IDs and disabling looped-back data in TX timestamps,
+   zero if not supported, or HW timestamping is enabled and the packets
+   are needed to find the interface and position of the UDP data */
+static int ts_id_flags;
+
+/* Number of sent packets saved per server and client socket (powers of 2) */
+#define MAX_SERVER_TX_PACKETS 256
+#define MAX_CLIENT_TX_PACKETS 16
+
 /* ================================================== */
 
 static int
@@ -249,7 +306,8 @@ add_interface(CNF_HwTsInterface *conf_iface)
   iface->rx_comp = conf_iface->rx_comp;
 
   iface->clock = HCL_CreateInstance(conf_iface->min_samples, conf_iface->max_samples,
-                                    UTI_Log2ToDouble(MAX(conf_iface->minpoll, MIN_PHC_POLL)));
+                                    UTI_Log2ToDouble(MAX(conf_iface->minpoll, MIN_PHC_POLL)),
+                                    UTI_Log2ToDouble(MAX(conf_iface->maxpoll, MIN_PHC_POLL)));
 
   LOG(LOGS_INFO, "Enabled HW timestamping %son %s",
       ts_config.rx_filter == HWTSTAMP_FILTER_NONE ? "(TX only) " : "", iface->name);
@@ -323,7 +381,8 @@ update_interface_speed(struct Interface *iface)
 
 /* ================================================== */
 
-#if defined(HAVE_LINUX_TIMESTAMPING_OPT_PKTINFO) || defined(HAVE_LINUX_TIMESTAMPING_OPT_TX_SWHW)
+#if defined(HAVE_LINUX_TIMESTAMPING_OPT_PKTINFO) || \
+    defined(HAVE_LINUX_TIMESTAMPING_OPT_TX_SWHW) || defined(HAVE_LINUX_TIMESTAMPING_OPT_ID)
 static int
 check_timestamping_option(int option)
 {
@@ -411,11 +470,20 @@ NIO_Linux_Initialise(void)
   /* Enable IP_PKTINFO in messages looped back to the error queue */
   ts_flags |= SOF_TIMESTAMPING_OPT_CMSG;
 
+  /* Avoid looping back the packets if they are not needed */
+  ts_id_flags = 0;
+#ifdef HAVE_LINUX_TIMESTAMPING_OPT_ID
+  if (!hwts && check_timestamping_option(SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID |
+                                         SOF_TIMESTAMPING_OPT_TSONLY))
+    ts_id_flags = SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+#endif
+  tx_sockets = ARR_CreateInstance(sizeof (struct TxSocket));
+
   /* Kernels before 4.7 ignore timestamping flags set in control messages */
   permanent_ts_options = !SYS_Linux_CheckKernelVersion(4, 7);
 
-  monitored_socket = INVALID_SOCK_FD;
-  suspended_socket = INVALID_SOCK_FD;
+  pending_tables = ARR_CreateInstance(sizeof (struct PendingTx *));
+
   dummy_rxts_socket = INVALID_SOCK_FD;
 }
 
@@ -430,6 +498,14 @@ NIO_Linux_Finalise(void)
   if (dummy_rxts_socket != INVALID_SOCK_FD)
     SCK_CloseSocket(dummy_rxts_socket);
 
+  for (i = 0; i < ARR_GetSize(tx_sockets); i++)
+    Free(((struct TxSocket *)ARR_GetElement(tx_sockets, i))->packets);
+  ARR_DestroyInstance(tx_sockets);
+
+  for (i = 0; i < ARR_GetSize(pending_tables); i++)
+    remove_pending_table(i);
+  ARR_DestroyInstance(pending_tables);
+
   for (i = 0; i < ARR_GetSize(interfaces); i++) {
     iface = ARR_GetElement(interfaces, i);
     HCL_DestroyInstance(iface->clock);
@@ -441,6 +517,91 @@ NIO_Linux_Finalise(void)
 
 /* ================================================== */
 
+static struct TxSocket *
+get_tx_socket(int sock_fd)
+{
+  struct TxSocket *s;
+
+  if (sock_fd < 0 || sock_fd >= ARR_GetSize(tx_sockets))
+    return NULL;
+
+  s = ARR_GetElement(tx_sockets, sock_fd);
+  if (!s->flags)
+    return NULL;
+
+  return s;
+}
+
+/* ================================================== */
+
+static void
+add_tx_socket(int sock_fd, int flags, int all_tx)
+{
+  struct TxSocket *s;
+  unsigned int i;
+
+  if (sock_fd < 0)
+    return;
+
+  for (i = ARR_GetSize(tx_sockets); i <= sock_fd; i++) {
+    s = ARR_GetNewElement(tx_sockets);
+    s->flags = 0;
+    s->packets = NULL;
+    s->size = 0;
+  }
+
+  s = ARR_GetElement(tx_sockets, sock_fd);
+  s->flags = flags;
+  s->all_tx = all_tx;
+  s->next_id = 0;
+}
+
+/* ================================================== */
+
+static void
+remove_tx_socket(int sock_fd)
+{
+  struct TxSocket *s;
+
+  s = get_tx_socket(sock_fd);
+  if (!s)
+    return;
+
+  Free(s->packets);
+  s->packets = NULL;
+  s->size = 0;
+  s->flags = 0;
+}
+
+/* ================================================== */
+/* Restart the counter of TX timestamps on a socket */
+
+static void
+reset_tx_ids(int sock_fd, struct TxSocket *s)
+{
+  int i, n, dropped;
+
+  if (!SCK_SetIntOption(sock_fd, SOL_SOCKET, SO_TIMESTAMPING, s->flags & ~ts_id_flags) ||
+      !SCK_SetIntOption(sock_fd, SOL_SOCKET, SO_TIMESTAMPING, s->flags)) {
+    remove_tx_socket(sock_fd);
+    return;
+  }
+
+  /* Drop timestamps already waiting in the error queue.  Their IDs are from
+     the previous sequence and they could be matched to packets sent after
+     the reset. */
+  for (dropped = 0; SCK_ReceiveMessages(sock_fd, SCK_FLAG_MSG_ERRQUEUE, &n); )
+    dropped += n;
+
+  for (i = 0; i < s->size; i++)
+    s->packets[i].valid = 0;
+  s->next_id = 0;
+
+  DEBUG_LOG("Reset TX timestamp IDs fd=%d dropped=%d", sock_fd, dropped);
+}
+
+/* ================================================== */
+
 int
 NIO_Linux_SetTimestampSocketOptions(int sock_fd, int client_only, int *events)
 {
@@ -453,7 +614,7 @@ NIO_Linux_SetTimestampSocketOptions(int sock_fd, int client_only, int *events)
      order to receive our transmitted packets with more accurate timestamps */
 
   val = 1;
-  flags = ts_flags;
+  flags = ts_flags | ts_id_flags;
 
   if (client_only || permanent_ts_options)
     flags |= ts_tx_flags;
@@ -468,75 +629,210 @@ NIO_Linux_SetTimestampSocketOptions(int sock_fd, int client_only, int *events)
     return 0;
   }
 
+  if (ts_id_flags)
+    add_tx_socket(sock_fd, flags, client_only || permanent_ts_options);
+
   *events |= SCH_FILE_EXCEPTION;
   return 1;
 }
 
 /* ================================================== */
 
-static void
-resume_socket(int sock_fd)
+static struct PendingTx *
+get_pending_table(int sock_fd)
 {
-  if (monitored_socket == sock_fd)
-    monitored_socket = INVALID_SOCK_FD;
+  if (sock_fd < 0 || sock_fd >= ARR_GetSize(pending_tables))
+    return NULL;
 
-  if (sock_fd == INVALID_SOCK_FD || sock_fd != suspended_socket)
-    return;
+  return *(struct PendingTx **)ARR_GetElement(pending_tables, sock_fd);
+}
 
-  suspended_socket = INVALID_SOCK_FD;
+/* ================================================== */
 
-  SCH_SetFileHandlerEvent(sock_fd, SCH_FILE_INPUT, 1);
+static struct PendingTx *
+find_pending_tx(int sock_fd, NTP_Remote_Address *remote_addr)
+{
+  struct PendingTx *table;
+  int i;
 
-  DEBUG_LOG("Resumed RX processing %s timeout fd=%d",
-            resume_timeout_id ? "before" : "on", sock_fd);
+  table = get_pending_table(sock_fd);
+  if (!table)
+    return NULL;
 
-  if (resume_timeout_id) {
-    SCH_RemoveTimeout(resume_timeout_id);
-    resume_timeout_id = 0;
+  for (i = 0; i < MAX_PENDING_TX; i++) {
+    if (table[i].valid && table[i].remote_addr.port == remote_addr->port &&
+        UTI_CompareIPs(&table[i].remote_addr.ip_addr, &remote_addr->ip_addr, NULL) == 0)
+      return &table[i];
   }
+
+  return NULL;
 }
 
 /* ================================================== */
+/* Process a deferred response and free its entry */
 
 static void
-resume_timeout(void *arg)
+process_deferred_response(struct PendingTx *pending, const char *reason)
 {
-  resume_timeout_id = 0;
-  resume_socket(suspended_socket);
+  assert(pending->deferred);
+
+  pending->valid = 0;
+  pending->deferred = 0;
+
+  if (pending->timeout_id) {
+    SCH_RemoveTimeout(pending->timeout_id);
+    pending->timeout_id = 0;
+  }
+
+  DEBUG_LOG("Processing deferred response from %s %s fd=%d",
+            UTI_IPSockAddrToString(&pending->remote_addr), reason,
+            pending->local_addr.sock_fd);
+
+  NSR_ProcessRx(&pending->remote_addr, &pending->local_addr, &pending->local_ts,
+                &pending->packet, pending->length);
 }
 
 /* ================================================== */
 
 static void
-suspend_socket(int sock_fd)
+defer_timeout(void *arg)
 {
-  resume_socket(suspended_socket);
+  struct PendingTx *pending = arg;
 
-  suspended_socket = sock_fd;
+  pending->timeout_id = 0;
+  process_deferred_response(pending, pending->valid ? "on timeout" : "after release");
+}
 
-  SCH_SetFileHandlerEvent(suspended_socket, SCH_FILE_INPUT, 0);
-  resume_timeout_id = SCH_AddTimeoutByDelay(RESUME_TIMEOUT, resume_timeout, NULL);
+/* ================================================== */
+/* Remove a pending request.  A deferred response is not processed here, as
+   this is called from the sending code, but it is processed from the
+   scheduler as soon as possible.  The entry is kept until then. */
 
-  DEBUG_LOG("Suspended RX processing fd=%d", sock_fd);
+static void
+release_pending_tx(struct PendingTx *pending)
+{
+  pending->valid = 0;
+
+  if (!pending->deferred)
+    return;
+
+  SCH_RemoveTimeout(pending->timeout_id);
+  pending->timeout_id = SCH_AddTimeoutByDelay(0.0, defer_timeout, pending);
 }
 
 /* ================================================== */
 
-int
-NIO_Linux_ProcessEvent(int sock_fd, int event)
+static void
+add_pending_tx(int sock_fd, NTP_Remote_Address *remote_addr)
+{
+  struct PendingTx *table, *pending, *null = NULL;
+  unsigned int i;
+
+  if (sock_fd < 0)
+    return;
+
+  /* Replace a previous request to the same address */
+  pending = find_pending_tx(sock_fd, remote_addr);
+  if (pending)
+    release_pending_tx(pending);
+
+  while (ARR_GetSize(pending_tables) <= sock_fd)
+    ARR_AppendElement(pending_tables, &null);
+
+  table = get_pending_table(sock_fd);
+  if (!table) {
+    table = MallocArray(struct PendingTx, MAX_PENDING_TX);
+    memset(table, 0, MAX_PENDING_TX * sizeof (table[0]));
+    *(struct PendingTx **)ARR_GetElement(pending_tables, sock_fd) = table;
+  }
+
+  /* Use a free entry, or an entry of a request which didn't get a response
+     yet (its response will be processed without waiting) */
+  for (i = 0, pending = NULL; i < MAX_PENDING_TX; i++) {
+    if (table[i].deferred)
+      continue;
+    pending = &table[i];
+    if (!table[i].valid)
+      break;
+  }
+
+  /* If all entries have a deferred response, drop one of them */
+  if (!pending) {
+    pending = &table[0];
+
+    DEBUG_LOG("Dropped deferred response from %s fd=%d",
+              UTI_IPSockAddrToString(&pending->remote_addr), sock_fd);
+
+    SCH_RemoveTimeout(pending->timeout_id);
+    pending->timeout_id = 0;
+    pending->deferred = 0;
+  }
+
+  pending->valid = 1;
+  pending->remote_addr = *remote_addr;
+}
+
+/* ================================================== */
+
+static void
+remove_pending_table(int sock_fd)
 {
-  if (sock_fd != monitored_socket)
+  struct PendingTx *table;
+  int i;
+
+  table = get_pending_table(sock_fd);
+  if (!table)
+    return;
+
+  for (i = 0; i < MAX_PENDING_TX; i++) {
+    if (table[i].timeout_id)
+      SCH_RemoveTimeout(table[i].timeout_id);
+  }
+
+  Free(table);
+  *(struct PendingTx **)ARR_GetElement(pending_tables, sock_fd) = NULL;
+}
+
+/* ================================================== */
+/* Save a response received before the transmit timestamp of the request.
+   Return 1 if the processing of the message is deferred. */
+
+static int
+defer_response(SCK_Message *message, NTP_Local_Address *local_addr,
+               NTP_Local_Timestamp *local_ts)
+{
+  struct PendingTx *pending;
+
+  pending = find_pending_tx(local_addr->sock_fd, &message->remote_addr.ip);
+  if (!pending)
     return 0;
 
-  if (event == SCH_FILE_INPUT) {
-    suspend_socket(monitored_socket);
-    monitored_socket = INVALID_SOCK_FD;
+  /* Don't defer more than one response.  Process the deferred response
+     now to keep the responses in the order in which they were received. */
+  if (pending->deferred) {
+    process_deferred_response(pending, "before next response");
+    return 0;
+  }
 
-    /* Don't process the message yet */
+  if (!NIO_UnwrapMessage(message, local_addr->sock_fd))
+    return 1;
+
+  if (message->length < NTP_HEADER_LENGTH || message->length > sizeof (NTP_Packet)) {
+    DEBUG_LOG("Unexpected length");
     return 1;
   }
 
-  return 0;
+  pending->deferred = 1;
+  pending->local_addr = *local_addr;
+  pending->local_ts = *local_ts;
+  pending->length = message->length;
+  memcpy(&pending->packet, message->data, message->length);
+  pending->timeout_id = SCH_AddTimeoutByDelay(DEFER_TIMEOUT, defer_timeout, pending);
+
+  DEBUG_LOG("Deferred response from %s fd=%d",
+            UTI_IPSockAddrToString(&message->remote_addr.ip), local_addr->sock_fd);
+
+  return 1;
 }
 
 /* ================================================== */
@@ -734,14 +1030,51 @@ extract_udp_data(unsigned char *msg, NTP_Remote_Address *remote_addr, int len)
 
 /* ================================================== */
 
+static int
+find_tx_packet(struct TxSocket *s, SCK_Message *message, NTP_Local_Address *local_addr)
+{
+  struct TxPacket *packet;
+
+  packet = s->size > 0 ? &s->packets[message->timestamp.id % s->size] : NULL;
+
+  if (!packet || !packet->valid || packet->id != message->timestamp.id) {
+    DEBUG_LOG("Unknown TX timestamp id=%"PRIu32" fd=%d",
+              message->timestamp.id, local_addr->sock_fd);
+    return 0;
+  }
+
+  packet->valid = 0;
+
+  message->addr_type = SCK_ADDR_IP;
+  message->remote_addr.ip.ip_addr = packet->remote_addr.ip_addr;
+  message->remote_addr.ip.port = packet->remote_addr.port;
+  local_addr->ip_addr = packet->local_addr.ip_addr;
+  local_addr->if_index = packet->local_addr.if_index;
+
+  /* Replace the missing data with the saved header */
+  memcpy(message->data, packet->header, sizeof (packet->header));
+  message->length = sizeof (packet->header);
+
+  DEBUG_LOG("Found TX packet id=%"PRIu32" for %s fd=%d",
+            packet->id, UTI_IPSockAddrToString(&message->remote_addr.ip),
+            local_addr->sock_fd);
+
+  return 1;
+}
+
+/* ================================================== */
+
 int
 NIO_Linux_ProcessMessage(SCK_Message *message, NTP_Local_Address *local_addr,
                          NTP_Local_Timestamp *local_ts, int event)
 {
+  struct PendingTx *pending;
+  struct TxSocket *tx_socket;
   struct Interface *iface;
-  int is_tx, ts_if_index, l2_length;
+  int is_tx, hw_tx, ts_if_index, l2_length;
 
   is_tx = event == SCH_FILE_EXCEPTION;
+  hw_tx = is_tx && !UTI_IsZeroTimespec(&message->timestamp.hw);
   iface = NULL;
 
   ts_if_index = message->timestamp.if_index;
@@ -757,11 +1090,6 @@ NIO_Linux_ProcessMessage(SCK_Message *message, NTP_Local_Address *local_addr,
     } else {
       DEBUG_LOG("HW clock not found for interface %d", ts_if_index);
     }
-
-    /* If a HW transmit timestamp was received, resume processing
-       of non-error messages on this socket */
-    if (is_tx)
-      resume_socket(local_addr->sock_fd);
   }
 
   if (local_ts->source == NTP_TS_DAEMON && !UTI_IsZeroTimespec(&message->timestamp.kernel) &&
@@ -777,41 +1105,58 @@ NIO_Linux_ProcessMessage(SCK_Message *message, NTP_Local_Address *local_addr,
       dummy_rxts_socket = open_dummy_socket();
   }
 
-  /* Return the message if it's not received from the error queue */
+  /* Return the message if it's not received from the error queue, unless
+     it's a response waiting for the HW transmit timestamp of the request */
   if (!is_tx)
-    return 0;
-
-  /* The data from the error queue includes all layers up to UDP.  We have to
-     extract the UDP data and also the destination address with port as there
-     currently doesn't seem to be a better way to get them both. */
-  l2_length = message->length;
-  message->length = extract_udp_data(message->data, &message->remote_addr.ip, message->length);
+    return defer_response(message, local_addr, local_ts);
 
-  DEBUG_LOG("Extracted message for %s fd=%d len=%d",
-            UTI_IPSockAddrToString(&message->remote_addr.ip),
-            local_addr->sock_fd, message->length);
+  tx_socket = get_tx_socket(local_addr->sock_fd);
 
-  /* Update assumed position of UDP data at layer 2 for next received packet */
-  if (iface && message->length) {
-    if (message->remote_addr.ip.ip_addr.family == IPADDR_INET4)
-      iface->l2_udp4_ntp_start = l2_length - message->length;
-    else if (message->remote_addr.ip.ip_addr.family == IPADDR_INET6)
-      iface->l2_udp6_ntp_start = l2_length - message->length;
+  if (tx_socket) {
+    /* The packet was not looped back.  Find the saved packet by the ID. */
+    if (!find_tx_packet(tx_socket, message, local_addr))
+      return 1;
+  } else {
+    /* The data from the error queue includes all layers up to UDP.  We have
+       to extract the UDP data and also the destination address with port as
+       there currently doesn't seem to be a better way to get them both. */
+    l2_length = message->length;
+    message->length = extract_udp_data(message->data, &message->remote_addr.ip,
+                                       message->length);
+
+    DEBUG_LOG("Extracted message for %s fd=%d len=%d",
+              UTI_IPSockAddrToString(&message->remote_addr.ip),
+              local_addr->sock_fd, message->length);
+
+    /* Update assumed position of UDP data at layer 2 for next received packet */
+    if (iface && message->length) {
+      if (message->remote_addr.ip.ip_addr.family == IPADDR_INET4)
+        iface->l2_udp4_ntp_start = l2_length - message->length;
+      else if (message->remote_addr.ip.ip_addr.family == IPADDR_INET6)
+        iface->l2_udp6_ntp_start = l2_length - message->length;
+    }
   }
 
   /* Drop the message if it has no timestamp or its processing failed */
   if (local_ts->source == NTP_TS_DAEMON) {
     DEBUG_LOG("Missing TX timestamp");
-    return 1;
+  } else if ((tx_socket || NIO_UnwrapMessage(message, local_addr->sock_fd)) &&
+             message->length >= NTP_HEADER_LENGTH && message->length <= sizeof (NTP_Packet)) {
+    NSR_ProcessTx(&message->remote_addr.ip, local_addr, local_ts, message->data,
+                  message->length);
   }
 
-  if (!NIO_UnwrapMessage(message, local_addr->sock_fd))
-    return 1;
-
-  if (message->length < NTP_HEADER_LENGTH || message->length > sizeof (NTP_Packet))
-    return 1;
-
-  NSR_ProcessTx(&message->remote_addr.ip, local_addr, local_ts, message->data, message->length);
+  /* If a HW transmit timestamp was received, process the response to
+     the request if it was already received */
+  if (hw_tx) {
+    pending = find_pending_tx(local_addr->sock_fd, &message->remote_addr.ip);
+    if (pending) {
+      if (pending->deferred)
+        process_deferred_response(pending, "after timestamp");
+      else
+        pending->valid = 0;
+    }
+  }
 
   return 1;
 }
@@ -819,16 +1164,17 @@ NIO_Linux_ProcessMessage(SCK_Message *message, NTP_Local_Address *local_addr,
 /* ================================================== */
 
 void
-NIO_Linux_RequestTxTimestamp(SCK_Message *message, int sock_fd)
+NIO_Linux_RequestTxTimestamp(SCK_Message *message, NTP_Remote_Address *remote_addr,
+                             int sock_fd)
 {
   if (!ts_flags)
     return;
 
-  /* If a HW transmit timestamp is requested on a client socket, monitor
-     events on the socket in order to avoid processing of a fast response
-     without the HW timestamp of the request */
+  /* If a HW transmit timestamp is requested on a client socket, add the
+     request to the table of the socket in order to avoid processing of
+     a fast response without the HW timestamp of the request */
   if (ts_tx_flags & SOF_TIMESTAMPING_TX_HARDWARE && !NIO_IsServerSocket(sock_fd))
-    monitored_socket = sock_fd;
+    add_pending_tx(sock_fd, remote_addr);
 
   /* Check if TX timestamping is disabled on this socket */
   if (permanent_ts_options || !NIO_IsServerSocket(sock_fd))
@@ -839,8 +1185,47 @@ NIO_Linux_RequestTxTimestamp(SCK_Message *message, int sock_fd)
 
 /* ================================================== */
 
+void
+NIO_Linux_SaveTxPacket(int sock_fd, SCK_Message *message, NTP_Packet *packet,
+                       NTP_Remote_Address *remote_addr, NTP_Local_Address *local_addr,
+                       int sent)
+{
+  struct TxPacket *tx_packet;
+  struct TxSocket *s;
+
+  s = get_tx_socket(sock_fd);
+  if (!s)
+    return;
+
+  /* Ignore packets sent without TX timestamping (which don't get an ID) */
+  if (!s->all_tx && !message->timestamp.tx_flags)
+    return;
+
+  /* If the sending failed, it's not known whether an ID was used or not */
+  if (!sent) {
+    reset_tx_ids(sock_fd, s);
+    return;
+  }
+
+  if (!s->packets) {
+    s->size = NIO_IsServerSocket(sock_fd) ? MAX_SERVER_TX_PACKETS : MAX_CLIENT_TX_PACKETS;
+    s->packets = MallocArray(struct TxPacket, s->size);
+    memset(s->packets, 0, s->size * sizeof (s->packets[0]));
+  }
+
+  tx_packet = &s->packets[s->next_id % s->size];
+  tx_packet->id = s->next_id++;
+  tx_packet->valid = 1;
+  tx_packet->remote_addr = *remote_addr;
+  tx_packet->local_addr = *local_addr;
+  memcpy(tx_packet->header, packet, sizeof (tx_packet->header));
+}
+
+/* ================================================== */
+
 void
 NIO_Linux_NotifySocketClosing(int sock_fd)
 {
-  resume_socket(sock_fd);
+  remove_pending_table(sock_fd);
+  remove_tx_socket(sock_fd);
 }
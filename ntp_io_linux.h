@@ -35,12 +35,15 @@ extern void NIO_Linux_Finalise(void);
 
 extern int NIO_Linux_SetTimestampSocketOptions(int sock_fd, int client_only, int *events);
 
-extern int NIO_Linux_ProcessEvent(int sock_fd, int event);
-
 extern int NIO_Linux_ProcessMessage(SCK_Message *message, NTP_Local_Address *local_addr,
                                     NTP_Local_Timestamp *local_ts, int event);
 
-extern void NIO_Linux_RequestTxTimestamp(SCK_Message *message, int sock_fd);
+extern void NIO_Linux_RequestTxTimestamp(SCK_Message *message,
+                                         NTP_Remote_Address *remote_addr, int sock_fd);
+
+extern void NIO_Linux_SaveTxPacket(int sock_fd, SCK_Message *message, NTP_Packet *packet,
+                                   NTP_Remote_Address *remote_addr,
+                                   NTP_Local_Address *local_addr, int sent);
 
 extern void NIO_Linux_NotifySocketClosing(int sock_fd);
 
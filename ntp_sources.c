@@ -46,13 +46,13 @@
 /* ================================================== */
 
 /* Maximum number of sources */
-#define MAX_SOURCES 65536
+#define MAX_SOURCES 1048576
 
 /* Record type private to this file, used to store information about
    particular sources */
 typedef struct {
   NTP_Remote_Address *remote_addr; /* The address of this source, non-NULL
-                                      means this slot in table is in use
+                                      means this record is in use
                                       (an IPADDR_ID address means the address
                                       is not resolved yet) */
   NCR_Instance data;            /* Data for the protocol engine for this source */
@@ -66,10 +66,17 @@ typedef struct {
                                    different sources in case of a pool */
 } SourceRecord;
 
-/* Hash table of SourceRecord, its size is a power of two and it's never
-   more than half full */
+/* Array of SourceRecord.  Records of removed sources are not in use until
+   the array is compacted in rehash_records(). */
 static ARR_Instance records;
 
+/* Hash table of indices of records in the array, its size is a power of two
+   and it's never more than half full */
+static ARR_Instance record_table;
+
+/* Index of an empty slot in the hash table */
+#define EMPTY_SLOT -1
+
 /* Number of sources in the hash table */
 static int n_sources;
 
@@ -172,6 +179,14 @@ get_record(unsigned index)
 
 /* ================================================== */
 
+static int *
+get_table_slot(unsigned index)
+{
+  return (int *)ARR_GetElement(record_table, index);
+}
+
+/* ================================================== */
+
 static struct SourcePool *
 get_pool(unsigned index)
 {
@@ -187,6 +202,7 @@ NSR_Initialise(void)
   initialised = 1;
 
   records = ARR_CreateInstance(sizeof (SourceRecord));
+  record_table = ARR_CreateInstance(sizeof (int));
   rehash_records();
 
   pools = ARR_CreateInstance(sizeof (struct SourcePool));
@@ -204,6 +220,7 @@ NSR_Finalise(void)
   LCL_RemoveParameterChangeHandler(slew_sources, NULL);
 
   ARR_DestroyInstance(records);
+  ARR_DestroyInstance(record_table);
   ARR_DestroyInstance(pools);
 
   while (unresolved_sources)
@@ -213,7 +230,7 @@ NSR_Finalise(void)
 }
 
 /* ================================================== */
-/* Find a slot matching an IP address.  It is assumed that there can
+/* Find a record matching an IP address.  It is assumed that there can
    only ever be one record for a particular IP address. */
 
 static int
@@ -222,8 +239,9 @@ find_slot(IPAddr *ip_addr, int *slot)
   SourceRecord *record;
   uint32_t hash;
   unsigned int i, size;
+  int index;
 
-  size = ARR_GetSize(records);
+  size = ARR_GetSize(record_table);
 
   *slot = 0;
   
@@ -238,24 +256,31 @@ find_slot(IPAddr *ip_addr, int *slot)
 
   hash = UTI_IPToHash(ip_addr);
 
-  for (i = 0; i < size / 2; i++) {
+  for (i = 0; i < size; i++) {
     /* Use quadratic probing */
-    *slot = (hash + (i + i * i) / 2) % size;
-    record = get_record(*slot);
+    index = *get_table_slot((hash + (i + i * i) / 2) % size);
 
-    if (!record->remote_addr)
+    if (index == EMPTY_SLOT)
       break;
 
-    if (UTI_CompareIPs(&record->remote_addr->ip_addr, ip_addr, NULL) == 0)
+    record = get_record(index);
+
+    /* Skip records of sources removed before the table was rehashed */
+    if (!record->remote_addr)
+      continue;
+
+    if (UTI_CompareIPs(&record->remote_addr->ip_addr, ip_addr, NULL) == 0) {
+      *slot = index;
       return 1;
+    }
   }
 
   return 0;
 }
 
 /* ================================================== */
-/* Find a slot matching an IP address and port. The function returns:
-   0 => IP not matched, empty slot returned if a valid address was provided
+/* Find a record matching an IP address and port. The function returns:
+   0 => IP not matched
    1 => Only IP matched, port doesn't match
    2 => Both IP and port matched. */
 
@@ -278,41 +303,60 @@ check_hashtable_size(unsigned int sources, unsigned int size)
 }
 
 /* ================================================== */
+/* Add a record to the hash table */
 
 static void
-rehash_records(void)
+add_table_slot(int index)
 {
-  SourceRecord *temp_records;
-  unsigned int i, old_size, new_size;
-  int slot;
+  unsigned int i, size;
+  uint32_t hash;
+  int *slot;
 
-  assert(!record_lock);
+  size = ARR_GetSize(record_table);
+  hash = UTI_IPToHash(&get_record(index)->remote_addr->ip_addr);
 
-  old_size = ARR_GetSize(records);
+  for (i = 0; i < size; i++) {
+    slot = get_table_slot((hash + (i + i * i) / 2) % size);
+    if (*slot == EMPTY_SLOT) {
+      *slot = index;
+      return;
+    }
+  }
 
-  temp_records = MallocArray(SourceRecord, old_size);
-  memcpy(temp_records, ARR_GetElements(records), old_size * sizeof (SourceRecord));
+  assert(0);
+}
 
-  /* The size of the hash table is always a power of two */
-  for (new_size = 1; !check_hashtable_size(n_sources, new_size); new_size *= 2)
-    ;
+/* ================================================== */
 
-  ARR_SetSize(records, new_size);
+static void
+rehash_records(void)
+{
+  unsigned int i, n, size;
 
-  for (i = 0; i < new_size; i++)
-    get_record(i)->remote_addr = NULL;
+  assert(!record_lock);
 
-  for (i = 0; i < old_size; i++) {
-    if (!temp_records[i].remote_addr)
+  /* Drop the records of removed sources */
+  for (i = n = 0; i < ARR_GetSize(records); i++) {
+    if (!get_record(i)->remote_addr)
       continue;
+    if (i != n)
+      *get_record(n) = *get_record(i);
+    n++;
+  }
 
-    if (find_slot2(temp_records[i].remote_addr, &slot) != 0)
-      assert(0);
+  ARR_SetSize(records, n);
 
-    *get_record(slot) = temp_records[i];
-  }
+  /* The size of the hash table is always a power of two */
+  for (size = 1; !check_hashtable_size(n_sources, size); size *= 2)
+    ;
+
+  ARR_SetSize(record_table, size);
 
-  Free(temp_records);
+  for (i = 0; i < size; i++)
+    *get_table_slot(i) = EMPTY_SLOT;
+
+  for (i = 0; i < n; i++)
+    add_table_slot(i);
 }
 
 /* ================================================== */
@@ -343,16 +387,15 @@ add_source(NTP_Remote_Address *remote_addr, char *name, NTP_Source_Type type,
     } else {
       n_sources++;
 
-      if (!check_hashtable_size(n_sources, ARR_GetSize(records))) {
+      if (!check_hashtable_size(n_sources, ARR_GetSize(record_table)))
         rehash_records();
-        if (find_slot2(remote_addr, &slot) != 0)
-          assert(0);
-      }
 
       assert(!record_lock);
       record_lock = 1;
 
-      record = get_record(slot);
+      slot = ARR_GetSize(records);
+      record = ARR_GetNewElement(records);
+      record->remote_addr = NULL;
       record->name = Strdup(name ? name : UTI_IPToString(&remote_addr->ip_addr));
       record->data = NCR_CreateInstance(remote_addr, type, params, record->name);
       record->remote_addr = NCR_GetRemoteAddress(record->data);
@@ -360,6 +403,8 @@ add_source(NTP_Remote_Address *remote_addr, char *name, NTP_Source_Type type,
       record->tentative = 1;
       record->conf_id = conf_id;
 
+      add_table_slot(slot);
+
       record_lock = 0;
 
       if (record->pool_id != INVALID_POOL) {
@@ -920,8 +965,10 @@ NSR_RemoveAllSources(void)
   SourceRecord *record;
   unsigned int i;
 
-  for (i = 0; i < ARR_GetSize(records); i++) {
-    record = get_record(i);
+  /* Remove the newest sources first, which is faster in the sources
+     module with many sources */
+  for (i = ARR_GetSize(records); i > 0; i--) {
+    record = get_record(i - 1);
     if (!record->remote_addr)
       continue;
     clean_source_record(record);
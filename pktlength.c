@@ -129,6 +129,19 @@ static const struct request_length request_lengths[] = {
   REQ_LENGTH_ENTRY(select_data, select_data),   /* SELECT_DATA */
   REQ_LENGTH_ENTRY(null, null),                 /* RELOAD_SOURCES */
   REQ_LENGTH_ENTRY(doffset, null),              /* DOFFSET2 */
+  REQ_LENGTH_ENTRY(sources_by_index,
+                   source_data_by_index),       /* SOURCE_DATA_BY_INDEX */
+  REQ_LENGTH_ENTRY(sources_by_index,
+                   sourcestats_by_index),       /* SOURCESTATS_BY_INDEX */
+  REQ_LENGTH_ENTRY(sources_by_index,
+                   select_data_by_index),       /* SELECT_DATA_BY_INDEX */
+  REQ_LENGTH_ENTRY(sched_stats, sched_stats),   /* SCHED_STATS */
+  /* Padded to the length of the largest report pushed to subscribers */
+  { offsetof(CMD_Request, data.subscribe.EOR),
+    MAX(PADDING_LENGTH(data.subscribe.EOR, data.tracking.EOR),
+        PADDING_LENGTH(data.subscribe.EOR, data.server_stats.EOR)) }, /* SUBSCRIBE */
+  REQ_LENGTH_ENTRY(server_socket_stats,
+                   server_socket_stats),        /* SERVER_SOCKET_STATS */
 };
 
 static const uint16_t reply_lengths[] = {
@@ -156,7 +169,13 @@ static const uint16_t reply_lengths[] = {
   RPY_LENGTH_ENTRY(client_accesses_by_index),   /* CLIENT_ACCESSES_BY_INDEX3 */
   0,                                            /* SERVER_STATS2 - not supported */
   RPY_LENGTH_ENTRY(select_data),                /* SELECT_DATA */
-  RPY_LENGTH_ENTRY(server_stats),               /* SERVER_STATS3 */
+  offsetof(CMD_Reply, data.server_stats.ntp_sockets), /* SERVER_STATS3 */
+  RPY_LENGTH_ENTRY(source_data_by_index),       /* SOURCE_DATA_BY_INDEX */
+  RPY_LENGTH_ENTRY(sourcestats_by_index),       /* SOURCESTATS_BY_INDEX */
+  RPY_LENGTH_ENTRY(select_data_by_index),       /* SELECT_DATA_BY_INDEX */
+  RPY_LENGTH_ENTRY(sched_stats),                /* SCHED_STATS */
+  RPY_LENGTH_ENTRY(server_stats),               /* SERVER_STATS4 */
+  RPY_LENGTH_ENTRY(server_socket_stats),        /* SERVER_SOCKET_STATS */
 };
 
 /* ================================================== */
@@ -77,6 +77,7 @@ struct RCL_Instance_Record {
   int driver_parameter_length;
   int driver_poll;
   int driver_polled;
+  int driver_polling;
   int poll;
   int leap_status;
   int local;
@@ -92,6 +93,8 @@ struct RCL_Instance_Record {
   double delay;
   double precision;
   double pulse_width;
+  unsigned long dropped_samples;
+  int filter_length;
   SPF_Instance filter;
   SCH_TimeoutID timeout_id;
   SRC_Instance source;
@@ -103,6 +106,10 @@ static ARR_Instance refclocks;
 static LOG_FileID logfileid;
 
 static int valid_sample_time(RCL_Instance instance, struct timespec *sample_time);
+static int add_pulse(RCL_Instance instance, struct timespec *pulse_time, double second,
+                     double error);
+static int add_cooked_pulse(RCL_Instance instance, struct timespec *cooked_time,
+                            double second, double dispersion, double raw_correction);
 static int pps_stratum(RCL_Instance instance, struct timespec *ts);
 static void poll_timeout(void *arg);
 static void slew_samples(struct timespec *raw, struct timespec *cooked, double dfreq,
@@ -204,6 +211,8 @@ RCL_AddRefclock(RefclockParameters *params)
   inst->precision = LCL_GetSysPrecisionAsQuantum();
   inst->precision = MAX(inst->precision, params->precision);
   inst->pulse_width = params->pulse_width;
+  inst->dropped_samples = 0;
+  inst->filter = NULL;
   inst->timeout_id = -1;
   inst->source = NULL;
 
@@ -239,29 +248,32 @@ RCL_AddRefclock(RefclockParameters *params)
     inst->leap_status = LEAP_Unsynchronised;
   }
 
-  if (inst->driver->poll) {
-    int max_samples;
+  if (inst->driver_poll > inst->poll)
+    inst->driver_poll = inst->poll;
 
-    if (inst->driver_poll > inst->poll)
-      inst->driver_poll = inst->poll;
+  inst->driver_polling = inst->driver->poll != NULL;
+  inst->filter_length = params->filter_length;
+
+  if (inst->driver->init && !inst->driver->init(inst))
+    LOG_FATAL("refclock %s initialisation failed", params->driver_name);
+
+  if (inst->driver_polling) {
+    int max_samples;
 
     max_samples = 1 << (inst->poll - inst->driver_poll);
-    if (max_samples < params->filter_length) {
+    if (max_samples < inst->filter_length) {
       if (max_samples < 4) {
         LOG(LOGS_WARN, "Setting filter length for %s to %d",
             UTI_RefidToString(inst->ref_id), max_samples);
       }
-      params->filter_length = max_samples;
+      inst->filter_length = max_samples;
     }
   }
 
-  if (inst->driver->init && !inst->driver->init(inst))
-    LOG_FATAL("refclock %s initialisation failed", params->driver_name);
-
   /* Require the filter to have at least 4 samples to produce a filtered
      sample, or be full for shorter lengths, and combine 60% of samples
      closest to the median */
-  inst->filter = SPF_CreateInstance(MIN(params->filter_length, 4), params->filter_length,
+  inst->filter = SPF_CreateInstance(MIN(inst->filter_length, 4), inst->filter_length,
                                     params->max_dispersion, 0.6);
 
   inst->source = SRC_CreateNewInstance(inst->ref_id, SRC_REFCLOCK, 0, params->sel_options,
@@ -270,7 +282,7 @@ RCL_AddRefclock(RefclockParameters *params)
 
   DEBUG_LOG("refclock %s refid=%s poll=%d dpoll=%d filter=%d",
       params->driver_name, UTI_RefidToString(inst->ref_id),
-      inst->poll, inst->driver_poll, params->filter_length);
+      inst->poll, inst->driver_poll, inst->filter_length);
 
   return 1;
 }
@@ -299,7 +311,7 @@ RCL_StartRefclocks(void)
         if (inst->lock_ref != inst2->ref_id)
           continue;
 
-        if (inst->driver->poll && inst2->driver->poll &&
+        if (inst->driver_polling && inst2->driver_polling &&
             (double)inst->max_lock_age / inst->pps_rate < UTI_Log2ToDouble(inst2->driver_poll))
           LOG(LOGS_WARN, "%s maxlockage too small for %s",
               UTI_RefidToString(inst->ref_id), UTI_RefidToString(inst2->ref_id));
@@ -335,6 +347,20 @@ RCL_ReportSource(RPT_SourceReport *report, struct timespec *now)
   }
 }
 
+void
+RCL_ReportSourcestats(RPT_SourcestatsReport *report)
+{
+  unsigned int i;
+
+  for (i = 0; i < ARR_GetSize(refclocks); i++) {
+    RCL_Instance inst = get_refclock(i);
+    if (inst->ref_id == report->ref_id) {
+      report->n_dropped = inst->dropped_samples;
+      break;
+    }
+  }
+}
+
 void
 RCL_SetDriverData(RCL_Instance instance, void *data)
 {
@@ -447,22 +473,33 @@ accumulate_sample(RCL_Instance instance, struct timespec *sample_time, double of
   return SPF_AccumulateSample(instance->filter, &sample);
 }
 
-int
-RCL_AddSample(RCL_Instance instance, struct timespec *sample_time,
-              struct timespec *ref_time, int leap)
+static int
+count_sample(RCL_Instance instance, int accepted)
+{
+  /* Count samples which were dropped as invalid, too old, or not fitting
+     the other samples */
+  if (!accepted)
+    instance->dropped_samples++;
+
+  return accepted;
+}
+
+static int
+add_sample(RCL_Instance instance, struct timespec *sample_time,
+           struct timespec *ref_time, int leap, double error)
 {
   double correction, dispersion, raw_offset, offset;
   struct timespec cooked_time;
 
   if (instance->pps_forced)
-    return RCL_AddPulse(instance, sample_time,
-                        1.0e-9 * (sample_time->tv_nsec - ref_time->tv_nsec));
+    return add_pulse(instance, sample_time,
+                     1.0e-9 * (sample_time->tv_nsec - ref_time->tv_nsec), error);
 
   raw_offset = UTI_DiffTimespecsToDouble(ref_time, sample_time);
 
   LCL_GetOffsetCorrection(sample_time, &correction, &dispersion);
   UTI_AddDoubleToTimespec(sample_time, correction, &cooked_time);
-  dispersion += instance->precision;
+  dispersion += instance->precision + error;
 
   /* Make sure the timestamp and offset provided by the driver are sane */
   if (!UTI_IsTimeOffsetSane(sample_time, raw_offset) ||
@@ -500,14 +537,28 @@ RCL_AddSample(RCL_Instance instance, struct timespec *sample_time,
   log_sample(instance, &cooked_time, 0, 0, raw_offset, offset, dispersion);
 
   /* for logging purposes */
-  if (!instance->driver->poll)
+  if (!instance->driver_polling)
     instance->driver_polled++;
 
   return 1;
 }
 
 int
-RCL_AddPulse(RCL_Instance instance, struct timespec *pulse_time, double second)
+RCL_AddSample(RCL_Instance instance, struct timespec *sample_time,
+              struct timespec *ref_time, int leap)
+{
+  return count_sample(instance, add_sample(instance, sample_time, ref_time, leap, 0.0));
+}
+
+int
+RCL_AddSampleWithError(RCL_Instance instance, struct timespec *sample_time,
+                       struct timespec *ref_time, int leap, double error)
+{
+  return count_sample(instance, add_sample(instance, sample_time, ref_time, leap, error));
+}
+
+static int
+add_pulse(RCL_Instance instance, struct timespec *pulse_time, double second, double error)
 {
   double correction, dispersion;
   struct timespec cooked_time;
@@ -519,7 +570,20 @@ RCL_AddPulse(RCL_Instance instance, struct timespec *pulse_time, double second)
   if (!UTI_IsTimeOffsetSane(pulse_time, 0.0))
     return 0;
 
-  return RCL_AddCookedPulse(instance, &cooked_time, second, dispersion, correction);
+  return add_cooked_pulse(instance, &cooked_time, second, dispersion + error, correction);
+}
+
+int
+RCL_AddPulse(RCL_Instance instance, struct timespec *pulse_time, double second)
+{
+  return count_sample(instance, add_pulse(instance, pulse_time, second, 0.0));
+}
+
+int
+RCL_AddPulseWithError(RCL_Instance instance, struct timespec *pulse_time, double second,
+                      double error)
+{
+  return count_sample(instance, add_pulse(instance, pulse_time, second, error));
 }
 
 static int
@@ -546,6 +610,21 @@ check_pulse_edge(RCL_Instance instance, double offset, double distance)
 int
 RCL_AddCookedPulse(RCL_Instance instance, struct timespec *cooked_time,
                    double second, double dispersion, double raw_correction)
+{
+  return count_sample(instance, add_cooked_pulse(instance, cooked_time, second,
+                                                 dispersion, raw_correction));
+}
+
+void
+RCL_CountDroppedSample(RCL_Instance instance)
+{
+  /* Count a sample which was dropped by the driver, e.g. an invalid message */
+  count_sample(instance, 0);
+}
+
+static int
+add_cooked_pulse(RCL_Instance instance, struct timespec *cooked_time,
+                 double second, double dispersion, double raw_correction)
 {
   double offset;
   int rate;
@@ -651,7 +730,7 @@ RCL_AddCookedPulse(RCL_Instance instance, struct timespec *cooked_time,
              offset, dispersion);
 
   /* for logging purposes */
-  if (!instance->driver->poll)
+  if (!instance->driver_polling)
     instance->driver_polled++;
 
   return 1;
@@ -669,6 +748,30 @@ RCL_GetDriverPoll(RCL_Instance instance)
   return instance->driver_poll;
 }
 
+int
+RCL_GetPoll(RCL_Instance instance)
+{
+  return instance->poll;
+}
+
+/* Function to be called from the driver's initialisation if the driver
+   filters the readings itself and adds fewer samples per polling interval */
+void
+RCL_SetFilterLength(RCL_Instance instance, int length)
+{
+  assert(!instance->filter);
+  instance->filter_length = CLAMP(1, length, instance->filter_length);
+}
+
+/* Function to be called from the driver's initialisation if the driver
+   adds the samples on its own and doesn't need to be polled */
+void
+RCL_DisableDriverPolling(RCL_Instance instance)
+{
+  assert(!instance->filter);
+  instance->driver_polling = 0;
+}
+
 static int
 valid_sample_time(RCL_Instance instance, struct timespec *sample_time)
 {
@@ -775,13 +878,13 @@ poll_timeout(void *arg)
 
   poll = inst->poll;
 
-  if (inst->driver->poll) {
+  if (inst->driver_polling) {
     poll = inst->driver_poll;
     inst->driver->poll(inst);
     inst->driver_polled++;
   }
   
-  if (!(inst->driver->poll && inst->driver_polled < (1 << (inst->poll - inst->driver_poll)))) {
+  if (!(inst->driver_polling && inst->driver_polled < (1 << (inst->poll - inst->driver_poll)))) {
     inst->driver_polled = 0;
 
     if (SPF_GetFilteredSample(inst->filter, &sample)) {
@@ -68,6 +68,7 @@ extern void RCL_Finalise(void);
 extern int RCL_AddRefclock(RefclockParameters *params);
 extern void RCL_StartRefclocks(void);
 extern void RCL_ReportSource(RPT_SourceReport *report, struct timespec *now);
+extern void RCL_ReportSourcestats(RPT_SourcestatsReport *report);
 
 /* functions used by drivers */
 extern void RCL_SetDriverData(RCL_Instance instance, void *data);
@@ -77,10 +78,18 @@ extern void RCL_CheckDriverOptions(RCL_Instance instance, const char **options);
 extern char *RCL_GetDriverOption(RCL_Instance instance, char *name);
 extern int RCL_AddSample(RCL_Instance instance, struct timespec *sample_time,
                          struct timespec *ref_time, int leap);
+extern int RCL_AddSampleWithError(RCL_Instance instance, struct timespec *sample_time,
+                                  struct timespec *ref_time, int leap, double error);
 extern int RCL_AddPulse(RCL_Instance instance, struct timespec *pulse_time, double second);
+extern int RCL_AddPulseWithError(RCL_Instance instance, struct timespec *pulse_time,
+                                 double second, double error);
 extern int RCL_AddCookedPulse(RCL_Instance instance, struct timespec *cooked_time,
                               double second, double dispersion, double raw_correction);
+extern void RCL_CountDroppedSample(RCL_Instance instance);
 extern double RCL_GetPrecision(RCL_Instance instance);
 extern int RCL_GetDriverPoll(RCL_Instance instance);
+extern int RCL_GetPoll(RCL_Instance instance);
+extern void RCL_SetFilterLength(RCL_Instance instance, int length);
+extern void RCL_DisableDriverPolling(RCL_Instance instance);
 
 #endif
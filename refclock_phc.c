@@ -42,6 +42,27 @@
 #include "sched.h"
 #include "sys_linux.h"
 
+/* Number of PHC readings requested in one poll of the fit mode */
+#define FIT_READINGS 10
+
+/* Minimum number of polls needed to fit a line instead of averaging */
+#define MIN_FIT_POLLS 3
+
+/* Running delay-weighted linear fit of the offset between the PHC and
+   system clock */
+struct phc_fit {
+  struct timespec ref_time;
+  double last_x;
+  double sum_w;
+  double sum_wx;
+  double sum_wy;
+  double sum_wxx;
+  double sum_wxy;
+  double min_delay;
+  int readings;
+  int polls;
+};
+
 struct phc_instance {
   int fd;
   int mode;
@@ -50,13 +71,132 @@ struct phc_instance {
   int pin;
   int channel;
   HCL_Instance clock;
+  int fit;
+  int fit_polls;
+  struct phc_fit fit_data;
 };
 
 static void read_ext_pulse(int sockfd, int event, void *anything);
+static void handle_step(struct timespec *raw, struct timespec *cooked, double dfreq,
+                        double doffset, LCL_ChangeType change_type, void *anything);
+
+static void reset_fit(struct phc_fit *fit)
+{
+  fit->last_x = 0.0;
+  fit->sum_w = fit->sum_wx = fit->sum_wy = fit->sum_wxx = fit->sum_wxy = 0.0;
+  fit->min_delay = 0.0;
+  fit->readings = 0;
+}
+
+static void accumulate_readings(struct phc_fit *fit, struct timespec ts[][3], int n,
+                                double precision)
+{
+  double delays[FIT_READINGS], min_delay = -1.0, correction, x, y, w;
+  int i;
+
+  n = MIN(n, FIT_READINGS);
+
+  for (i = 0; i < n; i++) {
+    delays[i] = UTI_DiffTimespecsToDouble(&ts[i][2], &ts[i][0]);
+    if (delays[i] < 0.0) {
+      DEBUG_LOG("Bad PHC reading delay=%e", delays[i]);
+      continue;
+    }
+    if (min_delay < 0.0 || delays[i] < min_delay)
+      min_delay = delays[i];
+  }
+
+  for (i = 0; i < n; i++) {
+    if (delays[i] < 0.0)
+      continue;
+
+    if (!fit->readings) {
+      fit->ref_time = ts[i][0];
+      fit->min_delay = delays[i];
+    }
+
+    /* The offset is accumulated relative to the cooked time, which can be
+       corrected for slewing of the clock between the readings.  The error
+       of the offset is limited by the delay in excess of the minimum delay
+       of the batch. */
+    LCL_GetOffsetCorrection(&ts[i][0], &correction, NULL);
+    x = UTI_DiffTimespecsToDouble(&ts[i][0], &fit->ref_time) + delays[i] / 2.0;
+    y = UTI_DiffTimespecsToDouble(&ts[i][1], &ts[i][0]) - delays[i] / 2.0 - correction;
+    w = 1.0 / SQUARE(delays[i] - min_delay + precision);
+
+    fit->sum_w += w;
+    fit->sum_wx += w * x;
+    fit->sum_wy += w * y;
+    fit->sum_wxx += w * x * x;
+    fit->sum_wxy += w * x * y;
+
+    if (x > fit->last_x)
+      fit->last_x = x;
+    if (delays[i] < fit->min_delay)
+      fit->min_delay = delays[i];
+    fit->readings++;
+  }
+}
+
+static int get_fit(struct phc_fit *fit, struct timespec *sys_ts, struct timespec *phc_ts,
+                   double *err)
+{
+  double mean_x, mean_y, var_x, cov_xy, x, offset, correction;
+
+  if (!fit->readings)
+    return 0;
+
+  mean_x = fit->sum_wx / fit->sum_w;
+  mean_y = fit->sum_wy / fit->sum_w;
+  var_x = fit->sum_wxx / fit->sum_w - mean_x * mean_x;
+  cov_xy = fit->sum_wxy / fit->sum_w - mean_x * mean_y;
+
+  /* Use the weighted mean if the readings don't cover enough polls,
+     otherwise the offset of the fitted line at the last reading */
+  if (fit->polls < MIN_FIT_POLLS || var_x <= 0.0) {
+    x = mean_x;
+    offset = mean_y;
+  } else {
+    x = fit->last_x;
+    offset = mean_y + cov_xy / var_x * (x - mean_x);
+  }
+
+  /* Convert the offset back to the raw time of the sample */
+  UTI_AddDoubleToTimespec(&fit->ref_time, x, sys_ts);
+  LCL_GetOffsetCorrection(sys_ts, &correction, NULL);
+  UTI_AddDoubleToTimespec(sys_ts, offset + correction, phc_ts);
+  *err = fit->min_delay / 2.0;
+
+  return 1;
+}
+
+static void handle_step(struct timespec *raw, struct timespec *cooked, double dfreq,
+                        double doffset, LCL_ChangeType change_type, void *anything)
+{
+  struct phc_instance *phc = anything;
+  struct phc_fit *fit = &phc->fit_data;
+  double delta0;
+
+  /* Drop readings made before the step */
+  if (change_type != LCL_ChangeAdjust) {
+    reset_fit(fit);
+    return;
+  }
+
+  if (!fit->readings)
+    return;
+
+  /* Correct the offsets as if they were measured with the new frequency and
+     offset of the clock (like SPF_SlewSamples()).  The offset of a reading
+     at x changes by -(delta0 - dfreq * x), which is applied to the sums. */
+  delta0 = UTI_DiffTimespecsToDouble(raw, &fit->ref_time) * dfreq - doffset;
+  fit->sum_wy -= delta0 * fit->sum_w - dfreq * fit->sum_wx;
+  fit->sum_wxy -= delta0 * fit->sum_wx - dfreq * fit->sum_wxx;
+}
 
 static int phc_initialise(RCL_Instance instance)
 {
-  const char *options[] = {"nocrossts", "extpps", "pin", "channel", "clear", NULL};
+  const char *options[] = {"nocrossts", "extpps", "pin", "channel", "clear", "fit", NULL};
   struct phc_instance *phc;
   int phc_fd, rising_edge;
   char *path, *s;
@@ -81,7 +221,8 @@ static int phc_initialise(RCL_Instance instance)
     s = RCL_GetDriverOption(instance, "channel");
     phc->channel = s ? atoi(s) : 0;
     rising_edge = RCL_GetDriverOption(instance, "clear") ? 0 : 1;
-    phc->clock = HCL_CreateInstance(0, 16, UTI_Log2ToDouble(RCL_GetDriverPoll(instance)));
+    phc->clock = HCL_CreateInstance(0, 16, UTI_Log2ToDouble(RCL_GetDriverPoll(instance)),
+                                    UTI_Log2ToDouble(RCL_GetDriverPoll(instance)));
 
     if (!SYS_Linux_SetPHCExtTimestamping(phc->fd, phc->pin, phc->channel,
                                          rising_edge, !rising_edge, 1))
@@ -93,6 +234,17 @@ static int phc_initialise(RCL_Instance instance)
     phc->clock = NULL;
   }
 
+  phc->fit = !phc->extpps && RCL_GetDriverOption(instance, "fit") ? 1 : 0;
+  phc->fit_polls = 1 << (RCL_GetPoll(instance) - RCL_GetDriverPoll(instance));
+  reset_fit(&phc->fit_data);
+  phc->fit_data.polls = 0;
+
+  if (phc->fit) {
+    /* The fit replaces the median filter */
+    RCL_SetFilterLength(instance, 1);
+    LCL_AddParameterChangeHandler(handle_step, phc);
+  }
+
   RCL_SetDriverData(instance, phc);
   return 1;
 }
@@ -103,6 +255,9 @@ static void phc_finalise(RCL_Instance instance)
 
   phc = (struct phc_instance *)RCL_GetDriverData(instance);
 
+  if (phc->fit)
+    LCL_RemoveParameterChangeHandler(handle_step, phc);
+
   if (phc->extpps) {
     SCH_RemoveFileHandler(phc->fd);
     SYS_Linux_SetPHCExtTimestamping(phc->fd, phc->pin, phc->channel, 0, 0, 0);
@@ -139,6 +294,36 @@ static void read_ext_pulse(int fd, int event, void *anything)
                      UTI_DiffTimespecsToDouble(&phc_ts, &local_ts));
 }
 
+static int fit_poll(RCL_Instance instance, struct phc_instance *phc)
+{
+  struct timespec readings[FIT_READINGS][3], phc_ts, sys_ts;
+  double phc_err;
+  int n, r;
+
+  n = SYS_Linux_GetPHCReadings(phc->fd, phc->nocrossts, &phc->mode, FIT_READINGS, readings);
+  if (n > 0)
+    accumulate_readings(&phc->fit_data, readings, n, RCL_GetPrecision(instance));
+
+  /* Add one sample per polling interval of the refclock */
+  if (++phc->fit_data.polls < phc->fit_polls)
+    return 0;
+
+  r = get_fit(&phc->fit_data, &sys_ts, &phc_ts, &phc_err);
+
+  DEBUG_LOG("PHC fit readings: %d polls: %d", phc->fit_data.readings, phc->fit_data.polls);
+
+  reset_fit(&phc->fit_data);
+  phc->fit_data.polls = 0;
+
+  if (!r)
+    return 0;
+
+  DEBUG_LOG("PHC offset: %+.9f err: %.9f",
+            UTI_DiffTimespecsToDouble(&phc_ts, &sys_ts), phc_err);
+
+  return RCL_AddSample(instance, &sys_ts, &phc_ts, LEAP_Normal);
+}
+
 static int phc_poll(RCL_Instance instance)
 {
   struct phc_instance *phc;
@@ -147,6 +332,9 @@ static int phc_poll(RCL_Instance instance)
 
   phc = (struct phc_instance *)RCL_GetDriverData(instance);
 
+  if (phc->fit)
+    return fit_poll(instance, phc);
+
   if (!SYS_Linux_GetPHCSample(phc->fd, phc->nocrossts, RCL_GetPrecision(instance),
                               &phc->mode, &phc_ts, &sys_ts, &phc_err))
     return 0;
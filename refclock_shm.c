@@ -31,7 +31,10 @@
 
 #include "refclock.h"
 #include "logging.h"
+#include "memory.h"
 #include "util.h"
+#include "sched.h"
+#include "socket.h"
 
 #define SHMKEY 0x4e545030
 
@@ -58,10 +61,20 @@ struct shmTime {
   int    dummy[8]; 
 };
 
+struct shm_instance {
+  struct shmTime *shm;
+  /* Socket receiving notifications of new samples, or -1 if polled */
+  int notify_fd;
+};
+
+static int read_sample(RCL_Instance instance, struct shmTime *shm);
+static void read_notification(int sockfd, int event, void *anything);
+
 static int shm_initialise(RCL_Instance instance) {
-  const char *options[] = {"perm", NULL};
+  const char *options[] = {"perm", "notify", NULL};
+  struct shm_instance *inst;
   int id, param, perm;
-  char *s;
+  char *s, *path;
   struct shmTime *shm;
 
   RCL_CheckDriverOptions(instance, options);
@@ -82,21 +95,71 @@ static int shm_initialise(RCL_Instance instance) {
     return 0;
   }
 
-  RCL_SetDriverData(instance, shm);
+  inst = MallocNew(struct shm_instance);
+  inst->shm = shm;
+  inst->notify_fd = -1;
+
+  /* If the writer notifies chronyd about new samples by sending a datagram
+     to a socket, read the segment only when notified instead of polling */
+  path = RCL_GetDriverOption(instance, "notify");
+  if (path) {
+    inst->notify_fd = SCK_OpenUnixDatagramSocket(NULL, path, 0);
+    if (inst->notify_fd < 0)
+      LOG_FATAL("Could not open socket %s", path);
+
+    SCH_AddFileHandler(inst->notify_fd, SCH_FILE_INPUT, read_notification, instance);
+    RCL_DisableDriverPolling(instance);
+  }
+
+  RCL_SetDriverData(instance, inst);
   return 1;
 }
 
 static void shm_finalise(RCL_Instance instance)
 {
-  shmdt(RCL_GetDriverData(instance));
+  struct shm_instance *inst;
+
+  inst = (struct shm_instance *)RCL_GetDriverData(instance);
+
+  if (inst->notify_fd >= 0) {
+    SCH_RemoveFileHandler(inst->notify_fd);
+    SCK_RemoveSocket(inst->notify_fd);
+    SCK_CloseSocket(inst->notify_fd);
+  }
+
+  shmdt(inst->shm);
+  Free(inst);
+}
+
+static void read_notification(int sockfd, int event, void *anything)
+{
+  RCL_Instance instance;
+  struct shm_instance *inst;
+  int n;
+
+  instance = (RCL_Instance)anything;
+  inst = (struct shm_instance *)RCL_GetDriverData(instance);
+
+  /* Drain all notifications, the content is ignored */
+  while (SCK_ReceiveMessages(sockfd, 0, &n))
+    ;
+
+  read_sample(instance, inst->shm);
 }
 
 static int shm_poll(RCL_Instance instance)
 {
-  struct timespec receive_ts, clock_ts;
-  struct shmTime t, *shm;
+  struct shm_instance *inst;
+
+  inst = (struct shm_instance *)RCL_GetDriverData(instance);
+
+  return read_sample(instance, inst->shm);
+}
 
-  shm = (struct shmTime *)RCL_GetDriverData(instance);
+static int read_sample(RCL_Instance instance, struct shmTime *shm)
+{
+  struct timespec receive_ts, clock_ts;
+  struct shmTime t;
 
   t = *shm;
   
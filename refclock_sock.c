@@ -36,7 +36,9 @@
 #include "socket.h"
 
 #define SOCK_MAGIC 0x534f434b
+#define SOCK_MAGIC2 0x534f4332
 
+/* Message with one sample (version 1) */
 struct sock_sample {
   /* Time of the measurement (system time) */
   struct timeval tv;
@@ -58,46 +60,143 @@ struct sock_sample {
   int magic;
 };
 
-static void read_sample(int sockfd, int event, void *anything)
-{
-  struct timespec sys_ts, ref_ts;
-  struct sock_sample sample;
-  RCL_Instance instance;
-  int s;
+/* Maximum number of samples in a version 2 message */
+#define MAX_SOCK_SAMPLES 16
 
-  instance = (RCL_Instance)anything;
+/* Sample in a version 2 message */
+struct sock_sample2 {
+  /* Time of the measurement (system time) */
+  int64_t sec;
+  int32_t nsec;
 
-  s = recv(sockfd, &sample, sizeof (sample), 0);
+  /* Non-zero if the sample is from a PPS signal */
+  int32_t pulse;
+
+  /* Offset between the true time and the system time (in seconds) */
+  double offset;
+
+  /* Maximum error of the offset in addition to the precision of the
+     refclock (in seconds) */
+  double error;
+
+  /* 0 - normal, 1 - insert leap second, 2 - delete leap second */
+  int32_t leap;
 
-  if (s < 0) {
-    DEBUG_LOG("Could not read SOCK sample : %s", strerror(errno));
+  /* Padding, ignored */
+  int32_t _pad;
+};
+
+/* Message with multiple samples (version 2).  Only the used samples
+   are included in the message. */
+struct sock_message2 {
+  /* Protocol identifier (0x534f4332) */
+  int32_t magic;
+
+  /* Number of samples in the message (1-16) */
+  int32_t n_samples;
+
+  struct sock_sample2 samples[MAX_SOCK_SAMPLES];
+};
+
+static void
+add_sample(RCL_Instance instance, struct timespec *sys_ts, double offset, int pulse,
+           int leap, double error)
+{
+  struct timespec ref_ts;
+
+  if (!UTI_IsTimeOffsetSane(sys_ts, offset)) {
+    RCL_CountDroppedSample(instance);
     return;
   }
 
-  if (s != sizeof (sample)) {
-    DEBUG_LOG("Unexpected length of SOCK sample : %d != %ld",
-              s, (long)sizeof (sample));
-    return;
+  UTI_AddDoubleToTimespec(sys_ts, offset, &ref_ts);
+
+  if (pulse) {
+    RCL_AddPulseWithError(instance, sys_ts, offset, error);
+  } else {
+    RCL_AddSampleWithError(instance, sys_ts, &ref_ts, leap, error);
   }
+}
+
+static void
+process_sample(RCL_Instance instance, void *data)
+{
+  struct timespec sys_ts;
+  struct sock_sample sample;
+
+  memcpy(&sample, data, sizeof (sample));
 
   if (sample.magic != SOCK_MAGIC) {
     DEBUG_LOG("Unexpected magic number in SOCK sample : %x != %x",
               (unsigned int)sample.magic, (unsigned int)SOCK_MAGIC);
+    RCL_CountDroppedSample(instance);
     return;
   }
 
   UTI_TimevalToTimespec(&sample.tv, &sys_ts);
   UTI_NormaliseTimespec(&sys_ts);
 
-  if (!UTI_IsTimeOffsetSane(&sys_ts, sample.offset))
+  add_sample(instance, &sys_ts, sample.offset, sample.pulse, sample.leap, 0.0);
+}
+
+static void
+process_message2(RCL_Instance instance, void *data, int length)
+{
+  struct sock_message2 message;
+  struct sock_sample2 *sample;
+  struct timespec sys_ts;
+  int i;
+
+  memcpy(&message, data, length);
+
+  if (message.magic != SOCK_MAGIC2 || message.n_samples < 1 ||
+      message.n_samples > MAX_SOCK_SAMPLES ||
+      length != offsetof(struct sock_message2, samples) +
+                message.n_samples * sizeof (message.samples[0])) {
+    DEBUG_LOG("Invalid SOCK message");
+    RCL_CountDroppedSample(instance);
     return;
+  }
 
-  UTI_AddDoubleToTimespec(&sys_ts, sample.offset, &ref_ts);
+  for (i = 0; i < message.n_samples; i++) {
+    sample = &message.samples[i];
 
-  if (sample.pulse) {
-    RCL_AddPulse(instance, &sys_ts, sample.offset);
-  } else {
-    RCL_AddSample(instance, &sys_ts, &ref_ts, sample.leap);
+    if (sample->nsec < 0 || sample->nsec >= 1000000000 ||
+        !(sample->error >= 0.0) || !isfinite(sample->error)) {
+      DEBUG_LOG("Invalid SOCK sample");
+      RCL_CountDroppedSample(instance);
+      continue;
+    }
+
+    sys_ts.tv_sec = sample->sec;
+    sys_ts.tv_nsec = sample->nsec;
+
+    add_sample(instance, &sys_ts, sample->offset, sample->pulse, sample->leap,
+               sample->error);
+  }
+}
+
+static void read_sample(int sockfd, int event, void *anything)
+{
+  RCL_Instance instance;
+  SCK_Message *messages;
+  int i, n;
+
+  instance = (RCL_Instance)anything;
+
+  /* Read all queued messages in one call if possible */
+  messages = SCK_ReceiveMessages(sockfd, 0, &n);
+
+  for (i = 0; i < n; i++) {
+    if (messages[i].length == sizeof (struct sock_sample)) {
+      process_sample(instance, messages[i].data);
+    } else if (messages[i].length >= offsetof(struct sock_message2, samples) &&
+               messages[i].length <= sizeof (struct sock_message2)) {
+      process_message2(instance, messages[i].data, messages[i].length);
+    } else {
+      DEBUG_LOG("Unexpected length of SOCK message : %d", messages[i].length);
+      RCL_CountDroppedSample(instance);
+    }
   }
 }
 
@@ -36,6 +36,8 @@
 #include "logging.h"
 #include "local.h"
 #include "sched.h"
+#include "shmpub.h"
+#include "usdt.h"
 
 /* ================================================== */
 
@@ -827,6 +829,8 @@ update_sync_status(struct timespec *now)
   LCL_SetSyncStatus(are_we_synchronised,
                     our_offset_sd + elapsed * our_frequency_sd,
                     our_root_delay / 2.0 + get_root_dispersion(now));
+
+  SHP_Update();
 }
 
 /* ================================================== */
@@ -1001,6 +1005,10 @@ REF_SetReference(int stratum, NTP_Leap leap, int combined_sources,
 
   assert(initialised);
 
+  USDT_PROBE10(ref_set, stratum, (int)leap, combined_sources, ref_id, USDT_NS(offset),
+               USDT_NS(offset_sd), USDT_PPB(frequency), USDT_PPB(skew),
+               USDT_NS(root_delay), USDT_NS(root_dispersion));
+
   /* Special modes are implemented elsewhere */
   if (mode != REF_ModeNormal) {
     special_mode_sync(1, offset);
@@ -34,8 +34,191 @@
 #include "logging.h"
 #include "util.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #define MAX_POINTS 64
 
+/* ================================================== */
+/* Kernels processing the arrays of points.  If SSE2 is available, they
+   process two points at once.  The results may differ from the scalar
+   versions in rounding. */
+
+#ifdef __SSE2__
+static double
+sum_pd(__m128d v)
+{
+  return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+#endif
+
+/* ================================================== */
+/* Calculate the sum of 1/w and x/w */
+
+static void
+sum_inverse_weights(double *x, double *w, int n, double *sw, double *sx)
+{
+  double W, U;
+  int i = 0;
+
+  W = U = 0.0;
+
+#ifdef __SSE2__
+  {
+    __m128d one = _mm_set1_pd(1.0), W2 = _mm_setzero_pd(), U2 = _mm_setzero_pd(), iw;
+
+    for (; i + 1 < n; i += 2) {
+      iw = _mm_div_pd(one, _mm_loadu_pd(w + i));
+      W2 = _mm_add_pd(W2, iw);
+      U2 = _mm_add_pd(U2, _mm_mul_pd(_mm_loadu_pd(x + i), iw));
+    }
+
+    W = sum_pd(W2);
+    U = sum_pd(U2);
+  }
+#endif
+
+  for (; i < n; i++) {
+    U += x[i] / w[i];
+    W += 1.0  / w[i];
+  }
+
+  *sw = W;
+  *sx = U;
+}
+
+/* ================================================== */
+/* Calculate the sum of y/w, y*(x-u)/w, and (x-u)^2/w */
+
+static void
+sum_centered(double *x, double *y, double *w, int n, double u,
+             double *sp, double *sq, double *sv)
+{
+  double P, Q, V, ui;
+  int i = 0;
+
+  P = Q = V = 0.0;
+
+#ifdef __SSE2__
+  {
+    __m128d P2 = _mm_setzero_pd(), Q2 = _mm_setzero_pd(), V2 = _mm_setzero_pd();
+    __m128d u2 = _mm_set1_pd(u), one = _mm_set1_pd(1.0), iw, yw, ui2;
+
+    for (; i + 1 < n; i += 2) {
+      iw = _mm_div_pd(one, _mm_loadu_pd(w + i));
+      ui2 = _mm_sub_pd(_mm_loadu_pd(x + i), u2);
+      yw = _mm_mul_pd(_mm_loadu_pd(y + i), iw);
+      P2 = _mm_add_pd(P2, yw);
+      Q2 = _mm_add_pd(Q2, _mm_mul_pd(yw, ui2));
+      V2 = _mm_add_pd(V2, _mm_mul_pd(_mm_mul_pd(ui2, ui2), iw));
+    }
+
+    P = sum_pd(P2);
+    Q = sum_pd(Q2);
+    V = sum_pd(V2);
+  }
+#endif
+
+  for (; i < n; i++) {
+    ui = x[i] - u;
+    P += y[i]        / w[i];
+    Q += y[i] * ui   / w[i];
+    V += ui   * ui   / w[i];
+  }
+
+  *sp = P;
+  *sq = Q;
+  *sv = V;
+}
+
+/* ================================================== */
+/* Calculate residuals y - a - b*x */
+
+static void
+calc_residuals(double *x, double *y, int n, double a, double b, double *resid)
+{
+  int i = 0;
+
+#ifdef __SSE2__
+  {
+    __m128d a2 = _mm_set1_pd(a), b2 = _mm_set1_pd(b);
+
+    for (; i + 1 < n; i += 2)
+      _mm_storeu_pd(resid + i, _mm_sub_pd(_mm_sub_pd(_mm_loadu_pd(y + i), a2),
+                                          _mm_mul_pd(b2, _mm_loadu_pd(x + i))));
+  }
+#endif
+
+  for (; i < n; i++)
+    resid[i] = y[i] - a - b * x[i];
+}
+
+/* ================================================== */
+/* Calculate the sum of r^2/w */
+
+static double
+sum_weighted_squares(double *r, double *w, int n)
+{
+  double ss = 0.0;
+  int i = 0;
+
+#ifdef __SSE2__
+  {
+    __m128d ss2 = _mm_setzero_pd(), r2;
+
+    for (; i + 1 < n; i += 2) {
+      r2 = _mm_loadu_pd(r + i);
+      ss2 = _mm_add_pd(ss2, _mm_div_pd(_mm_mul_pd(r2, r2), _mm_loadu_pd(w + i)));
+    }
+
+    ss = sum_pd(ss2);
+  }
+#endif
+
+  for (; i < n; i++)
+    ss += r[i] * r[i] / w[i];
+
+  return ss;
+}
+
+/* ================================================== */
+/* Calculate the sum of x * sign(y - a - b*x) */
+
+static double
+sum_signed(double *x, double *y, int n, double a, double b)
+{
+  double del, res = 0.0;
+  int i = 0;
+
+#ifdef __SSE2__
+  {
+    __m128d a2 = _mm_set1_pd(a), b2 = _mm_set1_pd(b), zero = _mm_setzero_pd();
+    __m128d res2 = _mm_setzero_pd(), x2, del2;
+
+    for (; i + 1 < n; i += 2) {
+      x2 = _mm_loadu_pd(x + i);
+      del2 = _mm_sub_pd(_mm_sub_pd(_mm_loadu_pd(y + i), a2), _mm_mul_pd(b2, x2));
+      res2 = _mm_add_pd(res2, _mm_and_pd(_mm_cmpgt_pd(del2, zero), x2));
+      res2 = _mm_sub_pd(res2, _mm_and_pd(_mm_cmplt_pd(del2, zero), x2));
+    }
+
+    res = sum_pd(res2);
+  }
+#endif
+
+  for (; i < n; i++) {
+    del = y[i] - a - b * x[i];
+    if (del > 0.0) {
+      res += x[i];
+    } else if (del < 0.0) {
+      res -= x[i];
+    }
+  }
+
+  return res;
+}
+
 void
 RGR_WeightedRegression
 (double *x,                     /* independent variable */
@@ -60,36 +243,27 @@ RGR_WeightedRegression
 )
 {
   double P, Q, U, V, W;
-  double diff;
-  double u, ui, aa;
-  int i;
+  double resid[MAX_POINTS];
+  double u, aa;
+  int i, m;
 
   assert(n >= 3);
 
-  W = U = 0;
-  for (i=0; i<n; i++) {
-    U += x[i]        / w[i];
-    W += 1.0         / w[i];
-  }
+  sum_inverse_weights(x, w, n, &W, &U);
 
   u = U / W;
 
   /* Calculate statistics from data */
-  P = Q = V = 0.0;
-  for (i=0; i<n; i++) {
-    ui = x[i] - u;
-    P += y[i]        / w[i];
-    Q += y[i] * ui   / w[i];
-    V += ui   * ui   / w[i];
-  }
+  sum_centered(x, y, w, n, u, &P, &Q, &V);
 
   *b1 = Q / V;
   *b0 = (P / W) - (*b1) * u;
 
-  *s2 = 0.0;
-  for (i=0; i<n; i++) {
-    diff = y[i] - *b0 - *b1*x[i];
-    *s2 += diff*diff / w[i];
+  /* The sample filter may have more points than MAX_POINTS */
+  for (i = 0, *s2 = 0.0; i < n; i += m) {
+    m = MIN(n - i, MAX_POINTS);
+    calc_residuals(x + i, y + i, m, *b0, *b1, resid);
+    *s2 += sum_weighted_squares(resid, w + i, m);
   }
 
   *s2 /= (double)(n-2);
@@ -179,7 +353,27 @@ n_runs_from_residuals(double *resid, int n)
   int i;
   
   nruns = 1;
-  for (i=1; i<n; i++) {
+  i = 1;
+
+#ifdef __SSE2__
+  {
+    __m128d zero = _mm_setzero_pd(), r0, r1;
+    int mask;
+
+    /* Count pairs of neighbouring residuals with different signs */
+    for (; i + 1 < n; i += 2) {
+      r0 = _mm_loadu_pd(resid + i - 1);
+      r1 = _mm_loadu_pd(resid + i);
+      mask = _mm_movemask_pd(_mm_or_pd(_mm_and_pd(_mm_cmplt_pd(r0, zero),
+                                                  _mm_cmplt_pd(r1, zero)),
+                                       _mm_and_pd(_mm_cmpgt_pd(r0, zero),
+                                                  _mm_cmpgt_pd(r1, zero))));
+      nruns += 2 - (mask & 1) - (mask >> 1);
+    }
+  }
+#endif
+
+  for (; i<n; i++) {
     if (((resid[i-1] < 0.0) && (resid[i] < 0.0)) ||
         ((resid[i-1] > 0.0) && (resid[i] > 0.0))) {
       /* Nothing to do */
@@ -232,9 +426,11 @@ RGR_FindBestRegression
 )
 {
   double P, Q, U, V, W; /* total */
+  double sw[MAX_POINTS + 1], sx[MAX_POINTS + 1], sy[MAX_POINTS + 1];
+  double sxx[MAX_POINTS + 1], sxy[MAX_POINTS + 1];
   double resid[MAX_POINTS * REGRESS_RUNS_RATIO];
   double ss;
-  double a, b, u, ui, aa;
+  double a, b, c, u, xi, aa;
 
   int start, resid_start, nruns, npoints;
   int i;
@@ -246,36 +442,41 @@ RGR_FindBestRegression
     return 0;
   }
 
+  /* Accumulate the weighted sums from the end of the arrays, so that the
+     regression for each starting index can be calculated in constant time.
+     The x values are shifted by the newest value to avoid a loss of
+     precision in the subtractions. */
+  c = x[n - 1];
+  sw[n] = sx[n] = sy[n] = sxx[n] = sxy[n] = 0.0;
+  for (i = n - 1; i >= 0; i--) {
+    xi = x[i] - c;
+    sw[i] = sw[i + 1] + 1.0 / w[i];
+    sx[i] = sx[i + 1] + xi / w[i];
+    sy[i] = sy[i + 1] + y[i] / w[i];
+    sxx[i] = sxx[i + 1] + xi * xi / w[i];
+    sxy[i] = sxy[i + 1] + xi * y[i] / w[i];
+  }
+
   start = 0;
   do {
 
-    W = U = 0;
-    for (i=start; i<n; i++) {
-      U += x[i]        / w[i];
-      W += 1.0         / w[i];
-    }
+    W = sw[start];
+    U = sx[start];
+    P = sy[start];
 
     u = U / W;
-
-    P = Q = V = 0.0;
-    for (i=start; i<n; i++) {
-      ui = x[i] - u;
-      P += y[i]        / w[i];
-      Q += y[i] * ui   / w[i];
-      V += ui   * ui   / w[i];
-    }
+    Q = sxy[start] - u * P;
+    V = sxx[start] - u * U;
 
     b = Q / V;
-    a = (P / W) - (b * u);
+    a = (P / W) - (b * (u + c));
 
     /* Get residuals also for the extra samples before start */
     resid_start = n - (n - start) * REGRESS_RUNS_RATIO;
     if (resid_start < -m)
       resid_start = -m;
 
-    for (i=resid_start; i<n; i++) {
-      resid[i - resid_start] = y[i] - a - b*x[i];
-    }
+    calc_residuals(x + resid_start, y + resid_start, n - resid_start, a, b, resid);
 
     /* Count number of runs */
     nruns = n_runs_from_residuals(resid, n - resid_start); 
@@ -295,14 +496,13 @@ RGR_FindBestRegression
 
   } while (1);
 
+  u += c;
+
   /* Work out statistics from full dataset */
   *b1 = b;
   *b0 = a;
 
-  ss = 0.0;
-  for (i=start; i<n; i++) {
-    ss += resid[i - resid_start]*resid[i - resid_start] / w[i];
-  }
+  ss = sum_weighted_squares(resid + (start - resid_start), w + start, n - start);
 
   npoints = n - start;
   ss /= (double)(npoints - 2);
@@ -323,92 +523,122 @@ RGR_FindBestRegression
 
 #define EXCH(a,b) temp=(a); (a)=(b); (b)=temp
 
+/* Arrays up to this size are sorted instead of partitioned */
+#define MAX_SORT_POINTS 8
+
 /* ================================================== */
-/* Find the index'th biggest element in the array x of n elements.
-   flags is an array where a 1 indicates that the corresponding entry
-   in x is known to be sorted into its correct position and a 0
-   indicates that the corresponding entry is not sorted.  However, if
-   flags[m] = flags[n] = 1 with m<n, then x[m] must be <= x[n] and for
-   all i with m<i<n, x[m] <= x[i] <= x[n].  In practice, this means
-   flags[] has to be the result of a previous call to this routine
-   with the same array x, and is used to remember which parts of the
-   x[] array we have already sorted.
-
-   The approach used is a cut-down quicksort, where we only bother to
-   keep sorting the partition that contains the index we are after.
-   The approach comes from Numerical Recipes in C (ISBN
-   0-521-43108-5). */
 
-static double
-find_ordered_entry_with_flags(double *x, int n, int index, char *flags)
+static void
+sort_small(double *x, int n)
 {
-  int u, v, l, r;
   double temp;
-  double piv;
-  int pivind;
+  int i, j;
 
-  assert(index >= 0);
-
-  /* If this bit of the array is already sorted, simple! */
-  if (flags[index]) {
-    return x[index];
+  for (i = 1; i < n; i++) {
+    temp = x[i];
+    for (j = i; j > 0 && x[j - 1] > temp; j--)
+      x[j] = x[j - 1];
+    x[j] = temp;
   }
-  
-  /* Find subrange to look at */
-  u = v = index;
-  while (u > 0 && !flags[u]) u--;
-  if (flags[u]) u++;
+}
 
-  while (v < (n-1) && !flags[v]) v++;
-  if (flags[v]) v--;
+/* ================================================== */
+/* Partition the array x of n elements into three parts with values
+   smaller than, equal to, and larger than the pivot.  The returned
+   indices lt and gt are the first and last index of the middle part. */
 
-  do {
-    if (v - u < 2) {
-      if (x[v] < x[u]) {
-        EXCH(x[v], x[u]);
-      }
-      flags[v] = flags[u] = 1;
-      return x[index];
-    } else { 
-      pivind = (u + v) >> 1;
-      EXCH(x[u], x[pivind]);
-      piv = x[u]; /* New value */
-      l = u + 1;
-      r = v;
-      do {
-        while (l < v && x[l] < piv) l++;
-        while (x[r] > piv) r--;
-        if (r <= l) break;
-        EXCH(x[l], x[r]);
-        l++;
-        r--;
-      } while (1);
-      EXCH(x[u], x[r]);
-      flags[r] = 1; /* Pivot now in correct place */
-      if (index == r) {
-        return x[r];
-      } else if (index < r) {
-        v = r - 1;
-      } else if (index > r) {
-        u = l;
-      }
+static void
+partition(double *x, int n, double piv, int *lt, int *gt)
+{
+  int l, r, i;
+  double temp;
+
+  for (l = i = 0, r = n - 1; i <= r; ) {
+    if (x[i] < piv) {
+      EXCH(x[l], x[i]);
+      l++;
+      i++;
+    } else if (x[i] > piv) {
+      EXCH(x[i], x[r]);
+      r--;
+    } else {
+      i++;
     }
-  } while (1);
+  }
+
+  *lt = l;
+  *gt = r;
 }
 
 /* ================================================== */
 
-#if 0
-/* Not used, but this is how it can be done */
+static double
+find_ordered_entry(double *x, int n, int index);
+
+/* Get a pivot which guarantees that at least 30% of elements are
+   smaller or equal, and 30% larger or equal (median of medians of
+   groups of 5) */
+
+static double
+get_mom_pivot(double *x, int n)
+{
+  double temp;
+  int i, m;
+
+  for (i = m = 0; i + 5 <= n; i += 5, m++) {
+    sort_small(x + i, 5);
+    EXCH(x[m], x[i + 2]);
+  }
+
+  return find_ordered_entry(x, m, m / 2);
+}
+
+/* ================================================== */
+/* Find the index'th smallest element in the array x of n elements
+   (introselect).  The array is reordered so that all elements before
+   index are smaller or equal to the returned value.  The first iterations
+   use the median of three elements as the pivot.  If the iterations don't
+   reduce the size of the array quickly enough, the median of medians is
+   used to guarantee a linear time in the worst case. */
+
 static double
 find_ordered_entry(double *x, int n, int index)
 {
-  char flags[MAX_POINTS];
+  int lt, gt, budget;
+  double a, b, c, piv;
+
+  assert(index >= 0 && index < n);
 
-  memset(flags, 0, n * sizeof (flags[0]));
-  return find_ordered_entry_with_flags(x, n, index, flags);
+  /* Allow about 2*log2(n) iterations with the cheap pivot */
+  for (budget = 0; 1 << budget < n; budget++)
+    ;
+  budget *= 2;
+
+  while (n > MAX_SORT_POINTS) {
+    if (budget-- > 0) {
+      a = x[0], b = x[n / 2], c = x[n - 1];
+      piv = a < b ? (b < c ? b : a < c ? c : a) : (a < c ? a : b < c ? c : b);
+    } else {
+      piv = get_mom_pivot(x, n);
+    }
+
+    partition(x, n, piv, &lt, &gt);
+
+    if (index < lt) {
+      n = lt;
+    } else if (index > gt) {
+      x += gt + 1;
+      n -= gt + 1;
+      index -= gt + 1;
+    } else {
+      return piv;
+    }
+  }
+
+  sort_small(x, n);
+
+  return x[index];
 }
-#endif
 
 /* ================================================== */
 /* Find the median entry of an array x[] with n elements. */
@@ -416,17 +646,21 @@ find_ordered_entry(double *x, int n, int index)
 static double
 find_median(double *x, int n)
 {
-  int k;
-  char flags[MAX_POINTS];
+  double a, b;
+  int i, k;
 
-  memset(flags, 0, n * sizeof (flags[0]));
-  k = n>>1;
-  if (n&1) {
-    return find_ordered_entry_with_flags(x, n, k, flags);
-  } else {
-    return 0.5 * (find_ordered_entry_with_flags(x, n, k, flags) +
-                  find_ordered_entry_with_flags(x, n, k-1, flags));
+  k = n / 2;
+  a = find_ordered_entry(x, n, k);
+  if (n % 2)
+    return a;
+
+  /* The other middle element is the largest element before k */
+  for (i = 1, b = x[0]; i < k; i++) {
+    if (x[i] > b)
+      b = x[i];
   }
+
+  return 0.5 * (a + b);
 }
 
 /* ================================================== */
@@ -461,28 +695,14 @@ eval_robust_residual
  double *rr                     /* Corresponding value of equation */
 )
 {
-  int i;
-  double a, res, del;
-  double d[MAX_POINTS];
+  double a, d[MAX_POINTS];
 
-  for (i=0; i<n; i++) {
-    d[i] = y[i] - b * x[i];
-  }
-  
-  a = find_median(d, n);
+  calc_residuals(x, y, n, 0.0, b, d);
 
-  res = 0.0;
-  for (i=0; i<n; i++) {
-    del = y[i] - a - b * x[i];
-    if (del > 0.0) {
-      res += x[i];
-    } else if (del < 0.0) {
-      res -= x[i];
-    }
-  }
+  a = find_median(d, n);
 
   *aa = a;
-  *rr = res;
+  *rr = sum_signed(x, y, n, a, b);
 }
 
 /* ================================================== */
@@ -626,9 +846,7 @@ RGR_FindBestRobustRegression
       break;
     }
 
-    for (i=start; i<n; i++) {
-      resids[i] = y[i] - a - bmid * x[i];
-    }
+    calc_residuals(x + start, y + start, n_points, a, bmid, resids + start);
 
     nruns = n_runs_from_residuals(resids + start, n_points);
 
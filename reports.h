@@ -80,6 +80,7 @@ typedef struct {
   double sd;
   double est_offset;
   double est_offset_err;
+  unsigned long n_dropped;
 } RPT_SourcestatsReport;
 
 typedef struct {
@@ -120,6 +121,11 @@ typedef struct {
   uint32_t ntp_interleaved_hits;
   uint32_t ntp_timestamps;
   uint32_t ntp_span_seconds;
+  uint32_t ntp_sockets;
+  uint32_t ntp_socket_min_hits;
+  uint32_t ntp_socket_max_hits;
+  uint32_t ptp_hits;
+  uint32_t ptp_sent;
 } RPT_ServerStatsReport;
 
 typedef struct {
@@ -202,4 +208,25 @@ typedef struct {
   double hi_limit;
 } RPT_SelectReport;
 
+typedef struct {
+  uint32_t iterations;
+  double blocked_time;
+  double busy_time;
+  double max_busy_time;
+  int n_handlers;
+} RPT_SchedStatsReport;
+
+typedef struct {
+  char name[32];
+  enum {RPT_SCH_TIMEOUT, RPT_SCH_FILE} type;
+  uint32_t calls;
+  double total_time;
+  double max_time;
+} RPT_SchedHandlerReport;
+
+typedef struct {
+  int family;
+  uint32_t rx_messages;
+} RPT_ServerSocketReport;
+
 #endif /* GOT_REPORTS_H */
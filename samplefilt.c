@@ -48,6 +48,7 @@ struct SPF_Instance_Record {
   double max_var;
   double combine_ratio;
   NTP_Sample *samples;
+  int *sorted;
   int *selected;
   double *x_data;
   double *y_data;
@@ -79,6 +80,7 @@ SPF_CreateInstance(int min_samples, int max_samples, double max_dispersion, doub
   filter->max_var = SQUARE(max_dispersion);
   filter->combine_ratio = combine_ratio;
   filter->samples = MallocArray(NTP_Sample, filter->max_samples);
+  filter->sorted = MallocArray(int, filter->max_samples);
   filter->selected = MallocArray(int, filter->max_samples);
   filter->x_data = MallocArray(double, filter->max_samples);
   filter->y_data = MallocArray(double, filter->max_samples);
@@ -93,6 +95,7 @@ void
 SPF_DestroyInstance(SPF_Instance filter)
 {
   Free(filter->samples);
+  Free(filter->sorted);
   Free(filter->selected);
   Free(filter->x_data);
   Free(filter->y_data);
@@ -118,22 +121,92 @@ check_sample(SPF_Instance filter, NTP_Sample *sample)
   return 1;
 }
 
+/* ================================================== */
+/* Compare samples by their offset and index in the buffer */
+
+static int
+compare_samples(SPF_Instance filter, int i, int j)
+{
+  const NTP_Sample *s1, *s2;
+
+  s1 = &filter->samples[i];
+  s2 = &filter->samples[j];
+
+  if (s1->offset < s2->offset)
+    return -1;
+  else if (s1->offset > s2->offset)
+    return 1;
+  return i - j;
+}
+
+/* ================================================== */
+/* Find the position of a sample in the list of samples sorted by offset,
+   or the position where it should be inserted */
+
+static int
+find_sorted_position(SPF_Instance filter, int index)
+{
+  int lo, hi, mid;
+
+  for (lo = 0, hi = filter->used; lo < hi; ) {
+    mid = (lo + hi) / 2;
+    if (compare_samples(filter, filter->sorted[mid], index) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+/* ================================================== */
+/* Restore the order of the sorted list after the offsets were adjusted */
+
+static void
+sort_samples(SPF_Instance filter)
+{
+  int i, j, index;
+
+  for (i = 1; i < filter->used; i++) {
+    index = filter->sorted[i];
+    for (j = i; j > 0 && compare_samples(filter, filter->sorted[j - 1], index) > 0; j--)
+      filter->sorted[j] = filter->sorted[j - 1];
+    filter->sorted[j] = index;
+  }
+}
+
 /* ================================================== */
 
 int
 SPF_AccumulateSample(SPF_Instance filter, NTP_Sample *sample)
 {
+  int i;
+
   if (!check_sample(filter, sample))
       return 0;
 
   filter->index++;
   filter->index %= filter->max_samples;
   filter->last = filter->index;
-  if (filter->used < filter->max_samples)
-    filter->used++;
+
+  /* Remove the replaced sample from the sorted list */
+  if (filter->used == filter->max_samples) {
+    i = find_sorted_position(filter, filter->index);
+    assert(i < filter->used && filter->sorted[i] == filter->index);
+    memmove(filter->sorted + i, filter->sorted + i + 1,
+            (filter->used - i - 1) * sizeof (filter->sorted[0]));
+    filter->used--;
+  }
 
   filter->samples[filter->index] = *sample;
 
+  /* Insert the new sample to keep the list sorted by offset */
+  i = find_sorted_position(filter, filter->index);
+  memmove(filter->sorted + i + 1, filter->sorted + i,
+          (filter->used - i) * sizeof (filter->sorted[0]));
+  filter->sorted[i] = filter->index;
+  filter->used++;
+
   DEBUG_LOG("filter sample %d t=%s offset=%.9f peer_disp=%.9f",
             filter->index, UTI_TimespecToString(&sample->time),
             sample->offset, sample->peer_dispersion);
@@ -179,25 +252,6 @@ SPF_DropSamples(SPF_Instance filter)
 
 /* ================================================== */
 
-static const NTP_Sample *tmp_sort_samples;
-
-static int
-compare_samples(const void *a, const void *b)
-{
-  const NTP_Sample *s1, *s2;
-
-  s1 = &tmp_sort_samples[*(int *)a];
-  s2 = &tmp_sort_samples[*(int *)b];
-
-  if (s1->offset < s2->offset)
-    return -1;
-  else if (s1->offset > s2->offset)
-    return 1;
-  return 0;
-}
-
-/* ================================================== */
-
 static int
 select_samples(SPF_Instance filter)
 {
@@ -210,7 +264,8 @@ select_samples(SPF_Instance filter)
   selected = filter->selected;
 
   /* With 4 or more samples, select those that have peer dispersion smaller
-     than 1.5x of the minimum dispersion */
+     than 1.5x of the minimum dispersion.  The selected samples are sorted
+     by offset. */
   if (filter->used > 4) {
     for (i = 1, min_dispersion = filter->samples[0].peer_dispersion; i < filter->used; i++) {
       if (min_dispersion > filter->samples[i].peer_dispersion)
@@ -218,8 +273,9 @@ select_samples(SPF_Instance filter)
     }
 
     for (i = j = 0; i < filter->used; i++) {
-      if (filter->samples[i].peer_dispersion <= 1.5 * min_dispersion)
-        selected[j++] = i;
+      k = filter->sorted[i];
+      if (filter->samples[k].peer_dispersion <= 1.5 * min_dispersion)
+        selected[j++] = k;
     }
   } else {
     j = 0;
@@ -229,13 +285,9 @@ select_samples(SPF_Instance filter)
     /* Select all samples */
 
     for (j = 0; j < filter->used; j++)
-      selected[j] = j;
+      selected[j] = filter->sorted[j];
   }
 
-  /* And sort their indices by offset */
-  tmp_sort_samples = filter->samples;
-  qsort(selected, j, sizeof (int), compare_samples);
-
   /* Select samples closest to the median */
   if (j > 2) {
     from = j * (1.0 - filter->combine_ratio) / 2.0;
@@ -447,6 +499,8 @@ SPF_SlewSamples(SPF_Instance filter, struct timespec *when, double dfreq, double
                        &delta_time, dfreq, doffset);
     filter->samples[i].offset -= delta_time;
   }
+
+  sort_samples(filter);
 }
 
 /* ================================================== */
@@ -461,6 +515,8 @@ SPF_CorrectOffset(SPF_Instance filter, double doffset)
 
   for (i = first; i <= last; i++)
     filter->samples[i].offset -= doffset;
+
+  sort_samples(filter);
 }
 
 /* ================================================== */
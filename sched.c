@@ -37,6 +37,14 @@
 #include "local.h"
 #include "logging.h"
 
+#ifdef FEAT_SCHEDSTATS
+/* The public functions are defined here without the macros adding names */
+#undef SCH_AddFileHandler
+#undef SCH_AddTimeout
+#undef SCH_AddTimeoutByDelay
+#undef SCH_AddTimeoutInClass
+#endif
+
 /* ================================================== */
 
 /* Flag indicating that we are initialised */
@@ -57,6 +65,9 @@ typedef struct {
   SCH_FileHandler       handler;
   SCH_ArbitraryArgument arg;
   int                   events;
+#ifdef FEAT_SCHEDSTATS
+  int                   stats_index;
+#endif
 } FileHandlerEntry;
 
 static ARR_Instance file_handlers;
@@ -94,6 +105,9 @@ typedef struct _TimerQueueEntry
   SCH_TimeoutClass class;       /* The class that the epoch is in */
   SCH_TimeoutHandler handler;   /* The handler routine to use */
   SCH_ArbitraryArgument arg;    /* The argument to pass to the handler */
+#ifdef FEAT_SCHEDSTATS
+  int stats_index;              /* Index of the handler statistics */
+#endif
 
 } TimerQueueEntry;
 
@@ -116,6 +130,30 @@ static volatile int need_to_exit;
 
 /* ================================================== */
 
+#ifdef FEAT_SCHEDSTATS
+
+/* Statistics of a timeout or file handler function */
+typedef struct {
+  SCH_TimeoutHandler timeout_handler;
+  SCH_FileHandler file_handler;
+  const char *name;
+  uint32_t calls;
+  double total_time;
+  double max_time;
+} HandlerStats;
+
+static ARR_Instance handler_stats;
+
+/* Statistics of the main loop */
+static uint32_t loop_iterations;
+static double loop_blocked_time;
+static double loop_busy_time;
+static double loop_max_busy_time;
+
+#endif
+
+/* ================================================== */
+
 static void
 handle_slew(struct timespec *raw,
             struct timespec *cooked,
@@ -131,6 +169,11 @@ SCH_Initialise(void)
 {
   file_handlers = ARR_CreateInstance(sizeof (FileHandlerEntry));
 
+#ifdef FEAT_SCHEDSTATS
+  handler_stats = ARR_CreateInstance(sizeof (HandlerStats));
+  SCH_GetStatsReport(NULL, 1);
+#endif
+
   n_timer_queue_entries = 0;
   next_tqe_id = 0;
 
@@ -156,6 +199,10 @@ void
 SCH_Finalise(void) {
   ARR_DestroyInstance(file_handlers);
 
+#ifdef FEAT_SCHEDSTATS
+  ARR_DestroyInstance(handler_stats);
+#endif
+
   LCL_RemoveParameterChangeHandler(handle_slew, NULL);
 
   initialised = 0;
@@ -163,9 +210,71 @@ SCH_Finalise(void) {
 
 /* ================================================== */
 
-void
-SCH_AddFileHandler
-(int fd, int events, SCH_FileHandler handler, SCH_ArbitraryArgument arg)
+#ifdef FEAT_SCHEDSTATS
+
+static void
+read_stats_time(struct timespec *ts)
+{
+#if HAVE_CLOCK_GETTIME
+  if (clock_gettime(CLOCK_MONOTONIC, ts) == 0)
+    return;
+#endif
+  LCL_ReadRawTime(ts);
+}
+
+/* ================================================== */
+
+static int
+get_handler_stats_index(SCH_TimeoutHandler timeout_handler, SCH_FileHandler file_handler,
+                        const char *name)
+{
+  HandlerStats *stats;
+  int i;
+
+  for (i = 0; i < ARR_GetSize(handler_stats); i++) {
+    stats = ARR_GetElement(handler_stats, i);
+    if (stats->timeout_handler == timeout_handler && stats->file_handler == file_handler) {
+      if (!stats->name)
+        stats->name = name;
+      return i;
+    }
+  }
+
+  stats = ARR_GetNewElement(handler_stats);
+  memset(stats, 0, sizeof (*stats));
+  stats->timeout_handler = timeout_handler;
+  stats->file_handler = file_handler;
+  stats->name = name;
+
+  return i;
+}
+
+/* ================================================== */
+
+static void
+update_handler_stats(int index, struct timespec *start)
+{
+  HandlerStats *stats;
+  struct timespec now;
+  double elapsed;
+
+  read_stats_time(&now);
+  elapsed = UTI_DiffTimespecsToDouble(&now, start);
+
+  stats = ARR_GetElement(handler_stats, index);
+  stats->calls++;
+  stats->total_time += elapsed;
+  if (stats->max_time < elapsed)
+    stats->max_time = elapsed;
+}
+
+#endif
+
+/* ================================================== */
+
+static void
+add_file_handler(int fd, int events, SCH_FileHandler handler, SCH_ArbitraryArgument arg,
+                 const char *name)
 {
   FileHandlerEntry *ptr;
 
@@ -194,11 +303,33 @@ SCH_AddFileHandler
   ptr->handler = handler;
   ptr->arg = arg;
   ptr->events = events;
+#ifdef FEAT_SCHEDSTATS
+  ptr->stats_index = get_handler_stats_index(NULL, handler, name);
+#endif
 
   if (one_highest_fd < fd + 1)
     one_highest_fd = fd + 1;
 }
 
+/* ================================================== */
+
+void
+SCH_AddFileHandler(int fd, int events, SCH_FileHandler handler, SCH_ArbitraryArgument arg)
+{
+  add_file_handler(fd, events, handler, arg, NULL);
+}
+
+/* ================================================== */
+
+#ifdef FEAT_SCHEDSTATS
+void
+SCH_AddNamedFileHandler(int fd, int events, SCH_FileHandler handler,
+                        SCH_ArbitraryArgument arg, const char *name)
+{
+  add_file_handler(fd, events, handler, arg, name);
+}
+#endif
+
 
 /* ================================================== */
 
@@ -319,8 +450,9 @@ try_again:
 
 /* ================================================== */
 
-SCH_TimeoutID
-SCH_AddTimeout(struct timespec *ts, SCH_TimeoutHandler handler, SCH_ArbitraryArgument arg)
+static SCH_TimeoutID
+add_timeout(struct timespec *ts, SCH_TimeoutHandler handler, SCH_ArbitraryArgument arg,
+            const char *name)
 {
   TimerQueueEntry *new_tqe;
   TimerQueueEntry *ptr;
@@ -334,6 +466,9 @@ SCH_AddTimeout(struct timespec *ts, SCH_TimeoutHandler handler, SCH_ArbitraryArg
   new_tqe->arg = arg;
   new_tqe->ts = *ts;
   new_tqe->class = SCH_ReservedTimeoutValue;
+#ifdef FEAT_SCHEDSTATS
+  new_tqe->stats_index = get_handler_stats_index(handler, NULL, name);
+#endif
 
   /* Now work out where to insert the new entry in the list */
   for (ptr = timer_queue.next; ptr != &timer_queue; ptr = ptr->next) {
@@ -361,8 +496,9 @@ SCH_AddTimeout(struct timespec *ts, SCH_TimeoutHandler handler, SCH_ArbitraryArg
 /* This queues a timeout to elapse at a given delta time relative to
    the current (raw) time */
 
-SCH_TimeoutID
-SCH_AddTimeoutByDelay(double delay, SCH_TimeoutHandler handler, SCH_ArbitraryArgument arg)
+static SCH_TimeoutID
+add_timeout_by_delay(double delay, SCH_TimeoutHandler handler, SCH_ArbitraryArgument arg,
+                     const char *name)
 {
   struct timespec now, then;
 
@@ -375,16 +511,16 @@ SCH_AddTimeoutByDelay(double delay, SCH_TimeoutHandler handler, SCH_ArbitraryArg
     LOG_FATAL("Timeout overflow");
   }
 
-  return SCH_AddTimeout(&then, handler, arg);
+  return add_timeout(&then, handler, arg, name);
 
 }
 
 /* ================================================== */
 
-SCH_TimeoutID
-SCH_AddTimeoutInClass(double min_delay, double separation, double randomness,
-                      SCH_TimeoutClass class,
-                      SCH_TimeoutHandler handler, SCH_ArbitraryArgument arg)
+static SCH_TimeoutID
+add_timeout_in_class(double min_delay, double separation, double randomness,
+                     SCH_TimeoutClass class, SCH_TimeoutHandler handler,
+                     SCH_ArbitraryArgument arg, const char *name)
 {
   TimerQueueEntry *new_tqe;
   TimerQueueEntry *ptr;
@@ -446,6 +582,9 @@ SCH_AddTimeoutInClass(double min_delay, double separation, double randomness,
   new_tqe->arg = arg;
   UTI_AddDoubleToTimespec(&now, new_min_delay, &new_tqe->ts);
   new_tqe->class = class;
+#ifdef FEAT_SCHEDSTATS
+  new_tqe->stats_index = get_handler_stats_index(handler, NULL, name);
+#endif
 
   new_tqe->next = ptr;
   new_tqe->prev = ptr->prev;
@@ -458,6 +597,62 @@ SCH_AddTimeoutInClass(double min_delay, double separation, double randomness,
 
 /* ================================================== */
 
+SCH_TimeoutID
+SCH_AddTimeout(struct timespec *ts, SCH_TimeoutHandler handler, SCH_ArbitraryArgument arg)
+{
+  return add_timeout(ts, handler, arg, NULL);
+}
+
+/* ================================================== */
+
+SCH_TimeoutID
+SCH_AddTimeoutByDelay(double delay, SCH_TimeoutHandler handler, SCH_ArbitraryArgument arg)
+{
+  return add_timeout_by_delay(delay, handler, arg, NULL);
+}
+
+/* ================================================== */
+
+SCH_TimeoutID
+SCH_AddTimeoutInClass(double min_delay, double separation, double randomness,
+                      SCH_TimeoutClass class,
+                      SCH_TimeoutHandler handler, SCH_ArbitraryArgument arg)
+{
+  return add_timeout_in_class(min_delay, separation, randomness, class, handler, arg, NULL);
+}
+
+/* ================================================== */
+
+#ifdef FEAT_SCHEDSTATS
+SCH_TimeoutID
+SCH_AddNamedTimeout(struct timespec *ts, SCH_TimeoutHandler handler,
+                    SCH_ArbitraryArgument arg, const char *name)
+{
+  return add_timeout(ts, handler, arg, name);
+}
+
+/* ================================================== */
+
+SCH_TimeoutID
+SCH_AddNamedTimeoutByDelay(double delay, SCH_TimeoutHandler handler,
+                           SCH_ArbitraryArgument arg, const char *name)
+{
+  return add_timeout_by_delay(delay, handler, arg, name);
+}
+
+/* ================================================== */
+
+SCH_TimeoutID
+SCH_AddNamedTimeoutInClass(double min_delay, double separation, double randomness,
+                           SCH_TimeoutClass class, SCH_TimeoutHandler handler,
+                           SCH_ArbitraryArgument arg, const char *name)
+{
+  return add_timeout_in_class(min_delay, separation, randomness, class, handler, arg, name);
+}
+#endif
+
+/* ================================================== */
+
 void
 SCH_RemoveTimeout(SCH_TimeoutID id)
 {
@@ -503,6 +698,10 @@ dispatch_timeouts(struct timespec *now) {
   TimerQueueEntry *ptr;
   SCH_TimeoutHandler handler;
   SCH_ArbitraryArgument arg;
+#ifdef FEAT_SCHEDSTATS
+  struct timespec start;
+  int stats_index;
+#endif
 
   n_entries_on_start = n_timer_queue_entries;
   n_done = 0;
@@ -521,12 +720,20 @@ dispatch_timeouts(struct timespec *now) {
 
     handler = ptr->handler;
     arg = ptr->arg;
+#ifdef FEAT_SCHEDSTATS
+    stats_index = ptr->stats_index;
+    read_stats_time(&start);
+#endif
 
     SCH_RemoveTimeout(ptr->id);
 
     /* Dispatch the handler */
     (handler)(arg);
 
+#ifdef FEAT_SCHEDSTATS
+    update_handler_stats(stats_index, &start);
+#endif
+
     /* Increment count of timeouts handled */
     ++n_done;
 
@@ -549,20 +756,45 @@ dispatch_timeouts(struct timespec *now) {
 
 /* ================================================== */
 
+static void
+dispatch_filehandler(int fd, int event)
+{
+  FileHandlerEntry *ptr;
+#ifdef FEAT_SCHEDSTATS
+  struct timespec start;
+  int stats_index;
+#endif
+
+  ptr = (FileHandlerEntry *)ARR_GetElement(file_handlers, fd);
+  if (!ptr->handler)
+    return;
+
+#ifdef FEAT_SCHEDSTATS
+  /* The handler may remove itself or add other handlers */
+  stats_index = ptr->stats_index;
+  read_stats_time(&start);
+#endif
+
+  (ptr->handler)(fd, event, ptr->arg);
+
+#ifdef FEAT_SCHEDSTATS
+  update_handler_stats(stats_index, &start);
+#endif
+}
+
+/* ================================================== */
+
 /* nfd is the number of bits set in all fd_sets */
 
 static void
 dispatch_filehandlers(int nfd, fd_set *read_fds, fd_set *write_fds, fd_set *except_fds)
 {
-  FileHandlerEntry *ptr;
   int fd;
   
   for (fd = 0; nfd && fd < one_highest_fd; fd++) {
     if (except_fds && FD_ISSET(fd, except_fds)) {
       /* This descriptor has an exception, dispatch its handler */
-      ptr = (FileHandlerEntry *)ARR_GetElement(file_handlers, fd);
-      if (ptr->handler)
-        (ptr->handler)(fd, SCH_FILE_EXCEPTION, ptr->arg);
+      dispatch_filehandler(fd, SCH_FILE_EXCEPTION);
       nfd--;
 
       /* Don't try to read from it now */
@@ -574,17 +806,13 @@ dispatch_filehandlers(int nfd, fd_set *read_fds, fd_set *write_fds, fd_set *exce
 
     if (read_fds && FD_ISSET(fd, read_fds)) {
       /* This descriptor can be read from, dispatch its handler */
-      ptr = (FileHandlerEntry *)ARR_GetElement(file_handlers, fd);
-      if (ptr->handler)
-        (ptr->handler)(fd, SCH_FILE_INPUT, ptr->arg);
+      dispatch_filehandler(fd, SCH_FILE_INPUT);
       nfd--;
     }
 
     if (write_fds && FD_ISSET(fd, write_fds)) {
       /* This descriptor can be written to, dispatch its handler */
-      ptr = (FileHandlerEntry *)ARR_GetElement(file_handlers, fd);
-      if (ptr->handler)
-        (ptr->handler)(fd, SCH_FILE_OUTPUT, ptr->arg);
+      dispatch_filehandler(fd, SCH_FILE_OUTPUT);
       nfd--;
     }
   }
@@ -767,6 +995,12 @@ SCH_MainLoop(void)
   struct timeval tv, saved_tv, *ptv;
   struct timespec ts, now, saved_now, cooked;
   double err;
+#ifdef FEAT_SCHEDSTATS
+  struct timespec busy_start, select_start;
+  double elapsed;
+
+  read_stats_time(&busy_start);
+#endif
 
   assert(initialised);
 
@@ -802,9 +1036,23 @@ SCH_MainLoop(void)
     if (!ptv && !p_read_fds && !p_write_fds)
       LOG_FATAL("Nothing to do");
 
+#ifdef FEAT_SCHEDSTATS
+    read_stats_time(&select_start);
+    elapsed = UTI_DiffTimespecsToDouble(&select_start, &busy_start);
+    loop_iterations++;
+    loop_busy_time += elapsed;
+    if (loop_max_busy_time < elapsed)
+      loop_max_busy_time = elapsed;
+#endif
+
     status = select(one_highest_fd, p_read_fds, p_write_fds, p_except_fds, ptv);
     errsv = errno;
 
+#ifdef FEAT_SCHEDSTATS
+    read_stats_time(&busy_start);
+    loop_blocked_time += UTI_DiffTimespecsToDouble(&busy_start, &select_start);
+#endif
+
     LCL_ReadRawTime(&now);
     LCL_CookTime(&now, &cooked, &err);
 
@@ -850,3 +1098,61 @@ SCH_QuitProgram(void)
 
 /* ================================================== */
 
+int
+SCH_GetStatsReport(RPT_SchedStatsReport *report, int reset)
+{
+#ifdef FEAT_SCHEDSTATS
+  if (report) {
+    report->iterations = loop_iterations;
+    report->blocked_time = loop_blocked_time;
+    report->busy_time = loop_busy_time;
+    report->max_busy_time = loop_max_busy_time;
+    report->n_handlers = ARR_GetSize(handler_stats);
+  }
+
+  if (reset) {
+    loop_iterations = 0;
+    loop_blocked_time = 0.0;
+    loop_busy_time = 0.0;
+    loop_max_busy_time = 0.0;
+  }
+
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/* ================================================== */
+
+int
+SCH_GetHandlerStatsReport(int index, RPT_SchedHandlerReport *report, int reset)
+{
+#ifdef FEAT_SCHEDSTATS
+  HandlerStats *stats;
+
+  if (index < 0 || index >= ARR_GetSize(handler_stats))
+    return 0;
+
+  stats = ARR_GetElement(handler_stats, index);
+
+  snprintf(report->name, sizeof (report->name), "%s", stats->name ? stats->name : "?");
+  report->type = stats->timeout_handler ? RPT_SCH_TIMEOUT : RPT_SCH_FILE;
+  report->calls = stats->calls;
+  report->total_time = stats->total_time;
+  report->max_time = stats->max_time;
+
+  if (reset) {
+    stats->calls = 0;
+    stats->total_time = 0.0;
+    stats->max_time = 0.0;
+  }
+
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/* ================================================== */
+
@@ -28,6 +28,7 @@
 #define GOT_SCHED_H
 
 #include "sysincl.h"
+#include "reports.h"
 
 /* Type for timeout IDs, valid IDs are always greater than zero */
 typedef unsigned int SCH_TimeoutID;
@@ -89,4 +90,34 @@ extern void SCH_MainLoop(void);
 
 extern void SCH_QuitProgram(void);
 
+/* Get statistics of the main loop and its handlers, optionally resetting
+   them.  The functions return zero if chronyd was compiled without support
+   for the statistics. */
+extern int SCH_GetStatsReport(RPT_SchedStatsReport *report, int reset);
+extern int SCH_GetHandlerStatsReport(int index, RPT_SchedHandlerReport *report, int reset);
+
+#ifdef FEAT_SCHEDSTATS
+/* With the statistics enabled, the handlers are registered together with
+   the name of their function */
+extern void SCH_AddNamedFileHandler(int fd, int events, SCH_FileHandler handler,
+                                    SCH_ArbitraryArgument arg, const char *name);
+extern SCH_TimeoutID SCH_AddNamedTimeout(struct timespec *ts, SCH_TimeoutHandler handler,
+                                         SCH_ArbitraryArgument arg, const char *name);
+extern SCH_TimeoutID SCH_AddNamedTimeoutByDelay(double delay, SCH_TimeoutHandler handler,
+                                                SCH_ArbitraryArgument arg, const char *name);
+extern SCH_TimeoutID SCH_AddNamedTimeoutInClass(double min_delay, double separation,
+                                                double randomness, SCH_TimeoutClass class,
+                                                SCH_TimeoutHandler handler,
+                                                SCH_ArbitraryArgument arg, const char *name);
+
+#define SCH_AddFileHandler(fd, events, handler, arg) \
+  SCH_AddNamedFileHandler(fd, events, handler, arg, #handler)
+#define SCH_AddTimeout(ts, handler, arg) \
+  SCH_AddNamedTimeout(ts, handler, arg, #handler)
+#define SCH_AddTimeoutByDelay(delay, handler, arg) \
+  SCH_AddNamedTimeoutByDelay(delay, handler, arg, #handler)
+#define SCH_AddTimeoutInClass(min_delay, separation, randomness, class, handler, arg) \
+  SCH_AddNamedTimeoutInClass(min_delay, separation, randomness, class, handler, arg, #handler)
+#endif
+
 #endif /* GOT_SCHED_H */
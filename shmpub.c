@@ -0,0 +1,243 @@
+/*
+  chronyd/chronyc - Programs for keeping computer clocks accurate.
+
+ **********************************************************************
+ * Copyright (C) Miroslav Lichvar  2026
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * 
+ **********************************************************************
+
+  =======================================================================
+
+  Publishing of the reference and the correction of the system clock in
+  a file mapped to memory (see timeshm.h for the format), which allows
+  other applications to get the time estimated by chronyd without making
+  requests.
+
+  */
+
+#include "config.h"
+
+#include "sysincl.h"
+
+#include "conf.h"
+#include "local.h"
+#include "logging.h"
+#include "reference.h"
+#include "sched.h"
+#include "shmpub.h"
+#include "smooth.h"
+#include "timeshm.h"
+#include "util.h"
+
+/* Interval of updates when time smoothing is enabled to keep its linear
+   approximation close to the actual offset */
+#define SMOOTHING_UPDATE_INTERVAL 1.0
+
+static char *filename;
+static TSM_Segment *segment;
+static SCH_TimeoutID timeout_id;
+
+/* ================================================== */
+
+static void
+convert_timespec(struct timespec *ts, TSM_Timespec *tsm_ts)
+{
+  tsm_ts->sec = ts->tv_sec;
+  tsm_ts->nsec = ts->tv_nsec;
+  tsm_ts->_pad = 0;
+}
+
+/* ================================================== */
+
+static void
+get_data(TSM_Segment *data)
+{
+  double root_delay, root_dispersion;
+  RPT_SmoothingReport smoothing;
+  RPT_TrackingReport tracking;
+  struct timespec now, ref_time;
+  int synchronised, stratum;
+  LCL_CookingModel model;
+  NTP_Leap leap;
+  uint32_t ref_id;
+
+  memset(data, 0, sizeof (*data));
+
+  LCL_ReadCookedTime(&now, NULL);
+  REF_GetReferenceParams(&now, &synchronised, &leap, &stratum, &ref_id, &ref_time,
+                         &root_delay, &root_dispersion);
+  REF_GetTrackingReport(&tracking);
+
+  if (synchronised)
+    data->flags |= TSM_FLAG_SYNCHRONISED;
+  data->leap = leap;
+  data->stratum = stratum;
+  data->ref_id = ref_id;
+  convert_timespec(&ref_time, &data->ref_time);
+  data->last_offset = tracking.last_offset;
+  data->rms_offset = tracking.rms_offset;
+  data->freq_ppm = tracking.freq_ppm;
+  data->resid_freq_ppm = tracking.resid_freq_ppm;
+  data->skew_ppm = tracking.skew_ppm;
+  data->root_delay = root_delay;
+  data->root_dispersion = root_dispersion;
+  data->dispersion_rate = synchronised ? 1.0e-6 * (tracking.skew_ppm +
+                                                   fabs(tracking.resid_freq_ppm)) +
+                                         LCL_GetMaxClockError() : 0.0;
+  convert_timespec(&now, &data->update_time);
+
+  if (SMT_GetSmoothingReport(&smoothing, &now) && smoothing.active) {
+    data->flags |= TSM_FLAG_SMOOTHING;
+    data->smooth_offset = smoothing.offset;
+    data->smooth_rate = 1.0e-6 * smoothing.freq_ppm;
+  }
+
+  if (LCL_GetCookingModel(&model)) {
+    data->flags |= TSM_FLAG_MODEL_VALID;
+    convert_timespec(&model.ref, &data->model_ref);
+    data->model_offset = model.offset;
+    data->model_rate = model.rate;
+    data->model_err = model.err;
+    data->model_err_interval = model.err_interval;
+    data->model_valid_interval = model.valid_interval;
+  }
+}
+
+/* ================================================== */
+
+static void
+write_data(TSM_Segment *data)
+{
+  uint32_t sequence;
+  size_t offset;
+
+  /* Copy everything after the sequence number with the number odd */
+  offset = offsetof(TSM_Segment, flags);
+  sequence = segment->sequence;
+
+  __atomic_store_n(&segment->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  memcpy((char *)segment + offset, (char *)data + offset, sizeof (*segment) - offset);
+
+  __atomic_store_n(&segment->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+/* ================================================== */
+
+static void
+update_segment(void)
+{
+  TSM_Segment data;
+
+  if (!segment)
+    return;
+
+  get_data(&data);
+  write_data(&data);
+}
+
+/* ================================================== */
+
+static void
+handle_model_change(void *anything)
+{
+  update_segment();
+}
+
+/* ================================================== */
+
+static void
+update_timeout(void *arg)
+{
+  timeout_id = SCH_AddTimeoutByDelay(SMOOTHING_UPDATE_INTERVAL, update_timeout, NULL);
+  update_segment();
+}
+
+/* ================================================== */
+
+void
+SHP_Initialise(void)
+{
+  int fd;
+
+  segment = NULL;
+  timeout_id = 0;
+
+  filename = CNF_GetTimeShmFile();
+  if (!filename)
+    return;
+
+  UTI_RemoveFile(NULL, filename, NULL);
+
+  fd = open(filename, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0)
+    LOG_FATAL("Could not open %s : %s", filename, strerror(errno));
+
+  if (ftruncate(fd, sizeof (*segment)) < 0)
+    LOG_FATAL("Could not resize %s : %s", filename, strerror(errno));
+
+  segment = mmap(NULL, sizeof (*segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (segment == MAP_FAILED)
+    LOG_FATAL("Could not map %s : %s", filename, strerror(errno));
+
+  close(fd);
+
+  segment->magic = TSM_MAGIC;
+  segment->version = TSM_VERSION;
+  segment->size = sizeof (*segment);
+  segment->sequence = 0;
+
+  LCL_SetCookingModelHandler(handle_model_change, NULL);
+
+  if (SMT_IsEnabled())
+    timeout_id = SCH_AddTimeoutByDelay(SMOOTHING_UPDATE_INTERVAL, update_timeout, NULL);
+
+  update_segment();
+}
+
+/* ================================================== */
+
+void
+SHP_Finalise(void)
+{
+  TSM_Segment data;
+
+  if (!segment)
+    return;
+
+  LCL_SetCookingModelHandler(NULL, NULL);
+  SCH_RemoveTimeout(timeout_id);
+
+  /* Leave the mapped segment invalid for readers which don't check
+     the file */
+  memset(&data, 0, sizeof (data));
+  data.leap = TSM_LEAP_UNSYNCHRONISED;
+  write_data(&data);
+
+  munmap(segment, sizeof (*segment));
+  segment = NULL;
+
+  UTI_RemoveFile(NULL, filename, NULL);
+}
+
+/* ================================================== */
+
+void
+SHP_Update(void)
+{
+  update_segment();
+}
@@ -36,6 +36,10 @@
 #include <linux/net_tstamp.h>
 #endif
 
+#ifdef LINUX
+#include <linux/filter.h>
+#endif
+
 #include "socket.h"
 #include "array.h"
 #include "logging.h"
@@ -700,7 +704,7 @@ log_message(int sock_fd, int direction, SCK_Message *message, const char *prefix
             remote_addr ? remote_addr : "",
             local_addr ? (direction > 0 ? " to " : " from ") : "",
             local_addr ? local_addr : "",
-            sock_fd, message->length, if_index,
+            sock_fd, message->header_length + message->length, if_index,
             tss, tsif, tslen,
             error ? " : " : "", error ? error : "");
 }
@@ -735,6 +739,8 @@ init_message_nonaddress(SCK_Message *message)
 {
   message->data = NULL;
   message->length = 0;
+  message->header = NULL;
+  message->header_length = 0;
   message->if_index = INVALID_IF_INDEX;
 
   UTI_ZeroTimespec(&message->timestamp.kernel);
@@ -742,6 +748,7 @@ init_message_nonaddress(SCK_Message *message)
   message->timestamp.if_index = INVALID_IF_INDEX;
   message->timestamp.l2_length = 0;
   message->timestamp.tx_flags = 0;
+  message->timestamp.id = 0;
 
   message->descriptor = INVALID_SOCK_FD;
 }
@@ -900,6 +907,9 @@ process_header(struct msghdr *msg, int msg_length, int sock_fd, int flags,
         log_message(sock_fd, 1, message, "Unexpected extended error in", NULL);
         r = 0;
       }
+
+      /* Save the ID of the timestamp (if enabled by SOF_TIMESTAMPING_OPT_ID) */
+      message->timestamp.id = err.ee_data;
     }
 #endif
     else if (match_cmsg(cmsg, SOL_SOCKET, SCM_RIGHTS, 0)) {
@@ -1036,7 +1046,7 @@ send_message(int sock_fd, SCK_Message *message, int flags)
   union sockaddr_all saddr;
   socklen_t saddr_len;
   struct msghdr msg;
-  struct iovec iov;
+  struct iovec iov[2];
 
   switch (message->addr_type) {
     case SCK_ADDR_UNSPEC:
@@ -1068,15 +1078,23 @@ send_message(int sock_fd, SCK_Message *message, int flags)
     msg.msg_namelen = 0;
   }
 
-  if (message->length < 0) {
+  if (message->length < 0 || message->header_length < 0) {
     DEBUG_LOG("Invalid length %d", message->length);
     return 0;
   }
 
-  iov.iov_base = message->data;
-  iov.iov_len = message->length;
-  msg.msg_iov = &iov;
-  msg.msg_iovlen = 1;
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 0;
+
+  if (message->header_length > 0) {
+    iov[msg.msg_iovlen].iov_base = message->header;
+    iov[msg.msg_iovlen].iov_len = message->header_length;
+    msg.msg_iovlen++;
+  }
+
+  iov[msg.msg_iovlen].iov_base = message->data;
+  iov[msg.msg_iovlen].iov_len = message->length;
+  msg.msg_iovlen++;
   msg.msg_control = cmsg_buf;
   msg.msg_controllen = 0;
   msg.msg_flags = 0;
@@ -1395,6 +1413,36 @@ SCK_EnableKernelRxTimestamping(int sock_fd)
 
 /* ================================================== */
 
+int
+SCK_EnableCpuSteering(int sock_fd, int sockets)
+{
+#if defined(LINUX) && defined(SO_ATTACH_REUSEPORT_CBPF)
+  /* Select the socket by the CPU which received the packet, modulo the
+     number of sockets in the group */
+  struct sock_filter code[] = {
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU),
+    BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, sockets),
+    BPF_STMT(BPF_RET | BPF_A, 0)
+  };
+  struct sock_fprog program = { sizeof (code) / sizeof (code[0]), code };
+
+  if (sockets < 1)
+    return 0;
+
+  if (setsockopt(sock_fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                 &program, sizeof (program)) < 0) {
+    DEBUG_LOG("setsockopt() failed fd=%d : %s", sock_fd, strerror(errno));
+    return 0;
+  }
+
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/* ================================================== */
+
 int
 SCK_ListenOnSocket(int sock_fd, int backlog)
 {
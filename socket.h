@@ -50,6 +50,12 @@ typedef enum {
 typedef struct {
   void *data;
   int length;
+
+  /* Optional header sent before the data without copying (ignored
+     in received messages) */
+  void *header;
+  int header_length;
+
   SCK_AddressType addr_type;
   int if_index;
 
@@ -68,6 +74,7 @@ typedef struct {
     int if_index;
     int l2_length;
     int tx_flags;
+    uint32_t id;
   } timestamp;
 
   int descriptor;
@@ -113,6 +120,10 @@ extern int SCK_GetIntOption(int sock_fd, int level, int name, int *value);
 /* Enable RX timestamping socket option */
 extern int SCK_EnableKernelRxTimestamping(int sock_fd);
 
+/* Make the kernel select the socket receiving a packet in a group of sockets
+   sharing a port (SO_REUSEPORT) by the CPU which processed the packet */
+extern int SCK_EnableCpuSteering(int sock_fd, int sockets);
+
 /* Operate on a stream socket - listen()/accept()/shutdown() wrappers */
 extern int SCK_ListenOnSocket(int sock_fd, int backlog);
 extern int SCK_AcceptConnection(int sock_fd, IPSockAddr *remote_addr);
@@ -46,6 +46,7 @@
 #include "nameserv.h"
 #include "sched.h"
 #include "regress.h"
+#include "usdt.h"
 
 /* ================================================== */
 /* Flag indicating that we are initialised */
@@ -140,6 +141,9 @@ struct SRC_Instance_Record {
 
   /* Flag indicating the source has a leap second vote */
   int leap_vote;
+
+  /* Flag indicating the source has endpoints in the sort list */
+  int sort_endpoints;
 };
 
 /* ================================================== */
@@ -157,10 +161,26 @@ struct Sort_Element {
 /* Table of sources */
 static struct SRC_Instance_Record **sources;
 static struct Sort_Element *sort_list;
+static int n_sort_endpoints; /* Number of endpoints kept in the sort list
+                                from the last selection */
 static int *sel_sources;
+/* Statistics of the sources and their data for batched requests */
+static SST_Stats *sel_stats;
+static SST_SelectionData *sel_data;
+static SST_TrackingData *tracking_data;
 static int n_sources; /* Number of sources currently in the table */
 static int max_n_sources; /* Capacity of the table */
 
+/* Numbers of authenticated and unauthenticated NTP sources which are not
+   configured with the noselect option */
+static int n_auth_ntp_sources;
+static int n_unauth_ntp_sources;
+
+/* Selection options added to sources to follow the authselectmode */
+static int auth_ntp_options;
+static int unauth_ntp_options;
+static int refclk_options;
+
 #define INVALID_SOURCE (-1)
 static int selected_source_index; /* Which source index is currently
                                      selected (set to INVALID_SOURCE
@@ -172,6 +192,10 @@ static int selected_source_index; /* Which source index is currently
 /* Number of updates needed to reset the distant status */
 #define DISTANT_PENALTY 32
 
+/* Maximum number of new endpoints in the kept sort list to use insertion
+   sort instead of qsort */
+#define MAX_NEW_SORT_ENDPOINTS 16
+
 static double max_distance;
 static double max_jitter;
 static double reselect_distance;
@@ -184,11 +208,13 @@ static double combine_limit;
 /* ================================================== */
 /* Forward prototype */
 
-static void update_sel_options(void);
+static void count_sel_source(SRC_Instance inst, int change);
+static void update_sel_options(SRC_Instance inst);
 static void slew_sources(struct timespec *raw, struct timespec *cooked, double dfreq,
                          double doffset, LCL_ChangeType change_type, void *anything);
 static void add_dispersion(double dispersion, void *anything);
 static char *source_to_string(SRC_Instance inst);
+static void mark_source(SRC_Instance inst, SRC_Status status);
 static char get_status_char(SRC_Status status);
 
 /* ================================================== */
@@ -196,9 +222,15 @@ static char get_status_char(SRC_Status status);
 void SRC_Initialise(void) {
   sources = NULL;
   sort_list = NULL;
+  n_sort_endpoints = 0;
   sel_sources = NULL;
+  sel_stats = NULL;
+  sel_data = NULL;
+  tracking_data = NULL;
   n_sources = 0;
   max_n_sources = 0;
+  n_auth_ntp_sources = n_unauth_ntp_sources = 0;
+  auth_ntp_options = unauth_ntp_options = refclk_options = 0;
   selected_source_index = INVALID_SOURCE;
   max_distance = CNF_GetMaxDistance();
   max_jitter = CNF_GetMaxJitter();
@@ -221,6 +253,9 @@ void SRC_Finalise(void)
   Free(sources);
   Free(sort_list);
   Free(sel_sources);
+  Free(sel_stats);
+  Free(sel_data);
+  Free(tracking_data);
 
   initialised = 0;
 }
@@ -242,6 +277,12 @@ SRC_Instance SRC_CreateNewInstance(uint32_t ref_id, SRC_Type type, int authentic
   if (max_samples == SRC_DEFAULT_MAXSAMPLES)
     max_samples = CNF_GetMaxSamples();
 
+  /* Monitor-only sources are never selected and keep only the last sample */
+  if (sel_options & SRC_SELECT_MONITOR) {
+    sel_options |= SRC_SELECT_NOSELECT;
+    min_samples = max_samples = 1;
+  }
+
   result = MallocNew(struct SRC_Instance_Record);
   result->stats = SST_CreateInstance(ref_id, addr, min_samples, max_samples,
                                      min_delay, asymmetry);
@@ -253,10 +294,16 @@ SRC_Instance SRC_CreateNewInstance(uint32_t ref_id, SRC_Type type, int authentic
       sources = ReallocArray(struct SRC_Instance_Record *, max_n_sources, sources);
       sort_list = ReallocArray(struct Sort_Element, 3*max_n_sources, sort_list);
       sel_sources = ReallocArray(int, max_n_sources, sel_sources);
+      sel_stats = ReallocArray(SST_Stats, max_n_sources, sel_stats);
+      sel_data = ReallocArray(SST_SelectionData, max_n_sources, sel_data);
+      tracking_data = ReallocArray(SST_TrackingData, max_n_sources, tracking_data);
     } else {
       sources = MallocArray(struct SRC_Instance_Record *, max_n_sources);
       sort_list = MallocArray(struct Sort_Element, 3*max_n_sources);
       sel_sources = MallocArray(int, max_n_sources);
+      sel_stats = MallocArray(SST_Stats, max_n_sources);
+      sel_data = MallocArray(SST_SelectionData, max_n_sources);
+      tracking_data = MallocArray(SST_TrackingData, max_n_sources);
     }
   }
 
@@ -274,7 +321,8 @@ SRC_Instance SRC_CreateNewInstance(uint32_t ref_id, SRC_Type type, int authentic
 
   n_sources++;
 
-  update_sel_options();
+  count_sel_source(result, 1);
+  update_sel_options(result);
 
   return result;
 }
@@ -291,6 +339,8 @@ void SRC_DestroyInstance(SRC_Instance instance)
 
   assert(initialised);
 
+  count_sel_source(instance, -1);
+
   SST_DeleteInstance(instance->stats);
   dead_index = instance->index;
   for (i=dead_index; i<n_sources-1; i++) {
@@ -300,7 +350,10 @@ void SRC_DestroyInstance(SRC_Instance instance)
   --n_sources;
   Free(instance);
 
-  update_sel_options();
+  /* The indices in the sort list are no longer valid */
+  n_sort_endpoints = 0;
+
+  update_sel_options(NULL);
 
   /* If this was the previous reference source, we have to reselect! */
   if (selected_source_index == dead_index)
@@ -418,6 +471,13 @@ SRC_AccumulateSample(SRC_Instance inst, NTP_Sample *sample)
   }
 
   SST_AccumulateSample(inst->stats, sample);
+
+  /* Monitor-only sources don't need the regression */
+  if (inst->conf_sel_options & SRC_SELECT_MONITOR) {
+    mark_source(inst, SRC_UNSELECTABLE);
+    return;
+  }
+
   SST_DoNewRegression(inst->stats);
 }
 
@@ -505,25 +565,58 @@ SRC_ResetReachability(SRC_Instance inst)
 /* ================================================== */
 
 static void
-update_sel_options(void)
+count_sel_source(SRC_Instance inst, int change)
+{
+  if (inst->conf_sel_options & SRC_SELECT_NOSELECT || inst->type != SRC_NTP)
+    return;
+
+  if (inst->authenticated)
+    n_auth_ntp_sources += change;
+  else
+    n_unauth_ntp_sources += change;
+}
+
+/* ================================================== */
+
+static void
+update_source_sel_options(SRC_Instance inst)
 {
-  int options, auth_ntp_options, unauth_ntp_options, refclk_options;
-  int i, auth_ntp_sources, unauth_ntp_sources;
+  int options;
 
-  auth_ntp_sources = unauth_ntp_sources = 0;
+  options = inst->conf_sel_options;
 
-  for (i = 0; i < n_sources; i++) {
-    if (sources[i]->conf_sel_options & SRC_SELECT_NOSELECT)
-      continue;
-    if (sources[i]->type != SRC_NTP)
-      continue;
-    if (sources[i]->authenticated)
-      auth_ntp_sources++;
-    else
-      unauth_ntp_sources++;
+  if (options & SRC_SELECT_NOSELECT)
+    return;
+
+  switch (inst->type) {
+    case SRC_NTP:
+      options |= inst->authenticated ? auth_ntp_options : unauth_ntp_options;
+      break;
+    case SRC_REFCLOCK:
+      options |= refclk_options;
+      break;
+    default:
+      assert(0);
   }
 
-  auth_ntp_options = unauth_ntp_options = refclk_options = 0;
+  if (inst->sel_options != options) {
+    DEBUG_LOG("changing %s from %x to %x", source_to_string(inst),
+              (unsigned int)inst->sel_options, (unsigned int)options);
+    inst->sel_options = options;
+  }
+}
+
+/* ================================================== */
+/* Update the selection options of sources after a source was added (inst)
+   or removed (NULL).  All sources need to be updated only if the added
+   options changed. */
+
+static void
+update_sel_options(SRC_Instance inst)
+{
+  int new_auth_ntp_options, new_unauth_ntp_options, new_refclk_options, i;
+
+  new_auth_ntp_options = new_unauth_ntp_options = new_refclk_options = 0;
 
   /* Determine which selection options need to be added to authenticated NTP
      sources, unauthenticated NTP sources, and refclocks, to follow the
@@ -532,43 +625,34 @@ update_sel_options(void)
     case SRC_AUTHSELECT_IGNORE:
       break;
     case SRC_AUTHSELECT_MIX:
-      if (auth_ntp_sources > 0 && unauth_ntp_sources > 0)
-        auth_ntp_options = refclk_options = SRC_SELECT_REQUIRE | SRC_SELECT_TRUST;
+      if (n_auth_ntp_sources > 0 && n_unauth_ntp_sources > 0)
+        new_auth_ntp_options = new_refclk_options = SRC_SELECT_REQUIRE | SRC_SELECT_TRUST;
       break;
     case SRC_AUTHSELECT_PREFER:
-      if (auth_ntp_sources > 0)
-        unauth_ntp_options = SRC_SELECT_NOSELECT;
+      if (n_auth_ntp_sources > 0)
+        new_unauth_ntp_options = SRC_SELECT_NOSELECT;
       break;
     case SRC_AUTHSELECT_REQUIRE:
-      unauth_ntp_options = SRC_SELECT_NOSELECT;
+      new_unauth_ntp_options = SRC_SELECT_NOSELECT;
       break;
     default:
       assert(0);
   }
 
-  for (i = 0; i < n_sources; i++) {
-    options = sources[i]->conf_sel_options;
+  if (new_auth_ntp_options == auth_ntp_options &&
+      new_unauth_ntp_options == unauth_ntp_options &&
+      new_refclk_options == refclk_options) {
+    if (inst)
+      update_source_sel_options(inst);
+    return;
+  }
 
-    if (options & SRC_SELECT_NOSELECT)
-      continue;
+  auth_ntp_options = new_auth_ntp_options;
+  unauth_ntp_options = new_unauth_ntp_options;
+  refclk_options = new_refclk_options;
 
-    switch (sources[i]->type) {
-      case SRC_NTP:
-        options |= sources[i]->authenticated ? auth_ntp_options : unauth_ntp_options;
-        break;
-      case SRC_REFCLOCK:
-        options |= refclk_options;
-        break;
-      default:
-        assert(0);
-    }
-
-    if (sources[i]->sel_options != options) {
-      DEBUG_LOG("changing %s from %x to %x", source_to_string(sources[i]),
-                (unsigned int)sources[i]->sel_options, (unsigned int)options);
-      sources[i]->sel_options = options;
-    }
-  }
+  for (i = 0; i < n_sources; i++)
+    update_source_sel_options(sources[i]);
 }
 
 /* ================================================== */
@@ -671,9 +755,8 @@ static int
 combine_sources(int n_sel_sources, struct timespec *ref_time, double *offset,
                 double *offset_sd, double *frequency, double *frequency_sd, double *skew)
 {
-  struct timespec src_ref_time;
   double src_offset, src_offset_sd, src_frequency, src_frequency_sd, src_skew;
-  double src_root_delay, src_root_dispersion, sel_src_distance, elapsed;
+  double sel_src_distance, elapsed;
   double offset_weight, sum_offset_weight, sum_offset, sum2_offset_sd;
   double frequency_weight, sum_frequency_weight, sum_frequency;
   double inv_sum2_frequency_sd, inv_sum2_skew;
@@ -689,12 +772,18 @@ combine_sources(int n_sel_sources, struct timespec *ref_time, double *offset,
   if (sources[selected_source_index]->type == SRC_NTP)
     sel_src_distance += reselect_distance;
 
+  /* Get the tracking data of all selected sources in one pass */
+  for (i = 0; i < n_sel_sources; i++)
+    sel_stats[i] = sources[sel_sources[i]]->stats;
+  SST_GetTrackingDataBatch(sel_stats, n_sel_sources, tracking_data);
+
   for (i = combined = 0; i < n_sel_sources; i++) {
     index = sel_sources[i];
-    SST_GetTrackingData(sources[index]->stats, &src_ref_time,
-                        &src_offset, &src_offset_sd,
-                        &src_frequency, &src_frequency_sd, &src_skew,
-                        &src_root_delay, &src_root_dispersion);
+    src_offset = tracking_data[i].average_offset;
+    src_offset_sd = tracking_data[i].offset_sd;
+    src_frequency = tracking_data[i].frequency;
+    src_frequency_sd = tracking_data[i].frequency_sd;
+    src_skew = tracking_data[i].skew;
 
     /* Don't include this source if its distance is longer than the distance of
        the selected source multiplied by the limit, their estimated frequencies
@@ -719,7 +808,7 @@ combine_sources(int n_sel_sources, struct timespec *ref_time, double *offset,
     if (sources[index]->status == SRC_OK)
       mark_source(sources[index], SRC_UNSELECTED);
 
-    elapsed = UTI_DiffTimespecsToDouble(ref_time, &src_ref_time);
+    elapsed = UTI_DiffTimespecsToDouble(ref_time, &tracking_data[i].ref_time);
     src_offset += elapsed * src_frequency;
     src_offset_sd += elapsed * src_frequency_sd;
     offset_weight = 1.0 / sources[index]->sel_info.root_distance;
@@ -755,16 +844,44 @@ combine_sources(int n_sel_sources, struct timespec *ref_time, double *offset,
   return combined;
 }
 
+/* ================================================== */
+/* Sort the endpoints.  The list is kept between selections, so only
+   the endpoints of new sources and sources which changed their order
+   need to be moved, unless there are many new endpoints. */
+
+static void
+sort_endpoints(int n_endpoints, int n_new_endpoints)
+{
+  struct Sort_Element e;
+  int i, j;
+
+  if (n_new_endpoints > MAX_NEW_SORT_ENDPOINTS) {
+    qsort((void *) sort_list, n_endpoints, sizeof(struct Sort_Element), compare_sort_elements);
+    return;
+  }
+
+  for (i = 1; i < n_endpoints; i++) {
+    if (compare_sort_elements(&sort_list[i - 1], &sort_list[i]) <= 0)
+      continue;
+
+    e = sort_list[i];
+    for (j = i; j > 0 && compare_sort_elements(&sort_list[j - 1], &e) > 0; j--)
+      sort_list[j] = sort_list[j - 1];
+    sort_list[j] = e;
+  }
+}
+
 /* ================================================== */
 /* This function selects the current reference from amongst the pool
    of sources we are holding and updates the local reference */
 
-void
-SRC_SelectSource(SRC_Instance updated_inst)
+static void
+select_source(SRC_Instance updated_inst)
 {
   struct SelectInfo *si;
   struct timespec now, ref_time;
-  int i, j, j1, j2, index, sel_prefer, n_endpoints, n_sel_sources, sel_req_source;
+  int i, j, j1, j2, index, sel_prefer, n_endpoints, n_new_endpoints;
+  int n_sel_data, n_sel_sources, sel_req_source;
   int n_badstats_sources, max_sel_reach, max_sel_reach_size, max_badstat_reach;
   int depth, best_depth, trust_depth, best_trust_depth, n_sel_trust_sources;
   int combined, stratum, min_stratum, max_score_index;
@@ -794,7 +911,7 @@ SRC_SelectSource(SRC_Instance updated_inst)
   /* Step 1 - build intervals about each source */
 
   n_endpoints = 0;
-  n_sel_sources = n_sel_trust_sources = 0;
+  n_sel_data = n_sel_sources = n_sel_trust_sources = 0;
   n_badstats_sources = 0;
   sel_req_source = 0;
   max_sel_reach = max_badstat_reach = 0;
@@ -807,6 +924,15 @@ SRC_SelectSource(SRC_Instance updated_inst)
     /* Don't allow the source to vote on leap seconds unless it's selectable */
     sources[i]->leap_vote = 0;
 
+    sources[i]->sort_endpoints = 0;
+
+    /* Monitor-only sources don't take part in the selection at all, not even
+       through the require option */
+    if (sources[i]->conf_sel_options & SRC_SELECT_MONITOR) {
+      mark_source(sources[i], SRC_UNSELECTABLE);
+      continue;
+    }
+
     /* If some sources are specified with the require option, at least one
        of them will have to be selectable in order to update the clock */
     if (sources[i]->sel_options & SRC_SELECT_REQUIRE)
@@ -824,11 +950,25 @@ SRC_SelectSource(SRC_Instance updated_inst)
       continue;
     }
 
+    sel_sources[n_sel_data] = i;
+    sel_stats[n_sel_data] = sources[i]->stats;
+    n_sel_data++;
+  }
+
+  /* Get the selection data of the remaining sources in one pass */
+  SST_GetSelectionDataBatch(sel_stats, n_sel_data, &now, sel_data);
+
+  for (j = 0; j < n_sel_data; j++) {
+    i = sel_sources[j];
+
     si = &sources[i]->sel_info;
-    SST_GetSelectionData(sources[i]->stats, &now,
-                         &si->lo_limit, &si->hi_limit, &si->root_distance,
-                         &si->std_dev, &first_sample_ago,
-                         &si->last_sample_ago, &si->select_ok);
+    si->lo_limit = sel_data[j].lo_limit;
+    si->hi_limit = sel_data[j].hi_limit;
+    si->root_distance = sel_data[j].root_distance;
+    si->std_dev = sel_data[j].std_dev;
+    si->last_sample_ago = sel_data[j].last_sample_ago;
+    si->select_ok = sel_data[j].select_ok;
+    first_sample_ago = sel_data[j].first_sample_ago;
 
     if (!si->select_ok) {
       ++n_badstats_sources;
@@ -934,6 +1074,22 @@ SRC_SelectSource(SRC_Instance updated_inst)
     }
   }
 
+  /* Update the endpoints of sources which are still selectable in the list
+     from the last selection, which is likely to be nearly sorted */
+  for (i = 0; i < n_sort_endpoints; i++) {
+    index = sort_list[i].index;
+    if (sources[index]->status != SRC_OK)
+      continue;
+
+    si = &sources[index]->sel_info;
+    sort_list[n_endpoints] = sort_list[i];
+    sort_list[n_endpoints].offset = sort_list[i].tag == LOW ? si->lo_limit : si->hi_limit;
+    sources[index]->sort_endpoints = 1;
+    n_endpoints++;
+  }
+
+  n_new_endpoints = 0;
+
   for (i = 0; i < n_sources; i++) {
     if (sources[i]->status != SRC_OK)
       continue;
@@ -941,6 +1097,9 @@ SRC_SelectSource(SRC_Instance updated_inst)
     if (sources[i]->sel_options & SRC_SELECT_TRUST)
       n_sel_trust_sources++;
 
+    if (sources[i]->sort_endpoints)
+      continue;
+
     si = &sources[i]->sel_info;
 
     j1 = n_endpoints;
@@ -955,8 +1114,11 @@ SRC_SelectSource(SRC_Instance updated_inst)
     sort_list[j2].tag = HIGH;
 
     n_endpoints += 2;
+    n_new_endpoints += 2;
   }
 
+  n_sort_endpoints = n_endpoints;
+
   DEBUG_LOG("badstat=%d sel=%d badstat_reach=%o sel_reach=%o size=%d max_reach_ago=%f",
             n_badstats_sources, n_sel_sources, (unsigned int)max_badstat_reach,
             (unsigned int)max_sel_reach, max_sel_reach_size, max_reach_sample_ago);
@@ -982,7 +1144,7 @@ SRC_SelectSource(SRC_Instance updated_inst)
   }
 
   /* Now sort the endpoint list */
-  qsort((void *) sort_list, n_endpoints, sizeof(struct Sort_Element), compare_sort_elements);
+  sort_endpoints(n_endpoints, n_new_endpoints);
 
   /* Now search for the interval which is contained in the most
      individual source intervals.  Any source which overlaps this
@@ -1273,6 +1435,22 @@ SRC_SelectSource(SRC_Instance updated_inst)
                    src_root_delay, src_root_dispersion);
 }
 
+/* ================================================== */
+
+void
+SRC_SelectSource(SRC_Instance updated_inst)
+{
+  /* A new sample from a monitor-only source cannot change the selection */
+  if (updated_inst && updated_inst->conf_sel_options & SRC_SELECT_MONITOR)
+    return;
+
+  select_source(updated_inst);
+
+  USDT_PROBE4(source_select, updated_inst ? updated_inst->index : INVALID_SOURCE,
+              selected_source_index, selected_source_index != INVALID_SOURCE ?
+                sources[selected_source_index]->ref_id : 0, n_sources);
+}
+
 /* ================================================== */
 /* Force reselecting the best source */
 
@@ -1297,9 +1475,8 @@ SRC_SetReselectDistance(double distance)
 /* ================================================== */
 /* This routine is registered as a callback with the local clock
    module, to be called whenever the local clock changes frequency or
-   is slewed.  It runs through all the existing source statistics, and
-   adjusts them to make them look as though they were sampled under
-   the new regime. */
+   is slewed.  It adjusts all the existing source statistics to make
+   them look as though they were sampled under the new regime. */
 
 static void
 slew_sources(struct timespec *raw, struct timespec *cooked, double dfreq,
@@ -1307,18 +1484,16 @@ slew_sources(struct timespec *raw, struct timespec *cooked, double dfreq,
 {
   int i;
 
-  for (i=0; i<n_sources; i++) {
-    if (change_type == LCL_ChangeUnknownStep) {
-      SST_ResetInstance(sources[i]->stats);
-    } else {
-      SST_SlewSamples(sources[i]->stats, cooked, dfreq, doffset);
-    }
+  if (change_type != LCL_ChangeUnknownStep) {
+    SST_SlewAllSamples(cooked, dfreq, doffset);
+    return;
   }
 
-  if (change_type == LCL_ChangeUnknownStep) {
-    /* Update selection status */
-    SRC_SelectSource(NULL);
-  }
+  for (i = 0; i < n_sources; i++)
+    SST_ResetInstance(sources[i]->stats);
+
+  /* Update selection status */
+  SRC_SelectSource(NULL);
 }
 
 /* ================================================== */
@@ -1331,6 +1506,9 @@ add_dispersion(double dispersion, void *anything)
   int i;
 
   for (i = 0; i < n_sources; i++) {
+    /* Monitor-only sources have no regression that could be used */
+    if (sources[i]->conf_sel_options & SRC_SELECT_MONITOR)
+      continue;
     SST_AddDispersion(sources[i]->stats, dispersion);
   }
 }
@@ -1638,6 +1816,7 @@ SRC_ReportSourcestats(int index, RPT_SourcestatsReport *report, struct timespec
       report->ip_addr = *src->ip_addr;
     else
       report->ip_addr.family = IPADDR_UNSPEC; 
+    report->n_dropped = 0;
     SST_DoSourcestatsReport(src->stats, report, now);
     return 1;
   }
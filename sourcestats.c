@@ -31,6 +31,7 @@
 #include "sysincl.h"
 
 #include "sourcestats.h"
+#include "array.h"
 #include "memory.h"
 #include "regress.h"
 #include "util.h"
@@ -70,10 +71,65 @@
 /* The maximum value of the counter */
 #define MAX_ASYMMETRY_RUN 1000
 
+/* Minimum length of the arrays of samples */
+#define MIN_BUF_SIZE 8
+
+/* Ratio between the maximum number of samples and the number of new samples
+   which can be added to full arrays before the stored samples need to be
+   moved to the beginning of the arrays */
+#define BUF_EXTRA_RATIO 8
+
+/* Number of slews of all instances which can be recorded before they
+   need to be applied to all instances */
+#define MAX_SLEWS 64
+
 /* ================================================== */
 
 static LOG_FileID logfileid;
 
+/* Slews of all instances, which are applied to an instance when it is
+   accessed.  The slew with epoch N is recorded at index N % MAX_SLEWS. */
+struct Slew {
+  struct timespec when;
+  double dfreq;
+  double doffset;
+};
+
+static struct Slew slews[MAX_SLEWS];
+
+/* Epoch of the next recorded slew */
+static unsigned int slew_epoch;
+
+/* Epoch which all instances were slewed to */
+static unsigned int min_slew_epoch;
+
+/* Array of pointers to all instances */
+static ARR_Instance instances;
+
+/* Summary of the instances needed for the source selection and tracking,
+   kept in contiguous arrays indexed by the instance index.  It is updated
+   whenever an instance changes, which allows the selection and tracking
+   data of many sources to be evaluated in one pass without accessing the
+   arrays of samples. */
+static struct {
+  unsigned int size;
+  int *n_samples;
+  int *select_ok;
+  double *select_std_devs;
+  struct timespec *first_times;
+  struct timespec *last_times;
+  struct timespec *best_times;
+  double *best_offsets;
+  double *best_root_delays;
+  double *best_root_dispersions;
+  struct timespec *offset_times;
+  double *offsets;
+  double *offset_sds;
+  double *frequencies;
+  double *frequency_sds;
+  double *skews;
+} summary;
+
 /* ================================================== */
 /* This data structure is used to hold the history of data from the
    source */
@@ -94,17 +150,38 @@ struct SST_Stats_Record {
   /* User defined asymmetry of network jitter */
   double fixed_asymmetry;
 
-  /* Number of samples currently stored.  The samples are stored in circular
-     buffer. */
+  /* Index of the instance in the array of instances */
+  unsigned int instance_index;
+
+  /* Epoch of the first slew which was not applied to the samples yet */
+  unsigned int slew_epoch;
+
+  /* Number of samples currently stored.  The samples are stored in
+     contiguous parts of the arrays, which are moved to the beginning of
+     the arrays when the end is reached. */
   int n_samples;
 
-  /* Number of extra samples stored in sample_times, offsets and peer_delays
-     arrays that are used to extend the runs test */
+  /* Number of extra samples stored before the samples that are used to
+     extend the runs test.  They are kept only in the sample_times, offsets,
+     and peer_delays arrays. */
   int runs_samples;
 
-  /* The index of the newest sample */
+  /* The index of the newest sample in the sample_times, offsets, and
+     peer_delays arrays */
   int last_sample;
 
+  /* The current and maximum length of the sample_times, offsets, and
+     peer_delays arrays */
+  int buf_size;
+  int max_buf_size;
+
+  /* The index of the newest sample in the other arrays */
+  int last_data_sample;
+
+  /* The current and maximum length of the other arrays */
+  int data_buf_size;
+  int max_data_buf_size;
+
   /* Flag indicating whether last regression was successful */
   int regression_ok;
 
@@ -147,42 +224,45 @@ struct SST_Stats_Record {
 
   /* This array contains the sample epochs, in terms of the local
      clock. */
-  struct timespec sample_times[MAX_SAMPLES * REGRESS_RUNS_RATIO];
+  struct timespec *sample_times;
 
   /* This is an array of offsets, in seconds, corresponding to the
      sample times.  In this module, we use the convention that
      positive means the local clock is FAST of the source and negative
      means it is SLOW.  This is contrary to the convention in the NTP
      stuff. */
-  double offsets[MAX_SAMPLES * REGRESS_RUNS_RATIO];
+  double *offsets;
 
   /* This is an array of the offsets as originally measured.  Local
      clock fast of real time is indicated by positive values.  This
      array is not slewed to adjust the readings when we apply
      adjustments to the local clock, as is done for the array
      'offset'. */
-  double orig_offsets[MAX_SAMPLES];
+  double *orig_offsets;
 
   /* This is an array of peer delays, in seconds, being the roundtrip
      measurement delay to the peer */
-  double peer_delays[MAX_SAMPLES * REGRESS_RUNS_RATIO];
+  double *peer_delays;
 
   /* This is an array of peer dispersions, being the skew and local
      precision dispersion terms from sampling the peer */
-  double peer_dispersions[MAX_SAMPLES];
+  double *peer_dispersions;
 
   /* This array contains the root delays of each sample, in seconds */
-  double root_delays[MAX_SAMPLES];
+  double *root_delays;
 
   /* This array contains the root dispersions of each sample at the
      time of the measurements */
-  double root_dispersions[MAX_SAMPLES];
+  double *root_dispersions;
 };
 
 /* ================================================== */
 
 static void find_min_delay_sample(SST_Stats inst);
 static int get_buf_index(SST_Stats inst, int i);
+static int get_data_index(SST_Stats inst, int i);
+static void apply_slews(SST_Stats inst);
+static void update_summary(SST_Stats inst);
 
 /* ================================================== */
 
@@ -192,6 +272,11 @@ SST_Initialise(void)
   logfileid = CNF_GetLogStatistics() ? LOG_FileOpen("statistics",
       "   Date (UTC) Time     IP Address    Std dev'n Est offset  Offset sd  Diff freq   Est skew  Stress  Ns  Bs  Nr  Asym")
     : -1;
+
+  slew_epoch = 0;
+  min_slew_epoch = 0;
+  instances = ARR_CreateInstance(sizeof (SST_Stats));
+  memset(&summary, 0, sizeof (summary));
 }
 
 /* ================================================== */
@@ -199,6 +284,46 @@ SST_Initialise(void)
 void
 SST_Finalise(void)
 {
+  ARR_DestroyInstance(instances);
+
+  Free(summary.n_samples);
+  Free(summary.select_ok);
+  Free(summary.select_std_devs);
+  Free(summary.first_times);
+  Free(summary.last_times);
+  Free(summary.best_times);
+  Free(summary.best_offsets);
+  Free(summary.best_root_delays);
+  Free(summary.best_root_dispersions);
+  Free(summary.offset_times);
+  Free(summary.offsets);
+  Free(summary.offset_sds);
+  Free(summary.frequencies);
+  Free(summary.frequency_sds);
+  Free(summary.skews);
+}
+
+/* ================================================== */
+
+static void
+resize_summary(unsigned int size)
+{
+  summary.n_samples = ReallocArray(int, size, summary.n_samples);
+  summary.select_ok = ReallocArray(int, size, summary.select_ok);
+  summary.select_std_devs = ReallocArray(double, size, summary.select_std_devs);
+  summary.first_times = ReallocArray(struct timespec, size, summary.first_times);
+  summary.last_times = ReallocArray(struct timespec, size, summary.last_times);
+  summary.best_times = ReallocArray(struct timespec, size, summary.best_times);
+  summary.best_offsets = ReallocArray(double, size, summary.best_offsets);
+  summary.best_root_delays = ReallocArray(double, size, summary.best_root_delays);
+  summary.best_root_dispersions = ReallocArray(double, size, summary.best_root_dispersions);
+  summary.offset_times = ReallocArray(struct timespec, size, summary.offset_times);
+  summary.offsets = ReallocArray(double, size, summary.offsets);
+  summary.offset_sds = ReallocArray(double, size, summary.offset_sds);
+  summary.frequencies = ReallocArray(double, size, summary.frequencies);
+  summary.frequency_sds = ReallocArray(double, size, summary.frequency_sds);
+  summary.skews = ReallocArray(double, size, summary.skews);
+  summary.size = size;
 }
 
 /* ================================================== */
@@ -216,6 +341,30 @@ SST_CreateInstance(uint32_t refid, IPAddr *addr, int min_samples, int max_sample
   inst->fixed_min_delay = min_delay;
   inst->fixed_asymmetry = asymmetry;
 
+  /* The arrays holding the runs samples can grow to the maximum number of
+     samples including the runs samples and the other arrays to the maximum
+     number of samples, plus a fraction of the maximum to not have to move
+     the stored samples on each new sample.  They are allocated when the
+     first sample is accumulated. */
+  inst->buf_size = 0;
+  inst->max_buf_size = inst->max_samples * REGRESS_RUNS_RATIO +
+                       MAX(1, inst->max_samples / BUF_EXTRA_RATIO);
+  inst->data_buf_size = 0;
+  inst->max_data_buf_size = inst->max_samples + MAX(1, inst->max_samples / BUF_EXTRA_RATIO);
+  inst->sample_times = NULL;
+  inst->offsets = NULL;
+  inst->orig_offsets = NULL;
+  inst->peer_delays = NULL;
+  inst->peer_dispersions = NULL;
+  inst->root_delays = NULL;
+  inst->root_dispersions = NULL;
+
+  inst->instance_index = ARR_GetSize(instances);
+  ARR_AppendElement(instances, &inst);
+
+  if (inst->instance_index >= summary.size)
+    resize_summary(summary.size > 0 ? 2 * summary.size : 16);
+
   SST_SetRefid(inst, refid, addr);
   SST_ResetInstance(inst);
 
@@ -228,6 +377,26 @@ SST_CreateInstance(uint32_t refid, IPAddr *addr, int min_samples, int max_sample
 void
 SST_DeleteInstance(SST_Stats inst)
 {
+  SST_Stats last;
+  unsigned int n;
+
+  /* Move the last instance in the array to the place of the deleted one */
+  n = ARR_GetSize(instances);
+  last = *(SST_Stats *)ARR_GetElement(instances, n - 1);
+  last->instance_index = inst->instance_index;
+  *(SST_Stats *)ARR_GetElement(instances, inst->instance_index) = last;
+  ARR_SetSize(instances, n - 1);
+
+  if (last != inst)
+    update_summary(last);
+
+  Free(inst->sample_times);
+  Free(inst->offsets);
+  Free(inst->orig_offsets);
+  Free(inst->peer_delays);
+  Free(inst->peer_dispersions);
+  Free(inst->root_delays);
+  Free(inst->root_dispersions);
   Free(inst);
 }
 
@@ -238,7 +407,8 @@ SST_ResetInstance(SST_Stats inst)
 {
   inst->n_samples = 0;
   inst->runs_samples = 0;
-  inst->last_sample = 0;
+  inst->last_sample = -1;
+  inst->last_data_sample = -1;
   inst->regression_ok = 0;
   inst->best_single_sample = 0;
   inst->min_delay_sample = 0;
@@ -252,6 +422,9 @@ SST_ResetInstance(SST_Stats inst)
   inst->nruns = 0;
   inst->asymmetry_run = 0;
   inst->asymmetry = 0.0;
+  inst->slew_epoch = slew_epoch;
+
+  update_summary(inst);
 }
 
 /* ================================================== */
@@ -279,21 +452,90 @@ prune_register(SST_Stats inst, int new_oldest)
   if (inst->runs_samples > inst->n_samples * (REGRESS_RUNS_RATIO - 1))
     inst->runs_samples = inst->n_samples * (REGRESS_RUNS_RATIO - 1);
   
-  assert(inst->n_samples + inst->runs_samples <= MAX_SAMPLES * REGRESS_RUNS_RATIO);
+  assert(inst->n_samples + inst->runs_samples <= inst->max_samples * REGRESS_RUNS_RATIO);
 
   find_min_delay_sample(inst);
 }
 
 /* ================================================== */
 
+static void
+resize_buffers(SST_Stats inst, int size)
+{
+  inst->sample_times = ReallocArray(struct timespec, size, inst->sample_times);
+  inst->offsets = ReallocArray(double, size, inst->offsets);
+  inst->peer_delays = ReallocArray(double, size, inst->peer_delays);
+  inst->buf_size = size;
+}
+
+/* ================================================== */
+
+static void
+resize_data_buffers(SST_Stats inst, int size)
+{
+  inst->orig_offsets = ReallocArray(double, size, inst->orig_offsets);
+  inst->peer_dispersions = ReallocArray(double, size, inst->peer_dispersions);
+  inst->root_delays = ReallocArray(double, size, inst->root_delays);
+  inst->root_dispersions = ReallocArray(double, size, inst->root_dispersions);
+  inst->data_buf_size = size;
+}
+
+/* ================================================== */
+/* Move the stored samples to the beginning of the arrays */
+
+static void
+move_samples(SST_Stats inst)
+{
+  int first, n;
+
+  n = inst->n_samples + inst->runs_samples;
+  first = inst->last_sample + 1 - n;
+
+  if (first <= 0)
+    return;
+
+  memmove(inst->sample_times, inst->sample_times + first, n * sizeof (inst->sample_times[0]));
+  memmove(inst->offsets, inst->offsets + first, n * sizeof (inst->offsets[0]));
+  memmove(inst->peer_delays, inst->peer_delays + first, n * sizeof (inst->peer_delays[0]));
+
+  inst->last_sample -= first;
+  inst->min_delay_sample -= first;
+}
+
+/* ================================================== */
+
+static void
+move_data_samples(SST_Stats inst)
+{
+  int first, n;
+
+  n = inst->n_samples;
+  first = inst->last_data_sample + 1 - n;
+
+  if (first <= 0)
+    return;
+
+  memmove(inst->orig_offsets, inst->orig_offsets + first, n * sizeof (inst->orig_offsets[0]));
+  memmove(inst->peer_dispersions, inst->peer_dispersions + first,
+          n * sizeof (inst->peer_dispersions[0]));
+  memmove(inst->root_delays, inst->root_delays + first, n * sizeof (inst->root_delays[0]));
+  memmove(inst->root_dispersions, inst->root_dispersions + first,
+          n * sizeof (inst->root_dispersions[0]));
+
+  inst->last_data_sample -= first;
+}
+
+/* ================================================== */
+
 void
 SST_AccumulateSample(SST_Stats inst, NTP_Sample *sample)
 {
   int n, m;
 
+  apply_slews(inst);
+
   /* Make room for the new sample */
-  if (inst->n_samples > 0 &&
-      (inst->n_samples == MAX_SAMPLES || inst->n_samples == inst->max_samples)) {
+  if (inst->n_samples > 0 && inst->n_samples == inst->max_samples) {
     prune_register(inst, 1);
   }
 
@@ -305,9 +547,28 @@ SST_AccumulateSample(SST_Stats inst, NTP_Sample *sample)
     SST_ResetInstance(inst);
   }
 
-  n = inst->last_sample = (inst->last_sample + 1) %
-    (MAX_SAMPLES * REGRESS_RUNS_RATIO);
-  m = n % MAX_SAMPLES;
+  if (inst->last_sample + 1 >= inst->buf_size) {
+    /* Extend the arrays if more than half is used by the stored samples */
+    if (2 * (inst->n_samples + inst->runs_samples) >= inst->buf_size &&
+        inst->buf_size < inst->max_buf_size)
+      resize_buffers(inst, MIN(MAX(MIN_BUF_SIZE, 2 * inst->buf_size), inst->max_buf_size));
+    else
+      move_samples(inst);
+  }
+
+  if (inst->last_data_sample + 1 >= inst->data_buf_size) {
+    if (2 * inst->n_samples >= inst->data_buf_size &&
+        inst->data_buf_size < inst->max_data_buf_size)
+      resize_data_buffers(inst, MIN(MAX(MIN_BUF_SIZE, 2 * inst->data_buf_size),
+                                    inst->max_data_buf_size));
+    else
+      move_data_samples(inst);
+  }
+
+  n = ++inst->last_sample;
+  assert(n < inst->buf_size);
+  m = ++inst->last_data_sample;
+  assert(m < inst->data_buf_size);
 
   /* WE HAVE TO NEGATE OFFSET IN THIS CALL, IT IS HERE THAT THE SENSE OF OFFSET
      IS FLIPPED */
@@ -326,27 +587,28 @@ SST_AccumulateSample(SST_Stats inst, NTP_Sample *sample)
     inst->min_delay_sample = n;
 
   ++inst->n_samples;
+
+  update_summary(inst);
 }
 
 /* ================================================== */
-/* Return index of the i-th sample in the sample_times and offset buffers,
-   i can be negative down to -runs_samples */
+/* Return index of the i-th sample in the arrays, i can be negative down to
+   -runs_samples */
 
 static int
-get_runsbuf_index(SST_Stats inst, int i)
+get_buf_index(SST_Stats inst, int i)
 {
-  return (unsigned int)(inst->last_sample + 2 * MAX_SAMPLES * REGRESS_RUNS_RATIO -
-      inst->n_samples + i + 1) % (MAX_SAMPLES * REGRESS_RUNS_RATIO);
+  return inst->last_sample - inst->n_samples + i + 1;
 }
 
 /* ================================================== */
-/* Return index of the i-th sample in the other buffers */
+/* Return index of the i-th sample in the arrays which don't hold the runs
+   samples (orig_offsets, peer_dispersions, root_delays, root_dispersions) */
 
 static int
-get_buf_index(SST_Stats inst, int i)
+get_data_index(SST_Stats inst, int i)
 {
-  return (unsigned int)(inst->last_sample + MAX_SAMPLES * REGRESS_RUNS_RATIO -
-      inst->n_samples + i + 1) % MAX_SAMPLES;
+  return inst->last_data_sample - inst->n_samples + i + 1;
 }
 
 /* ================================================== */
@@ -357,13 +619,18 @@ get_buf_index(SST_Stats inst, int i)
 static void
 convert_to_intervals(SST_Stats inst, double *times_back)
 {
-  struct timespec *ts;
+  struct timespec *times, *ts;
   int i;
 
+  if (!inst->n_samples)
+    return;
+
+  times = inst->sample_times + get_buf_index(inst, 0);
   ts = &inst->sample_times[inst->last_sample];
+
   for (i = -inst->runs_samples; i < inst->n_samples; i++) {
     /* The entries in times_back[] should end up negative */
-    times_back[i] = UTI_DiffTimespecsToDouble(&inst->sample_times[get_runsbuf_index(inst, i)], ts);
+    times_back[i] = UTI_DiffTimespecsToDouble(&times[i], ts);
   }
 }
 
@@ -376,22 +643,22 @@ find_best_sample_index(SST_Stats inst, double *times_back)
      samples offers the tightest bound on root distance */
 
   double root_distance, best_root_distance;
-  double elapsed;
-  int i, j, best_index;
+  double elapsed, *root_delays, *root_dispersions;
+  int i, best_index;
 
   if (!inst->n_samples)
     return;
 
   best_index = -1;
   best_root_distance = DBL_MAX;
+  root_delays = inst->root_delays + get_data_index(inst, 0);
+  root_dispersions = inst->root_dispersions + get_data_index(inst, 0);
 
   for (i = 0; i < inst->n_samples; i++) {
-    j = get_buf_index(inst, i);
-
     elapsed = -times_back[i];
     assert(elapsed >= 0.0);
 
-    root_distance = inst->root_dispersions[j] + elapsed * inst->skew + 0.5 * inst->root_delays[j];
+    root_distance = root_dispersions[i] + elapsed * inst->skew + 0.5 * root_delays[i];
     if (root_distance < best_root_distance) {
       best_root_distance = root_distance;
       best_index = i;
@@ -407,14 +674,13 @@ find_best_sample_index(SST_Stats inst, double *times_back)
 static void
 find_min_delay_sample(SST_Stats inst)
 {
-  int i, index;
+  int i;
 
-  inst->min_delay_sample = get_runsbuf_index(inst, -inst->runs_samples);
+  inst->min_delay_sample = get_buf_index(inst, -inst->runs_samples);
 
-  for (i = -inst->runs_samples + 1; i < inst->n_samples; i++) {
-    index = get_runsbuf_index(inst, i);
-    if (inst->peer_delays[index] < inst->peer_delays[inst->min_delay_sample])
-      inst->min_delay_sample = index;
+  for (i = inst->min_delay_sample + 1; i <= inst->last_sample; i++) {
+    if (inst->peer_delays[i] < inst->peer_delays[inst->min_delay_sample])
+      inst->min_delay_sample = i;
   }
 }
 
@@ -459,7 +725,7 @@ estimate_asymmetry(double *times_back, double *offsets, double *delays, int n,
 static void
 correct_asymmetry(SST_Stats inst, double *times_back, double *offsets)
 {
-  double min_delay, delays[MAX_SAMPLES * REGRESS_RUNS_RATIO];
+  double min_delay, delays[MAX_SAMPLES * REGRESS_RUNS_RATIO], *peer_delays;
   int i, n;
 
   /* Check if the asymmetry was not specified to be zero */
@@ -468,10 +734,10 @@ correct_asymmetry(SST_Stats inst, double *times_back, double *offsets)
 
   min_delay = SST_MinRoundTripDelay(inst);
   n = inst->runs_samples + inst->n_samples;
+  peer_delays = inst->peer_delays + get_buf_index(inst, -inst->runs_samples);
 
   for (i = 0; i < n; i++)
-    delays[i] = inst->peer_delays[get_runsbuf_index(inst, i - inst->runs_samples)] -
-                min_delay;
+    delays[i] = peer_delays[i] - min_delay;
 
   if (fabs(inst->fixed_asymmetry) <= MAX_ASYMMETRY) {
     inst->asymmetry = inst->fixed_asymmetry;
@@ -512,23 +778,24 @@ SST_DoNewRegression(SST_Stats inst)
   int degrees_of_freedom;
   int best_start, times_back_start;
   double est_intercept, est_slope, est_var, est_intercept_sd, est_slope_sd;
-  int i, j, nruns;
+  int i, j, k, nruns;
   double min_distance, median_distance;
   double sd_weight, sd;
   double old_skew, old_freq, stress;
   double precision;
 
+  apply_slews(inst);
+
   convert_to_intervals(inst, times_back + inst->runs_samples);
 
   if (inst->n_samples > 0) {
-    for (i = -inst->runs_samples; i < inst->n_samples; i++) {
-      offsets[i + inst->runs_samples] = inst->offsets[get_runsbuf_index(inst, i)];
-    }
-  
-    for (i = 0, min_distance = DBL_MAX; i < inst->n_samples; i++) {
-      j = get_buf_index(inst, i);
-      peer_distances[i] = 0.5 * inst->peer_delays[get_runsbuf_index(inst, i)] +
-                          inst->peer_dispersions[j];
+    /* The offsets are copied as they may be corrected for asymmetry */
+    memcpy(offsets, inst->offsets + get_buf_index(inst, -inst->runs_samples),
+           (inst->runs_samples + inst->n_samples) * sizeof (offsets[0]));
+
+    for (i = 0, j = get_buf_index(inst, 0), k = get_data_index(inst, 0),
+         min_distance = DBL_MAX; i < inst->n_samples; i++, j++, k++) {
+      peer_distances[i] = 0.5 * inst->peer_delays[j] + inst->peer_dispersions[k];
       if (peer_distances[i] < min_distance) {
         min_distance = peer_distances[i];
       }
@@ -616,6 +883,7 @@ SST_DoNewRegression(SST_Stats inst)
 
   find_best_sample_index(inst, times_back + times_back_start);
 
+  update_summary(inst);
 }
 
 /* ================================================== */
@@ -628,6 +896,9 @@ SST_GetFrequencyRange(SST_Stats inst,
                       double *lo, double *hi)
 {
   double freq, skew;
+
+  apply_slews(inst);
+
   freq = inst->estimated_frequency;
   skew = inst->skew;
   *lo = freq - skew;
@@ -644,6 +915,79 @@ SST_GetFrequencyRange(SST_Stats inst,
 
 /* ================================================== */
 
+static void
+update_summary(SST_Stats inst)
+{
+  unsigned int j = inst->instance_index;
+  int i;
+
+  summary.n_samples[j] = inst->n_samples;
+
+  if (inst->n_samples > 0) {
+    summary.first_times[j] = inst->sample_times[get_buf_index(inst, 0)];
+    summary.last_times[j] = inst->sample_times[inst->last_sample];
+
+    i = get_buf_index(inst, inst->best_single_sample);
+    summary.best_times[j] = inst->sample_times[i];
+    summary.best_offsets[j] = inst->offsets[i];
+    i = get_data_index(inst, inst->best_single_sample);
+    summary.best_root_delays[j] = inst->root_delays[i];
+    summary.best_root_dispersions[j] = inst->root_dispersions[i];
+  }
+
+  summary.select_ok[j] = inst->n_samples > 0 && inst->regression_ok;
+  summary.select_std_devs[j] = inst->std_dev;
+
+  /* If maxsamples is too small to have a successful regression, enable the
+     selection as a special case for a fast update/print-once reference mode */
+  if (!summary.select_ok[j] && inst->n_samples > 0 &&
+      inst->n_samples < MIN_SAMPLES_FOR_REGRESS && inst->n_samples == inst->max_samples) {
+    summary.select_std_devs[j] = CNF_GetMaxJitter();
+    summary.select_ok[j] = 1;
+  }
+
+  summary.offset_times[j] = inst->offset_time;
+  summary.offsets[j] = inst->estimated_offset;
+  summary.offset_sds[j] = inst->estimated_offset_sd;
+  summary.frequencies[j] = inst->estimated_frequency;
+  summary.frequency_sds[j] = inst->estimated_frequency_sd;
+  summary.skews[j] = inst->skew;
+}
+
+/* ================================================== */
+
+static void
+get_selection_data(unsigned int j, struct timespec *now, SST_SelectionData *data)
+{
+  double offset, sample_elapsed;
+
+  if (!summary.n_samples[j]) {
+    memset(data, 0, sizeof (*data));
+    return;
+  }
+
+  data->std_dev = summary.select_std_devs[j];
+
+  sample_elapsed = fabs(UTI_DiffTimespecsToDouble(now, &summary.best_times[j]));
+  offset = summary.best_offsets[j] + sample_elapsed * summary.frequencies[j];
+  data->root_distance = 0.5 * summary.best_root_delays[j] +
+    summary.best_root_dispersions[j] + sample_elapsed * summary.skews[j];
+
+  data->lo_limit = offset - data->root_distance;
+  data->hi_limit = offset + data->root_distance;
+
+  data->first_sample_ago = UTI_DiffTimespecsToDouble(now, &summary.first_times[j]);
+  data->last_sample_ago = UTI_DiffTimespecsToDouble(now, &summary.last_times[j]);
+
+  data->select_ok = summary.select_ok[j];
+
+  DEBUG_LOG("n=%d off=%f dist=%f sd=%f first_ago=%f last_ago=%f selok=%d",
+            summary.n_samples[j], offset, data->root_distance, data->std_dev,
+            data->first_sample_ago, data->last_sample_ago, data->select_ok);
+}
+
+/* ================================================== */
+
 void
 SST_GetSelectionData(SST_Stats inst, struct timespec *now,
                      double *offset_lo_limit,
@@ -654,59 +998,60 @@ SST_GetSelectionData(SST_Stats inst, struct timespec *now,
                      double *last_sample_ago,
                      int *select_ok)
 {
-  double offset, sample_elapsed;
-  int i, j;
-  
-  if (!inst->n_samples) {
-    *select_ok = 0;
-    return;
-  }
+  SST_SelectionData data;
 
-  i = get_runsbuf_index(inst, inst->best_single_sample);
-  j = get_buf_index(inst, inst->best_single_sample);
+  SST_GetSelectionDataBatch(&inst, 1, now, &data);
 
-  *std_dev = inst->std_dev;
+  *select_ok = data.select_ok;
+  *offset_lo_limit = data.lo_limit;
+  *offset_hi_limit = data.hi_limit;
+  *root_distance = data.root_distance;
+  *std_dev = data.std_dev;
+  *first_sample_ago = data.first_sample_ago;
+  *last_sample_ago = data.last_sample_ago;
+}
 
-  sample_elapsed = fabs(UTI_DiffTimespecsToDouble(now, &inst->sample_times[i]));
-  offset = inst->offsets[i] + sample_elapsed * inst->estimated_frequency;
-  *root_distance = 0.5 * inst->root_delays[j] +
-    inst->root_dispersions[j] + sample_elapsed * inst->skew;
-
-  *offset_lo_limit = offset - *root_distance;
-  *offset_hi_limit = offset + *root_distance;
-
-#if 0
-  double average_offset, elapsed;
-  int average_ok;
-  /* average_ok ignored for now */
-  elapsed = UTI_DiffTimespecsToDouble(now, &inst->offset_time);
-  average_offset = inst->estimated_offset + inst->estimated_frequency * elapsed;
-  if (fabs(average_offset - offset) <=
-      inst->peer_dispersions[j] + 0.5 * inst->peer_delays[i]) {
-    average_ok = 1;
-  } else {
-    average_ok = 0;
-  }
-#endif
+/* ================================================== */
 
-  i = get_runsbuf_index(inst, 0);
-  *first_sample_ago = UTI_DiffTimespecsToDouble(now, &inst->sample_times[i]);
-  i = get_runsbuf_index(inst, inst->n_samples - 1);
-  *last_sample_ago = UTI_DiffTimespecsToDouble(now, &inst->sample_times[i]);
+void
+SST_GetSelectionDataBatch(SST_Stats *insts, int n, struct timespec *now,
+                          SST_SelectionData *data)
+{
+  int i;
 
-  *select_ok = inst->regression_ok;
+  /* Make sure the summary is up to date */
+  for (i = 0; i < n; i++)
+    apply_slews(insts[i]);
 
-  /* If maxsamples is too small to have a successful regression, enable the
-     selection as a special case for a fast update/print-once reference mode */
-  if (!*select_ok && inst->n_samples < MIN_SAMPLES_FOR_REGRESS &&
-      inst->n_samples == inst->max_samples) {
-    *std_dev = CNF_GetMaxJitter();
-    *select_ok = 1;
-  }
+  for (i = 0; i < n; i++)
+    get_selection_data(insts[i]->instance_index, now, &data[i]);
+}
 
-  DEBUG_LOG("n=%d off=%f dist=%f sd=%f first_ago=%f last_ago=%f selok=%d",
-            inst->n_samples, offset, *root_distance, *std_dev,
-            *first_sample_ago, *last_sample_ago, *select_ok);
+/* ================================================== */
+
+static void
+get_tracking_data(unsigned int j, SST_TrackingData *data)
+{
+  double elapsed_sample;
+
+  assert(summary.n_samples[j] > 0);
+
+  data->ref_time = summary.offset_times[j];
+  data->average_offset = summary.offsets[j];
+  data->offset_sd = summary.offset_sds[j];
+  data->frequency = summary.frequencies[j];
+  data->frequency_sd = summary.frequency_sds[j];
+  data->skew = summary.skews[j];
+  data->root_delay = summary.best_root_delays[j];
+
+  elapsed_sample = UTI_DiffTimespecsToDouble(&summary.offset_times[j], &summary.best_times[j]);
+  data->root_dispersion = summary.best_root_dispersions[j] + data->skew * elapsed_sample +
+                          data->offset_sd;
+
+  DEBUG_LOG("n=%d off=%f offsd=%f freq=%e freqsd=%e skew=%e delay=%f disp=%f",
+            summary.n_samples[j], data->average_offset, data->offset_sd,
+            data->frequency, data->frequency_sd, data->skew,
+            data->root_delay, data->root_dispersion);
 }
 
 /* ================================================== */
@@ -717,36 +1062,40 @@ SST_GetTrackingData(SST_Stats inst, struct timespec *ref_time,
                     double *frequency, double *frequency_sd, double *skew,
                     double *root_delay, double *root_dispersion)
 {
-  int i, j;
-  double elapsed_sample;
-
-  assert(inst->n_samples > 0);
+  SST_TrackingData data;
+
+  SST_GetTrackingDataBatch(&inst, 1, &data);
+
+  *ref_time = data.ref_time;
+  *average_offset = data.average_offset;
+  *offset_sd = data.offset_sd;
+  *frequency = data.frequency;
+  *frequency_sd = data.frequency_sd;
+  *skew = data.skew;
+  *root_delay = data.root_delay;
+  *root_dispersion = data.root_dispersion;
+}
 
-  i = get_runsbuf_index(inst, inst->best_single_sample);
-  j = get_buf_index(inst, inst->best_single_sample);
+/* ================================================== */
 
-  *ref_time = inst->offset_time;
-  *average_offset = inst->estimated_offset;
-  *offset_sd = inst->estimated_offset_sd;
-  *frequency = inst->estimated_frequency;
-  *frequency_sd = inst->estimated_frequency_sd;
-  *skew = inst->skew;
-  *root_delay = inst->root_delays[j];
+void
+SST_GetTrackingDataBatch(SST_Stats *insts, int n, SST_TrackingData *data)
+{
+  int i;
 
-  elapsed_sample = UTI_DiffTimespecsToDouble(&inst->offset_time, &inst->sample_times[i]);
-  *root_dispersion = inst->root_dispersions[j] + inst->skew * elapsed_sample + *offset_sd;
+  for (i = 0; i < n; i++)
+    apply_slews(insts[i]);
 
-  DEBUG_LOG("n=%d off=%f offsd=%f freq=%e freqsd=%e skew=%e delay=%f disp=%f",
-            inst->n_samples, *average_offset, *offset_sd,
-            *frequency, *frequency_sd, *skew, *root_delay, *root_dispersion);
+  for (i = 0; i < n; i++)
+    get_tracking_data(insts[i]->instance_index, &data[i]);
 }
 
 /* ================================================== */
 
-void
-SST_SlewSamples(SST_Stats inst, struct timespec *when, double dfreq, double doffset)
+static void
+slew_samples(SST_Stats inst, struct timespec *when, double dfreq, double doffset)
 {
-  int m, i;
+  int i;
   double delta_time;
   struct timespec *sample, prev;
   double prev_offset, prev_freq;
@@ -754,10 +1103,8 @@ SST_SlewSamples(SST_Stats inst, struct timespec *when, double dfreq, double doff
   if (!inst->n_samples)
     return;
 
-  for (m = -inst->runs_samples; m < inst->n_samples; m++) {
-    i = get_runsbuf_index(inst, m);
+  for (i = get_buf_index(inst, -inst->runs_samples); i <= inst->last_sample; i++) {
     sample = &inst->sample_times[i];
-    prev = *sample;
     UTI_AdjustTimespec(sample, when, sample, &delta_time, dfreq, doffset);
     inst->offsets[i] += delta_time;
   }
@@ -778,6 +1125,57 @@ SST_SlewSamples(SST_Stats inst, struct timespec *when, double dfreq, double doff
             1.0e6 * prev_freq, 1.0e6 * inst->estimated_frequency);
 }
 
+/* ================================================== */
+/* Apply slews of all instances which were recorded after the last
+   access to the instance */
+
+static void
+apply_slews(SST_Stats inst)
+{
+  struct Slew *slew;
+
+  if (inst->slew_epoch == slew_epoch)
+    return;
+
+  for (; inst->slew_epoch != slew_epoch; inst->slew_epoch++) {
+    slew = &slews[inst->slew_epoch % MAX_SLEWS];
+    slew_samples(inst, &slew->when, slew->dfreq, slew->doffset);
+  }
+
+  update_summary(inst);
+}
+
+/* ================================================== */
+
+void
+SST_SlewSamples(SST_Stats inst, struct timespec *when, double dfreq, double doffset)
+{
+  apply_slews(inst);
+  slew_samples(inst, when, dfreq, doffset);
+  update_summary(inst);
+}
+
+/* ================================================== */
+
+void
+SST_SlewAllSamples(struct timespec *when, double dfreq, double doffset)
+{
+  unsigned int i;
+
+  /* Make room for the new slew if the oldest recorded slew may still be
+     needed by some instances */
+  if (slew_epoch - min_slew_epoch >= MAX_SLEWS) {
+    for (i = 0; i < ARR_GetSize(instances); i++)
+      apply_slews(*(SST_Stats *)ARR_GetElement(instances, i));
+    min_slew_epoch = slew_epoch;
+  }
+
+  slews[slew_epoch % MAX_SLEWS].when = *when;
+  slews[slew_epoch % MAX_SLEWS].dfreq = dfreq;
+  slews[slew_epoch % MAX_SLEWS].doffset = doffset;
+  slew_epoch++;
+}
+
 /* ================================================== */
 
 void
@@ -785,13 +1183,17 @@ SST_CorrectOffset(SST_Stats inst, double doffset)
 {
   int i;
 
+  apply_slews(inst);
+
   if (!inst->n_samples)
     return;
 
-  for (i = -inst->runs_samples; i < inst->n_samples; i++)
-    inst->offsets[get_runsbuf_index(inst, i)] += doffset;
+  for (i = get_buf_index(inst, -inst->runs_samples); i <= inst->last_sample; i++)
+    inst->offsets[i] += doffset;
 
   inst->estimated_offset += doffset;
+
+  update_summary(inst);
 }
 
 /* ================================================== */
@@ -799,13 +1201,14 @@ SST_CorrectOffset(SST_Stats inst, double doffset)
 void 
 SST_AddDispersion(SST_Stats inst, double dispersion)
 {
-  int m, i;
+  int i;
 
-  for (m = 0; m < inst->n_samples; m++) {
-    i = get_buf_index(inst, m);
+  for (i = get_data_index(inst, 0); i <= inst->last_data_sample; i++) {
     inst->root_dispersions[i] += dispersion;
     inst->peer_dispersions[i] += dispersion;
   }
+
+  update_summary(inst);
 }
 
 /* ================================================== */
@@ -814,7 +1217,9 @@ double
 SST_PredictOffset(SST_Stats inst, struct timespec *when)
 {
   double elapsed;
-  
+
+  apply_slews(inst);
+
   if (inst->n_samples < MIN_SAMPLES_FOR_REGRESS) {
     /* We don't have any useful statistics, and presumably the poll
        interval is minimal.  We can't do any useful prediction other
@@ -852,6 +1257,8 @@ SST_GetDelayTestData(SST_Stats inst, struct timespec *sample_time,
                      double *last_sample_ago, double *predicted_offset,
                      double *min_delay, double *skew, double *std_dev)
 {
+  apply_slews(inst);
+
   if (inst->n_samples < 6)
     return 0;
 
@@ -872,7 +1279,9 @@ SST_GetDelayTestData(SST_Stats inst, struct timespec *sample_time,
 int
 SST_SaveToFile(SST_Stats inst, FILE *out)
 {
-  int m, i, j;
+  int i, j;
+
+  apply_slews(inst);
 
   if (inst->n_samples < 1)
     return 0;
@@ -880,10 +1289,8 @@ SST_SaveToFile(SST_Stats inst, FILE *out)
   if (fprintf(out, "%d %d\n", inst->n_samples, inst->asymmetry_run) < 0)
     return 0;
 
-  for(m = 0; m < inst->n_samples; m++) {
-    i = get_runsbuf_index(inst, m);
-    j = get_buf_index(inst, m);
-
+  for (i = get_buf_index(inst, 0), j = get_data_index(inst, 0);
+       i <= inst->last_sample; i++, j++) {
     if (fprintf(out, "%s %.6e %.6e %.6e %.6e %.6e %.6e\n",
                 UTI_TimespecToString(&inst->sample_times[i]),
                 inst->offsets[i], inst->orig_offsets[j],
@@ -901,7 +1308,7 @@ SST_SaveToFile(SST_Stats inst, FILE *out)
 int
 SST_LoadFromFile(SST_Stats inst, FILE *in)
 {
-  int i, n_samples, arun;
+  int i, j, n_samples, arun;
   struct timespec now;
   double sample_time;
   char line[256];
@@ -913,9 +1320,22 @@ SST_LoadFromFile(SST_Stats inst, FILE *in)
 
   SST_ResetInstance(inst);
 
+  if (inst->buf_size < inst->max_buf_size)
+    resize_buffers(inst, inst->max_buf_size);
+  if (inst->data_buf_size < inst->max_data_buf_size)
+    resize_data_buffers(inst, inst->max_data_buf_size);
+
   LCL_ReadCookedTime(&now, NULL);
 
-  for (i = 0; i < n_samples; i++) {
+  for (j = 0; j < n_samples; j++) {
+    /* Keep only the newest samples if maxsamples was reduced */
+    i = j - MAX(0, n_samples - inst->max_samples);
+    if (i < 0) {
+      if (!fgets(line, sizeof (line), in))
+        return 0;
+      continue;
+    }
+
     if (!fgets(line, sizeof (line), in) ||
         sscanf(line, "%lf %lf %lf %lf %lf %lf %lf",
                &sample_time, &inst->offsets[i], &inst->orig_offsets[i],
@@ -938,8 +1358,9 @@ SST_LoadFromFile(SST_Stats inst, FILE *in)
       return 0;
   }
 
-  inst->n_samples = n_samples;
+  inst->n_samples = MIN(n_samples, inst->max_samples);
   inst->last_sample = inst->n_samples - 1;
+  inst->last_data_sample = inst->n_samples - 1;
   inst->asymmetry_run = CLAMP(-MAX_ASYMMETRY_RUN, arun, MAX_ASYMMETRY_RUN);
 
   find_min_delay_sample(inst);
@@ -953,15 +1374,18 @@ SST_LoadFromFile(SST_Stats inst, FILE *in)
 void
 SST_DoSourceReport(SST_Stats inst, RPT_SourceReport *report, struct timespec *now)
 {
-  int i, j;
+  int i;
   struct timespec last_sample_time;
 
+  apply_slews(inst);
+
   if (inst->n_samples > 0) {
-    i = get_runsbuf_index(inst, inst->n_samples - 1);
-    j = get_buf_index(inst, inst->n_samples - 1);
-    report->orig_latest_meas = inst->orig_offsets[j];
+    i = inst->last_data_sample;
+    report->orig_latest_meas = inst->orig_offsets[i];
+    report->latest_meas_err = 0.5*inst->root_delays[i] + inst->root_dispersions[i];
+
+    i = inst->last_sample;
     report->latest_meas = inst->offsets[i];
-    report->latest_meas_err = 0.5*inst->root_delays[j] + inst->root_dispersions[j];
 
     /* Align the sample time to reduce the leak of the receive timestamp */
     last_sample_time = inst->sample_times[i];
@@ -999,24 +1423,26 @@ SST_DoSourcestatsReport(SST_Stats inst, RPT_SourcestatsReport *report, struct ti
 {
   double dspan;
   double elapsed, sample_elapsed;
-  int bi, bj;
+  int bi, di;
+
+  apply_slews(inst);
 
   report->n_samples = inst->n_samples;
   report->n_runs = inst->nruns;
 
   if (inst->n_samples > 0) {
-    bi = get_runsbuf_index(inst, inst->best_single_sample);
-    bj = get_buf_index(inst, inst->best_single_sample);
+    bi = get_buf_index(inst, inst->best_single_sample);
+    di = get_data_index(inst, inst->best_single_sample);
 
     dspan = UTI_DiffTimespecsToDouble(&inst->sample_times[inst->last_sample],
-                                      &inst->sample_times[get_runsbuf_index(inst, 0)]);
+                                      &inst->sample_times[get_buf_index(inst, 0)]);
     elapsed = UTI_DiffTimespecsToDouble(now, &inst->offset_time);
     sample_elapsed = UTI_DiffTimespecsToDouble(now, &inst->sample_times[bi]);
 
     report->span_seconds = round(dspan);
     report->est_offset = inst->estimated_offset + elapsed * inst->estimated_frequency;
     report->est_offset_err = inst->estimated_offset_sd + sample_elapsed * inst->skew +
-                             (0.5 * inst->root_delays[bj] + inst->root_dispersions[bj]);
+                             (0.5 * inst->root_delays[di] + inst->root_dispersions[di]);
   } else {
     report->span_seconds = 0;
     report->est_offset = 0;
@@ -33,6 +33,29 @@
 
 typedef struct SST_Stats_Record *SST_Stats;
 
+/* Data needed for selection */
+typedef struct {
+  double lo_limit;
+  double hi_limit;
+  double root_distance;
+  double std_dev;
+  double first_sample_ago;
+  double last_sample_ago;
+  int select_ok;
+} SST_SelectionData;
+
+/* Data needed when setting up tracking on a source */
+typedef struct {
+  struct timespec ref_time;
+  double average_offset;
+  double offset_sd;
+  double frequency;
+  double frequency_sd;
+  double skew;
+  double root_delay;
+  double root_dispersion;
+} SST_TrackingData;
+
 /* Init and fini functions */
 extern void SST_Initialise(void);
 extern void SST_Finalise(void);
@@ -84,6 +107,13 @@ SST_GetTrackingData(SST_Stats inst, struct timespec *ref_time,
                     double *frequency, double *frequency_sd, double *skew,
                     double *root_delay, double *root_dispersion);
 
+/* Get data needed for selection of multiple sources in one pass */
+extern void SST_GetSelectionDataBatch(SST_Stats *insts, int n, struct timespec *now,
+                                      SST_SelectionData *data);
+
+/* Get data needed for tracking of multiple sources in one pass */
+extern void SST_GetTrackingDataBatch(SST_Stats *insts, int n, SST_TrackingData *data);
+
 /* This routine is called when the local machine clock parameters are
    changed.  It adjusts all existing samples that we are holding for
    each peer so that it looks like they were made under the new clock
@@ -102,6 +132,10 @@ SST_GetTrackingData(SST_Stats inst, struct timespec *ref_time,
 
 extern void SST_SlewSamples(SST_Stats inst, struct timespec *when, double dfreq, double doffset);
 
+/* This routine does the same for all instances.  The samples are adjusted
+   later when the instances are accessed. */
+extern void SST_SlewAllSamples(struct timespec *when, double dfreq, double doffset);
+
 /* This routine corrects already accumulated samples to improve the
    frequency estimate when a new sample is accumulated */
 extern void SST_CorrectOffset(SST_Stats inst, double doffset);
@@ -183,6 +183,25 @@ NIO_Finalise(void)
 {
 }
 
+int
+NIO_GetServerSocketStats(uint32_t *min_rx_messages, uint32_t *max_rx_messages)
+{
+  *min_rx_messages = *max_rx_messages = 0;
+  return 0;
+}
+
+int
+NIO_GetServerSocketReport(int index, RPT_ServerSocketReport *report)
+{
+  return 0;
+}
+
+void
+NIO_GetPtpMessageStats(uint32_t *rx_messages, uint32_t *tx_messages)
+{
+  *rx_messages = *tx_messages = 0;
+}
+
 void
 NSR_Initialise(void)
 {
@@ -413,6 +432,11 @@ RCL_ReportSource(RPT_SourceReport *report, struct timespec *now)
   memset(report, 0, sizeof (*report));
 }
 
+void
+RCL_ReportSourcestats(RPT_SourcestatsReport *report)
+{
+}
+
 #endif /* !FEAT_REFCLOCK */
 
 #ifndef FEAT_SIGND
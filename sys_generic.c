@@ -77,6 +77,9 @@ static struct timespec slew_start;
 #define MIN_SLEW_TIMEOUT 1.0
 #define MAX_SLEW_TIMEOUT 1.0e4
 
+/* Duration of the currently running slew */
+static double slew_duration;
+
 /* Scheduler timeout ID for ending of the currently running slew */
 static SCH_TimeoutID slew_timeout_id;
 
@@ -102,6 +105,31 @@ static int fastslew_active;
 static void handle_end_of_slew(void *anything);
 static void update_slew(void);
 
+/* ================================================== */
+/* Provide the local module with a model of offset_convert() which it can
+   use to cook timestamps without calling the driver */
+
+static void
+update_cooking_model(void)
+{
+  LCL_CookingModel model;
+
+  /* The correction of the system driver is not known in advance */
+  if (drv_get_offset_correction && fastslew_active) {
+    lcl_SetCookingModel(NULL);
+    return;
+  }
+
+  model.ref = slew_start;
+  model.offset = -offset_register;
+  model.rate = slew_freq;
+  model.err = slew_error;
+  model.err_interval = max_freq_change_delay;
+  model.valid_interval = slew_duration;
+
+  lcl_SetCookingModel(&model);
+}
+
 /* ================================================== */
 /* Adjust slew_start on clock step */
 
@@ -116,6 +144,7 @@ handle_step(struct timespec *raw, struct timespec *cooked, double dfreq,
     update_slew();
   } else if (change_type == LCL_ChangeStep) {
     UTI_AddDoubleToTimespec(&slew_start, -doffset, &slew_start);
+    update_cooking_model();
   }
 }
 
@@ -245,6 +274,9 @@ update_slew(void)
   UTI_AddDoubleToTimespec(&now, duration, &end_of_slew);
   slew_timeout_id = SCH_AddTimeout(&end_of_slew, handle_end_of_slew, NULL);
   slew_start = now;
+  slew_duration = duration;
+
+  update_cooking_model();
 
   DEBUG_LOG("slew offset=%e corr_rate=%e base_freq=%f total_freq=%f slew_freq=%e duration=%f slew_error=%e",
       offset_register, correction_rate, base_freq, total_freq, slew_freq,
@@ -303,8 +335,11 @@ offset_convert(struct timespec *raw,
 
   if (drv_get_offset_correction && fastslew_active) {
     drv_get_offset_correction(raw, &fastslew_corr, &fastslew_err);
-    if (fastslew_corr == 0.0 && fastslew_err == 0.0)
+    if (fastslew_corr == 0.0 && fastslew_err == 0.0) {
       fastslew_active = 0;
+      /* The correction is known again */
+      update_cooking_model();
+    }
   } else {
     fastslew_corr = fastslew_err = 0.0;
   }
@@ -418,6 +453,8 @@ SYS_Generic_Finalise(void)
   LCL_ReadRawTime(&now);
   stop_fastslew(&now);
 
+  lcl_SetCookingModel(NULL);
+
   LCL_RemoveParameterChangeHandler(handle_step, NULL);
 }
 
@@ -843,24 +843,25 @@ process_phc_readings(struct timespec ts[][3], int n, double precision,
 /* ================================================== */
 
 static int
-get_phc_sample(int phc_fd, double precision, struct timespec *phc_ts,
-               struct timespec *sys_ts, double *err)
+get_phc_readings(int phc_fd, int n, struct timespec ts[][3])
 {
-  struct timespec ts[PHC_READINGS][3];
   struct ptp_sys_offset sys_off;
   int i;
 
+  if (n > PTP_MAX_SAMPLES)
+    return 0;
+
   /* Silence valgrind */
   memset(&sys_off, 0, sizeof (sys_off));
 
-  sys_off.n_samples = PHC_READINGS;
+  sys_off.n_samples = n;
 
   if (ioctl(phc_fd, PTP_SYS_OFFSET, &sys_off)) {
     DEBUG_LOG("ioctl(%s) failed : %s", "PTP_SYS_OFFSET", strerror(errno));
     return 0;
   }
 
-  for (i = 0; i < PHC_READINGS; i++) {
+  for (i = 0; i < n; i++) {
     ts[i][0].tv_sec = sys_off.ts[i * 2].sec;
     ts[i][0].tv_nsec = sys_off.ts[i * 2].nsec;
     ts[i][1].tv_sec = sys_off.ts[i * 2 + 1].sec;
@@ -869,31 +870,32 @@ get_phc_sample(int phc_fd, double precision, struct timespec *phc_ts,
     ts[i][2].tv_nsec = sys_off.ts[i * 2 + 2].nsec;
   }
 
-  return process_phc_readings(ts, PHC_READINGS, precision, phc_ts, sys_ts, err);
+  return 1;
 }
 
 /* ================================================== */
 
 static int
-get_extended_phc_sample(int phc_fd, double precision, struct timespec *phc_ts,
-                        struct timespec *sys_ts, double *err)
+get_extended_phc_readings(int phc_fd, int n, struct timespec ts[][3])
 {
 #ifdef PTP_SYS_OFFSET_EXTENDED
-  struct timespec ts[PHC_READINGS][3];
   struct ptp_sys_offset_extended sys_off;
   int i;
 
+  if (n > PTP_MAX_SAMPLES)
+    return 0;
+
   /* Silence valgrind */
   memset(&sys_off, 0, sizeof (sys_off));
 
-  sys_off.n_samples = PHC_READINGS;
+  sys_off.n_samples = n;
 
   if (ioctl(phc_fd, PTP_SYS_OFFSET_EXTENDED, &sys_off)) {
     DEBUG_LOG("ioctl(%s) failed : %s", "PTP_SYS_OFFSET_EXTENDED", strerror(errno));
     return 0;
   }
 
-  for (i = 0; i < PHC_READINGS; i++) {
+  for (i = 0; i < n; i++) {
     ts[i][0].tv_sec = sys_off.ts[i][0].sec;
     ts[i][0].tv_nsec = sys_off.ts[i][0].nsec;
     ts[i][1].tv_sec = sys_off.ts[i][1].sec;
@@ -902,7 +904,7 @@ get_extended_phc_sample(int phc_fd, double precision, struct timespec *phc_ts,
     ts[i][2].tv_nsec = sys_off.ts[i][2].nsec;
   }
 
-  return process_phc_readings(ts, PHC_READINGS, precision, phc_ts, sys_ts, err);
+  return 1;
 #else
   return 0;
 #endif
@@ -910,6 +912,34 @@ get_extended_phc_sample(int phc_fd, double precision, struct timespec *phc_ts,
 
 /* ================================================== */
 
+static int
+get_phc_sample(int phc_fd, double precision, struct timespec *phc_ts,
+               struct timespec *sys_ts, double *err)
+{
+  struct timespec ts[PHC_READINGS][3];
+
+  if (!get_phc_readings(phc_fd, PHC_READINGS, ts))
+    return 0;
+
+  return process_phc_readings(ts, PHC_READINGS, precision, phc_ts, sys_ts, err);
+}
+
+/* ================================================== */
+
+static int
+get_extended_phc_sample(int phc_fd, double precision, struct timespec *phc_ts,
+                        struct timespec *sys_ts, double *err)
+{
+  struct timespec ts[PHC_READINGS][3];
+
+  if (!get_extended_phc_readings(phc_fd, PHC_READINGS, ts))
+    return 0;
+
+  return process_phc_readings(ts, PHC_READINGS, precision, phc_ts, sys_ts, err);
+}
+
+/* ================================================== */
+
 static int
 get_precise_phc_sample(int phc_fd, double precision, struct timespec *phc_ts,
 		       struct timespec *sys_ts, double *err)
@@ -995,6 +1025,38 @@ SYS_Linux_GetPHCSample(int fd, int nocrossts, double precision, int *reading_mod
 
 /* ================================================== */
 
+int
+SYS_Linux_GetPHCReadings(int fd, int nocrossts, int *reading_mode, int max_readings,
+                         struct timespec tss[][3])
+{
+  struct timespec phc_ts, sys_ts;
+  double err;
+  int n;
+
+  n = MIN(max_readings, PTP_MAX_SAMPLES);
+  if (n < 1)
+    return 0;
+
+  if ((*reading_mode == 2 || !*reading_mode) && !nocrossts &&
+      get_precise_phc_sample(fd, 0.0, &phc_ts, &sys_ts, &err)) {
+    *reading_mode = 2;
+    tss[0][0] = tss[0][2] = sys_ts;
+    tss[0][1] = phc_ts;
+    return 1;
+  } else if ((*reading_mode == 3 || !*reading_mode) &&
+      get_extended_phc_readings(fd, n, tss)) {
+    *reading_mode = 3;
+    return n;
+  } else if ((*reading_mode == 1 || !*reading_mode) &&
+      get_phc_readings(fd, n, tss)) {
+    *reading_mode = 1;
+    return n;
+  }
+  return 0;
+}
+
+/* ================================================== */
+
 int
 SYS_Linux_SetPHCExtTimestamping(int fd, int pin, int channel,
                                 int rising, int falling, int enable)
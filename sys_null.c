@@ -47,6 +47,24 @@ static struct timespec last_update;
 /* Minimum interval between updates when frequency is constant */
 #define MIN_UPDATE_INTERVAL 1000.0
 
+/* ================================================== */
+/* Provide the local module with a model of offset_convert() */
+
+static void
+update_cooking_model(void)
+{
+  LCL_CookingModel model;
+
+  model.ref = last_update;
+  model.offset = -offset_register;
+  model.rate = -1.0e-6 * freq;
+  model.err = 0.0;
+  model.err_interval = 0.0;
+  model.valid_interval = MIN_UPDATE_INTERVAL;
+
+  lcl_SetCookingModel(&model);
+}
+
 /* ================================================== */
 
 static void
@@ -60,6 +78,8 @@ update_offset(void)
   offset_register += 1.0e-6 * freq * duration;
   last_update = now;
 
+  update_cooking_model();
+
   DEBUG_LOG("System clock offset=%e freq=%f", offset_register, freq);
 }
 
@@ -78,6 +98,7 @@ set_frequency(double freq_ppm)
 {
   update_offset();
   freq = freq_ppm;
+  update_cooking_model();
 
   return freq;
 }
@@ -88,6 +109,7 @@ static void
 accrue_offset(double offset, double corr_rate)
 {
   offset_register += offset;
+  update_cooking_model();
 }
 
 /* ================================================== */
@@ -128,6 +150,7 @@ SYS_Null_Initialise(void)
 
   lcl_RegisterSystemDrivers(read_frequency, set_frequency, accrue_offset,
                             apply_step_offset, offset_convert, NULL, NULL);
+  update_cooking_model();
 
   LOG(LOGS_INFO, "Disabled control of system clock");
 }
@@ -21,18 +21,16 @@
 #include <hwclock.c>
 #include "test.h"
 
-void
-test_unit(void)
+static void
+test_tracking(void)
 {
   struct timespec start_hw_ts, start_local_ts, hw_ts, local_ts, ts;
   HCL_Instance clock;
   double freq, jitter, interval, dj, sum;
   int i, j, k, count;
 
-  LCL_Initialise();
-
   for (i = 1; i <= 8; i++) {
-    clock = HCL_CreateInstance(random() % (1 << i), 1 << i, 1.0);
+    clock = HCL_CreateInstance(random() % (1 << i), 1 << i, 1.0, 1.0);
 
     for (j = 0, count = 0, sum = 0.0; j < 100; j++) {
       UTI_ZeroTimespec(&start_hw_ts);
@@ -79,6 +77,101 @@ test_unit(void)
 
     HCL_DestroyInstance(clock);
   }
+}
+
+/* Simulated PHC with a random walk in frequency relative to the system
+   clock, which is read on each received packet */
+static struct {
+  struct timespec local_ts;
+  struct timespec hw_ts;
+  double freq;
+  double wander;
+  double jitter;
+} phc;
+
+static void
+advance_phc(double interval)
+{
+  UTI_AddDoubleToTimespec(&phc.local_ts, interval, &phc.local_ts);
+  UTI_AddDoubleToTimespec(&phc.hw_ts, interval * (1.0 + phc.freq), &phc.hw_ts);
+  phc.freq += TST_GetRandomDouble(-1.0, 1.0) * phc.wander * sqrt(interval);
+}
+
+static double
+run_phc(HCL_Instance clock, int packets, double interval, double *max_error)
+{
+  struct timespec hw_ts, ts;
+  double error;
+  int i, samples;
+
+  for (i = samples = 0, *max_error = 0.0; i < packets; i++) {
+    advance_phc(interval);
+
+    if (HCL_NeedsNewSample(clock, &phc.local_ts)) {
+      UTI_AddDoubleToTimespec(&phc.hw_ts, TST_GetRandomDouble(-phc.jitter, phc.jitter),
+                              &hw_ts);
+      HCL_AccumulateSample(clock, &hw_ts, &phc.local_ts, 2.0 * phc.jitter);
+      samples++;
+    }
+
+    if (!HCL_CookTime(clock, &phc.hw_ts, &ts, NULL))
+      continue;
+
+    error = fabs(UTI_DiffTimespecsToDouble(&ts, &phc.local_ts));
+    *max_error = MAX(*max_error, error);
+  }
+
+  return (double)packets * interval / samples;
+}
+
+static void
+test_separation(void)
+{
+  double separation, max_error, sum_stable, sum_wander, sum_error;
+  HCL_Instance clock;
+  int i, runs = 100;
+
+  for (i = 0, sum_stable = sum_wander = sum_error = 0.0; i < runs; i++) {
+    clock = HCL_CreateInstance(2, 16, 1.0, 16.0);
+
+    UTI_ZeroTimespec(&phc.local_ts);
+    UTI_ZeroTimespec(&phc.hw_ts);
+    UTI_AddDoubleToTimespec(&phc.local_ts, TST_GetRandomDouble(0.0, 1e9), &phc.local_ts);
+    UTI_AddDoubleToTimespec(&phc.hw_ts, TST_GetRandomDouble(0.0, 1e9), &phc.hw_ts);
+    phc.freq = TST_GetRandomDouble(-1.0e-4, 1.0e-4);
+    phc.jitter = TST_GetRandomDouble(10.0e-9, 1000.0e-9);
+
+    /* Stable clocks are read at the maximum interval */
+    phc.wander = 0.0;
+    run_phc(clock, 1000, 0.1, &max_error);
+    separation = run_phc(clock, 10000, 0.1, &max_error);
+    DEBUG_LOG("stable separation=%f error/jitter=%f", separation, max_error / phc.jitter);
+    TEST_CHECK(separation > 8.0);
+    TEST_CHECK(max_error <= 2.0 * phc.jitter);
+    sum_stable += separation;
+
+    /* Clocks with a wandering frequency are read more frequently */
+    phc.wander = 0.01 * phc.jitter;
+    separation = run_phc(clock, 10000, 0.1, &max_error);
+    DEBUG_LOG("wander separation=%f error/jitter=%f", separation, max_error / phc.jitter);
+    sum_wander += separation;
+    sum_error += max_error / phc.jitter;
+
+    HCL_DestroyInstance(clock);
+  }
+
+  TEST_CHECK(sum_stable / runs > 14.0);
+  TEST_CHECK(sum_wander / runs < 8.0);
+  TEST_CHECK(sum_error / runs < 4.0);
+}
+
+void
+test_unit(void)
+{
+  LCL_Initialise();
+
+  test_tracking();
+  test_separation();
 
   LCL_Finalise();
 }
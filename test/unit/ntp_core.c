@@ -42,6 +42,9 @@ static int req_length, res_length;
 #define NIO_IsServerSocket(fd) (fd == 100)
 #define NIO_IsServerSocketOpen() 1
 #define NIO_SendPacket(msg, to, from, len, process_tx) (memcpy(&req_buffer, msg, len), req_length = len, 1)
+/* Replace the macros recording handler names with schedstats */
+#undef SCH_AddTimeoutByDelay
+#undef SCH_AddTimeoutInClass
 #define SCH_AddTimeoutByDelay(delay, handler, arg) (1 ? 102 : (handler(arg), 1))
 #define SCH_AddTimeoutInClass(delay, separation, randomness, class, handler, arg) \
   add_timeout_in_class(delay, separation, randomness, class, handler, arg)
@@ -410,6 +413,7 @@ test_unit(void)
   NIO_Initialise();
   NCR_Initialise();
   REF_Initialise();
+  SST_Initialise();
   KEY_Initialise();
 
   CNF_SetupAccessRestrictions();
@@ -600,6 +604,7 @@ test_unit(void)
   NCR_Finalise();
   NIO_Finalise();
   SRC_Finalise();
+  SST_Finalise();
   SCH_Finalise();
   LCL_Finalise();
   CNF_Finalise();
@@ -0,0 +1,402 @@
+/*
+ **********************************************************************
+ * Copyright (C) Miroslav Lichvar  2026
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ **********************************************************************
+ */
+
+#include <config.h>
+#include "test.h"
+
+#if defined(FEAT_NTP) && defined(HAVE_LINUX_TIMESTAMPING)
+
+#include <ntp_sources.h>
+#include <sched.h>
+
+#define MAX_TIMEOUTS 64
+
+static struct {
+  SCH_TimeoutHandler handler;
+  void *arg;
+  double delay;
+} timeouts[MAX_TIMEOUTS];
+
+static int processed_responses;
+static int last_response;
+static int in_io;
+
+static SCH_TimeoutID
+add_timeout(double delay, SCH_TimeoutHandler handler, void *arg)
+{
+  int i;
+
+  for (i = 0; i < MAX_TIMEOUTS; i++) {
+    if (timeouts[i].handler)
+      continue;
+    timeouts[i].handler = handler;
+    timeouts[i].arg = arg;
+    timeouts[i].delay = delay;
+    return i + 1;
+  }
+
+  assert(0);
+  return 0;
+}
+
+static void
+remove_timeout(SCH_TimeoutID id)
+{
+  if (id == 0)
+    return;
+  assert(id <= MAX_TIMEOUTS && timeouts[id - 1].handler);
+  timeouts[id - 1].handler = NULL;
+}
+
+/* Dispatch the timeouts with a delay not larger than the specified delay */
+static int
+dispatch_timeouts(double max_delay)
+{
+  SCH_TimeoutHandler handler;
+  int i, n;
+
+  for (i = n = 0; i < MAX_TIMEOUTS; i++) {
+    if (!timeouts[i].handler || timeouts[i].delay > max_delay)
+      continue;
+    handler = timeouts[i].handler;
+    timeouts[i].handler = NULL;
+    handler(timeouts[i].arg);
+    n++;
+  }
+
+  return n;
+}
+
+static void
+process_rx(NTP_Remote_Address *remote_addr, NTP_Local_Address *local_addr,
+           NTP_Local_Timestamp *rx_ts, NTP_Packet *message, int length)
+{
+  /* Responses must not be processed from the sending code */
+  TEST_CHECK(!in_io);
+  TEST_CHECK(length == NTP_HEADER_LENGTH);
+  TEST_CHECK(ntohl(message->transmit_ts.hi) == remote_addr->port);
+  last_response = ntohl(message->transmit_ts.lo);
+  processed_responses++;
+}
+
+#undef SCH_AddTimeoutByDelay
+#define SCH_AddTimeoutByDelay(delay, handler, arg) add_timeout(delay, handler, arg)
+#define SCH_RemoveTimeout(id) remove_timeout(id)
+#define NSR_ProcessRx(remote_addr, local_addr, rx_ts, message, length) \
+  process_rx(remote_addr, local_addr, rx_ts, message, length)
+
+#include <ntp_io_linux.c>
+
+static int
+open_socket(IPSockAddr *addr)
+{
+  struct sockaddr_in sin;
+  socklen_t sin_len;
+  int sock_fd;
+
+  SCK_GetLoopbackIPAddress(IPADDR_INET4, &addr->ip_addr);
+  addr->port = 0;
+
+  sock_fd = SCK_OpenUdpSocket(NULL, addr, NULL, 0);
+  TEST_CHECK(sock_fd >= 0);
+
+  /* Get the assigned port in order to send packets to the socket itself */
+  sin_len = sizeof (sin);
+  TEST_CHECK(getsockname(sock_fd, (struct sockaddr *)&sin, &sin_len) == 0);
+  addr->port = ntohs(sin.sin_port);
+
+  return sock_fd;
+}
+
+static void
+send_packet(int sock_fd, IPSockAddr *addr, uint32_t seq)
+{
+  NTP_Remote_Address remote_addr;
+  NTP_Local_Address local_addr;
+  SCK_Message message;
+  NTP_Packet packet;
+  int sent;
+
+  memset(&packet, 0, sizeof (packet));
+  packet.lvm = NTP_LVM(LEAP_Normal, NTP_VERSION, MODE_CLIENT);
+  packet.transmit_ts.lo = htonl(seq);
+
+  SCK_InitMessage(&message, SCK_ADDR_IP);
+  message.data = &packet;
+  message.length = NTP_HEADER_LENGTH;
+  message.remote_addr.ip = *addr;
+
+  sent = SCK_SendMessage(sock_fd, &message, 0);
+  TEST_CHECK(sent);
+
+  /* Don't let the packets received by the socket fill the receive buffer */
+  TEST_CHECK(SCK_ReceiveMessage(sock_fd, 0));
+
+  remote_addr = *addr;
+  local_addr.ip_addr = addr->ip_addr;
+  local_addr.if_index = INVALID_IF_INDEX;
+  local_addr.sock_fd = sock_fd;
+
+  NIO_Linux_SaveTxPacket(sock_fd, &message, &packet, &remote_addr, &local_addr, sent);
+}
+
+/* Receive the TX timestamps from the error queue and check they are matched
+   to the packets with sequence numbers first_seq, first_seq + 1, ... */
+
+static void
+check_tx_timestamps(int sock_fd, IPSockAddr *addr, int n, uint32_t first_id,
+                    uint32_t first_seq, int ring_size)
+{
+  NTP_Local_Address local_addr;
+  SCK_Message *message;
+  struct TxSocket *s;
+  NTP_Packet *packet;
+  int i, found;
+
+  s = get_tx_socket(sock_fd);
+  TEST_CHECK(s);
+
+  for (i = 0; (message = SCK_ReceiveMessage(sock_fd, SCK_FLAG_MSG_ERRQUEUE)); i++) {
+    TEST_CHECK(i < n);
+    TEST_CHECK(message->timestamp.id == first_id + i);
+    TEST_CHECK(!UTI_IsZeroTimespec(&message->timestamp.kernel));
+
+    local_addr.sock_fd = sock_fd;
+    found = find_tx_packet(s, message, &local_addr);
+
+    /* Only the last packets are saved */
+    TEST_CHECK(found == (i >= n - ring_size));
+    if (!found)
+      continue;
+
+    packet = message->data;
+    TEST_CHECK(message->length == NTP_HEADER_LENGTH);
+    TEST_CHECK(ntohl(packet->transmit_ts.lo) == first_seq + i);
+    TEST_CHECK(UTI_CompareIPs(&message->remote_addr.ip.ip_addr, &addr->ip_addr, NULL) == 0);
+    TEST_CHECK(message->remote_addr.ip.port == addr->port);
+    TEST_CHECK(UTI_CompareIPs(&local_addr.ip_addr, &addr->ip_addr, NULL) == 0);
+
+    /* Each saved packet can be matched only once */
+    TEST_CHECK(!find_tx_packet(s, message, &local_addr));
+  }
+
+  TEST_CHECK(i == n);
+}
+
+static void
+test_tx_ids(void)
+{
+  int i, j, n, sock_fd, events = 0;
+  uint32_t seq, first_seq;
+  struct TxSocket *s;
+  IPSockAddr addr;
+
+  sock_fd = open_socket(&addr);
+  TEST_CHECK(NIO_Linux_SetTimestampSocketOptions(sock_fd, 1, &events));
+
+  s = get_tx_socket(sock_fd);
+  TEST_REQUIRE(s);
+  TEST_CHECK(s->all_tx);
+
+  for (i = 0, seq = 0; i < 100; i++) {
+    n = random() % (2 * MAX_CLIENT_TX_PACKETS) + 1;
+    first_seq = seq;
+
+    for (j = 0; j < n; j++)
+      send_packet(sock_fd, &addr, seq++);
+
+    if (random() % 2) {
+      /* Reset the counter with the timestamps still in the error queue */
+      reset_tx_ids(sock_fd, s);
+
+      s = get_tx_socket(sock_fd);
+      TEST_CHECK(s);
+      TEST_CHECK(s->next_id == 0);
+      for (j = 0; j < s->size; j++)
+        TEST_CHECK(!s->packets[j].valid);
+
+      /* The old timestamps must not be matched to the new packets */
+      n = random() % 4 + 1;
+      first_seq = seq;
+
+      for (j = 0; j < n; j++)
+        send_packet(sock_fd, &addr, seq++);
+    }
+
+    check_tx_timestamps(sock_fd, &addr, n, s->next_id - n, first_seq, s->size);
+  }
+
+  NIO_Linux_NotifySocketClosing(sock_fd);
+  TEST_CHECK(!get_tx_socket(sock_fd));
+  SCK_CloseSocket(sock_fd);
+}
+
+#define TEST_SOCK_FD 10
+
+static int
+count_pending(int *deferred, int *released)
+{
+  struct PendingTx *table;
+  int i, n;
+
+  table = get_pending_table(TEST_SOCK_FD);
+  TEST_CHECK(table);
+
+  for (i = n = *deferred = *released = 0; i < MAX_PENDING_TX; i++) {
+    if (table[i].valid)
+      n++;
+    if (table[i].deferred)
+      (*deferred)++;
+    if (!table[i].valid && table[i].deferred)
+      (*released)++;
+  }
+
+  return n;
+}
+
+static void
+send_request(int port)
+{
+  NTP_Remote_Address remote_addr;
+
+  remote_addr.ip_addr.family = IPADDR_INET4;
+  remote_addr.ip_addr.addr.in4 = 0x7f000001;
+  remote_addr.port = port;
+
+  in_io = 1;
+  add_pending_tx(TEST_SOCK_FD, &remote_addr);
+  in_io = 0;
+}
+
+static int
+receive_response(int port, int id)
+{
+  NTP_Local_Address local_addr;
+  NTP_Local_Timestamp local_ts;
+  SCK_Message message;
+  NTP_Packet packet;
+
+  memset(&packet, 0, sizeof (packet));
+  packet.lvm = NTP_LVM(LEAP_Normal, NTP_VERSION, MODE_SERVER);
+  packet.transmit_ts.hi = htonl(port);
+  packet.transmit_ts.lo = htonl(id);
+
+  SCK_InitMessage(&message, SCK_ADDR_IP);
+  message.data = &packet;
+  message.length = NTP_HEADER_LENGTH;
+  message.remote_addr.ip.ip_addr.family = IPADDR_INET4;
+  message.remote_addr.ip.ip_addr.addr.in4 = 0x7f000001;
+  message.remote_addr.ip.port = port;
+
+  local_addr.ip_addr.family = IPADDR_UNSPEC;
+  local_addr.if_index = INVALID_IF_INDEX;
+  local_addr.sock_fd = TEST_SOCK_FD;
+  LCL_ReadCookedTime(&local_ts.ts, &local_ts.err);
+  local_ts.source = NTP_TS_DAEMON;
+
+  return defer_response(&message, &local_addr, &local_ts);
+}
+
+static void
+test_deferred_responses(void)
+{
+  int i, j, n, deferred, released;
+
+  /* Nothing is deferred without a pending request */
+  TEST_CHECK(!receive_response(1, 0));
+
+  for (i = 0; i < 100; i++) {
+    processed_responses = 0;
+
+    /* Response processed on timeout */
+    send_request(1);
+    TEST_CHECK(count_pending(&deferred, &released) == 1 && deferred == 0);
+    TEST_CHECK(receive_response(1, 0));
+    TEST_CHECK(count_pending(&deferred, &released) == 1 && deferred == 1);
+    TEST_CHECK(dispatch_timeouts(DEFER_TIMEOUT / 2) == 0);
+    TEST_CHECK(processed_responses == 0);
+    TEST_CHECK(dispatch_timeouts(DEFER_TIMEOUT) == 1);
+    TEST_CHECK(processed_responses == 1);
+    TEST_CHECK(count_pending(&deferred, &released) == 0 && deferred == 0);
+
+    /* Response to a replaced request */
+    send_request(2);
+    TEST_CHECK(receive_response(2, 0));
+    send_request(2);
+    TEST_CHECK(processed_responses == 1);
+    TEST_CHECK(count_pending(&deferred, &released) == 1 && deferred == 1 && released == 1);
+    TEST_CHECK(dispatch_timeouts(0.0) == 1);
+    TEST_CHECK(processed_responses == 2);
+    TEST_CHECK(count_pending(&deferred, &released) == 1 && deferred == 0);
+    TEST_CHECK(receive_response(2, 1));
+
+    /* Second response to the same request, the deferred response needs to
+       be processed before it */
+    TEST_CHECK(!receive_response(2, 2));
+    TEST_CHECK(processed_responses == 3 && last_response == 1);
+    TEST_CHECK(count_pending(&deferred, &released) == 0 && deferred == 0);
+    TEST_CHECK(dispatch_timeouts(DEFER_TIMEOUT) == 0);
+
+    /* Full table */
+    n = MAX_PENDING_TX + random() % MAX_PENDING_TX;
+    for (j = 0; j < n; j++) {
+      send_request(100 + j);
+      TEST_CHECK(count_pending(&deferred, &released) == MIN(j + 1, MAX_PENDING_TX));
+      if (random() % 2)
+        TEST_CHECK(receive_response(100 + j, 0));
+    }
+    TEST_CHECK(processed_responses == 3);
+    TEST_CHECK(dispatch_timeouts(0.0) == 0);
+    j = count_pending(&deferred, &released);
+    TEST_CHECK(dispatch_timeouts(DEFER_TIMEOUT) == deferred);
+    TEST_CHECK(processed_responses == 3 + deferred);
+    TEST_CHECK(count_pending(&deferred, &released) == j - (processed_responses - 3));
+    TEST_CHECK(deferred == 0);
+
+    remove_pending_table(TEST_SOCK_FD);
+  }
+}
+
+void
+test_unit(void)
+{
+  CNF_Initialise(0, 0);
+  LCL_Initialise();
+  TST_RegisterDummyDrivers();
+  SCH_Initialise();
+  SCK_Initialise(IPADDR_UNSPEC);
+  NIO_Linux_Initialise();
+
+  test_tx_ids();
+  test_deferred_responses();
+
+  NIO_Linux_Finalise();
+  SCK_Finalise();
+  SCH_Finalise();
+  LCL_Finalise();
+  CNF_Finalise();
+}
+#else
+void
+test_unit(void)
+{
+  TEST_REQUIRE(0);
+}
+#endif
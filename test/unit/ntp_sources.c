@@ -26,6 +26,7 @@
 #include <conf.h>
 #include <cmdparse.h>
 #include <nameserv_async.h>
+#include <sys/resource.h>
 #include <ntp_core.h>
 #include <ntp_io.h>
 
@@ -49,6 +50,13 @@ static void change_remote_address(NCR_Instance inst, NTP_Remote_Address *remote_
 
 #undef NCR_ChangeRemoteAddress
 
+/* More sources than the previous limit of the hash table */
+#define MANY_SOURCES 100000
+
+/* Maximum memory needed by a source without samples, including the
+   NCR, SRC, and SST instances and the hash table */
+#define MAX_BYTES_PER_SOURCE 2048
+
 static void
 resolve_random_address(DNS_Status status, int rand_bits)
 {
@@ -107,6 +115,55 @@ change_remote_address(NCR_Instance inst, NTP_Remote_Address *remote_addr, int nt
     TEST_CHECK(UTI_IsIPReal(&saved_address_update.old_address.ip_addr));
 }
 
+static void
+test_many_sources(CPS_NTP_Source *source)
+{
+  NTP_Remote_Address addr;
+  struct timespec ts1, ts2;
+  double bytes_per_source;
+  struct rusage usage;
+  long max_rss;
+  int i, slot;
+
+  getrusage(RUSAGE_SELF, &usage);
+  max_rss = usage.ru_maxrss;
+  clock_gettime(CLOCK_MONOTONIC, &ts1);
+
+  for (i = 0; i < MANY_SOURCES; i++) {
+    addr.ip_addr.family = IPADDR_INET4;
+    addr.ip_addr.addr.in4 = 0x0a000000 + i;
+    addr.port = 123;
+    TEST_CHECK(NSR_AddSource(&addr, NTP_SERVER, &source->params, NULL) == NSR_Success);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &ts2);
+  getrusage(RUSAGE_SELF, &usage);
+
+  TEST_CHECK(n_sources == MANY_SOURCES);
+
+  bytes_per_source = 1024.0 * (usage.ru_maxrss - max_rss) / MANY_SOURCES;
+
+  LOG(LOGS_INFO, "added %d sources in %.3f seconds, max RSS increased by %ld kB (%.0f bytes per source)",
+      MANY_SOURCES, UTI_DiffTimespecsToDouble(&ts2, &ts1), usage.ru_maxrss - max_rss,
+      bytes_per_source);
+
+  TEST_CHECK(bytes_per_source <= MAX_BYTES_PER_SOURCE);
+
+  for (i = 0; i < MANY_SOURCES; i += 97) {
+    addr.ip_addr.addr.in4 = 0x0a000000 + i;
+    TEST_CHECK(find_slot2(&addr, &slot) == 2);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &ts1);
+  NSR_RemoveAllSources();
+  clock_gettime(CLOCK_MONOTONIC, &ts2);
+
+  TEST_CHECK(n_sources == 0);
+
+  LOG(LOGS_INFO, "removed %d sources in %.3f seconds",
+      MANY_SOURCES, UTI_DiffTimespecsToDouble(&ts2, &ts1));
+}
+
 void
 test_unit(void)
 {
@@ -133,6 +190,7 @@ test_unit(void)
   NIO_Initialise();
   NCR_Initialise();
   REF_Initialise();
+  SST_Initialise();
   NSR_Initialise();
 
   CPS_ParseNTPSourceAdd(source_line, &source);
@@ -140,7 +198,8 @@ test_unit(void)
   TEST_CHECK(n_sources == 0);
 
   for (i = 0; i < 6; i++) {
-    TEST_CHECK(ARR_GetSize(records) == 1);
+    TEST_CHECK(ARR_GetSize(records) == 0);
+    TEST_CHECK(ARR_GetSize(record_table) == 1);
 
     DEBUG_LOG("collision mod %u", 1U << i);
 
@@ -343,11 +402,14 @@ test_unit(void)
     TEST_CHECK(!unresolved_sources);
   }
 
+  test_many_sources(&source);
+
   NSR_Finalise();
   REF_Finalise();
   NCR_Finalise();
   NIO_Finalise();
   SRC_Finalise();
+  SST_Finalise();
   SCH_Finalise();
   LCL_Finalise();
   PRV_Finalise();
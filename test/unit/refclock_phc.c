@@ -0,0 +1,321 @@
+/*
+ **********************************************************************
+ * Copyright (C) Miroslav Lichvar  2026
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ **********************************************************************
+ */
+
+#include <config.h>
+#include "test.h"
+
+#ifdef FEAT_PHC
+
+#include <local.h>
+
+/* Constant correction of the simulated system clock */
+static double mock_correction;
+
+#define LCL_GetOffsetCorrection(raw, corr, err) (*(corr) = mock_correction)
+
+#include <refclock_phc.c>
+#include <linux/ptp_clock.h>
+#include <sys/syscall.h>
+
+/* Descriptor of the simulated PHC handled by the ioctl() wrapper */
+#define MOCK_PHC_FD 1000
+
+static struct {
+  int precise;
+  struct timespec sys_time;
+  double offset;
+  double freq;
+  double min_delay;
+  double jitter;
+  double outlier_rate;
+  double outlier_delay;
+} mock;
+
+static void
+advance_mock(double interval)
+{
+  UTI_AddDoubleToTimespec(&mock.sys_time, interval, &mock.sys_time);
+  mock.offset += mock.freq * interval;
+}
+
+static void
+get_mock_reading(struct timespec ts[3])
+{
+  double d1, d2;
+
+  d1 = mock.min_delay / 2.0 + TST_GetRandomDouble(0.0, mock.jitter);
+  d2 = mock.min_delay / 2.0 + TST_GetRandomDouble(0.0, mock.jitter);
+
+  /* Delay the reading of the PHC, e.g. by an interrupt */
+  if (TST_GetRandomDouble(0.0, 1.0) < mock.outlier_rate)
+    d1 += TST_GetRandomDouble(0.0, mock.outlier_delay);
+
+  ts[0] = mock.sys_time;
+  advance_mock(d1);
+  UTI_AddDoubleToTimespec(&mock.sys_time, mock.offset, &ts[1]);
+  advance_mock(d2);
+  ts[2] = mock.sys_time;
+}
+
+int
+ioctl(int fd, unsigned long request, ...)
+{
+  struct ptp_sys_offset_extended *sys_off;
+  struct ptp_sys_offset_precise *precise;
+  struct timespec ts[3];
+  va_list ap;
+  void *arg;
+  int i, j;
+
+  va_start(ap, request);
+  arg = va_arg(ap, void *);
+  va_end(ap);
+
+  if (fd != MOCK_PHC_FD)
+    return syscall(SYS_ioctl, fd, request, arg);
+
+  if (request == PTP_SYS_OFFSET_PRECISE && mock.precise) {
+    precise = arg;
+    get_mock_reading(ts);
+    precise->device.sec = ts[1].tv_sec;
+    precise->device.nsec = ts[1].tv_nsec;
+    precise->sys_realtime.sec = ts[0].tv_sec;
+    precise->sys_realtime.nsec = ts[0].tv_nsec;
+    return 0;
+  }
+
+  if (request == PTP_SYS_OFFSET_EXTENDED) {
+    sys_off = arg;
+    if (sys_off->n_samples > PTP_MAX_SAMPLES) {
+      errno = EINVAL;
+      return -1;
+    }
+    for (i = 0; i < sys_off->n_samples; i++) {
+      get_mock_reading(ts);
+      for (j = 0; j < 3; j++) {
+        sys_off->ts[i][j].sec = ts[j].tv_sec;
+        sys_off->ts[i][j].nsec = ts[j].tv_nsec;
+      }
+    }
+    return 0;
+  }
+
+  errno = EOPNOTSUPP;
+  return -1;
+}
+
+static void
+init_phc(struct phc_instance *phc, int fit_polls)
+{
+  memset(phc, 0, sizeof (*phc));
+  phc->fd = MOCK_PHC_FD;
+  phc->fit = 1;
+  phc->fit_polls = fit_polls;
+  reset_fit(&phc->fit_data);
+}
+
+static void
+poll_phc(struct phc_instance *phc)
+{
+  struct timespec readings[FIT_READINGS][3];
+  int n;
+
+  n = SYS_Linux_GetPHCReadings(phc->fd, phc->nocrossts, &phc->mode, FIT_READINGS, readings);
+  TEST_CHECK(n == (mock.precise && !phc->nocrossts ? 1 : FIT_READINGS));
+  accumulate_readings(&phc->fit_data, readings, n, 1.0e-9);
+  phc->fit_data.polls++;
+}
+
+static void
+test_fit(void)
+{
+  struct timespec sys_ts, phc_ts, readings[1][3];
+  struct phc_instance phc;
+  double err, interval, max_error;
+  int i, j, polls;
+
+  for (i = 0; i < 1000; i++) {
+    memset(&mock, 0, sizeof (mock));
+    mock.precise = random() % 4 == 0;
+    UTI_AddDoubleToTimespec(&mock.sys_time, TST_GetRandomDouble(1.0e8, 2.0e9), &mock.sys_time);
+    mock.offset = TST_GetRandomDouble(-1.0, 1.0);
+    mock.freq = TST_GetRandomDouble(-1.0e-4, 1.0e-4);
+    mock.min_delay = TST_GetRandomDouble(1.0e-7, 2.0e-6);
+    mock.jitter = TST_GetRandomDouble(1.0e-9, 1.0e-7);
+    mock.outlier_rate = TST_GetRandomDouble(0.0, 0.1);
+    mock.outlier_delay = TST_GetRandomDouble(1.0e-6, 1.0e-4);
+
+    polls = 1 << (random() % 8);
+    interval = UTI_Log2ToDouble(-(random() % 8));
+
+    init_phc(&phc, polls);
+    phc.nocrossts = random() % 2;
+
+    for (j = 0; j < polls; j++) {
+      if (j > 0)
+        advance_mock(interval);
+      poll_phc(&phc);
+    }
+
+    TEST_CHECK(phc.mode == (mock.precise && !phc.nocrossts ? 2 : 3));
+    TEST_CHECK(get_fit(&phc.fit_data, &sys_ts, &phc_ts, &err));
+
+    /* The fitted offset has to be close to the offset of the mock
+       clock at the time of the sample */
+    max_error = mock.jitter + 2.0e-9;
+    if (polls < MIN_FIT_POLLS)
+      max_error += fabs(mock.freq) * interval * polls + mock.outlier_delay / 2.0;
+    else
+      max_error += fabs(mock.freq) * mock.min_delay;
+    if (mock.precise && !phc.nocrossts)
+      max_error += mock.min_delay + mock.jitter + mock.outlier_delay;
+
+    advance_mock(-UTI_DiffTimespecsToDouble(&mock.sys_time, &sys_ts));
+    DEBUG_LOG("polls=%d interval=%f error=%e max=%e", polls, interval,
+              UTI_DiffTimespecsToDouble(&phc_ts, &sys_ts) - mock.offset, max_error);
+    TEST_CHECK(fabs(UTI_DiffTimespecsToDouble(&phc_ts, &sys_ts) - mock.offset) <= max_error);
+    if (mock.precise && !phc.nocrossts)
+      TEST_CHECK(err == 0.0);
+    else
+      TEST_CHECK(fabs(err - mock.min_delay / 2.0 - mock.jitter / 2.0) <=
+                 mock.jitter / 2.0 + 1.0e-9);
+
+    /* A step drops the readings */
+    handle_step(NULL, NULL, 0.0, 1.0, LCL_ChangeStep, &phc);
+    TEST_CHECK(!get_fit(&phc.fit_data, &sys_ts, &phc_ts, &err));
+  }
+
+  /* Readings with a negative delay are ignored */
+  init_phc(&phc, 1);
+  memset(&readings, 0, sizeof (readings));
+  readings[0][0].tv_sec = 1;
+  accumulate_readings(&phc.fit_data, readings, 1, 1.0e-9);
+  TEST_CHECK(!get_fit(&phc.fit_data, &sys_ts, &phc_ts, &err));
+}
+
+static void
+test_slew(void)
+{
+  struct timespec sys_ts, phc_ts, raw, cooked;
+  struct phc_instance phc;
+  double err, interval, dfreq, doffset, max_error;
+  int i, j, polls;
+
+  for (i = 0; i < 1000; i++) {
+    memset(&mock, 0, sizeof (mock));
+    mock.precise = random() % 4 == 0;
+    UTI_AddDoubleToTimespec(&mock.sys_time, TST_GetRandomDouble(1.0e8, 2.0e9), &mock.sys_time);
+    mock.offset = TST_GetRandomDouble(-1.0, 1.0);
+    mock.freq = TST_GetRandomDouble(-1.0e-4, 1.0e-4);
+    mock.min_delay = TST_GetRandomDouble(1.0e-7, 2.0e-6);
+    mock.jitter = TST_GetRandomDouble(1.0e-9, 1.0e-7);
+    mock_correction = TST_GetRandomDouble(-1.0e-3, 1.0e-3);
+
+    polls = MIN_FIT_POLLS << (random() % 4);
+    interval = UTI_Log2ToDouble(-(random() % 8));
+
+    init_phc(&phc, polls);
+    phc.nocrossts = random() % 2;
+
+    for (j = 0; j < polls; j++) {
+      if (j > 0)
+        advance_mock(interval);
+
+      /* Slew the clock between the polls.  The frequency of the raw time
+         changes and the correction of the cooked time is updated. */
+      if (random() % 4 == 0) {
+        dfreq = TST_GetRandomDouble(-1.0e-5, 1.0e-5);
+        doffset = TST_GetRandomDouble(-1.0e-4, 1.0e-4);
+        raw = mock.sys_time;
+        UTI_AddDoubleToTimespec(&raw, mock_correction, &cooked);
+        mock.freq += dfreq;
+        mock_correction -= doffset;
+        handle_step(&raw, &cooked, dfreq, doffset, LCL_ChangeAdjust, &phc);
+      }
+
+      poll_phc(&phc);
+    }
+
+    TEST_CHECK(get_fit(&phc.fit_data, &sys_ts, &phc_ts, &err));
+
+    /* The fitted offset has to follow the current frequency of the clock */
+    max_error = mock.jitter + 2.0e-9 + fabs(mock.freq) * mock.min_delay;
+    if (mock.precise && !phc.nocrossts)
+      max_error += mock.min_delay + mock.jitter;
+
+    advance_mock(-UTI_DiffTimespecsToDouble(&mock.sys_time, &sys_ts));
+    DEBUG_LOG("polls=%d interval=%f error=%e max=%e", polls, interval,
+              UTI_DiffTimespecsToDouble(&phc_ts, &sys_ts) - mock.offset, max_error);
+    TEST_CHECK(fabs(UTI_DiffTimespecsToDouble(&phc_ts, &sys_ts) - mock.offset) <= max_error);
+  }
+
+  mock_correction = 0.0;
+}
+
+static void
+benchmark(void)
+{
+  struct timespec start, end, sys_ts, phc_ts;
+  struct phc_instance phc;
+  double err, elapsed;
+  int i, polls = 100000;
+
+  memset(&mock, 0, sizeof (mock));
+  mock.min_delay = 1.0e-6;
+  mock.jitter = 1.0e-8;
+  mock.outlier_rate = 0.01;
+  mock.outlier_delay = 2.0e-5;
+
+  init_phc(&phc, polls);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (i = 0; i < polls; i++) {
+    advance_mock(1.0e-3);
+    poll_phc(&phc);
+  }
+
+  TEST_CHECK(get_fit(&phc.fit_data, &sys_ts, &phc_ts, &err));
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  elapsed = UTI_DiffTimespecsToDouble(&end, &start);
+  LOG(LOGS_INFO, "Processed %d polls with %d readings in %.3f seconds (%.0f ns per poll)",
+      polls, FIT_READINGS, elapsed, elapsed / polls * 1.0e9);
+}
+
+void
+test_unit(void)
+{
+  LCL_Initialise();
+
+  test_fit();
+  test_slew();
+  benchmark();
+
+  LCL_Finalise();
+}
+#else
+void
+test_unit(void)
+{
+  TEST_REQUIRE(0);
+}
+#endif
@@ -0,0 +1,293 @@
+/*
+ **********************************************************************
+ * Copyright (C) Miroslav Lichvar  2026
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ **********************************************************************
+ */
+
+#include <config.h>
+#include "test.h"
+
+#ifdef FEAT_REFCLOCK
+
+#include <conf.h>
+#include <refclock.h>
+#include <util.h>
+
+#define MAX_TEST_SAMPLES 256
+#define MAX_TEST_MESSAGES 16
+
+struct test_sample {
+  struct timespec sys_ts;
+  double offset;
+  double error;
+  int pulse;
+  int leap;
+};
+
+/* Samples passed by the driver to the refclock module */
+static struct test_sample accepted_samples[MAX_TEST_SAMPLES];
+static int n_accepted_samples;
+static int n_dropped_samples;
+
+static int
+add_test_sample(struct timespec *sys_ts, double offset, int pulse, int leap, double error)
+{
+  struct test_sample *sample;
+
+  TEST_CHECK(n_accepted_samples < MAX_TEST_SAMPLES);
+  sample = &accepted_samples[n_accepted_samples++];
+
+  sample->sys_ts = *sys_ts;
+  sample->offset = offset;
+  sample->pulse = pulse;
+  sample->leap = leap;
+  sample->error = error;
+
+  return 1;
+}
+
+#define RCL_AddSampleWithError(instance, sys_ts, ref_ts, leap, error) \
+  add_test_sample((sys_ts), UTI_DiffTimespecsToDouble((ref_ts), (sys_ts)), 0, (leap), (error))
+#define RCL_AddPulseWithError(instance, sys_ts, offset, error) \
+  add_test_sample((sys_ts), (offset), 1, 0, (error))
+#define RCL_CountDroppedSample(instance) (n_dropped_samples++)
+
+#include <refclock_sock.c>
+
+/* Samples expected to be accepted and number of expected drops */
+static struct test_sample expected_samples[MAX_TEST_SAMPLES];
+static int n_expected_samples;
+static int n_expected_drops;
+
+static void
+get_random_sample(struct test_sample *sample)
+{
+  sample->sys_ts.tv_sec = TST_GetRandomDouble(1.0e9, 2.0e9);
+  sample->sys_ts.tv_nsec = random() % 1000000000;
+  sample->offset = TST_GetRandomDouble(-1.0, 1.0);
+  sample->error = 0.0;
+  sample->pulse = random() % 2;
+  sample->leap = random() % 3;
+}
+
+static int
+make_message1(void *buf)
+{
+  struct test_sample sample;
+  struct sock_sample msg;
+
+  get_random_sample(&sample);
+
+  memset(&msg, 0, sizeof (msg));
+  msg.tv.tv_sec = sample.sys_ts.tv_sec;
+  msg.tv.tv_usec = sample.sys_ts.tv_nsec / 1000;
+  msg.offset = sample.offset;
+  msg.pulse = sample.pulse;
+  msg.leap = sample.leap;
+  msg.magic = SOCK_MAGIC;
+
+  sample.sys_ts.tv_nsec = msg.tv.tv_usec * 1000;
+  if (sample.pulse)
+    sample.leap = 0;
+
+  switch (random() % 4) {
+    case 0:
+      msg.magic = SOCK_MAGIC2;
+      n_expected_drops++;
+      break;
+    case 1:
+      msg.offset = 1.0e10;
+      n_expected_drops++;
+      break;
+    default:
+      TEST_CHECK(n_expected_samples < MAX_TEST_SAMPLES);
+      expected_samples[n_expected_samples++] = sample;
+      break;
+  }
+
+  memcpy(buf, &msg, sizeof (msg));
+
+  return sizeof (msg);
+}
+
+static int
+make_message2(void *buf)
+{
+  struct sock_message2 msg;
+  struct test_sample sample;
+  int i, length, valid;
+
+  memset(&msg, 0, sizeof (msg));
+  msg.magic = SOCK_MAGIC2;
+  msg.n_samples = random() % MAX_SOCK_SAMPLES + 1;
+  length = offsetof(struct sock_message2, samples) +
+           msg.n_samples * sizeof (msg.samples[0]);
+
+  /* Make an invalid message */
+  valid = 0;
+  switch (random() % 8) {
+    case 0:
+      msg.magic = SOCK_MAGIC;
+      break;
+    case 1:
+      msg.n_samples = random() % 2 ? 0 : -1;
+      break;
+    case 2:
+      msg.n_samples += random() % 2 ? 1 : -1;
+      break;
+    case 3:
+      length -= random() % 2 ? 1 : sizeof (msg.samples[0]) + 1;
+      if (length < offsetof(struct sock_message2, samples))
+        length = offsetof(struct sock_message2, samples);
+      break;
+    default:
+      valid = 1;
+      break;
+  }
+
+  if (!valid)
+    n_expected_drops++;
+
+  for (i = 0; i < msg.n_samples && i < MAX_SOCK_SAMPLES; i++) {
+    get_random_sample(&sample);
+    sample.error = TST_GetRandomDouble(0.0, 1.0e-3);
+
+    msg.samples[i].sec = sample.sys_ts.tv_sec;
+    msg.samples[i].nsec = sample.sys_ts.tv_nsec;
+    msg.samples[i].pulse = sample.pulse;
+    msg.samples[i].offset = sample.offset;
+    msg.samples[i].error = sample.error;
+    msg.samples[i].leap = sample.leap;
+
+    if (sample.pulse)
+      sample.leap = 0;
+
+    if (!valid)
+      continue;
+
+    /* Make an invalid sample */
+    switch (random() % 8) {
+      case 0:
+        msg.samples[i].nsec = random() % 2 ? -1 : 1000000000;
+        break;
+      case 1:
+        msg.samples[i].error = random() % 2 ? -1.0e-6 : NAN;
+        break;
+      case 2:
+        msg.samples[i].error = INFINITY;
+        break;
+      case 3:
+        msg.samples[i].offset = random() % 2 ? NAN : -1.0e10;
+        break;
+      default:
+        TEST_CHECK(n_expected_samples < MAX_TEST_SAMPLES);
+        expected_samples[n_expected_samples++] = sample;
+        continue;
+    }
+
+    n_expected_drops++;
+  }
+
+  memcpy(buf, &msg, length);
+
+  return length;
+}
+
+static void
+test_messages(void)
+{
+  unsigned char buf[sizeof (struct sock_message2) + 16];
+  struct test_sample *s1, *s2;
+  int i, j, fd, other_fd, length, n_messages;
+
+  fd = SCK_OpenUnixSocketPair(0, &other_fd);
+  TEST_CHECK(fd >= 0);
+
+  for (i = 0; i < 1000; i++) {
+    n_accepted_samples = n_dropped_samples = 0;
+    n_expected_samples = n_expected_drops = 0;
+
+    /* Send multiple messages which should be processed in one call
+       if the system supports receiving of multiple messages */
+    n_messages = random() % MAX_TEST_MESSAGES + 1;
+
+    for (j = 0; j < n_messages; j++) {
+      switch (random() % 4) {
+        case 0:
+          length = make_message1(buf);
+          break;
+        case 1:
+          /* Unexpected length */
+          length = random() % 2 ? random() % offsetof(struct sock_message2, samples) + 1 :
+                   sizeof (struct sock_message2) + random() % 16 + 1;
+          memset(buf, 0, length);
+          n_expected_drops++;
+          break;
+        default:
+          length = make_message2(buf);
+          break;
+      }
+
+      TEST_CHECK(SCK_Send(other_fd, buf, length, 0) == length);
+    }
+
+#ifdef HAVE_RECVMMSG
+    read_sample(fd, SCH_FILE_INPUT, NULL);
+#else
+    for (j = 0; j < n_messages; j++)
+      read_sample(fd, SCH_FILE_INPUT, NULL);
+#endif
+
+    DEBUG_LOG("messages=%d accepted=%d/%d dropped=%d/%d", n_messages,
+              n_accepted_samples, n_expected_samples, n_dropped_samples, n_expected_drops);
+
+    TEST_CHECK(n_accepted_samples == n_expected_samples);
+    TEST_CHECK(n_dropped_samples == n_expected_drops);
+
+    for (j = 0; j < n_accepted_samples; j++) {
+      s1 = &accepted_samples[j];
+      s2 = &expected_samples[j];
+      TEST_CHECK(UTI_CompareTimespecs(&s1->sys_ts, &s2->sys_ts) == 0);
+      TEST_CHECK(fabs(s1->offset - s2->offset) < 1.0e-9);
+      TEST_CHECK(s1->error == s2->error);
+      TEST_CHECK(s1->pulse == s2->pulse);
+      TEST_CHECK(s1->leap == s2->leap);
+    }
+  }
+
+  SCK_CloseSocket(other_fd);
+  SCK_CloseSocket(fd);
+}
+
+void
+test_unit(void)
+{
+  CNF_Initialise(0, 0);
+  SCK_Initialise(IPADDR_UNSPEC);
+
+  test_messages();
+
+  SCK_Finalise();
+  CNF_Finalise();
+}
+#else
+void
+test_unit(void)
+{
+  TEST_REQUIRE(0);
+}
+#endif
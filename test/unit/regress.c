@@ -21,6 +21,210 @@
 #include "test.h"
 
 #define POINTS 64
+#define FILTER_POINTS 256
+
+static int
+check_value(double value, double ref_value)
+{
+  return fabs(value - ref_value) <= 1e-6 * fabs(ref_value) + 1e-12;
+}
+
+/* Compare the result of the incremental regression with a regression
+   of the selected samples calculated from scratch */
+
+static void
+check_best_regression(double *x, double *y, double *w, int n, int start,
+                      double b0, double b1, double s2, double sb0, double sb1)
+{
+  double rb0, rb1, rs2, rsb0, rsb1;
+
+  RGR_WeightedRegression(x + start, y + start, w + start, n - start,
+                         &rb0, &rb1, &rs2, &rsb0, &rsb1);
+
+  TEST_CHECK(check_value(b0, rb0));
+  TEST_CHECK(check_value(b1, rb1));
+  TEST_CHECK(check_value(s2, rs2));
+  TEST_CHECK(check_value(sb0, rsb0));
+  TEST_CHECK(check_value(sb1, rsb1));
+}
+
+/* Compare the kernels with plain loops and measure their speed */
+
+static void
+test_kernels(void)
+{
+  double x[POINTS], y[POINTS], w[POINTS], r[POINTS], ref_r[POINTS];
+  double sums[6], ref[6], terms[6], scale[6];
+  double u, a, b, b0, b1, s2, sb0, sb1, sr, t;
+  struct timespec ts1, ts2;
+  int i, j, k, n, runs, ref_runs;
+
+  for (n = 4; n <= POINTS; n++) {
+    for (i = 0; i < 100; i++) {
+      for (j = 0; j < n; j++) {
+        x[j] = -j * TST_GetRandomDouble(1.0, 100.0);
+        y[j] = TST_GetRandomDouble(-1.0, 1.0) * (random() % 4 ? 1.0 : 0.0);
+        w[j] = TST_GetRandomDouble(1.0, 10.0);
+      }
+
+      u = TST_GetRandomDouble(-100.0, 0.0);
+      a = TST_GetRandomDouble(-1.0, 1.0);
+      b = TST_GetRandomDouble(-1e-3, 1e-3);
+
+      memset(ref, 0, sizeof (ref));
+      memset(scale, 0, sizeof (scale));
+
+      for (j = 0, ref_runs = 1; j < n; j++) {
+        terms[0] = 1.0 / w[j];
+        terms[1] = x[j] / w[j];
+        terms[2] = y[j] / w[j];
+        terms[3] = y[j] * (x[j] - u) / w[j];
+        terms[4] = (x[j] - u) * (x[j] - u) / w[j];
+        ref_r[j] = y[j] - a - b * x[j];
+        terms[5] = ref_r[j] * ref_r[j] / w[j];
+
+        for (k = 0; k < 6; k++) {
+          ref[k] += terms[k];
+          scale[k] += fabs(terms[k]);
+        }
+
+        if (j > 0 && !((y[j - 1] < 0.0 && y[j] < 0.0) || (y[j - 1] > 0.0 && y[j] > 0.0)))
+          ref_runs++;
+      }
+
+      sum_inverse_weights(x, w, n, &sums[0], &sums[1]);
+      sum_centered(x, y, w, n, u, &sums[2], &sums[3], &sums[4]);
+      calc_residuals(x, y, n, a, b, r);
+      sums[5] = sum_weighted_squares(r, w, n);
+      runs = n_runs_from_residuals(y, n);
+
+      for (k = 0; k < 6; k++)
+        TEST_CHECK(fabs(sums[k] - ref[k]) <= 1e-12 * scale[k]);
+
+      for (j = 0, sr = t = 0.0; j < n; j++) {
+        TEST_CHECK(fabs(r[j] - ref_r[j]) <= 1e-12 * (fabs(y[j]) + fabs(a) + fabs(b * x[j])));
+        sr += r[j] > 0.0 ? x[j] : r[j] < 0.0 ? -x[j] : 0.0;
+        t += fabs(x[j]);
+      }
+
+      TEST_CHECK(fabs(sum_signed(x, y, n, a, b) - sr) <= 1e-12 * t);
+      TEST_CHECK(runs == ref_runs);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts1);
+
+    for (i = 0; i < 1000; i++) {
+      RGR_WeightedRegression(x, y, w, n, &b0, &b1, &s2, &sb0, &sb1);
+      calc_residuals(x, y, n, b0, b1, r);
+      runs += n_runs_from_residuals(r, n);
+      sr += sum_signed(x, y, n, b0, b1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts2);
+    t = UTI_DiffTimespecsToDouble(&ts2, &ts1) / i;
+
+    LOG(LOGS_INFO, "n=%d regression+residuals+runs %.1f ns", n, t * 1e9);
+  }
+}
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* Compare the median with sorted arrays and measure the speed on random
+   and adversarial inputs */
+
+static void
+test_median(void)
+{
+  double x[POINTS], sorted[POINTS], median, t;
+  struct timespec ts1, ts2;
+  int i, j, n, type;
+
+  for (n = 1; n <= POINTS; n++) {
+    for (type = 0; type < 6; type++) {
+      for (i = 0; i < 100; i++) {
+        for (j = 0; j < n; j++) {
+          switch (type) {
+            case 0:
+              x[j] = TST_GetRandomDouble(-1.0, 1.0);
+              break;
+            case 1:
+              x[j] = random() % 3;
+              break;
+            case 2:
+              x[j] = j;
+              break;
+            case 3:
+              x[j] = n - j;
+              break;
+            case 4:
+              x[j] = 1.0;
+              break;
+            case 5:
+              /* Organ pipe */
+              x[j] = j < n / 2 ? j : n - j;
+              break;
+          }
+        }
+
+        memcpy(sorted, x, sizeof (x[0]) * n);
+        qsort(sorted, n, sizeof (sorted[0]), compare_doubles);
+
+        median = RGR_FindMedian(x, n);
+        TEST_CHECK(median == (n % 2 ? sorted[n / 2] :
+                              0.5 * (sorted[n / 2 - 1] + sorted[n / 2])));
+
+        for (j = 0; j < n; j++)
+          TEST_CHECK(find_ordered_entry(x, n, j) == sorted[j]);
+      }
+
+      if (n % 16 != 0 && n != 4 && n != 8)
+        continue;
+
+      clock_gettime(CLOCK_MONOTONIC, &ts1);
+
+      for (i = 0; i < 1000; i++)
+        median += RGR_FindMedian(x, n);
+
+      clock_gettime(CLOCK_MONOTONIC, &ts2);
+      t = UTI_DiffTimespecsToDouble(&ts2, &ts1) / i;
+
+      LOG(LOGS_INFO, "n=%d type=%d median %.1f ns", n, type, t * 1e9);
+    }
+  }
+}
+
+static void
+test_long_regression(void)
+{
+  double x[FILTER_POINTS], y[FILTER_POINTS], w[FILTER_POINTS];
+  double b0, b1, s2, sb0, sb1, slope, intercept, sd;
+  int i, j, n;
+
+  /* The sample filter may use more points than other regressions */
+  for (i = 0; i < 100; i++) {
+    n = POINTS + random() % (FILTER_POINTS - POINTS + 1);
+    slope = TST_GetRandomDouble(-0.1, 0.1);
+    intercept = TST_GetRandomDouble(-1.0, 1.0);
+    sd = TST_GetRandomDouble(1e-6, 1e-4);
+
+    for (j = 0; j < n; j++) {
+      x[j] = -j;
+      y[j] = intercept + slope * x[j] + (j % 2 ? 1 : -1) * TST_GetRandomDouble(1e-6, sd);
+      w[j] = TST_GetRandomDouble(1.0, 2.0);
+    }
+
+    RGR_WeightedRegression(x, y, w, n, &b0, &b1, &s2, &sb0, &sb1);
+    TEST_CHECK(fabs(b0 - intercept) < sd + 1e-3);
+    TEST_CHECK(fabs(b1 - slope) < sd);
+    TEST_CHECK(s2 > 0.0 && s2 < sd * sd * 2.0);
+  }
+}
 
 void
 test_unit(void)
@@ -30,6 +234,10 @@ test_unit(void)
   double xrange, yrange, wrange, x2range;
   int i, j, n, m, c1, c2, c3, runs, best_start, dof;
 
+  test_kernels();
+  test_median();
+  test_long_regression();
+
   for (n = 3; n <= POINTS; n++) {
     for (i = 0; i < 200; i++) {
       slope = TST_GetRandomDouble(-0.1, 0.1);
@@ -59,6 +267,8 @@ test_unit(void)
 
         TEST_CHECK(fabs(b0 - intercept) < sd + 1e-3);
         TEST_CHECK(fabs(b1 - slope) < sd);
+
+        check_best_regression(x, y, w, n, best_start, b0, b1, s2, sb0, sb1);
       }
 
       if (RGR_MultipleRegress(x, x2, y, n, &b2)) {
@@ -109,7 +319,7 @@ test_unit(void)
 
       if (RGR_FindBestRegression(x + m, y + m, w, n - m, m, 3, &b0, &b1, &s2, &sb0, &sb1,
                                  &best_start, &runs, &dof))
-        ;
+        check_best_regression(x + m, y + m, w, n - m, best_start, b0, b1, s2, sb0, sb1);
       if (RGR_MultipleRegress(x, x2, y, n, &b2))
         ;
       if (RGR_FindBestRobustRegression(x, y, n, 1e-8, &b0, &b1, &runs, &best_start))
@@ -25,6 +25,25 @@
 
 #include <samplefilt.c>
 
+static int
+check_sorted(SPF_Instance filter)
+{
+  int i, count[MAX_SAMPLES];
+
+  memset(count, 0, sizeof (count));
+
+  for (i = 0; i < filter->used; i++) {
+    if (filter->sorted[i] < 0 || filter->sorted[i] >= filter->used ||
+        count[filter->sorted[i]]++ > 0)
+      return 0;
+    if (i > 0 && filter->samples[filter->sorted[i - 1]].offset >
+                 filter->samples[filter->sorted[i]].offset)
+      return 0;
+  }
+
+  return 1;
+}
+
 void
 test_unit(void)
 {
@@ -64,6 +83,7 @@ test_unit(void)
         TEST_CHECK(!SPF_AccumulateSample(filter, &sample_in));
 
         TEST_CHECK(SPF_GetNumberOfSamples(filter) == MIN(k + 1, max_samples));
+        TEST_CHECK(check_sorted(filter));
 
         SPF_GetLastSample(filter, &sample_out);
         TEST_CHECK(!memcmp(&sample_in, &sample_out, sizeof (sample_in)));
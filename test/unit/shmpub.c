@@ -0,0 +1,151 @@
+/*
+ **********************************************************************
+ * Copyright (C) Miroslav Lichvar  2026
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ **********************************************************************
+ */
+
+#include <config.h>
+#include "test.h"
+
+#include <localp.h>
+#include <shmpub.c>
+
+#define TEST_FILE "timeshm.test"
+
+static void
+set_random_model(double valid_interval)
+{
+  LCL_CookingModel model;
+
+  LCL_ReadRawTime(&model.ref);
+  UTI_AddDoubleToTimespec(&model.ref, TST_GetRandomDouble(-10.0, 0.0), &model.ref);
+  model.offset = TST_GetRandomDouble(-1.0, 1.0);
+  model.rate = TST_GetRandomDouble(-1.0e-3, 1.0e-3);
+  model.err = TST_GetRandomDouble(0.0, 1.0e-3);
+  model.err_interval = TST_GetRandomDouble(0.0, 20.0);
+  model.valid_interval = valid_interval;
+
+  lcl_SetCookingModel(&model);
+}
+
+static void
+test_read(const TSM_Segment *seg)
+{
+  struct timespec ts, cooked;
+  double max_error, err, diff;
+  int i;
+
+  /* No model with the dummy drivers */
+  TEST_CHECK(!TSM_GetTime(seg, 0, &ts, &max_error));
+  TEST_CHECK(max_error < 0.0);
+
+  for (i = 0; i < 1000; i++) {
+    /* The model is published by the handler in the local module */
+    set_random_model(TST_GetRandomDouble(20.0, 100.0));
+
+    TEST_CHECK(TSM_GetTime(seg, i % 2, &ts, &max_error));
+    LCL_ReadCookedTime(&cooked, &err);
+
+    diff = UTI_DiffTimespecsToDouble(&cooked, &ts);
+    DEBUG_LOG("diff=%e", diff);
+    TEST_CHECK(diff >= -1.0e-9 && diff < 1.0e-3);
+
+    /* Not synchronised */
+    TEST_CHECK(max_error < 0.0);
+
+    /* Expired model */
+    set_random_model(-1.0);
+    TEST_CHECK(!TSM_GetTime(seg, 0, &ts, &max_error));
+  }
+
+  /* Data being updated */
+  set_random_model(100.0);
+  TEST_CHECK(TSM_GetTime(seg, 0, &ts, NULL));
+  segment->sequence++;
+  TEST_CHECK(!TSM_GetTime(seg, 0, &ts, NULL));
+  segment->sequence++;
+  TEST_CHECK(TSM_GetTime(seg, 0, &ts, NULL));
+}
+
+static void
+benchmark(const TSM_Segment *seg)
+{
+  struct timespec start, end, ts;
+  double elapsed, max_error;
+  int i, reads = 1000000;
+
+  set_random_model(1000.0);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (i = 0; i < reads; i++)
+    TEST_CHECK(TSM_GetTime(seg, 1, &ts, &max_error));
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  elapsed = UTI_DiffTimespecsToDouble(&end, &start);
+  LOG(LOGS_INFO, "Made %d reads in %.3f seconds (%.1f ns per read)",
+      reads, elapsed, elapsed / reads * 1.0e9);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (i = 0; i < reads; i++)
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  elapsed = UTI_DiffTimespecsToDouble(&end, &start);
+  LOG(LOGS_INFO, "Made %d clock_gettime() calls in %.3f seconds (%.1f ns per call)",
+      reads, elapsed, elapsed / reads * 1.0e9);
+}
+
+void
+test_unit(void)
+{
+  char conf[] = "timeshmfile " TEST_FILE;
+  const TSM_Segment *seg;
+  struct timespec ts;
+
+  CNF_Initialise(0, 0);
+  CNF_ParseLine(NULL, 1, conf);
+
+  LCL_Initialise();
+  TST_RegisterDummyDrivers();
+  SCH_Initialise();
+  REF_Initialise();
+  SMT_Initialise();
+  SHP_Initialise();
+
+  seg = TSM_Open(TEST_FILE);
+  TEST_CHECK(seg);
+
+  test_read(seg);
+  benchmark(seg);
+
+  SHP_Finalise();
+
+  /* The segment is left invalid and the file is removed */
+  TEST_CHECK(!TSM_GetTime(seg, 0, &ts, NULL));
+  TEST_CHECK(!TSM_Open(TEST_FILE));
+  TSM_Close(seg);
+
+  SMT_Finalise();
+  REF_Finalise();
+  SCH_Finalise();
+  LCL_Finalise();
+  CNF_Finalise();
+}
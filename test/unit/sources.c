@@ -35,7 +35,7 @@ void
 test_unit(void)
 {
   SRC_AuthSelectMode sel_mode;
-  SRC_Instance srcs[16];
+  SRC_Instance srcs[16], mon;
   IPAddr addrs[16];
   RPT_SourceReport report;
   NTP_Sample sample;
@@ -48,6 +48,7 @@ test_unit(void)
   SCH_Initialise();
   SRC_Initialise();
   REF_Initialise();
+  SST_Initialise();
   NSR_Initialise();
 
   REF_SetMode(REF_ModeIgnore);
@@ -189,6 +190,31 @@ test_unit(void)
         TEST_CHECK(sources[j]->status == SRC_DISTANT);
     }
 
+    /* The require option of a monitor source is ignored */
+    mon = create_source(SRC_NTP, &addrs[0], 0, SRC_SELECT_MONITOR | SRC_SELECT_REQUIRE);
+    TEST_CHECK(mon->sel_options ==
+               (SRC_SELECT_MONITOR | SRC_SELECT_NOSELECT | SRC_SELECT_REQUIRE));
+    SRC_UpdateReachability(mon, 1);
+
+    for (k = 0; k < 4; k++) {
+      SCH_GetLastEventTime(&sample.time, NULL, NULL);
+      UTI_AddDoubleToTimespec(&sample.time, k - 4, &sample.time);
+      sample.offset = 1e-6;
+      SRC_AccumulateSample(mon, &sample);
+      SRC_UpdateStatus(mon, 1, LEAP_Normal);
+      SRC_SelectSource(mon);
+      TEST_CHECK(mon->status == SRC_UNSELECTABLE);
+      TEST_CHECK(SST_Samples(mon->stats) == 1);
+      TEST_CHECK(sources[0]->status == SRC_SELECTED);
+    }
+
+    SRC_ReselectSource();
+    SRC_SelectSource(srcs[0]);
+    TEST_CHECK(mon->status == SRC_UNSELECTABLE);
+    TEST_CHECK(sources[0]->status == SRC_SELECTED);
+
+    SRC_DestroyInstance(mon);
+
     for (j = 0; j < sizeof (srcs) / sizeof (srcs[0]); j++) {
       SRC_ReportSource(j, &report, &sample.time);
       SRC_DestroyInstance(srcs[j]);
@@ -281,6 +307,7 @@ test_unit(void)
   NSR_Finalise();
   REF_Finalise();
   SRC_Finalise();
+  SST_Finalise();
   SCH_Finalise();
   LCL_Finalise();
   CNF_Finalise();
@@ -0,0 +1,308 @@
+/*
+ **********************************************************************
+ * Copyright (C) Miroslav Lichvar  2026
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ **********************************************************************
+ */
+
+#include <config.h>
+#include "test.h"
+
+#include <local.h>
+#include <sched.h>
+#include <sourcestats.c>
+
+static void
+add_samples(SST_Stats inst, int n)
+{
+  struct timespec now;
+  NTP_Sample sample;
+  int i;
+
+  LCL_ReadCookedTime(&now, NULL);
+
+  for (i = 0; i < n; i++) {
+    UTI_AddDoubleToTimespec(&now, TST_GetRandomDouble(i - n - 1.0, i - n - 0.5), &sample.time);
+    sample.offset = TST_GetRandomDouble(-1.0, 1.0);
+    sample.peer_delay = TST_GetRandomDouble(1.0e-6, 1.0e-1);
+    sample.peer_dispersion = TST_GetRandomDouble(1.0e-6, 1.0e-1);
+    sample.root_delay = sample.peer_delay + TST_GetRandomDouble(0.0, 1.0e-1);
+    sample.root_dispersion = sample.peer_dispersion + TST_GetRandomDouble(0.0, 1.0e-1);
+    SST_AccumulateSample(inst, &sample);
+  }
+}
+
+static int
+check_value(double value, double ref_value)
+{
+  return fabs(value - ref_value) <= 1.0e-6 * fabs(ref_value);
+}
+
+static void
+test_save_load(void)
+{
+  int i, j, k, l, n, max_samples;
+  SST_Stats inst1, inst2;
+  FILE *f;
+
+  for (i = 0; i < 300; i++) {
+    n = random() % MAX_SAMPLES + 1;
+
+    /* Load fewer, equal, and more samples than maxsamples */
+    switch (i % 3) {
+      case 0:
+        max_samples = n + random() % (MAX_SAMPLES - n + 1);
+        break;
+      case 1:
+        max_samples = n;
+        break;
+      default:
+        max_samples = random() % n + 1;
+        break;
+    }
+
+    DEBUG_LOG("iteration %d n=%d max_samples=%d", i, n, max_samples);
+
+    inst1 = SST_CreateInstance(1, NULL, 1, MAX_SAMPLES, 0.0, 1.0);
+    inst2 = SST_CreateInstance(2, NULL, 1, max_samples, 0.0, 1.0);
+
+    add_samples(inst1, n);
+    TEST_CHECK(inst1->n_samples == n);
+
+    f = tmpfile();
+    TEST_CHECK(f);
+    TEST_CHECK(SST_SaveToFile(inst1, f));
+    rewind(f);
+    TEST_CHECK(SST_LoadFromFile(inst2, f));
+    fclose(f);
+
+    /* The newest samples are kept (the regression may drop some of them) */
+    TEST_CHECK(inst2->n_samples >= 1 && inst2->n_samples <= MIN(n, max_samples));
+    TEST_CHECK(inst2->last_sample == MIN(n, max_samples) - 1);
+
+    for (j = 0; j < inst2->n_samples; j++) {
+      k = get_buf_index(inst2, j);
+      l = get_buf_index(inst1, n - inst2->n_samples + j);
+
+      TEST_CHECK(fabs(UTI_DiffTimespecsToDouble(&inst2->sample_times[k],
+                                                &inst1->sample_times[l])) < 1.0e-6);
+      TEST_CHECK(check_value(inst2->offsets[k], inst1->offsets[l]));
+      TEST_CHECK(check_value(inst2->peer_delays[k], inst1->peer_delays[l]));
+
+      k = get_data_index(inst2, j);
+      l = get_data_index(inst1, n - inst2->n_samples + j);
+
+      TEST_CHECK(check_value(inst2->orig_offsets[k], inst1->orig_offsets[l]));
+      TEST_CHECK(check_value(inst2->peer_dispersions[k], inst1->peer_dispersions[l]));
+      TEST_CHECK(check_value(inst2->root_delays[k], inst1->root_delays[l]));
+      TEST_CHECK(check_value(inst2->root_dispersions[k], inst1->root_dispersions[l]));
+    }
+
+    SST_DeleteInstance(inst2);
+    SST_DeleteInstance(inst1);
+  }
+}
+
+static void
+test_buffers(void)
+{
+  NTP_Sample samples[1000], *sample;
+  int i, j, k, l, max_samples;
+  struct timespec now;
+  SST_Stats inst;
+
+  LCL_ReadCookedTime(&now, NULL);
+
+  for (i = 0; i < 100; i++) {
+    max_samples = random() % MAX_SAMPLES + 1;
+    inst = SST_CreateInstance(1, NULL, 1, max_samples, 0.0, 1.0);
+
+    DEBUG_LOG("iteration %d max_samples=%d", i, max_samples);
+
+    for (j = 0; j < sizeof (samples) / sizeof (samples[0]); j++) {
+      sample = &samples[j];
+      UTI_AddDoubleToTimespec(&now, j - 1000.0, &sample->time);
+      sample->offset = TST_GetRandomDouble(-1.0, 1.0);
+      sample->peer_delay = TST_GetRandomDouble(1.0e-6, 1.0e-1);
+      sample->peer_dispersion = TST_GetRandomDouble(1.0e-6, 1.0e-1);
+      sample->root_delay = sample->peer_delay + TST_GetRandomDouble(0.0, 1.0e-1);
+      sample->root_dispersion = sample->peer_dispersion + TST_GetRandomDouble(0.0, 1.0e-1);
+      SST_AccumulateSample(inst, sample);
+
+      if (random() % 2)
+        SST_DoNewRegression(inst);
+
+      TEST_CHECK(inst->buf_size <= max_samples * REGRESS_RUNS_RATIO +
+                 MAX(1, max_samples / BUF_EXTRA_RATIO));
+      TEST_CHECK(inst->data_buf_size <= max_samples + MAX(1, max_samples / BUF_EXTRA_RATIO));
+      TEST_CHECK(inst->n_samples >= 1 && inst->n_samples <= max_samples);
+      TEST_CHECK(inst->runs_samples <= inst->n_samples * (REGRESS_RUNS_RATIO - 1));
+      TEST_CHECK(get_buf_index(inst, -inst->runs_samples) >= 0);
+      TEST_CHECK(get_data_index(inst, 0) >= 0);
+
+      for (k = -inst->runs_samples; k < inst->n_samples; k++) {
+        sample = &samples[j - inst->n_samples + k + 1];
+        l = get_buf_index(inst, k);
+        TEST_CHECK(UTI_CompareTimespecs(&inst->sample_times[l], &sample->time) == 0);
+        TEST_CHECK(inst->offsets[l] == -sample->offset);
+        TEST_CHECK(inst->peer_delays[l] == sample->peer_delay);
+
+        if (k < 0)
+          continue;
+
+        l = get_data_index(inst, k);
+        TEST_CHECK(inst->orig_offsets[l] == -sample->offset);
+        TEST_CHECK(inst->peer_dispersions[l] == sample->peer_dispersion);
+        TEST_CHECK(inst->root_delays[l] == sample->root_delay);
+        TEST_CHECK(inst->root_dispersions[l] == sample->root_dispersion);
+      }
+    }
+
+    SST_DeleteInstance(inst);
+  }
+}
+
+#define BATCH_INSTANCES 16
+
+static void
+test_batch(void)
+{
+  SST_Stats insts[BATCH_INSTANCES], insts2[BATCH_INSTANCES];
+  SST_SelectionData sel_data[BATCH_INSTANCES];
+  SST_TrackingData trk_data[BATCH_INSTANCES];
+  RPT_SourcestatsReport sst_report;
+  RPT_SourceReport src_report;
+  double lo, hi, dist, sd, first_ago, last_ago, offset, elapsed;
+  double avg_offset, offset_sd, freq, freq_sd, skew, delay, disp;
+  struct timespec now, ref_time;
+  int i, j, k, n, select_ok;
+
+  for (i = 0; i < 100; i++) {
+    n = random() % BATCH_INSTANCES + 1;
+
+    for (j = 0; j < n; j++) {
+      insts[j] = SST_CreateInstance(j + 1, NULL, 1, random() % MAX_SAMPLES + 1, 0.0, 1.0);
+      add_samples(insts[j], random() % MAX_SAMPLES + 1);
+      SST_DoNewRegression(insts[j]);
+    }
+
+    /* Apply some slews which need to be reflected in all instances */
+    for (j = random() % (2 * MAX_SLEWS); j > 0; j--) {
+      LCL_ReadCookedTime(&now, NULL);
+      SST_SlewAllSamples(&now, TST_GetRandomDouble(-1.0e-5, 1.0e-5),
+                         TST_GetRandomDouble(-1.0e-3, 1.0e-3));
+    }
+
+    LCL_ReadCookedTime(&now, NULL);
+    UTI_AddDoubleToTimespec(&now, TST_GetRandomDouble(0.0, 100.0), &now);
+
+    /* Pass the instances in a random order */
+    for (j = 0; j < n; j++) {
+      k = random() % (j + 1);
+      insts2[j] = insts2[k];
+      insts2[k] = insts[j];
+    }
+
+    SST_GetSelectionDataBatch(insts2, n, &now, sel_data);
+    SST_GetTrackingDataBatch(insts2, n, trk_data);
+
+    for (j = 0; j < n; j++) {
+      SST_GetSelectionData(insts2[j], &now, &lo, &hi, &dist, &sd,
+                           &first_ago, &last_ago, &select_ok);
+      TEST_CHECK(sel_data[j].select_ok == select_ok);
+      TEST_CHECK(sel_data[j].lo_limit == lo);
+      TEST_CHECK(sel_data[j].hi_limit == hi);
+      TEST_CHECK(sel_data[j].root_distance == dist);
+      TEST_CHECK(sel_data[j].std_dev == sd);
+      TEST_CHECK(sel_data[j].first_sample_ago == first_ago);
+      TEST_CHECK(sel_data[j].last_sample_ago == last_ago);
+
+      SST_GetTrackingData(insts2[j], &ref_time, &avg_offset, &offset_sd,
+                          &freq, &freq_sd, &skew, &delay, &disp);
+      TEST_CHECK(UTI_CompareTimespecs(&trk_data[j].ref_time, &ref_time) == 0);
+      TEST_CHECK(trk_data[j].average_offset == avg_offset);
+      TEST_CHECK(trk_data[j].offset_sd == offset_sd);
+      TEST_CHECK(trk_data[j].frequency == freq);
+      TEST_CHECK(trk_data[j].frequency_sd == freq_sd);
+      TEST_CHECK(trk_data[j].skew == skew);
+      TEST_CHECK(trk_data[j].root_delay == delay);
+      TEST_CHECK(trk_data[j].root_dispersion == disp);
+
+      /* Compare with the data in the reports, which are not cached */
+      SST_DoSourcestatsReport(insts2[j], &sst_report, &now);
+      TEST_CHECK(sst_report.n_samples == insts2[j]->n_samples);
+      TEST_CHECK(check_value(sst_report.resid_freq_ppm, 1.0e6 * trk_data[j].frequency));
+      TEST_CHECK(check_value(sst_report.skew_ppm, 1.0e6 * trk_data[j].skew));
+      elapsed = UTI_DiffTimespecsToDouble(&now, &trk_data[j].ref_time);
+      offset = trk_data[j].average_offset + elapsed * trk_data[j].frequency;
+      TEST_CHECK(fabs(sst_report.est_offset - offset) < 1.0e-9);
+      TEST_CHECK(fabs(sst_report.span_seconds -
+                      (sel_data[j].first_sample_ago - sel_data[j].last_sample_ago)) <= 0.5);
+
+      SST_DoSourceReport(insts2[j], &src_report, &now);
+      TEST_CHECK(fabs(src_report.latest_meas_ago - sel_data[j].last_sample_ago) < 1.0);
+      TEST_CHECK(src_report.latest_meas == insts2[j]->offsets[insts2[j]->last_sample]);
+
+      /* Compare with the data of the instance (the slews were applied) */
+      k = get_buf_index(insts2[j], insts2[j]->best_single_sample);
+      elapsed = fabs(UTI_DiffTimespecsToDouble(&now, &insts2[j]->sample_times[k]));
+      offset = insts2[j]->offsets[k] + elapsed * insts2[j]->estimated_frequency;
+      k = get_data_index(insts2[j], insts2[j]->best_single_sample);
+      dist = 0.5 * insts2[j]->root_delays[k] + insts2[j]->root_dispersions[k] +
+             elapsed * insts2[j]->skew;
+      TEST_CHECK(check_value(sel_data[j].root_distance, dist));
+      TEST_CHECK(fabs(sel_data[j].lo_limit - (offset - dist)) < 1.0e-9);
+      TEST_CHECK(fabs(sel_data[j].hi_limit - (offset + dist)) < 1.0e-9);
+      TEST_CHECK(check_value(sel_data[j].first_sample_ago, UTI_DiffTimespecsToDouble(&now,
+                   &insts2[j]->sample_times[get_buf_index(insts2[j], 0)])));
+      TEST_CHECK(check_value(sel_data[j].last_sample_ago, UTI_DiffTimespecsToDouble(&now,
+                   &insts2[j]->sample_times[insts2[j]->last_sample])));
+      TEST_CHECK(sel_data[j].select_ok == (insts2[j]->regression_ok ||
+                                           (insts2[j]->n_samples < MIN_SAMPLES_FOR_REGRESS &&
+                                            insts2[j]->n_samples == insts2[j]->max_samples)));
+
+      TEST_CHECK(UTI_CompareTimespecs(&trk_data[j].ref_time, &insts2[j]->offset_time) == 0);
+      TEST_CHECK(trk_data[j].average_offset == insts2[j]->estimated_offset);
+      TEST_CHECK(trk_data[j].offset_sd == insts2[j]->estimated_offset_sd);
+      TEST_CHECK(trk_data[j].frequency == insts2[j]->estimated_frequency);
+      TEST_CHECK(trk_data[j].frequency_sd == insts2[j]->estimated_frequency_sd);
+      TEST_CHECK(trk_data[j].skew == insts2[j]->skew);
+      TEST_CHECK(trk_data[j].root_delay == insts2[j]->root_delays[k]);
+    }
+
+    for (j = 0; j < n; j++)
+      SST_DeleteInstance(insts[j]);
+  }
+}
+
+void
+test_unit(void)
+{
+  CNF_Initialise(0, 0);
+  LCL_Initialise();
+  TST_RegisterDummyDrivers();
+  SCH_Initialise();
+  SST_Initialise();
+
+  test_save_load();
+  test_buffers();
+  test_batch();
+
+  SST_Finalise();
+  SCH_Finalise();
+  LCL_Finalise();
+  CNF_Finalise();
+}
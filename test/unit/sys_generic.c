@@ -0,0 +1,165 @@
+/*
+ **********************************************************************
+ * Copyright (C) Miroslav Lichvar  2026
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ **********************************************************************
+ */
+
+#include <config.h>
+#include "test.h"
+
+#include <local.h>
+
+static struct timespec current_time;
+
+#define LCL_ReadRawTime(ts) (*(ts) = current_time)
+
+#include <sys_generic.c>
+
+/* Rate of the simulated fast slew of the system driver */
+#define FASTSLEW_RATE 500.0e-6
+
+static double mock_freq;
+static double mock_fastslew_offset;
+static struct timespec mock_fastslew_start;
+
+static double
+mock_read_frequency(void)
+{
+  return mock_freq;
+}
+
+static double
+mock_set_frequency(double freq_ppm)
+{
+  mock_freq = freq_ppm;
+  return mock_freq;
+}
+
+static double
+get_fastslew_remaining(struct timespec *raw)
+{
+  double elapsed;
+
+  elapsed = UTI_DiffTimespecsToDouble(raw, &mock_fastslew_start);
+  if (fabs(mock_fastslew_offset) <= FASTSLEW_RATE * elapsed)
+    return 0.0;
+
+  return mock_fastslew_offset - (mock_fastslew_offset > 0.0 ? 1.0 : -1.0) *
+         FASTSLEW_RATE * elapsed;
+}
+
+static void
+mock_accrue_offset(double offset, double corr_rate)
+{
+  mock_fastslew_offset = get_fastslew_remaining(&current_time) + offset;
+  mock_fastslew_start = current_time;
+}
+
+static void
+mock_get_offset_correction(struct timespec *raw, double *corr, double *err)
+{
+  *corr = -get_fastslew_remaining(raw);
+  if (err)
+    *err = 0.0;
+}
+
+/* Check the cooking with the model provided to the local module gives the
+   same result as the conversion of the driver */
+
+static void
+check_cooking(void)
+{
+  double corr, err, cooked_err;
+  struct timespec raw, cooked;
+  LCL_CookingModel model;
+  int i, valid;
+
+  for (i = 0; i < 10; i++) {
+    UTI_AddDoubleToTimespec(&current_time, TST_GetRandomDouble(-1.0, 10.0), &raw);
+
+    valid = LCL_GetCookingModel(&model);
+    TEST_CHECK(valid == !fastslew_active);
+
+    LCL_CookTime(&raw, &cooked, &cooked_err);
+    offset_convert(&raw, &corr, &err);
+
+    TEST_CHECK(fabs(UTI_DiffTimespecsToDouble(&cooked, &raw) - corr) < 2.0e-9);
+    TEST_CHECK(fabs(cooked_err - err) <= 1.0e-12);
+  }
+}
+
+static void
+test_cooking_model(void)
+{
+  LCL_CookingModel model;
+  int i;
+
+  /* The model is provided from the first update of the slew */
+  set_frequency(0.0);
+
+  for (i = 0; i < 1000; i++) {
+    switch (random() % 4) {
+      case 0:
+        set_frequency(TST_GetRandomDouble(-100.0, 100.0));
+        break;
+      case 1:
+        accrue_offset(TST_GetRandomDouble(-1.0e-3, 1.0e-3), TST_GetRandomDouble(1.0, 10.0));
+        break;
+      case 2:
+        /* Large offset corrected by the fast slew */
+        accrue_offset(TST_GetRandomDouble(-1.0, 1.0), TST_GetRandomDouble(1.0, 10.0));
+        break;
+      default:
+        break;
+    }
+
+    check_cooking();
+
+    UTI_AddDoubleToTimespec(&current_time, TST_GetRandomDouble(0.0, 1000.0), &current_time);
+
+    check_cooking();
+
+    /* The model is provided again when the fast slew is finished */
+    if (fastslew_active && get_fastslew_remaining(&current_time) == 0.0) {
+      TEST_CHECK(!LCL_GetCookingModel(&model));
+      LCL_CookTime(&current_time, &model.ref, NULL);
+      TEST_CHECK(!fastslew_active);
+      TEST_CHECK(LCL_GetCookingModel(&model));
+    }
+  }
+}
+
+void
+test_unit(void)
+{
+  CNF_Initialise(0, 0);
+  LCL_Initialise();
+  SCH_Initialise();
+
+  clock_gettime(CLOCK_REALTIME, &current_time);
+
+  SYS_Generic_CompleteFreqDriver(500.0, 1.0e-3, mock_read_frequency, mock_set_frequency,
+                                 NULL, 0.0, 1000.0, mock_accrue_offset,
+                                 mock_get_offset_correction, NULL, NULL);
+
+  test_cooking_model();
+
+  SYS_Generic_Finalise();
+  SCH_Finalise();
+  LCL_Finalise();
+  CNF_Finalise();
+}
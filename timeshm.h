@@ -0,0 +1,259 @@
+/*
+  chronyd/chronyc - Programs for keeping computer clocks accurate.
+
+ **********************************************************************
+ * Copyright (C) Miroslav Lichvar  2026
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ **********************************************************************
+
+  =======================================================================
+
+  Format of the shared memory segment published by chronyd with the
+  timeshmfile directive and a header-only library for reading it.
+
+  The segment is a file mapped to memory.  The writer increments the
+  sequence number before and after each update of the data, i.e. the
+  number is odd while the data is being changed.  A reader needs to copy
+  the data and check that the number was even and did not change.  The
+  TSM_GetTime() function converts the system time (CLOCK_REALTIME) to the
+  time estimated by chronyd without any system calls (if clock_gettime()
+  is provided by vDSO).
+
+  This header does not depend on any other chrony header.
+
+  */
+
+#ifndef GOT_TIMESHM_H
+#define GOT_TIMESHM_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TSM_MAGIC 0x4354534d
+#define TSM_VERSION 1
+
+/* Values of the leap field (same as in NTP) */
+#define TSM_LEAP_NORMAL 0
+#define TSM_LEAP_INSERT_SECOND 1
+#define TSM_LEAP_DELETE_SECOND 2
+#define TSM_LEAP_UNSYNCHRONISED 3
+
+/* Flags */
+#define TSM_FLAG_SYNCHRONISED 0x1
+#define TSM_FLAG_MODEL_VALID 0x2
+#define TSM_FLAG_SMOOTHING 0x4
+
+/* Maximum number of attempts to get a consistent copy of the data */
+#define TSM_MAX_READ_TRIES 1000
+
+typedef struct {
+  int64_t sec;
+  int32_t nsec;
+  int32_t _pad;
+} TSM_Timespec;
+
+typedef struct {
+  /* Identification of the format, not changed after creation */
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;
+
+  /* Sequence number of the update, odd while the data is being updated */
+  uint32_t sequence;
+
+  /* TSM_FLAG_* */
+  uint32_t flags;
+
+  /* Reference as reported by the tracking command */
+  int32_t leap;
+  int32_t stratum;
+  uint32_t ref_id;
+  TSM_Timespec ref_time;
+  double last_offset;
+  double rms_offset;
+  double freq_ppm;
+  double resid_freq_ppm;
+  double skew_ppm;
+  double root_delay;
+
+  /* Root dispersion at the time of the update and its rate of increase
+     (in seconds per second) */
+  double root_dispersion;
+  double dispersion_rate;
+
+  /* Time of the update (corrected) */
+  TSM_Timespec update_time;
+
+  /* Offset of the served time if time smoothing is enabled at the time of
+     the update and its rate of change (linear approximation) */
+  double smooth_offset;
+  double smooth_rate;
+
+  /* Model of the correction of the system time (CLOCK_REALTIME), which is
+     offset + rate * (raw - ref) for raw times up to valid_interval after ref,
+     with an error of err if the raw time is within err_interval of ref */
+  TSM_Timespec model_ref;
+  double model_offset;
+  double model_rate;
+  double model_err;
+  double model_err_interval;
+  double model_valid_interval;
+} TSM_Segment;
+
+/* ================================================== */
+/* Map the segment to memory.  Returns NULL on error. */
+
+static inline const TSM_Segment *
+TSM_Open(const char *path)
+{
+  TSM_Segment *segment;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  segment = mmap(NULL, sizeof (*segment), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (segment == MAP_FAILED)
+    return NULL;
+
+  if (segment->magic != TSM_MAGIC || segment->version != TSM_VERSION ||
+      segment->size != sizeof (*segment)) {
+    munmap(segment, sizeof (*segment));
+    return NULL;
+  }
+
+  return segment;
+}
+
+/* ================================================== */
+
+static inline void
+TSM_Close(const TSM_Segment *segment)
+{
+  munmap((void *)segment, sizeof (*segment));
+}
+
+/* ================================================== */
+/* Get a consistent copy of the data and optionally read the system time
+   while the data is valid.  Returns 0 if the segment was being updated in
+   all attempts. */
+
+static inline int
+TSM_Read(const TSM_Segment *segment, TSM_Segment *copy, struct timespec *raw)
+{
+  uint32_t seq1, seq2;
+  int i;
+
+  for (i = 0; i < TSM_MAX_READ_TRIES; i++) {
+    seq1 = __atomic_load_n(&segment->sequence, __ATOMIC_ACQUIRE);
+    if (seq1 % 2 != 0)
+      continue;
+
+    memcpy(copy, segment, sizeof (*copy));
+    if (raw)
+      clock_gettime(CLOCK_REALTIME, raw);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    seq2 = __atomic_load_n(&segment->sequence, __ATOMIC_RELAXED);
+
+    if (seq1 == seq2)
+      return 1;
+  }
+
+  return 0;
+}
+
+/* ================================================== */
+
+static inline double
+TSM_DiffTimespec(const struct timespec *ts, const TSM_Timespec *tsm_ts)
+{
+  return (ts->tv_sec - tsm_ts->sec) + 1.0e-9 * (ts->tv_nsec - tsm_ts->nsec);
+}
+
+/* ================================================== */
+
+static inline void
+TSM_AddToTimespec(struct timespec *ts, double offset)
+{
+  int64_t sec, nsec;
+
+  sec = (int64_t)offset;
+  if (offset < sec)
+    sec--;
+  nsec = ts->tv_nsec + (int64_t)((offset - sec) * 1.0e9);
+
+  ts->tv_sec += sec + nsec / 1000000000;
+  ts->tv_nsec = nsec % 1000000000;
+}
+
+/* ================================================== */
+/* Get the current time as estimated by chronyd, optionally with smoothing
+   applied to the time served to NTP clients, and the maximum error of the
+   time (root distance), which is negative if chronyd is not synchronised.
+   Returns 0 if the data could not be read or the model of the correction is
+   not valid, in which case the time is not corrected. */
+
+static inline int
+TSM_GetTime(const TSM_Segment *segment, int smooth, struct timespec *ts, double *max_error)
+{
+  double elapsed, correction, error;
+  TSM_Segment s;
+
+  if (!TSM_Read(segment, &s, ts) || !(s.flags & TSM_FLAG_MODEL_VALID))
+    goto error;
+
+  elapsed = TSM_DiffTimespec(ts, &s.model_ref);
+  if (elapsed > s.model_valid_interval)
+    goto error;
+
+  correction = s.model_offset + s.model_rate * elapsed;
+  error = elapsed >= -s.model_err_interval && elapsed <= s.model_err_interval ?
+          s.model_err : 0.0;
+
+  TSM_AddToTimespec(ts, correction);
+
+  elapsed = TSM_DiffTimespec(ts, &s.update_time);
+
+  if (smooth && s.flags & TSM_FLAG_SMOOTHING)
+    TSM_AddToTimespec(ts, s.smooth_offset + s.smooth_rate * elapsed);
+
+  if (max_error) {
+    if (s.flags & TSM_FLAG_SYNCHRONISED)
+      *max_error = s.root_delay / 2.0 + s.root_dispersion + error +
+                   (elapsed >= 0.0 ? elapsed : -elapsed) * s.dispersion_rate;
+    else
+      *max_error = -1.0;
+  }
+
+  return 1;
+
+error:
+  clock_gettime(CLOCK_REALTIME, ts);
+  if (max_error)
+    *max_error = -1.0;
+
+  return 0;
+}
+
+#endif
@@ -0,0 +1,81 @@
+/*
+  chronyd/chronyc - Programs for keeping computer clocks accurate.
+
+ **********************************************************************
+ * Copyright (C) Miroslav Lichvar  2026
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * 
+ **********************************************************************
+
+  =======================================================================
+
+  Macros for static user-space tracing probes (USDT) in the chronyd provider.
+  The probes are compiled in only with the --enable-usdt configure option.
+  With no tracer attached, each probe is a single nop instruction.
+
+  Times, offsets and delays are passed as integers in nanoseconds and
+  frequencies in parts per billion (ppb).  Addresses are passed as
+  pointers to IPAddr.
+
+  ntp_rx          (IPAddr *addr, port, length, rx_sec, rx_nsec, rx_source)
+  ntp_ratelimit   (IPAddr *addr, port, log_index, limited)
+  ntp_tx          (IPAddr *addr, port, mode, interleaved, length, tx_sec,
+                   tx_nsec, sent)
+  ntp_sample      (IPAddr *addr, port, valid, good, offset, delay,
+                   dispersion, sample_sec, sample_nsec)
+  source_select   (updated_index, selected_index, selected_ref_id, sources)
+  ref_set         (stratum, leap, combined, ref_id, offset, offset_sd,
+                   frequency, skew, root_delay, root_dispersion)
+  clock_accumulate(dfreq, doffset, corr_rate, old_freq, new_freq)
+
+  */
+
+#ifndef GOT_USDT_H
+#define GOT_USDT_H
+
+#ifdef FEAT_USDT
+
+#include <sys/sdt.h>
+
+#define USDT_PROBE4(name, a1, a2, a3, a4) \
+  DTRACE_PROBE4(chronyd, name, a1, a2, a3, a4)
+#define USDT_PROBE5(name, a1, a2, a3, a4, a5) \
+  DTRACE_PROBE5(chronyd, name, a1, a2, a3, a4, a5)
+#define USDT_PROBE6(name, a1, a2, a3, a4, a5, a6) \
+  DTRACE_PROBE6(chronyd, name, a1, a2, a3, a4, a5, a6)
+#define USDT_PROBE8(name, a1, a2, a3, a4, a5, a6, a7, a8) \
+  DTRACE_PROBE8(chronyd, name, a1, a2, a3, a4, a5, a6, a7, a8)
+#define USDT_PROBE9(name, a1, a2, a3, a4, a5, a6, a7, a8, a9) \
+  DTRACE_PROBE9(chronyd, name, a1, a2, a3, a4, a5, a6, a7, a8, a9)
+#define USDT_PROBE10(name, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10) \
+  DTRACE_PROBE10(chronyd, name, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10)
+
+#else
+
+#define USDT_PROBE4(name, a1, a2, a3, a4)
+#define USDT_PROBE5(name, a1, a2, a3, a4, a5)
+#define USDT_PROBE6(name, a1, a2, a3, a4, a5, a6)
+#define USDT_PROBE8(name, a1, a2, a3, a4, a5, a6, a7, a8)
+#define USDT_PROBE9(name, a1, a2, a3, a4, a5, a6, a7, a8, a9)
+#define USDT_PROBE10(name, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10)
+
+#endif
+
+/* Convert seconds to integer nanoseconds and a relative frequency
+   (or rate) to integer parts per billion */
+#define USDT_NS(x) ((int64_t)((x) * 1.0e9))
+#define USDT_PPB(x) ((int64_t)((x) * 1.0e9))
+
+#endif /* GOT_USDT_H */